@@ -0,0 +1,429 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   ACQWRAPP.C                                                              */
+/*                                                                           */
+/*   Acquisition loop shared by the long running CLI modes. Parameter types, */
+/*   sample and read buffers are prepared once; a tick is then one          */
+/*   multi-channel GetChParam per due (slot, parameter) followed by one     */
+/*   put() per sink, with no formatting or allocation on the way. Every     */
+/*   read has its own period (--poll, else --period) on deadlines counted   */
+/*   from one start, so reads whose periods are multiples of each other     */
+/*   fall on the same ticks. The reads on the shortest period always go;   */
+/*   the others are held to a later tick when the link has already been     */
+/*   busy for --link-budget % of that period; once a full period late, one  */
+/*   of them per tick goes over the budget. Ticks are paced on absolute     */
+/*   CLOCK_MONOTONIC deadlines, so read time does not stretch the periods.  */
+/*                                                                           */
+/*****************************************************************************/
+#include <signal.h>
+#ifdef UNIX
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include "CAENHVWrapper.h"
+#include "CliWrapp.h"
+#include "AcqWrapp.h"
+
+/* one set of handlers for all the loops running (one per crate) */
+static volatile sig_atomic_t	stopReq;
+static pthread_mutex_t			sigLock = PTHREAD_MUTEX_INITIALIZER;
+static int						sigUsers;
+static struct sigaction			oldInt, oldTerm;
+
+static void on_stop(int sig)
+{
+	(void)sig;
+	stopReq = 1;
+}
+
+/* nested calls only count: the handlers stay until the outermost user is done */
+void acq_stop_handlers(int install)
+{
+	pthread_mutex_lock(&sigLock);
+	if(install && sigUsers++ == 0) {
+		struct sigaction sa;
+
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = on_stop;
+		sigemptyset(&sa.sa_mask);
+		stopReq = 0;
+		sigaction(SIGINT, &sa, &oldInt);
+		sigaction(SIGTERM, &sa, &oldTerm);
+	} else if(!install && --sigUsers == 0) {
+		sigaction(SIGINT, &oldInt, NULL);
+		sigaction(SIGTERM, &oldTerm, NULL);
+	}
+	pthread_mutex_unlock(&sigLock);
+}
+
+int acq_stopped(void)
+{
+	return stopReq != 0;
+}
+
+uint64_t acq_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int64_t mono_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* one --poll entry: NAME[@SLOT]=MS */
+typedef struct {
+	char	name[MAX_PARAM_NAME + 2];
+	int		slot;					/* -1: every slot */
+	int		ms;
+	int		used;
+} poll_ent_t;
+
+static int poll_parse(const char *spec, poll_ent_t *pe, FILE *err)
+{
+	const char	*p = spec;
+	int			n = 0;
+
+	while(*p != '\0') {
+		const char	*end = strchr(p, ','), *eq, *at;
+		size_t		len = end ? (size_t)(end - p) : strlen(p);
+		char		tok[64], *stop;
+		long		v;
+
+		if(len == 0 || len >= sizeof(tok) || n >= ACQ_MAX_POLL)
+			goto bad;
+		memcpy(tok, p, len);
+		tok[len] = '\0';
+		if((eq = strchr(tok, '=')) == NULL)
+			goto bad;
+		v = strtol(eq + 1, &stop, 10);
+		if(*stop != '\0' || v <= 0 || v > 86400000L)
+			goto bad;
+		pe[n].ms = (int)v;
+		pe[n].slot = -1;
+		pe[n].used = 0;
+		at = strchr(tok, '@');
+		if(at != NULL && at < eq) {
+			v = strtol(at + 1, &stop, 10);
+			if(stop != eq || v < 0 || v > 0xffff)
+				goto bad;
+			pe[n].slot = (int)v;
+		} else
+			at = eq;
+		if(at == tok || (size_t)(at - tok) > MAX_PARAM_NAME)
+			goto bad;
+		memcpy(pe[n].name, tok, (size_t)(at - tok));
+		pe[n].name[at - tok] = '\0';
+		n++;
+		p += len + (end ? 1 : 0);
+	}
+	return n;
+
+bad:
+	fprintf(err, "Invalid --poll '%s' (use PARAM[@SLOT]=MS,..., at most %d entries)\n", spec, ACQ_MAX_POLL);
+	return -1;
+}
+
+/* a slot entry wins over a parameter entry, which wins over --period */
+static int poll_period(poll_ent_t *pe, int nPoll, const char *name, int slot, int dflt)
+{
+	int i, ms = dflt, best = 0;
+
+	for(i = 0; i < nPoll; i++)
+		if(strcmp(pe[i].name, name) == 0 && (pe[i].slot < 0 || pe[i].slot == slot)) {
+			int rank = pe[i].slot < 0 ? 1 : 2;
+
+			pe[i].used = 1;
+			if(rank > best) {
+				best = rank;
+				ms = pe[i].ms;
+			}
+		}
+	return ms;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  ACQ_INIT                                                                 */
+/*  Parameter list from --get (VMon,IMon,ChStatus by default) plus the ones  */
+/*  named by --poll, types from the schema cache, buffers sized for the     */
+/*  whole target set, one read per target and parameter sorted by period.   */
+/*                                                                           */
+/*****************************************************************************/
+int acq_init(acq_t *a, cli_sess_t *s, cli_req_t *req, FILE *err)
+{
+	char		names[ACQ_MAX_PARAMS][MAX_PARAM_NAME + 2];
+	poll_ent_t	poll[ACQ_MAX_POLL];
+	int			nPoll = 0, p, t, i, k, maxCh = 0, total = 0;
+
+	memset(a, 0, sizeof(*a));
+	a->sess = s;
+	a->req = req;
+	a->periodMs = req->periodMs > 0 ? req->periodMs : ACQ_DEFAULT_PERIOD;
+	a->cycles = req->cycles;
+	a->budgetPct = req->linkBudget > 0 ? req->linkBudget : ACQ_DEFAULT_BUDGET;
+
+	if(req->poll != NULL && (nPoll = poll_parse(req->poll, poll, err)) < 0)
+		return 2;
+	a->nPar = cli_split_params(req->getParam ? req->getParam : ACQ_DEFAULT_PARAMS, names, ACQ_MAX_PARAMS);
+	if(a->nPar <= 0) {
+		fprintf(err, "Invalid parameter list '%s' (at most %d names)\n", req->getParam, ACQ_MAX_PARAMS);
+		return 2;
+	}
+	for(i = 0; i < nPoll; i++) {
+		for(p = 0; p < a->nPar && strcmp(names[p], poll[i].name) != 0; p++)
+			;
+		if(p < a->nPar)
+			continue;
+		if(a->nPar >= ACQ_MAX_PARAMS) {
+			fprintf(err, "--get and --poll name more than %d parameters\n", ACQ_MAX_PARAMS);
+			return 2;
+		}
+		strcpy(names[a->nPar++], poll[i].name);
+	}
+	if(req->nTargets <= 0)
+		return 2;
+	for(p = 0; p < a->nPar; p++) {
+		strcpy(a->par[p].name, names[p]);
+		CAENHVRESULT pr = cli_param_type(s, req->targets[0].slot, req->targets[0].ch[0],
+		                                 a->par[p].name, &a->par[p].type);
+		if(pr != CAENHV_OK) {
+			fprintf(err, "GetChParamProp('%s','Type') failed: %s (code %d)\n",
+			        a->par[p].name, CAENHV_GetError(s->handle), pr);
+			return (int)pr;
+		}
+	}
+
+	for(t = 0; t < req->nTargets; t++) {
+		total += req->targets[t].count;
+		if(req->targets[t].count > maxCh)
+			maxCh = req->targets[t].count;
+	}
+	a->nSmp = total * a->nPar;
+	a->nItems = req->nTargets * a->nPar;
+	a->smp = (acq_sample_t *)calloc((size_t)a->nSmp, sizeof(acq_sample_t));
+	a->out = (acq_sample_t *)calloc((size_t)a->nSmp, sizeof(acq_sample_t));
+	a->rd = (acq_sample_t *)calloc((size_t)a->nSmp, sizeof(acq_sample_t));
+	a->item = (acq_item_t *)calloc((size_t)a->nItems, sizeof(acq_item_t));
+	a->buf = malloc(sizeof(uint32_t) * (size_t)maxCh);
+	if(a->smp == NULL || a->out == NULL || a->rd == NULL || a->item == NULL || a->buf == NULL) {
+		fprintf(err, "Out of memory\n");
+		return 3;
+	}
+
+	/* samples laid out by target, parameter, channel; only time and value change later */
+	for(t = 0, i = 0, total = 0; t < req->nTargets; t++) {
+		const cli_target_t *tg = &req->targets[t];
+
+		for(p = 0; p < a->nPar; p++, i++) {
+			acq_item_t *it = &a->item[i];
+
+			it->t = t;
+			it->p = p;
+			it->base = total;
+			it->periodNs = (int64_t)poll_period(poll, nPoll, a->par[p].name, tg->slot, a->periodMs) * 1000000LL;
+			if(a->fastNs == 0 || it->periodNs < a->fastNs)
+				a->fastNs = it->periodNs;
+			for(k = 0; k < tg->count; k++, total++) {
+				acq_sample_t *sm = &a->smp[total];
+
+				sm->slot = tg->slot;
+				sm->ch = tg->ch[k];
+				sm->par = (uint16_t)p;
+				sm->type = (uint16_t)a->par[p].type;
+				sm->series = (uint32_t)total;
+			}
+		}
+	}
+	{
+		const char		*nm[ACQ_MAX_PARAMS];
+		unsigned long	ty[ACQ_MAX_PARAMS];
+
+		for(p = 0; p < a->nPar; p++) {
+			nm[p] = a->par[p].name;
+			ty[p] = a->par[p].type;
+		}
+		if((k = filt_init(&a->filt, req, nm, ty, a->nPar, a->nSmp, err)) != 0)
+			return k;
+	}
+	for(i = 0; i < nPoll; i++)
+		if(!poll[i].used)
+			fprintf(err, "--poll %s@%d: slot not read, ignored\n", poll[i].name, poll[i].slot);
+
+	/* fastest first (stable, so equal periods keep the layout order) */
+	for(i = 1; i < a->nItems; i++) {
+		acq_item_t it = a->item[i];
+
+		for(k = i; k > 0 && a->item[k - 1].periodNs > it.periodNs; k--)
+			a->item[k] = a->item[k - 1];
+		a->item[k] = it;
+	}
+	for(i = 0; i < a->nItems; i++) {
+		a->item[i].fast = a->item[i].periodNs == a->fastNs;
+		a->sched |= !a->item[i].fast;
+	}
+	return 0;
+}
+
+int acq_add_sink(acq_t *a, const acq_sink_t *sink)
+{
+	if(a->nSinks >= ACQ_MAX_SINKS)
+		return -1;
+	a->sink[a->nSinks++] = *sink;
+	return 0;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  ACQ_RUN                                                                  */
+/*  Ticks until stopped (or a.cycles ticks); each tick reads what is due.    */
+/*                                                                           */
+/*****************************************************************************/
+int acq_run(acq_t *a, FILE *err)
+{
+	struct timespec		ts;
+	cli_req_t			*req = a->req;
+	int					handle = a->sess->handle;
+	int64_t				start, wake, budgetNs = a->fastNs / 100 * a->budgetPct;
+	int					exitCode = 0, i, k, n, nRd, forced;
+	long				tick;
+
+	acq_stop_handlers(1);
+	start = mono_ns();
+	for(i = 0; i < a->nItems; i++) {
+		a->item[i].dueNs = start;
+		a->item[i].holdNs = 0;
+	}
+	for(tick = 0; !stopReq && (a->cycles <= 0 || tick < a->cycles); tick++) {
+		start = mono_ns();
+		n = nRd = 0;
+		forced = 0;
+		a->tickReads = a->tickFailed = 0;
+		for(i = 0; i < a->nItems && exitCode == 0; i++) {
+			acq_item_t			*it = &a->item[i];
+			const cli_target_t	*tg = &req->targets[it->t];
+			const char			*name = a->par[it->p].name;
+			CAENHVRESULT		gr;
+			int64_t				t0, t1;
+			uint64_t			tsNs;
+
+			if(it->dueNs > start + ACQ_MERGE_NS || it->holdNs > start + ACQ_MERGE_NS)
+				continue;
+			t0 = mono_ns();
+			if(!it->fast && (double)(t0 - start) + it->costNs > (double)budgetNs) {
+				/* over budget: one read a full period late may still go per tick */
+				if(forced || t0 - it->dueNs < it->periodNs) {
+					it->holdNs = start + a->fastNs;
+					it->deferred++;
+					continue;
+				}
+				forced = 1;
+			}
+			a->tickReads++;
+			gr = CAENHV_GetChParam(handle, tg->slot, name, (unsigned short)tg->count, tg->ch, a->buf);
+			tsNs = acq_now_ns();
+			t1 = mono_ns();
+			it->costNs = it->costNs == 0.0 ? (double)(t1 - t0) : 0.8 * it->costNs + 0.2 * (double)(t1 - t0);
+			it->holdNs = 0;
+			it->dueNs += it->periodNs;
+			if(it->dueNs <= t1)		/* missed deadlines are skipped, not caught up */
+				it->dueNs += ((t1 - it->dueNs) / it->periodNs + 1) * it->periodNs;
+
+			if(gr != CAENHV_OK) {
+				fprintf(err, "GetChParam('%s') slot %d failed: %s (code %d)\n",
+				        name, tg->slot, CAENHV_GetError(handle), gr);
+				a->tickFailed++;
+				if(cli_link_lost(gr) || gr == CAENHV_SYSCONFCHANGE)
+					exitCode = (int)gr;
+				continue;
+			}
+			it->reads++;
+			for(k = 0; k < tg->count; k++) {
+				acq_sample_t *sm = &a->smp[it->base + k];
+
+				sm->tsNs = tsNs;
+				sm->v.u = ((uint32_t *)a->buf)[k];
+				a->rd[nRd++] = *sm;
+				if(filt_pass(&a->filt, (int)sm->series, sm->par, sm->v.u, tsNs))
+					a->out[n++] = *sm;
+			}
+		}
+		/* a lost link still hands on what was read before it, a failed tick nothing */
+		for(i = 0; i < a->nSinks && a->tickReads > 0; i++) {
+			const acq_sink_t *sk = &a->sink[i];
+
+			if(sk->put(sk->ctx, sk->unfiltered ? a->rd : a->out, sk->unfiltered ? nRd : n) != 0) {
+				fprintf(err, "Acquisition stopped: sink %d failed\n", i);
+				if(exitCode == 0)
+					exitCode = 1;
+			}
+		}
+		if(exitCode != 0 || (a->cycles > 0 && tick + 1 >= a->cycles))
+			break;
+
+		/* next deadline; a late one starts the next tick at once */
+		for(i = 0, wake = INT64_MAX; i < a->nItems; i++) {
+			int64_t d = a->item[i].dueNs > a->item[i].holdNs ? a->item[i].dueNs : a->item[i].holdNs;
+
+			if(d < wake)
+				wake = d;
+		}
+		ts.tv_sec = (time_t)(wake / 1000000000LL);
+		ts.tv_nsec = (long)(wake % 1000000000LL);
+		if(wake > mono_ns())
+			while(!stopReq && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+				;
+	}
+
+	acq_stop_handlers(0);
+	return exitCode;
+}
+
+/* one line per read of the schedule, fastest first */
+void acq_report(const acq_t *a, FILE *out)
+{
+	int i;
+
+	for(i = 0; i < a->nItems; i++) {
+		const acq_item_t *it = &a->item[i];
+
+		fprintf(out, "  slot %-3d %-*s every %6lld ms: %ld read(s), %ld deferred, %.2f ms per call\n",
+		        a->req->targets[it->t].slot, MAX_PARAM_NAME, a->par[it->p].name,
+		        (long long)(it->periodNs / 1000000LL), it->reads, it->deferred, it->costNs / 1e6);
+	}
+}
+
+void acq_free(acq_t *a)
+{
+	int i;
+
+	for(i = 0; i < a->nSinks; i++)
+		if(a->sink[i].close)
+			a->sink[i].close(a->sink[i].ctx);
+	a->nSinks = 0;
+	filt_free(&a->filt);
+	free(a->smp);
+	free(a->out);
+	free(a->rd);
+	free(a->item);
+	free(a->buf);
+	a->smp = NULL;
+	a->out = NULL;
+	a->rd = NULL;
+	a->item = NULL;
+	a->buf = NULL;
+}
@@ -0,0 +1,102 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   ACQWRAPP.H                                                              */
+/*                                                                           */
+/*   Acquisition loop: periodic multi-channel reads of a parameter list on   */
+/*   the resolved targets, handed as binary samples to one or more sinks     */
+/*   (ring recorder, history writer, ...). With --poll each parameter (or    */
+/*   parameter of one slot) has its own period.                              */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef __ACQWRAPP_H
+#define __ACQWRAPP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "CliWrapp.h"
+#include "FiltWrapp.h"
+
+#define ACQ_MAX_PARAMS     (16)
+#define ACQ_MAX_SINKS      (4)
+#define ACQ_DEFAULT_PARAMS "VMon,IMon,ChStatus"
+#define ACQ_DEFAULT_PERIOD (1000)		/* ms */
+#define ACQ_MAX_POLL       (32)			/* --poll entries */
+#define ACQ_DEFAULT_BUDGET (80)			/* --link-budget: % of the fastest period */
+#define ACQ_MERGE_NS       (2000000LL)	/* reads due this close share a tick */
+
+/* one reading; 24 bytes, fixed layout (also the ring file record) */
+typedef struct {
+	uint64_t	tsNs;			/* CLOCK_REALTIME of the read, ns */
+	uint16_t	slot;
+	uint16_t	ch;
+	uint16_t	par;			/* index in the parameter table */
+	uint16_t	type;			/* PARAM_TYPE_* */
+	union {
+		float		f;			/* PARAM_TYPE_NUMERIC */
+		uint32_t	u;			/* everything else */
+	} v;
+	uint32_t	series;			/* (slot, ch, par) index, the same every cycle */
+} acq_sample_t;
+
+typedef struct {
+	char			name[MAX_PARAM_NAME + 2];
+	unsigned long	type;
+} acq_par_t;
+
+/* one multi-channel read: a parameter on one target, with its own period */
+typedef struct {
+	int				t, p;			/* target, parameter */
+	int				base;			/* first of its samples in smp[] */
+	int64_t			periodNs;
+	int64_t			dueNs;			/* next deadline, CLOCK_MONOTONIC */
+	int64_t			holdNs;			/* deferred: not before this */
+	double			costNs;			/* running mean of the call, 0 = unknown */
+	int				fast;			/* on the shortest period: never deferred */
+	long			reads, deferred;
+} acq_item_t;
+
+/* a consumer of read cycles; put() gets the samples read in one tick at once, none
+   (n == 0) when every read of the tick failed */
+typedef struct {
+	void	*ctx;
+	int		(*put)(void *ctx, const acq_sample_t *smp, int n);
+	void	(*close)(void *ctx);
+	int		unfiltered;		/* gets every sample read, past --deadband/--changes */
+} acq_sink_t;
+
+typedef struct {
+	cli_sess_t		*sess;
+	cli_req_t		*req;			/* targets already resolved */
+	acq_par_t		par[ACQ_MAX_PARAMS];
+	int				nPar;
+	int				periodMs;
+	long			cycles;			/* 0: until SIGINT/SIGTERM */
+	acq_sink_t		sink[ACQ_MAX_SINKS];
+	int				nSinks;
+	acq_sample_t	*smp;			/* latest value of every series */
+	int				nSmp;
+	acq_sample_t	*out;			/* the samples of one tick that passed the filter */
+	acq_sample_t	*rd;			/* and all of them, for the unfiltered sinks */
+	acq_item_t		*item;			/* fastest first */
+	int				nItems;
+	int				sched;			/* periods differ */
+	int64_t			fastNs;			/* shortest period */
+	int				budgetPct;
+	filt_t			filt;			/* --deadband/--changes on what the sinks get */
+	int				tickReads;		/* reads tried in the last tick */
+	int				tickFailed;		/* and how many of them failed */
+	void			*buf;			/* GetChParam scratch */
+} acq_t;
+
+int  acq_init(acq_t *a, cli_sess_t *s, cli_req_t *req, FILE *err);
+int  acq_add_sink(acq_t *a, const acq_sink_t *sink);
+int  acq_run(acq_t *a, FILE *err);
+void acq_report(const acq_t *a, FILE *out);
+void acq_free(acq_t *a);
+uint64_t acq_now_ns(void);
+void acq_stop_handlers(int install);
+int  acq_stopped(void);
+
+#endif // __ACQWRAPP_H
@@ -0,0 +1,458 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   BENCHWRAPP.C                                                            */
+/*                                                                           */
+/*   Each scenario is swept over the batch sizes: an operation covers the   */
+/*   next 'batch' channels of the slot (wrapping around), BENCH_WARMUP_OPS  */
+/*   are discarded and then --cycles operations are timed one by one. A     */
+/*   row gives p50/p99/max/mean per operation, operations, API calls and    */
+/*   channels per second, and the time one pass over all channels takes.    */
+/*                                                                           */
+/*     get    GetChParam, one parameter                                      */
+/*     typed  GetChParamProp('Type') before each GetChParam (no cache)       */
+/*     mix    GetChParam of every --get parameter for the same channels      */
+/*     set    SetChParam(BENCH_SET_PARAM), restored at the end               */
+/*     name   GetChName                                                      */
+/*     prop   GetChParamProp, cycling Type/Mode/Minval/Maxval/Unit/Exp       */
+/*     info   GetChParamInfo                                                 */
+/*     map    GetCrateMap                                                    */
+/*                                                                           */
+/*****************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "CAENHVWrapper.h"
+#include "CliWrapp.h"
+#include "BenchWrapp.h"
+
+enum { SC_GET, SC_TYPED, SC_MIX, SC_SET, SC_NAME, SC_PROP, SC_INFO, SC_MAP, SC_COUNT };
+
+static const char *scNames[SC_COUNT] = { "get", "typed", "mix", "set", "name", "prop", "info", "map" };
+static const char *propNames[] = { "Type", "Mode", "Minval", "Maxval", "Unit", "Exp" };
+#define BENCH_NPROPS ((int)(sizeof(propNames) / sizeof(propNames[0])))
+
+/* one measured point */
+typedef struct {
+	int				kind;
+	const char		*par[CLI_MAX_GET];
+	int				nPar;
+	int				batch;				/* channels per operation */
+} bench_point_t;
+
+typedef struct {
+	int				kind;
+	unsigned short	slot;
+	char			param[CLI_MAX_GET * (MAX_PARAM_NAME + 2)];
+	int				batch, callsPerOp, chunks;
+	long			ops;
+	double			p50, p99, max, mean;	/* us */
+	double			elapsed;				/* s */
+	double			channels;				/* over the timed operations */
+} bench_row_t;
+
+typedef struct {
+	cli_sess_t		*s;
+	unsigned short	slot;
+	unsigned short	*ch;
+	int				n;
+	long			ops;
+	int64_t			*lat;				/* ns, one per timed operation */
+	void			*buf;
+	float			*setVal;			/* BENCH_SET_PARAM as found */
+	bench_row_t		*rows;
+	int				nRows, capRows;
+	int				json;
+	FILE			*out, *err;
+} bench_t;
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp_i64(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+int hvbench_invoked(const char *argv0)
+{
+	const char *base;
+
+	if(argv0 == NULL)
+		return 0;
+	base = strrchr(argv0, '/');
+	base = base ? base + 1 : argv0;
+	return strcmp(base, HVBENCH_NAME) == 0;
+}
+
+/* operation i of a point; '*nCh' gets the channels it covered */
+static CAENHVRESULT bench_op(bench_t *b, const bench_point_t *pt, long i, int *nCh, int *calls)
+{
+	int				chunks = (b->n + pt->batch - 1) / pt->batch;
+	int				first = (int)(i % chunks) * pt->batch;
+	int				k = (b->n - first < pt->batch) ? b->n - first : pt->batch;
+	unsigned short	*ch = b->ch + first;
+	int				h = b->s->handle;
+	CAENHVRESULT	ret = CAENHV_OK;
+	int				p;
+
+	*nCh = k;
+	*calls = 1;
+	switch(pt->kind) {
+	case SC_TYPED: {
+		unsigned int type;					/* the library's 'ulong' */
+
+		*calls = 2;
+		if((ret = CAENHV_GetChParamProp(h, b->slot, ch[0], pt->par[0], "Type", &type)) != CAENHV_OK)
+			return ret;
+		return CAENHV_GetChParam(h, b->slot, pt->par[0], (unsigned short)k, ch, b->buf);
+	}
+	case SC_GET:
+		return CAENHV_GetChParam(h, b->slot, pt->par[0], (unsigned short)k, ch, b->buf);
+	case SC_MIX:
+		*calls = pt->nPar;
+		for(p = 0; p < pt->nPar && ret == CAENHV_OK; p++)
+			ret = CAENHV_GetChParam(h, b->slot, pt->par[p], (unsigned short)k, ch, b->buf);
+		return ret;
+	case SC_SET:
+		return CAENHV_SetChParam(h, b->slot, BENCH_SET_PARAM, (unsigned short)k, ch, &b->setVal[first]);
+	case SC_NAME:
+		return CAENHV_GetChName(h, b->slot, (unsigned short)k, ch, (char (*)[MAX_CH_NAME])b->buf);
+	case SC_PROP:
+		*nCh = 1;
+		return CAENHV_GetChParamProp(h, b->slot, b->ch[i % b->n], pt->par[0], propNames[i % BENCH_NPROPS], b->buf);
+	case SC_INFO: {
+		char	*list = NULL;
+		int		np = 0;
+
+		*nCh = 1;
+		ret = CAENHV_GetChParamInfo(h, b->slot, b->ch[i % b->n], &list, &np);
+		if(ret == CAENHV_OK)
+			CAENHV_Free(list);
+		return ret;
+	}
+	case SC_MAP: {
+		ushort	nSlots, *nrOfCh = NULL, *serNum = NULL;
+		char	*model = NULL, *desc = NULL;
+		uchar	*fwMin = NULL, *fwMax = NULL;
+
+		*nCh = 0;
+		ret = CAENHV_GetCrateMap(h, &nSlots, &nrOfCh, &model, &desc, &serNum, &fwMin, &fwMax);
+		if(ret == CAENHV_OK) {
+			CAENHV_Free(nrOfCh);
+			CAENHV_Free(model);
+			CAENHV_Free(desc);
+			CAENHV_Free(serNum);
+			CAENHV_Free(fwMin);
+			CAENHV_Free(fwMax);
+		}
+		return ret;
+	}
+	}
+	return CAENHV_INVALIDPARAMETER;
+}
+
+static void row_csv(FILE *out, const bench_row_t *r)
+{
+	double calls = (double)r->ops * r->callsPerOp;
+
+	fprintf(out, "%s,%d,%s,%d,%ld,%d,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.3f\n",
+	        scNames[r->kind], r->slot, r->param, r->batch, r->ops, r->callsPerOp,
+	        r->p50, r->p99, r->max, r->mean,
+	        r->ops / r->elapsed, calls / r->elapsed, r->channels / r->elapsed,
+	        r->mean * r->chunks / 1000.0);
+	fflush(out);
+}
+
+static void row_json(FILE *out, const bench_row_t *r, int last)
+{
+	double calls = (double)r->ops * r->callsPerOp;
+
+	fprintf(out, "    {\"scenario\": \"%s\", \"slot\": %d, \"param\": \"%s\", \"batch\": %d, "
+	        "\"ops\": %ld, \"calls_per_op\": %d, \"p50_us\": %.1f, \"p99_us\": %.1f, "
+	        "\"max_us\": %.1f, \"mean_us\": %.1f, \"ops_per_s\": %.1f, \"calls_per_s\": %.1f, "
+	        "\"ch_per_s\": %.1f, \"round_ms\": %.3f}%s\n",
+	        scNames[r->kind], r->slot, r->param, r->batch, r->ops, r->callsPerOp,
+	        r->p50, r->p99, r->max, r->mean,
+	        r->ops / r->elapsed, calls / r->elapsed, r->channels / r->elapsed,
+	        r->mean * r->chunks / 1000.0, last ? "" : ",");
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  BENCH_POINT                                                              */
+/*  Times one point. A failing call ends the point; the error is returned   */
+/*  so that a lost link stops the run.                                       */
+/*                                                                           */
+/*****************************************************************************/
+static CAENHVRESULT bench_point(bench_t *b, const bench_point_t *pt)
+{
+	bench_row_t		*r;
+	CAENHVRESULT	ret = CAENHV_OK;
+	int64_t			t0, t1, sum = 0;
+	double			channels = 0.0;
+	int				nCh = 0, calls = 1, p;
+	long			i;
+
+	for(i = 0; i < BENCH_WARMUP_OPS && ret == CAENHV_OK; i++)
+		ret = bench_op(b, pt, i, &nCh, &calls);
+	t0 = now_ns();
+	for(i = 0; i < b->ops && ret == CAENHV_OK; i++) {
+		int64_t t = now_ns();
+
+		ret = bench_op(b, pt, i, &nCh, &calls);
+		b->lat[i] = now_ns() - t;
+		sum += b->lat[i];
+		channels += nCh;
+	}
+	t1 = now_ns();
+	if(ret != CAENHV_OK) {
+		fprintf(b->err, "hvbench: %s %s (batch %d) on slot %d failed: %s (code %d)\n",
+		        scNames[pt->kind], pt->nPar > 0 ? pt->par[0] : "", pt->batch, b->slot,
+		        CAENHV_GetError(b->s->handle), ret);
+		return ret;
+	}
+
+	if(b->nRows == b->capRows) {
+		int			cap = b->capRows ? 2 * b->capRows : 32;
+		bench_row_t	*nr = (bench_row_t *)realloc(b->rows, sizeof(bench_row_t) * (size_t)cap);
+
+		if(nr == NULL) {
+			fprintf(b->err, "Out of memory\n");
+			return CAENHV_MEMORYFAULT;
+		}
+		b->rows = nr;
+		b->capRows = cap;
+	}
+	r = &b->rows[b->nRows++];
+	memset(r, 0, sizeof(*r));
+	r->kind = pt->kind;
+	r->slot = b->slot;
+	for(p = 0; p < pt->nPar; p++) {
+		if(p > 0)
+			strcat(r->param, "+");
+		strcat(r->param, pt->par[p]);
+	}
+	r->batch = pt->batch;
+	r->chunks = (pt->kind == SC_PROP || pt->kind == SC_INFO || pt->kind == SC_MAP)
+	          ? 1 : (b->n + pt->batch - 1) / pt->batch;
+	r->callsPerOp = calls;
+	r->ops = b->ops;
+	qsort(b->lat, (size_t)b->ops, sizeof(int64_t), cmp_i64);
+	r->p50 = b->lat[(b->ops - 1) * 50 / 100] / 1e3;
+	r->p99 = b->lat[(b->ops - 1) * 99 / 100] / 1e3;
+	r->max = b->lat[b->ops - 1] / 1e3;
+	r->mean = (double)sum / (double)b->ops / 1e3;
+	r->elapsed = (double)(t1 - t0) / 1e9;
+	r->channels = channels;
+	if(!b->json)
+		row_csv(b->out, r);
+	return CAENHV_OK;
+}
+
+/* --batch "1,8,all"; the default doubles from 1 to the channel count */
+static int parse_batches(const char *list, int n, int *batch, FILE *err)
+{
+	int nb = 0, i, b;
+
+	if(list == NULL) {
+		for(b = 1; b < n && nb < BENCH_MAX_BATCHES - 1; b *= 2)
+			batch[nb++] = b;
+		batch[nb++] = n;
+		return nb;
+	}
+	while(*list != '\0') {
+		size_t len = strcspn(list, ",");
+
+		b = (len == 3 && strncmp(list, "all", 3) == 0) ? n : atoi(list);
+		if(b <= 0) {
+			fprintf(err, "Invalid --batch item '%.*s'\n", (int)len, list);
+			return -1;
+		}
+		if(b > n)
+			b = n;
+		for(i = 0; i < nb && batch[i] != b; i++)
+			;
+		if(i == nb && nb < BENCH_MAX_BATCHES)
+			batch[nb++] = b;
+		list += len + (list[len] == ',');
+	}
+	return nb;
+}
+
+static int parse_scenarios(const char *list, int *want, FILE *err)
+{
+	int k;
+
+	memset(want, 0, sizeof(int) * SC_COUNT);
+	while(*list != '\0') {
+		size_t len = strcspn(list, ",");
+
+		for(k = 0; k < SC_COUNT; k++)
+			if(strlen(scNames[k]) == len && strncmp(scNames[k], list, len) == 0)
+				break;
+		if(k == SC_COUNT) {
+			fprintf(err, "Unknown --scenario '%.*s' (get, typed, mix, set, name, prop, info, map)\n", (int)len, list);
+			return -1;
+		}
+		want[k] = 1;
+		list += len + (list[len] == ',');
+	}
+	return 0;
+}
+
+/* the sweeps of one slot, in scenario order */
+static CAENHVRESULT bench_slot(bench_t *b, const int *want, char (*names)[MAX_PARAM_NAME + 2], int nNames,
+                               char (*mixNames)[MAX_PARAM_NAME + 2], int nMix, const int *batch, int nb)
+{
+	bench_point_t	pt;
+	CAENHVRESULT	ret = CAENHV_OK, rr;
+	int				k, p, j, calls = 0;
+
+	for(k = 0; k < SC_COUNT; k++) {
+		if(!want[k])
+			continue;
+		if(k == SC_SET) {
+			/* the values found are written back whatever happens */
+			rr = CAENHV_GetChParam(b->s->handle, b->slot, BENCH_SET_PARAM, (unsigned short)b->n, b->ch, b->setVal);
+			if(rr != CAENHV_OK) {
+				fprintf(b->err, "hvbench: reading %s on slot %d failed: %s (code %d), 'set' skipped\n",
+				        BENCH_SET_PARAM, b->slot, CAENHV_GetError(b->s->handle), rr);
+				if(cli_link_lost(rr))
+					return rr;
+				continue;
+			}
+		}
+		memset(&pt, 0, sizeof(pt));
+		pt.kind = k;
+		for(p = 0; p < (k == SC_MIX ? 1 : nNames); p++) {
+			if(k == SC_MIX) {
+				for(pt.nPar = 0; pt.nPar < nMix; pt.nPar++)
+					pt.par[pt.nPar] = mixNames[pt.nPar];
+			} else if(k == SC_SET) {
+				if(p > 0)
+					break;
+				pt.par[0] = BENCH_SET_PARAM;
+				pt.nPar = 1;
+			} else if(k == SC_NAME || k == SC_INFO || k == SC_MAP) {
+				if(p > 0)
+					break;
+				pt.nPar = 0;
+			} else {
+				pt.par[0] = names[p];
+				pt.nPar = 1;
+			}
+			for(j = 0; j < nb; j++) {
+				if((k == SC_PROP || k == SC_INFO || k == SC_MAP) && j > 0)
+					break;				/* not batched */
+				pt.batch = (k == SC_PROP || k == SC_INFO || k == SC_MAP) ? 1 : batch[j];
+				rr = bench_point(b, &pt);
+				if(rr != CAENHV_OK) {
+					ret = rr;
+					if(cli_link_lost(rr))
+						return rr;
+					break;				/* next parameter */
+				}
+			}
+		}
+		if(k == SC_SET) {
+			rr = cli_set_grouped(b->s, b->slot, BENCH_SET_PARAM, b->ch, b->setVal, b->n, &calls, b->err);
+			if(rr != CAENHV_OK)
+				ret = rr;
+		}
+	}
+	return ret;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  BENCH_RUN                                                                */
+/*  Every resolved slot in turn. CSV rows are printed as they complete; the */
+/*  JSON document is printed at the end.                                     */
+/*                                                                           */
+/*****************************************************************************/
+int bench_run(cli_sess_t *s, cli_req_t *req, FILE *out, FILE *err)
+{
+	char			names[CLI_MAX_GET][MAX_PARAM_NAME + 2], mixNames[CLI_MAX_GET][MAX_PARAM_NAME + 2];
+	int				want[SC_COUNT], batch[BENCH_MAX_BATCHES];
+	int				nNames, nMix, nb, t, i, exitCode = 0;
+	bench_t			b;
+
+	memset(&b, 0, sizeof(b));
+	b.s = s;
+	b.out = out;
+	b.err = err;
+	b.ops = req->cycles > 0 ? req->cycles : BENCH_DEFAULT_OPS;
+	if(req->format != NULL && strcmp(req->format, "json") != 0 && strcmp(req->format, "csv") != 0) {
+		fprintf(err, "hvbench: --format is csv or json\n");
+		return 2;
+	}
+	b.json = req->format != NULL && strcmp(req->format, "json") == 0;
+	if(parse_scenarios(req->benchScenario ? req->benchScenario : BENCH_DEFAULT_SCENARIOS, want, err) != 0)
+		return 2;
+	nNames = cli_split_params(req->getParam ? req->getParam : "VMon", names, CLI_MAX_GET);
+	/* a lone --get parameter says nothing about a mix: use the snapshot set */
+	nMix = nNames > 1 ? cli_split_params(req->getParam, mixNames, CLI_MAX_GET)
+	                  : cli_split_params(CLI_SNAPSHOT_PARAMS, mixNames, CLI_MAX_GET);
+	if(nNames <= 0 || nMix <= 0)
+		return 2;
+
+	b.lat = (int64_t *)malloc(sizeof(int64_t) * (size_t)b.ops);
+	if(b.lat == NULL) {
+		fprintf(err, "Out of memory\n");
+		return 3;
+	}
+	if(!b.json)
+		fprintf(out, "scenario,slot,param,batch,ops,calls_per_op,p50_us,p99_us,max_us,mean_us,"
+		             "ops_per_s,calls_per_s,ch_per_s,round_ms\n");
+
+	for(t = 0; t < req->nTargets && exitCode == 0; t++) {
+		CAENHVRESULT ret;
+
+		b.slot = req->targets[t].slot;
+		b.ch = req->targets[t].ch;
+		b.n = req->targets[t].count;
+		if(b.n <= 0)
+			continue;
+		if((nb = parse_batches(req->benchBatch, b.n, batch, err)) < 0) {
+			exitCode = 2;
+			break;
+		}
+		b.buf = malloc((size_t)b.n * MAX_CH_NAME + 64);
+		b.setVal = (float *)malloc(sizeof(float) * (size_t)b.n);
+		if(b.buf == NULL || b.setVal == NULL) {
+			fprintf(err, "Out of memory\n");
+			exitCode = 3;
+		} else {
+			ret = bench_slot(&b, want, names, nNames, mixNames, nMix, batch, nb);
+			if(ret != CAENHV_OK)
+				exitCode = (int)ret;
+		}
+		free(b.buf);
+		free(b.setVal);
+		b.buf = NULL;
+		b.setVal = NULL;
+	}
+
+	if(b.json) {
+		fprintf(out, "{\n  \"library\": \"%s\",\n  \"host\": \"%s\",\n  \"system\": %d,\n"
+		             "  \"ops_per_point\": %ld,\n  \"points\": [\n",
+		        CAENHVLibSwRel(), s->host, (int)s->sysType, b.ops);
+		for(i = 0; i < b.nRows; i++)
+			row_json(out, &b.rows[i], i == b.nRows - 1);
+		fprintf(out, "  ]\n}\n");
+	}
+	free(b.rows);
+	free(b.lat);
+	return exitCode;
+}
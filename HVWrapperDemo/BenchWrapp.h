@@ -0,0 +1,28 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   BENCHWRAPP.H                                                            */
+/*                                                                           */
+/*   hvbench (or --bench): latency of the CAENHV_* call patterns used by     */
+/*   the tools, swept over batch sizes, against whatever libcaenhvwrapper   */
+/*   is loaded (a crate, or the simulator of sim/).                          */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef __BENCHWRAPP_H
+#define __BENCHWRAPP_H
+
+#include <stdio.h>
+#include "CliWrapp.h"
+
+#define HVBENCH_NAME            "hvbench"
+#define BENCH_DEFAULT_OPS       (200)			/* samples per point (--cycles) */
+#define BENCH_WARMUP_OPS        (5)
+#define BENCH_DEFAULT_SCENARIOS "get,typed,mix,name,prop,info,map"
+#define BENCH_SET_PARAM         "RUp"			/* written and restored by 'set' */
+#define BENCH_MAX_BATCHES       (16)
+
+int hvbench_invoked(const char *argv0);
+int bench_run(cli_sess_t *s, cli_req_t *req, FILE *out, FILE *err);
+
+#endif // __BENCHWRAPP_H
@@ -0,0 +1,551 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   CACHEWRAPP.C                                                            */
+/*                                                                           */
+/*   Parameter metadata (schema) cache. Type, Mode, limits, unit and state   */
+/*   names of a parameter depend only on the board, so they are stored per   */
+/*   (model, serial, firmware) - the identity CAENHV_GetCrateMap reports     */
+/*   for each slot - in memory and in a small text file per board:           */
+/*                                                                           */
+/*     $HVWRAPP_CACHE_DIR, else $XDG_CACHE_HOME/hvwrapp,                     */
+/*     else $HOME/.cache/hvwrapp  /  <model>_<serial>_<fwmax>.<fwmin>.schema */
+/*                                                                           */
+/*   A handle costs one CAENHV_GetCrateMap when it is first used; after that */
+/*   known parameters are served without any crate access. A                 */
+/*   CAENHV_SYSCONFCHANGE answer drops the crate map and the schemas of the  */
+/*   boards of that crate.                                                   */
+/*                                                                           */
+/*****************************************************************************/
+#ifdef UNIX
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "CAENHVWrapper.h"
+#include "CacheWrapp.h"
+
+#define PCACHE_MAX_CRATES  (16)
+#define PCACHE_MAX_BOARDS  (128)
+#define PCACHE_MAGIC       "# hvwrapp schema 1"
+
+/* properties already known for an entry */
+#define PP_TYPE            (1u << 0)
+#define PP_ALL             (1u << 1)
+
+typedef struct {
+	char			name[MAX_PARAM_NAME + 2];
+	int				board;			/* 1: board parameter, 0: channel parameter */
+	unsigned		have;
+	ParProp			pp;
+} pc_entry_t;
+
+typedef struct {
+	char			model[16];
+	unsigned short	serial;
+	unsigned char	fwMax, fwMin;
+	int				loaded;			/* disk file already consulted */
+	pc_entry_t		*ent;
+	int				count, cap;
+} pc_board_t;
+
+typedef struct {
+	int				handle;			/* -1: free */
+	unsigned short	nrSlots;
+	unsigned short	*nrOfCh;		/* per slot */
+	short			*board;			/* per slot: index in boards[], -1 if empty */
+	unsigned long	used;			/* crate_get stamp, for eviction */
+} pc_crate_t;
+
+static pc_crate_t		crates[PCACHE_MAX_CRATES];
+static int				nCrates;
+static unsigned long	useClock;
+static pc_board_t		boards[PCACHE_MAX_BOARDS];
+static int				nBoards;
+static pthread_mutex_t	pcLock = PTHREAD_MUTEX_INITIALIZER;	/* the tables; never held across a crate call */
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Disk storage                                                             */
+/*                                                                           */
+/*****************************************************************************/
+int pcache_dir(char *buf, size_t len)
+{
+	const char *env = getenv("HVWRAPP_CACHE_DIR");
+	const char *xdg = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	char *p;
+
+	if(env != NULL && *env)
+		snprintf(buf, len, "%s", env);
+	else if(xdg != NULL && *xdg)
+		snprintf(buf, len, "%s/hvwrapp", xdg);
+	else if(home != NULL && *home)
+		snprintf(buf, len, "%s/.cache/hvwrapp", home);
+	else
+		return -1;
+
+	/* mkdir -p */
+	for(p = buf + 1; *p; p++)
+		if(*p == '/') {
+			*p = '\0';
+			mkdir(buf, 0755);
+			*p = '/';
+		}
+	if(mkdir(buf, 0755) != 0 && errno != EEXIST)
+		return -1;
+	return 0;
+}
+
+static int board_path(const pc_board_t *b, char *buf, size_t len)
+{
+	char	dir[512], model[sizeof(b->model)];
+	size_t	i;
+
+	if(pcache_dir(dir, sizeof(dir)) != 0)
+		return -1;
+	for(i = 0; b->model[i] && i < sizeof(model) - 1; i++)
+		model[i] = (isalnum((unsigned char)b->model[i]) || b->model[i] == '-') ? b->model[i] : '_';
+	model[i] = '\0';
+	snprintf(buf, len, "%s/%s_%u_%u.%u.schema", dir, model, b->serial, b->fwMax, b->fwMin);
+	return 0;
+}
+
+static pc_entry_t *board_add(pc_board_t *b, const char *name, int board)
+{
+	pc_entry_t *e;
+
+	if(b->count >= b->cap) {
+		int ncap = b->cap ? b->cap * 2 : 16;
+		pc_entry_t *n = (pc_entry_t *)realloc(b->ent, sizeof(*n) * (size_t)ncap);
+
+		if(n == NULL)
+			return NULL;
+		b->ent = n;
+		b->cap = ncap;
+	}
+	e = &b->ent[b->count++];
+	memset(e, 0, sizeof(*e));
+	snprintf(e->name, sizeof(e->name), "%s", name);
+	e->board = board;
+	return e;
+}
+
+/* next tab separated field; empty fields are kept */
+static char *next_field(char **s)
+{
+	char *f = *s;
+
+	if(f == NULL)
+		return "";
+	*s = strchr(f, '\t');
+	if(*s != NULL)
+		*(*s)++ = '\0';
+	f[strcspn(f, "\r\n")] = '\0';
+	return f;
+}
+
+/* line: B|C name have type mode minval maxval unit exp onstate offstate */
+static void board_load(pc_board_t *b)
+{
+	char	path[640], line[512];
+	FILE	*fp;
+
+	b->loaded = 1;
+	if(board_path(b, path, sizeof(path)) != 0 || (fp = fopen(path, "r")) == NULL)
+		return;
+	if(fgets(line, sizeof(line), fp) == NULL || strncmp(line, PCACHE_MAGIC, strlen(PCACHE_MAGIC))) {
+		fclose(fp);
+		return;
+	}
+	while(fgets(line, sizeof(line), fp)) {
+		char		*s = line, *kind, *name;
+		pc_entry_t	*e;
+
+		kind = next_field(&s);
+		name = next_field(&s);
+		if((kind[0] != 'B' && kind[0] != 'C') || *name == '\0' || strlen(name) > MAX_PARAM_NAME)
+			continue;
+		if((e = board_add(b, name, kind[0] == 'B')) == NULL)
+			break;
+		e->have         = (unsigned)strtoul(next_field(&s), NULL, 10);
+		e->pp.Type      = strtoul(next_field(&s), NULL, 10);
+		e->pp.Mode      = strtoul(next_field(&s), NULL, 10);
+		e->pp.MinVal    = strtof(next_field(&s), NULL);
+		e->pp.MaxVal    = strtof(next_field(&s), NULL);
+		e->pp.Unit      = (unsigned short)strtoul(next_field(&s), NULL, 10);
+		e->pp.Exp       = (short)strtol(next_field(&s), NULL, 10);
+		snprintf(e->pp.OnState, sizeof(e->pp.OnState), "%s", next_field(&s));
+		snprintf(e->pp.OffState, sizeof(e->pp.OffState), "%s", next_field(&s));
+	}
+	fclose(fp);
+}
+
+/* rewritten as a whole and renamed in place: readers never see half a file */
+static void board_save(const pc_board_t *b)
+{
+	char	path[640], tmp[700];
+	FILE	*fp;
+	int		i;
+
+	if(board_path(b, path, sizeof(path)) != 0)
+		return;
+	snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid());
+	if((fp = fopen(tmp, "w")) == NULL)
+		return;
+	fprintf(fp, "%s %s serial %u fw %u.%u\n", PCACHE_MAGIC, b->model, b->serial, b->fwMax, b->fwMin);
+	for(i = 0; i < b->count; i++) {
+		const pc_entry_t *e = &b->ent[i];
+
+		fprintf(fp, "%c\t%s\t%u\t%lu\t%lu\t%.9g\t%.9g\t%u\t%d\t%s\t%s\n",
+		        e->board ? 'B' : 'C', e->name, e->have, e->pp.Type, e->pp.Mode,
+		        (double)e->pp.MinVal, (double)e->pp.MaxVal, e->pp.Unit, e->pp.Exp,
+		        e->pp.OnState, e->pp.OffState);
+	}
+	if(fclose(fp) != 0 || rename(tmp, path) != 0)
+		unlink(tmp);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Crate map                                                                */
+/*                                                                           */
+/*****************************************************************************/
+static int board_find(const char *model, unsigned short serial, unsigned char fwMax, unsigned char fwMin)
+{
+	int i;
+
+	for(i = 0; i < nBoards; i++)
+		if(boards[i].serial == serial && boards[i].fwMax == fwMax && boards[i].fwMin == fwMin &&
+		   !strncmp(boards[i].model, model, sizeof(boards[i].model) - 1))
+			return i;
+	if(nBoards >= PCACHE_MAX_BOARDS)
+		return -1;
+	memset(&boards[nBoards], 0, sizeof(boards[nBoards]));
+	snprintf(boards[nBoards].model, sizeof(boards[nBoards].model), "%s", model);
+	boards[nBoards].serial = serial;
+	boards[nBoards].fwMax = fwMax;
+	boards[nBoards].fwMin = fwMin;
+	return nBoards++;
+}
+
+static void crate_drop(pc_crate_t *c)
+{
+	free(c->nrOfCh);
+	free(c->board);
+	c->nrOfCh = NULL;
+	c->board = NULL;
+	c->nrSlots = 0;
+	c->handle = -1;
+}
+
+static pc_crate_t *crate_find(int handle)
+{
+	int i;
+
+	for(i = 0; i < nCrates; i++)
+		if(crates[i].handle == handle)
+			return &crates[i];
+	return NULL;
+}
+
+/* a free entry of crates[]; with every one taken, the least recently used map
+   goes (it is read again on its next use) */
+static pc_crate_t *crate_slot(void)
+{
+	pc_crate_t	*c = NULL;
+	int			i;
+
+	for(i = 0; i < nCrates; i++) {
+		if(crates[i].handle == -1)
+			return &crates[i];
+		if(c == NULL || crates[i].used < c->used)
+			c = &crates[i];
+	}
+	if(nCrates < PCACHE_MAX_CRATES)
+		return &crates[nCrates++];
+	crate_drop(c);
+	return c;
+}
+
+/* crate of 'handle', reading its map on first use; NULL if not available.
+   Called with pcLock held, which is released around CAENHV_GetCrateMap */
+static pc_crate_t *crate_get(int handle, CAENHVRESULT *err)
+{
+	unsigned short	nrSlots = 0, *nrChList = NULL, *serList = NULL;
+	unsigned char	*fmwMinList = NULL, *fmwMaxList = NULL;
+	char			*modelList = NULL, *descList = NULL, *m;
+	pc_crate_t		*c;
+	int				i;
+
+	*err = CAENHV_OK;
+	if((c = crate_find(handle)) != NULL) {
+		c->used = ++useClock;
+		return c;
+	}
+
+	pthread_mutex_unlock(&pcLock);
+	*err = CAENHV_GetCrateMap(handle, &nrSlots, &nrChList, &modelList, &descList,
+	                          &serList, &fmwMinList, &fmwMaxList);
+	pthread_mutex_lock(&pcLock);
+	if(*err == CAENHV_FUNCTIONNOTAVAILABLE || *err == CAENHV_NOTYETIMPLEMENTED ||
+	   *err == CAENHV_INVALIDPARAMETER) {
+		/* no crate map on this system: remember it as a crate without boards */
+		nrSlots = 0;
+		*err = CAENHV_OK;
+	}
+	/* the table may have changed meanwhile: take an entry only now */
+	if(*err == CAENHV_OK && (c = crate_find(handle)) == NULL) {
+		c = crate_slot();
+		c->nrOfCh = (unsigned short *)calloc(nrSlots ? nrSlots : 1, sizeof(*c->nrOfCh));
+		c->board = (short *)calloc(nrSlots ? nrSlots : 1, sizeof(*c->board));
+		if(c->nrOfCh == NULL || c->board == NULL) {
+			crate_drop(c);
+			c = NULL;
+		} else {
+			c->handle = handle;
+			c->nrSlots = nrSlots;
+			c->used = ++useClock;
+			for(m = modelList, i = 0; m != NULL && i < nrSlots; i++, m += strlen(m) + 1) {
+				c->nrOfCh[i] = nrChList[i];
+				c->board[i] = (short)(*m && nrChList[i] ?
+				              board_find(m, serList[i], fmwMaxList[i], fmwMinList[i]) : -1);
+			}
+		}
+	}
+
+	if(nrChList)     CAENHV_Free(nrChList);
+	if(modelList)    CAENHV_Free(modelList);
+	if(descList)     CAENHV_Free(descList);
+	if(serList)      CAENHV_Free(serList);
+	if(fmwMinList)   CAENHV_Free(fmwMinList);
+	if(fmwMaxList)   CAENHV_Free(fmwMaxList);
+	return *err == CAENHV_OK ? c : NULL;
+}
+
+/* schema of the board in 'slot', or NULL when it cannot be identified */
+static pc_board_t *board_of(int handle, unsigned short slot)
+{
+	CAENHVRESULT	err;
+	pc_crate_t		*c = crate_get(handle, &err);
+	pc_board_t		*b;
+
+	if(c == NULL || slot >= c->nrSlots || c->board[slot] < 0)
+		return NULL;
+	b = &boards[c->board[slot]];
+	if(!b->loaded)
+		board_load(b);
+	return b;
+}
+
+static void invalidate_locked(int handle)
+{
+	pc_crate_t	*c = crate_find(handle);
+	char		path[640];
+	int			i;
+
+	if(c == NULL)
+		return;
+	for(i = 0; i < c->nrSlots; i++) {
+		pc_board_t *b;
+
+		if(c->board[i] < 0)
+			continue;
+		b = &boards[c->board[i]];
+		b->count = 0;
+		b->loaded = 1;				/* nothing to trust on disk either */
+		if(board_path(b, path, sizeof(path)) == 0)
+			unlink(path);
+	}
+	crate_drop(c);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Crate access                                                             */
+/*                                                                           */
+/*****************************************************************************/
+static CAENHVRESULT read_prop(int handle, unsigned short slot, unsigned short ch,
+                              const char *parName, const char *propName, void *val)
+{
+	if(ch == PCACHE_BOARD_CH)
+		return CAENHV_GetBdParamProp(handle, slot, parName, propName, val);
+	return CAENHV_GetChParamProp(handle, slot, ch, parName, propName, val);
+}
+
+/* fills the properties of 'want' missing from 'have' */
+static CAENHVRESULT fetch(int handle, unsigned short slot, unsigned short ch,
+                          const char *parName, unsigned want, unsigned *have, ParProp *pp)
+{
+	CAENHVRESULT	ret;
+	unsigned int	u;					/* the library's 'ulong' */
+
+	if(!(*have & PP_TYPE)) {
+		u = 0;
+		if((ret = read_prop(handle, slot, ch, parName, "Type", &u)) != CAENHV_OK)
+			return ret;
+		pp->Type = u;
+		*have |= PP_TYPE;
+	}
+	if((want & PP_ALL) && !(*have & PP_ALL)) {
+		u = 0;
+		if((ret = read_prop(handle, slot, ch, parName, "Mode", &u)) != CAENHV_OK)
+			return ret;
+		pp->Mode = u;
+		if(pp->Type == PARAM_TYPE_NUMERIC) {
+			if((ret = read_prop(handle, slot, ch, parName, "Minval", &pp->MinVal)) != CAENHV_OK ||
+			   (ret = read_prop(handle, slot, ch, parName, "Maxval", &pp->MaxVal)) != CAENHV_OK ||
+			   (ret = read_prop(handle, slot, ch, parName, "Unit", &pp->Unit)) != CAENHV_OK ||
+			   (ret = read_prop(handle, slot, ch, parName, "Exp", &pp->Exp)) != CAENHV_OK)
+				return ret;
+		} else if(pp->Type == PARAM_TYPE_ONOFF) {
+			if((ret = read_prop(handle, slot, ch, parName, "Onstate", pp->OnState)) != CAENHV_OK ||
+			   (ret = read_prop(handle, slot, ch, parName, "Offstate", pp->OffState)) != CAENHV_OK)
+				return ret;
+		}
+		*have |= PP_ALL;
+	}
+	return CAENHV_OK;
+}
+
+static pc_entry_t *entry_find(pc_board_t *b, const char *parName, int isBoard)
+{
+	int i;
+
+	for(i = 0; i < b->count; i++)
+		if(b->ent[i].board == isBoard && !strcmp(b->ent[i].name, parName))
+			return &b->ent[i];
+	return NULL;
+}
+
+static CAENHVRESULT lookup(int handle, unsigned short slot, unsigned short ch,
+                           const char *parName, unsigned want, ParProp *pp)
+{
+	CAENHVRESULT	ret = CAENHV_OK;
+	int				isBoard = (ch == PCACHE_BOARD_CH), retry;
+
+	pthread_mutex_lock(&pcLock);
+	for(retry = 0; retry < 2; retry++) {
+		pc_board_t	*b = board_of(handle, slot);
+		pc_entry_t	*e = b != NULL ? entry_find(b, parName, isBoard) : NULL;
+		ParProp		tmp;
+		unsigned	have = 0;
+
+		if(e != NULL && (e->have & want) == want) {
+			*pp = e->pp;
+			break;
+		}
+
+		/* miss: ask the crate, with the other handles free to go on */
+		memset(&tmp, 0, sizeof(tmp));
+		if(e != NULL) {
+			tmp = e->pp;
+			have = e->have;
+		}
+		pthread_mutex_unlock(&pcLock);
+		ret = fetch(handle, slot, ch, parName, want, &have, &tmp);
+		pthread_mutex_lock(&pcLock);
+		if(ret == CAENHV_SYSCONFCHANGE) {
+			invalidate_locked(handle);
+			continue;
+		}
+		if(ret != CAENHV_OK)
+			break;
+		*pp = tmp;
+
+		/* entries may have moved, or the crate been dropped, while unlocked */
+		if(crate_find(handle) == NULL || (b = board_of(handle, slot)) == NULL ||
+		   strlen(parName) > MAX_PARAM_NAME)
+			break;
+		if((e = entry_find(b, parName, isBoard)) == NULL)
+			e = board_add(b, parName, isBoard);
+		if(e != NULL && (have & e->have) == e->have) {
+			e->pp = tmp;
+			e->have = have;
+			board_save(b);
+		}
+		break;
+	}
+	pthread_mutex_unlock(&pcLock);
+	return ret;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Public functions                                                         */
+/*                                                                           */
+/*****************************************************************************/
+CAENHVRESULT pcache_ch_type(int handle, unsigned short slot, unsigned short ch,
+                            const char *parName, unsigned long *type)
+{
+	ParProp			pp;
+	CAENHVRESULT	ret = lookup(handle, slot, ch, parName, PP_TYPE, &pp);
+
+	if(ret == CAENHV_OK)
+		*type = pp.Type;
+	return ret;
+}
+
+CAENHVRESULT pcache_ch_prop(int handle, unsigned short slot, unsigned short ch,
+                            const char *parName, ParProp *pp)
+{
+	return lookup(handle, slot, ch, parName, PP_TYPE | PP_ALL, pp);
+}
+
+CAENHVRESULT pcache_nr_of_ch(int handle, unsigned short slot, unsigned short *nrOfCh)
+{
+	CAENHVRESULT	ret;
+	pc_crate_t		*c;
+
+	pthread_mutex_lock(&pcLock);
+	c = crate_get(handle, &ret);
+	if(c != NULL) {
+		if(slot < c->nrSlots && c->nrOfCh[slot] > 0)
+			*nrOfCh = c->nrOfCh[slot];
+		else
+			ret = CAENHV_SLOTNOTPRES;
+	} else if(ret == CAENHV_OK) {
+		ret = CAENHV_MEMORYFAULT;
+	}
+	pthread_mutex_unlock(&pcLock);
+	return ret;
+}
+
+CAENHVRESULT pcache_nr_of_slots(int handle, unsigned short *nrOfSlots)
+{
+	CAENHVRESULT	ret;
+	pc_crate_t		*c;
+
+	pthread_mutex_lock(&pcLock);
+	c = crate_get(handle, &ret);
+	if(c != NULL)
+		*nrOfSlots = c->nrSlots;
+	else if(ret == CAENHV_OK)
+		ret = CAENHV_MEMORYFAULT;
+	pthread_mutex_unlock(&pcLock);
+	return ret;
+}
+
+void pcache_invalidate(int handle)
+{
+	pthread_mutex_lock(&pcLock);
+	invalidate_locked(handle);
+	pthread_mutex_unlock(&pcLock);
+}
+
+void pcache_detach(int handle)
+{
+	pc_crate_t *c;
+
+	pthread_mutex_lock(&pcLock);
+	if((c = crate_find(handle)) != NULL)
+		crate_drop(c);
+	pthread_mutex_unlock(&pcLock);
+}
@@ -0,0 +1,100 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   CACHEWRAPP.H                                                            */
+/*                                                                           */
+/*   Parameter metadata (schema) cache, keyed by board model, serial number  */
+/*   and firmware release as reported by CAENHV_GetCrateMap.                 */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef __CACHEWRAPP_H
+#define __CACHEWRAPP_H
+
+#include <stddef.h>
+#include "CAENHVWrapper.h"
+
+#define PCACHE_BOARD_CH    (0xffff)		/* 'Ch' value selecting a board parameter */
+
+typedef struct ParPropTag
+			{
+				unsigned long	Type, Mode;
+				float			MinVal, MaxVal;
+				unsigned short	Unit;
+				short			Exp;
+				char			OnState[30], OffState[30];
+			} ParProp;
+
+/***------------------------------------------------------------------------
+
+  pcache_ch_type
+  "Type" property of a channel parameter (Ch = PCACHE_BOARD_CH for a board
+  parameter). Served from memory or from the on-disk cache when the board
+  is known; otherwise read from the crate and stored.
+  Return value:
+    the CAENHV_* result of the crate access, CAENHV_OK on a cache hit
+
+    --------------------------------------------------------------------***/
+CAENHVRESULT pcache_ch_type(int handle, unsigned short slot, unsigned short ch,
+                            const char *parName, unsigned long *type);
+
+/***------------------------------------------------------------------------
+
+  pcache_ch_prop
+  All the properties of a parameter (Type, Mode and, depending on the
+  type, Minval/Maxval/Unit/Exp or Onstate/Offstate).
+
+    --------------------------------------------------------------------***/
+CAENHVRESULT pcache_ch_prop(int handle, unsigned short slot, unsigned short ch,
+                            const char *parName, ParProp *pp);
+
+/***------------------------------------------------------------------------
+
+  pcache_nr_of_ch
+  Number of channels of the board in 'slot', from the crate map read when
+  the handle was first used.
+  Return value:
+    CAENHV_OK, CAENHV_SLOTNOTPRES for an empty slot, or the crate map error
+
+    --------------------------------------------------------------------***/
+CAENHVRESULT pcache_nr_of_ch(int handle, unsigned short slot, unsigned short *nrOfCh);
+
+/***------------------------------------------------------------------------
+
+  pcache_nr_of_slots
+  Number of slots of the crate (populated or not), from the same crate map.
+
+    --------------------------------------------------------------------***/
+CAENHVRESULT pcache_nr_of_slots(int handle, unsigned short *nrOfSlots);
+
+/***------------------------------------------------------------------------
+
+  pcache_invalidate
+  To be called when the crate answers CAENHV_SYSCONFCHANGE: forgets the
+  crate map and the schemas (memory and disk) of the boards of 'handle'.
+
+    --------------------------------------------------------------------***/
+void pcache_invalidate(int handle);
+
+/***------------------------------------------------------------------------
+
+  pcache_detach
+  Forgets the crate map of a handle that is being closed. Board schemas
+  stay available to other handles and later runs.
+
+    --------------------------------------------------------------------***/
+void pcache_detach(int handle);
+
+/***------------------------------------------------------------------------
+
+  pcache_dir
+  The cache directory ($HVWRAPP_CACHE_DIR, $XDG_CACHE_HOME/hvwrapp or
+  $HOME/.cache/hvwrapp), created if missing. Also holds the config plans
+  of CfgWrapp.
+  Return value:
+    0, or -1 when there is no usable directory
+
+    --------------------------------------------------------------------***/
+int pcache_dir(char *buf, size_t len);
+
+#endif // __CACHEWRAPP_H
@@ -0,0 +1,577 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   CFGWRAPP.C                                                              */
+/*                                                                           */
+/*   Channel config compiled into an apply plan. The file is read in one     */
+/*   go and tokenised in place; rows go to arrays sized from the line count, */
+/*   then each parameter's channels are sorted by value, so applying the     */
+/*   config is one SetChParam per (parameter, value) group without any      */
+/*   sorting. The header line names the parameter columns:                  */
+/*                                                                           */
+/*     ch  name   V0Set  I0Set  RUp  RDWn  Trip  PDwn                        */
+/*     0   T1C    900    500    50   50    1     Off                         */
+/*     1   T2C    900    500    -    -     1     Off                         */
+/*                                                                           */
+/*   without one the columns are V0Set I0Set. A cell is a number, On/Off,   */
+/*   or '-' to leave the parameter alone on that channel.                    */
+/*                                                                           */
+/*   The names, but for None placeholders, are indexed in sorted order for  */
+/*   --ch NAME and globs. The plan is a single blob, written as is to a     */
+/*   sidecar in the pcache directory:                                        */
+/*                                                                           */
+/*     <pcache dir>/config_<hash of the config path>.plan                    */
+/*                                                                           */
+/*   A sidecar is used while the config has the size, mtime and inode it    */
+/*   was compiled from and the skip list hashes the same; the blob carries  */
+/*   its own FNV-1a sum. Anything else and the config is parsed again.      */
+/*                                                                           */
+/*****************************************************************************/
+#ifdef UNIX
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "CAENHVWrapper.h"
+#include "CacheWrapp.h"
+#include "CfgWrapp.h"
+
+#define CFG_MAGIC          "HVCPLAN1"
+#define CFG_VERSION        (4)
+#define CFG_FNV_INIT       (0xcbf29ce484222325ull)
+#define CFG_DELIMS         " ,\t\r"
+
+/* the columns of a config without a header line */
+static const char *cfgDefPar[] = { "V0Set", "I0Set" };
+
+/* sidecar header, followed by the blob */
+typedef struct {
+	char		magic[8];
+	uint32_t	version, nPar;
+	uint64_t	srcSize, srcIno, srcDev;
+	int64_t		srcMtimeNs;
+	uint64_t	skipHash;			/* channels left out when compiling */
+	uint64_t	blobSize, blobSum;
+	int32_t		n, nGrp, nNamed;
+	char		par[CFG_MAX_PAR][MAX_PARAM_NAME + 2];
+} cfg_file_t;
+
+/* one row of one parameter while grouping */
+typedef struct {
+	float			val;
+	unsigned short	ch;
+} cfg_item_t;
+
+static uint64_t fnv1a(uint64_t h, const void *p, size_t len)
+{
+	const unsigned char *b = (const unsigned char *)p;
+
+	while(len--) {
+		h ^= *b++;
+		h *= 0x100000001b3ull;
+	}
+	return h;
+}
+
+/* one row of the name index while sorting */
+typedef struct {
+	const char		*name;
+	int				row;
+} cfg_name_t;
+
+/* by name, then by row: the index is the same from one compile to the next */
+static int name_cmp(const void *a, const void *b)
+{
+	const cfg_name_t *x = (const cfg_name_t *)a, *y = (const cfg_name_t *)b;
+	int c = strcmp(x->name, y->name);
+
+	return c != 0 ? c : x->row - y->row;
+}
+
+static int item_cmp(const void *a, const void *b)
+{
+	const cfg_item_t *x = (const cfg_item_t *)a, *y = (const cfg_item_t *)b;
+
+	if(x->val != y->val)
+		return x->val < y->val ? -1 : 1;
+	return (int)x->ch - (int)y->ch;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Plan blob                                                                */
+/*  Arrays by decreasing alignment: val, parGrp, byName, grp, ch, grpCh,    */
+/*  name.                                                                    */
+/*                                                                           */
+/*****************************************************************************/
+static size_t plan_size(int n, int nPar, int nGrp)
+{
+	return sizeof(float) * (size_t)nPar * (size_t)n + sizeof(int) * (size_t)(nPar + 1 + n)
+	     + sizeof(cfg_group_t) * (size_t)nGrp + sizeof(unsigned short) * (size_t)n
+	     + sizeof(unsigned short) * (size_t)nPar * (size_t)n + (size_t)MAX_CH_NAME * (size_t)n;
+}
+
+static void plan_bind(cfg_plan_t *pl)
+{
+	char *b = (char *)pl->blob;
+
+	pl->val = (float *)b;
+	b += sizeof(float) * (size_t)pl->nPar * (size_t)pl->n;
+	pl->parGrp = (int *)b;
+	b += sizeof(int) * (size_t)(pl->nPar + 1);
+	pl->byName = (int *)b;
+	b += sizeof(int) * (size_t)pl->n;
+	pl->grp = (cfg_group_t *)b;
+	b += sizeof(cfg_group_t) * (size_t)pl->nGrp;
+	pl->ch = (unsigned short *)b;
+	b += sizeof(unsigned short) * (size_t)pl->n;
+	pl->grpCh = (unsigned short *)b;
+	b += sizeof(unsigned short) * (size_t)pl->nPar * (size_t)pl->n;
+	pl->name = (char (*)[MAX_CH_NAME])b;
+}
+
+static cfg_plan_t *plan_alloc(int n, int nPar, int nGrp)
+{
+	cfg_plan_t *pl = (cfg_plan_t *)calloc(1, sizeof(cfg_plan_t));
+
+	if(pl == NULL)
+		return NULL;
+	pl->n = n;
+	pl->nPar = nPar;
+	pl->nGrp = nGrp;
+	pl->blobSize = plan_size(n, nPar, nGrp);
+	if((pl->blob = calloc(1, pl->blobSize)) == NULL) {
+		free(pl);
+		return NULL;
+	}
+	plan_bind(pl);
+	return pl;
+}
+
+void cfg_free(cfg_plan_t *plan)
+{
+	if(plan == NULL)
+		return;
+	free(plan->blob);
+	free(plan);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Parsing                                                                  */
+/*                                                                           */
+/*****************************************************************************/
+/* next token of a line, NUL terminated in place; NULL at the end */
+static char *next_tok(char **s)
+{
+	char *t = *s + strspn(*s, CFG_DELIMS);
+
+	if(*t == '\0')
+		return NULL;
+	*s = t + strcspn(t, CFG_DELIMS);
+	if(**s != '\0')
+		*(*s)++ = '\0';
+	return t;
+}
+
+/* strict: the whole token must be the number (header lines are skipped) */
+static int tok_ushort(const char *s, unsigned short *out)
+{
+	char			*endp;
+	unsigned long	v;
+
+	if(s == NULL)
+		return 0;
+	v = strtoul(s, &endp, 10);
+	if(endp == s || *endp != '\0' || v > 0xFFFF)
+		return 0;
+	*out = (unsigned short)v;
+	return 1;
+}
+
+/* a value cell: a number, On/Off, or '-' (or nothing) for not set (NAN) */
+static int tok_cell(const char *s, float *out)
+{
+	char	*endp;
+	double	v;
+
+	if(s == NULL || strcmp(s, "-") == 0) {
+		*out = NAN;
+		return 1;
+	}
+	if(strcasecmp(s, "On") == 0 || strcasecmp(s, "Off") == 0) {
+		*out = strcasecmp(s, "On") == 0 ? 1.0f : 0.0f;
+		return 1;
+	}
+	v = strtod(s, &endp);
+	if(endp == s || *endp != '\0' || isnan(v))
+		return 0;
+	*out = (float)v;
+	return 1;
+}
+
+static int skipped(unsigned short ch, const unsigned short *skip, int nSkip)
+{
+	int i;
+
+	for(i = 0; i < nSkip; i++)
+		if(skip[i] == ch)
+			return 1;
+	return 0;
+}
+
+/* the first column of a header line names the channel: ch, ch#, channel */
+static int header_first(const char *t)
+{
+	return strcasecmp(t, "ch") == 0 || strcasecmp(t, "ch#") == 0 || strcasecmp(t, "channel") == 0;
+}
+
+/* the parameter columns of a header line ( ch  name  PAR  PAR .. ), 's' past 'ch'; 0 if none */
+static int header_cols(char *s, char (*par)[MAX_PARAM_NAME + 2])
+{
+	char	*t;
+	int		nPar = 0;
+
+	if(next_tok(&s) == NULL)
+		return 0;
+	while((t = next_tok(&s)) != NULL) {
+		if(nPar == CFG_MAX_PAR || strlen(t) > MAX_PARAM_NAME)
+			return 0;
+		snprintf(par[nPar++], MAX_PARAM_NAME + 2, "%s", t);
+	}
+	return nPar;
+}
+
+/* 'text' (NUL terminated, modified) to a plan; NULL with '*rc' -2 when out of memory.
+   Lines left out are reported on 'err' (if not NULL) with the line number of 'path' */
+static cfg_plan_t *plan_compile(char *text, const unsigned short *skip, int nSkip, const char *path,
+                                FILE *err, int *rc)
+{
+	cfg_plan_t		*pl = NULL;
+	cfg_item_t		*it;
+	unsigned short	*rowCh;
+	char			(*rowName)[MAX_CH_NAME];
+	char			par[CFG_MAX_PAR][MAX_PARAM_NAME + 2];
+	float			*rowVal;
+	char			*line, *next;
+	int				maxRows = 1, n = 0, nPar = 0, nGrp = 0, lineNo = 0, p, k, g;
+	int				nSet[CFG_MAX_PAR];
+	cfg_name_t		*nm;
+
+	*rc = -2;
+	for(line = text; (line = strchr(line, '\n')) != NULL; line++)
+		maxRows++;
+	rowCh = (unsigned short *)malloc(sizeof(unsigned short) * (size_t)maxRows);
+	rowName = (char (*)[MAX_CH_NAME])malloc((size_t)MAX_CH_NAME * (size_t)maxRows);
+	rowVal = (float *)malloc(sizeof(float) * CFG_MAX_PAR * (size_t)maxRows);
+	it = (cfg_item_t *)malloc(sizeof(cfg_item_t) * (size_t)maxRows);
+	if(rowCh == NULL || rowName == NULL || rowVal == NULL || it == NULL)
+		goto out;
+
+	/* ch#  chName  PAR..: the columns are named by a 'ch' line before the data */
+	for(line = text; line != NULL; line = next) {
+		char			*s = line, *name, *first, *cell = NULL;
+		unsigned short	ch;
+		float			v[CFG_MAX_PAR];
+
+		if((next = strchr(line, '\n')) != NULL)
+			*next++ = '\0';
+		lineNo++;
+		s += strspn(s, " \t");
+		if(*s == '#' || (first = next_tok(&s)) == NULL)
+			continue;
+		if(!tok_ushort(first, &ch)) {
+			if(n == 0 && nPar == 0 && header_first(first))
+				nPar = header_cols(s, par);
+			else if(err != NULL)
+				fprintf(err, "%s:%d: '%s' is not a channel number, line skipped\n", path, lineNo, first);
+			continue;
+		}
+		if((name = next_tok(&s)) == NULL) {
+			if(err != NULL)
+				fprintf(err, "%s:%d: channel %u has no name, line skipped\n", path, lineNo, ch);
+			continue;
+		}
+		if(nPar == 0) {
+			for(nPar = 0; nPar < (int)(sizeof(cfgDefPar) / sizeof(cfgDefPar[0])); nPar++)
+				snprintf(par[nPar], sizeof(par[nPar]), "%s", cfgDefPar[nPar]);
+		}
+		for(p = 0; p < nPar; p++)
+			if(!tok_cell(cell = next_tok(&s), &v[p]))
+				break;
+		if(p < nPar) {
+			if(err != NULL)
+				fprintf(err, "%s:%d: invalid %s '%s' for channel %u, line skipped\n", path, lineNo,
+				        par[p], cell, ch);
+			continue;
+		}
+		if(skipped(ch, skip, nSkip))
+			continue;
+		rowCh[n] = ch;
+		snprintf(rowName[n], MAX_CH_NAME, "%s", name);
+		for(p = 0; p < nPar; p++)
+			rowVal[p * maxRows + n] = v[p];
+		n++;
+	}
+	*rc = 0;
+	if(n == 0)
+		goto out;
+
+	/* groups per (parameter, value): count them, then fill the plan */
+	for(p = 0; p < nPar; p++) {
+		for(k = 0, nSet[p] = 0; k < n; k++)
+			if(!isnan(rowVal[p * maxRows + k])) {
+				it[nSet[p]].val = rowVal[p * maxRows + k];
+				it[nSet[p]++].ch = rowCh[k];
+			}
+		qsort(it, (size_t)nSet[p], sizeof(cfg_item_t), item_cmp);
+		for(k = 0; k < nSet[p]; k++)
+			if(k == 0 || it[k].val != it[k - 1].val)
+				nGrp++;
+	}
+
+	if((pl = plan_alloc(n, nPar, nGrp)) == NULL) {
+		*rc = -2;
+		goto out;
+	}
+	memcpy(pl->ch, rowCh, sizeof(unsigned short) * (size_t)n);
+	memcpy(pl->name, rowName, (size_t)MAX_CH_NAME * (size_t)n);
+	for(p = 0, g = 0; p < nPar; p++) {
+		unsigned short *gc = pl->grpCh + p * n;
+
+		for(k = 0, nSet[p] = 0; k < n; k++)
+			if(!isnan(rowVal[p * maxRows + k])) {
+				it[nSet[p]].val = rowVal[p * maxRows + k];
+				it[nSet[p]++].ch = rowCh[k];
+			}
+		qsort(it, (size_t)nSet[p], sizeof(cfg_item_t), item_cmp);
+
+		snprintf(pl->par[p], sizeof(pl->par[p]), "%s", par[p]);
+		memcpy(pl->val + p * n, rowVal + p * maxRows, sizeof(float) * (size_t)n);
+		pl->parGrp[p] = g;
+		for(k = 0; k < nSet[p]; k++) {
+			if(k == 0 || it[k].val != it[k - 1].val) {
+				pl->grp[g].val = it[k].val;
+				pl->grp[g].first = p * n + k;
+				pl->grp[g].count = 0;
+				g++;
+			}
+			gc[k] = it[k].ch;
+			pl->grp[g - 1].count++;
+		}
+	}
+	pl->parGrp[nPar] = g;
+
+	/* the name index */
+	if((nm = (cfg_name_t *)malloc(sizeof(cfg_name_t) * (size_t)n)) == NULL) {
+		cfg_free(pl);
+		pl = NULL;
+		*rc = -2;
+		goto out;
+	}
+	for(k = 0; k < n; k++)
+		if(strcasecmp(pl->name[k], CFG_NONE_NAME) != 0) {
+			nm[pl->nNamed].name = pl->name[k];
+			nm[pl->nNamed++].row = k;
+		}
+	qsort(nm, (size_t)pl->nNamed, sizeof(cfg_name_t), name_cmp);
+	for(k = 0; k < pl->nNamed; k++)
+		pl->byName[k] = nm[k].row;
+	free(nm);
+	*rc = n;
+
+out:
+	free(rowCh);
+	free(rowName);
+	free(rowVal);
+	free(it);
+	return pl;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Sidecar                                                                  */
+/*                                                                           */
+/*****************************************************************************/
+static int sidecar_path(const char *path, char *buf, size_t len)
+{
+	char	dir[512], real[PATH_MAX];
+
+	if(pcache_dir(dir, sizeof(dir)) != 0)
+		return -1;
+	if(realpath(path, real) == NULL)
+		snprintf(real, sizeof(real), "%s", path);
+	snprintf(buf, len, "%s/config_%016llx.plan", dir,
+	         (unsigned long long)fnv1a(CFG_FNV_INIT, real, strlen(real)));
+	return 0;
+}
+
+static void sidecar_key(cfg_file_t *h, const struct stat *st, const unsigned short *skip, int nSkip)
+{
+	memset(h, 0, sizeof(*h));
+	memcpy(h->magic, CFG_MAGIC, sizeof(h->magic));
+	h->version = CFG_VERSION;
+	h->srcSize = (uint64_t)st->st_size;
+	h->srcIno = (uint64_t)st->st_ino;
+	h->srcDev = (uint64_t)st->st_dev;
+	h->srcMtimeNs = (int64_t)st->st_mtim.tv_sec * 1000000000ll + st->st_mtim.tv_nsec;
+	h->skipHash = fnv1a(CFG_FNV_INIT, skip, sizeof(unsigned short) * (size_t)nSkip);
+}
+
+static cfg_plan_t *sidecar_load(const char *file, const cfg_file_t *key)
+{
+	cfg_file_t	h;
+	cfg_plan_t	*pl = NULL;
+	FILE		*fp;
+
+	if((fp = fopen(file, "rb")) == NULL)
+		return NULL;
+	if(fread(&h, sizeof(h), 1, fp) != 1 || memcmp(h.magic, key->magic, sizeof(h.magic))
+	|| h.version != key->version || h.nPar == 0 || h.nPar > CFG_MAX_PAR || h.srcSize != key->srcSize
+	|| h.srcIno != key->srcIno || h.srcDev != key->srcDev || h.srcMtimeNs != key->srcMtimeNs
+	|| h.skipHash != key->skipHash || h.n <= 0 || h.nGrp < 0 || h.nNamed < 0 || h.nNamed > h.n
+	|| h.blobSize != plan_size(h.n, (int)h.nPar, h.nGrp))
+		goto out;
+	if((pl = plan_alloc(h.n, (int)h.nPar, h.nGrp)) == NULL)
+		goto out;
+	if(fread(pl->blob, pl->blobSize, 1, fp) != 1
+	|| fnv1a(CFG_FNV_INIT, pl->blob, pl->blobSize) != h.blobSum) {
+		cfg_free(pl);
+		pl = NULL;
+		goto out;
+	}
+	memcpy(pl->par, h.par, sizeof(pl->par));
+	pl->nNamed = h.nNamed;
+	pl->cached = 1;
+out:
+	fclose(fp);
+	return pl;
+}
+
+/* written whole and renamed in place, as the pcache schemas; the temporary
+   name is unique, so concurrent writers never share it */
+static void sidecar_save(const char *file, cfg_file_t *key, const cfg_plan_t *pl)
+{
+	char	tmp[700];
+	FILE	*fp;
+	int		fd;
+
+	key->n = pl->n;
+	key->nPar = (uint32_t)pl->nPar;
+	key->nGrp = pl->nGrp;
+	key->nNamed = pl->nNamed;
+	key->blobSize = pl->blobSize;
+	key->blobSum = fnv1a(CFG_FNV_INIT, pl->blob, pl->blobSize);
+	memcpy(key->par, pl->par, sizeof(key->par));
+	snprintf(tmp, sizeof(tmp), "%s.XXXXXX", file);
+	if((fd = mkstemp(tmp)) < 0)
+		return;
+	if((fp = fdopen(fd, "wb")) == NULL) {
+		close(fd);
+		unlink(tmp);
+		return;
+	}
+	if(fwrite(key, sizeof(*key), 1, fp) != 1 || fwrite(pl->blob, pl->blobSize, 1, fp) != 1) {
+		fclose(fp);
+		unlink(tmp);
+		return;
+	}
+	if(fclose(fp) != 0 || rename(tmp, file) != 0)
+		unlink(tmp);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  CFG_MATCH                                                                */
+/*                                                                           */
+/*****************************************************************************/
+int cfg_match(const cfg_plan_t *plan, const char *pattern, int *rows, int max)
+{
+	size_t	pre = strcspn(pattern, "*?[\\");
+	int		glob = pattern[pre] != '\0', lo = 0, hi = plan->nNamed, found = 0, i;
+
+	/* first name not below the literal prefix */
+	while(lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if(strncmp(plan->name[plan->byName[mid]], pattern, pre) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for(i = lo; i < plan->nNamed; i++) {
+		const char *name = plan->name[plan->byName[i]];
+
+		if(strncmp(name, pattern, pre) != 0)
+			break;
+		if(glob ? fnmatch(pattern, name, 0) != 0 : strcmp(name, pattern) != 0)
+			continue;
+		if(found < max)
+			rows[found] = plan->byName[i];
+		found++;
+	}
+	return found;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  CFG_LOAD                                                                 */
+/*                                                                           */
+/*****************************************************************************/
+int cfg_load(const char *path, const unsigned short *skip, int nSkip, int useCache,
+             cfg_plan_t **plan, FILE *err)
+{
+	struct stat	st;
+	cfg_file_t	key;
+	char		file[640], *text;
+	ssize_t		got = 0;
+	int			fd, rc;
+
+	*plan = NULL;
+	if((fd = open(path, O_RDONLY)) < 0)
+		return -1;
+	if(fstat(fd, &st) != 0) {
+		close(fd);
+		return -1;
+	}
+	sidecar_key(&key, &st, skip, nSkip);
+	if(useCache && sidecar_path(path, file, sizeof(file)) != 0)
+		useCache = 0;
+	if(useCache && (*plan = sidecar_load(file, &key)) != NULL) {
+		close(fd);
+		return (*plan)->n;
+	}
+
+	if((text = (char *)malloc((size_t)st.st_size + 1)) == NULL) {
+		close(fd);
+		return -2;
+	}
+	while(got < st.st_size) {
+		ssize_t r = read(fd, text + got, (size_t)(st.st_size - got));
+
+		if(r < 0 && errno == EINTR)
+			continue;
+		if(r <= 0)
+			break;
+		got += r;
+	}
+	close(fd);
+	text[got] = '\0';
+
+	*plan = plan_compile(text, skip, nSkip, path, err, &rc);
+	free(text);
+	if(*plan != NULL && useCache)
+		sidecar_save(file, &key, *plan);
+	return rc;
+}
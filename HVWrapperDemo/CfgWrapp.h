@@ -0,0 +1,88 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   CFGWRAPP.H                                                              */
+/*                                                                           */
+/*   Channel config (config.txt) compiled once into an apply plan: the      */
+/*   channels, their names and the values of the header-declared parameter  */
+/*   columns, with the channels grouped by (parameter, value) for           */
+/*   multi-channel SetChParam.                                               */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef __CFGWRAPP_H
+#define __CFGWRAPP_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "CAENHVWrapper.h"
+
+#define CFG_MAX_PAR        (32)			/* parameter columns */
+#define CFG_NONE_NAME      "None"		/* placeholder row: not in the name index */
+
+/* the channels of one parameter sharing one value */
+typedef struct {
+	float			val;
+	int				first, count;		/* grpCh[first .. first + count - 1] */
+} cfg_group_t;
+
+/* every array lives in 'blob', one allocation, as stored in the sidecar */
+typedef struct cfg_plan {
+	int				n;					/* channel rows, in file order */
+	int				nPar;
+	char			par[CFG_MAX_PAR][MAX_PARAM_NAME + 2];
+	unsigned short	*ch;				/* [n] */
+	char			(*name)[MAX_CH_NAME];	/* [n] */
+	float			*val;				/* [nPar * n]: row k of parameter p at val[p * n + k], NAN: not set */
+	int				*parGrp;			/* [nPar + 1]: groups of p are grp[parGrp[p] .. parGrp[p + 1] - 1] */
+	int				*byName;			/* [nNamed]: rows sorted by name, without None rows */
+	cfg_group_t		*grp;				/* [nGrp] */
+	unsigned short	*grpCh;				/* [nPar * n]: channels set, by value, per parameter */
+	int				nGrp;
+	int				nNamed;
+	int				cached;				/* 1: read from the sidecar, not parsed */
+	void			*blob;
+	size_t			blobSize;
+} cfg_plan_t;
+
+/***------------------------------------------------------------------------
+
+  cfg_load
+  Compiles the config 'path' ( ch#  chName  PAR.., whitespace or commas;
+  '#' comments skipped; the parameter columns are named by the header line,
+  V0Set I0Set without one ), leaving out the 'nSkip' channels of 'skip'.
+  With 'useCache' the plan is read from, or written to, a sidecar in the
+  pcache directory, valid while the config keeps its size, mtime and inode
+  and the skip list is the same. Lines that are neither the header nor a
+  valid channel row are reported on 'err' (NULL: silently) as PATH:LINE
+  when the config is parsed; the header is a line before the data whose
+  first column is ch (ch#, channel).
+  Return value:
+    the number of channels (0: none, '*plan' left NULL), -1 when the file
+    cannot be opened, -2 when out of memory
+
+    --------------------------------------------------------------------***/
+int  cfg_load(const char *path, const unsigned short *skip, int nSkip, int useCache,
+              cfg_plan_t **plan, FILE *err);
+
+/***------------------------------------------------------------------------
+
+  cfg_match
+  The rows whose name matches 'pattern', an exact name or a glob ( * ? [..] ),
+  in name order. The literal prefix of the pattern is looked up by binary
+  search in the name index; only the names under it are matched.
+  Return value:
+    the number of rows found; the first 'max' are stored in 'rows'
+
+    --------------------------------------------------------------------***/
+int  cfg_match(const cfg_plan_t *plan, const char *pattern, int *rows, int max);
+
+/***------------------------------------------------------------------------
+
+  cfg_free
+  Frees a plan from cfg_load (NULL is allowed).
+
+    --------------------------------------------------------------------***/
+void cfg_free(cfg_plan_t *plan);
+
+#endif // __CFGWRAPP_H
@@ -0,0 +1,1954 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   CLIWRAPP.C                                                              */
+/*                                                                           */
+/*   Non-interactive command line front end. Parsing and execution are kept  */
+/*   apart so that a request can run either on a private session (one login  */
+/*   per process) or on a session held open by hvwrappd.                     */
+/*                                                                           */
+/*****************************************************************************/
+#ifdef UNIX
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <time.h>
+#include <math.h>
+#include "CAENHVWrapper.h"
+#include "CacheWrapp.h"
+#include "CliWrapp.h"
+#include "DaemWrapp.h"
+#include "MultiWrapp.h"
+#include "WatchWrapp.h"
+#include "AcqWrapp.h"
+#include "RecWrapp.h"
+#include "HistWrapp.h"
+#include "ExpWrapp.h"
+#include "RampWrapp.h"
+#include "BenchWrapp.h"
+#include "TripWrapp.h"
+#include "FmtWrapp.h"
+#include "CfgWrapp.h"
+#include "FiltWrapp.h"
+
+/* =========================
+   Default CLI configuration
+   ========================= */
+#define DEFAULT_SYSTEM	SY2527
+#define DEFAULT_LINK	LINKTYPE_TCPIP
+#define DEFAULT_HOST	"192.168.1.2"
+#define DEFAULT_USER	"admin"
+#define DEFAULT_PASS	"admin"
+#define DEFAULT_SLOT	1
+
+/* ----------------------------------------
+   Channels to exclude when using '--ch all'
+   Edit the list below to skip channels.
+   Example: { 3, 7, 15 }
+   ---------------------------------------- */
+#define EXCLUDED_CH_COUNT 0
+static const unsigned short EXCLUDED_CH[EXCLUDED_CH_COUNT] = { };
+
+static int is_channel_excluded(unsigned short ch)
+{
+	for(int i = 0; i < EXCLUDED_CH_COUNT; i++)
+		if(EXCLUDED_CH[i] == ch)
+			return 1;
+	return 0;
+}
+
+/* Default config file paths (first existing one will be used) */
+#define DEFAULT_CONFIG_PATH1 "../config/config.txt"
+#define DEFAULT_CONFIG_PATH2 "config.txt"
+
+/* strict token parsers to validate numeric fields (avoid treating headers as data) */
+static int parse_ushort_token(const char *s, unsigned short *out)
+{
+	char *endp = NULL;
+	if(s == NULL || *s == '\0') return 0;
+	unsigned long v = strtoul(s, &endp, 10);
+	if(endp == s || *endp != '\0') return 0;
+	if(v > 0xFFFF) return 0;
+	*out = (unsigned short)v;
+	return 1;
+}
+
+static int parse_float_token(const char *s, float *out)
+{
+	char *endp = NULL;
+	if(s == NULL || *s == '\0') return 0;
+	double v = strtod(s, &endp);
+	if(endp == s || *endp != '\0') return 0;
+	*out = (float)v;
+	return 1;
+}
+
+/* the config plan of a request: compiled (or read from its sidecar) on first
+   use, then shared by the channel list, '--ch all' and the config apply */
+const cfg_plan_t *cli_config(cli_req_t *req, FILE *err)
+{
+	cfg_plan_t *pl = NULL;
+
+	if(req->cfgLoaded)
+		return req->cfg;
+	req->cfgLoaded = 1;
+	if(req->configPath == NULL
+	|| cfg_load(req->configPath, EXCLUDED_CH, EXCLUDED_CH_COUNT, !req->noCfgCache, &pl, err) < 0)
+		if(cfg_load(DEFAULT_CONFIG_PATH1, EXCLUDED_CH, EXCLUDED_CH_COUNT, !req->noCfgCache, &pl, err) < 0)
+			cfg_load(DEFAULT_CONFIG_PATH2, EXCLUDED_CH, EXCLUDED_CH_COUNT, !req->noCfgCache, &pl, err);
+	req->cfg = pl;
+	return pl;
+}
+
+static int str_ieq(const char *a, const char *b) {
+	if(a == NULL || b == NULL) return 0;
+	while(*a && *b) {
+		char ca = (char)tolower((unsigned char)*a++);
+		char cb = (char)tolower((unsigned char)*b++);
+		if(ca != cb) return 0;
+	}
+	return *a == '\0' && *b == '\0';
+}
+
+static int parse_system_type(const char *s, CAENHV_SYSTEM_TYPE_t *out) {
+	if(s == NULL || out == NULL) return -1;
+	if(str_ieq(s, "SY1527")) { *out = SY1527; return 0; }
+	if(str_ieq(s, "SY2527")) { *out = SY2527; return 0; }
+	if(str_ieq(s, "SY4527")) { *out = SY4527; return 0; }
+	if(str_ieq(s, "SY5527")) { *out = SY5527; return 0; }
+	if(str_ieq(s, "V65XX"))  { *out = V65XX;  return 0; }
+	if(str_ieq(s, "N1470"))  { *out = N1470;  return 0; }
+	if(str_ieq(s, "V8100"))  { *out = V8100;  return 0; }
+	if(str_ieq(s, "N568E"))  { *out = N568E;  return 0; }
+	if(str_ieq(s, "DT55XX")) { *out = DT55XX; return 0; }
+	if(str_ieq(s, "DT55XXE")){ *out = DT55XXE;return 0; }
+	if(str_ieq(s, "SMARTHV")){ *out = SMARTHV;return 0; }
+	if(str_ieq(s, "NGPS"))   { *out = NGPS;   return 0; }
+	if(str_ieq(s, "N1068"))  { *out = N1068;  return 0; }
+	if(str_ieq(s, "N1168"))  { *out = N1168;  return 0; }
+	if(str_ieq(s, "R6060"))  { *out = R6060;  return 0; }
+	return -1;
+}
+
+static int parse_link_type(const char *s, int *outLinkType) {
+	if(s == NULL || outLinkType == NULL) return -1;
+	if(str_ieq(s, "tcpip"))      { *outLinkType = LINKTYPE_TCPIP;    return 0; }
+	if(str_ieq(s, "rs232"))      { *outLinkType = LINKTYPE_RS232;    return 0; }
+	if(str_ieq(s, "caenet"))     { *outLinkType = LINKTYPE_CAENET;   return 0; }
+	if(str_ieq(s, "usb"))        { *outLinkType = LINKTYPE_USB;      return 0; }
+	if(str_ieq(s, "optlink") || str_ieq(s, "optical") || str_ieq(s, "optical_link")) { *outLinkType = LINKTYPE_OPTLINK; return 0; }
+	if(str_ieq(s, "usbvcp") || str_ieq(s, "usb_vcp")) { *outLinkType = LINKTYPE_USB_VCP; return 0; }
+	if(str_ieq(s, "usb3"))       { *outLinkType = LINKTYPE_USB3;     return 0; }
+	if(str_ieq(s, "a4818"))      { *outLinkType = LINKTYPE_A4818;    return 0; }
+	return -1;
+}
+
+/* --ch item: "N", "SLOT:N", "SLOT:all", "all", or config names and globs
+   ("T*C", "3:Trig1,Trig2") left in 'name' for cli_resolve_names */
+static int parse_addr_token(const char *s, cli_addr_t *out)
+{
+	const char *colon = strchr(s, ':');
+	unsigned short v;
+	char slotTok[16];
+
+	out->slot = -1;
+	out->ch = -1;
+	out->name = NULL;
+	if(colon != NULL) {
+		size_t len = (size_t)(colon - s);
+		if(len == 0 || len >= sizeof(slotTok)) return -1;
+		memcpy(slotTok, s, len);
+		slotTok[len] = '\0';
+		if(!parse_ushort_token(slotTok, &v)) return -1;
+		out->slot = v;
+		s = colon + 1;
+	}
+	if(str_ieq(s, "all"))
+		return 0;
+	if(*s == '\0') return -1;
+	if(!parse_ushort_token(s, &v)) {
+		out->name = s;
+		return 0;
+	}
+	out->ch = v;
+	return 0;
+}
+
+/* the --ch names: each item of a comma list is matched in the config name
+   index and becomes one address per channel found, on the item's slot; a
+   numeric item ("0,1,2") is a channel index and needs no config */
+static int cli_resolve_names(cli_req_t *req, FILE *err)
+{
+	const cfg_plan_t *cfg = NULL;
+	cli_addr_t *na = NULL;
+	int *rows = NULL;
+	int i, n = 0, cap = 0;
+
+	for(i = 0; i < req->addrCount && req->addrs[i].name == NULL; i++);
+	if(i == req->addrCount)
+		return 0;
+
+	for(i = 0; i < req->addrCount; i++) {
+		const cli_addr_t *a = &req->addrs[i];
+		const char *p = a->name;
+		char pat[64];
+		unsigned short v = 0;
+		int found = 1;
+
+		do {
+			size_t len = p ? strcspn(p, ",") : 0;
+			int idx = 0;
+
+			if(p != NULL) {
+				if(len == 0 || len >= sizeof(pat)) {
+					fprintf(err, "Invalid channel name in '%s'\n", a->name);
+					free(na);
+					free(rows);
+					return 2;
+				}
+				memcpy(pat, p, len);
+				pat[len] = '\0';
+				idx = parse_ushort_token(pat, &v);
+			}
+			if(p != NULL && !idx) {
+				if(cfg == NULL && (cfg = cli_config(req, err)) == NULL) {
+					fprintf(err, "Channel names need a config: '%s' not resolved (see --config)\n", pat);
+					free(na);
+					return 2;
+				}
+				if(rows == NULL && (rows = (int*)malloc(sizeof(int) * (size_t)cfg->n)) == NULL) {
+					fprintf(err, "Out of memory\n");
+					free(na);
+					return 3;
+				}
+				if((found = cfg_match(cfg, pat, rows, cfg->n)) == 0) {
+					fprintf(err, "No channel named '%s' in the config\n", pat);
+					free(na);
+					free(rows);
+					return 2;
+				}
+			} else
+				found = 1;
+			if(n + found > cap) {
+				int ncap = (n + found) * 2;
+				cli_addr_t *nb = (cli_addr_t*)realloc(na, sizeof(cli_addr_t) * (size_t)ncap);
+
+				if(!nb) {
+					fprintf(err, "Out of memory\n");
+					free(na);
+					free(rows);
+					return 3;
+				}
+				na = nb;
+				cap = ncap;
+			}
+			for(int k = 0; k < found; k++) {
+				na[n].slot = a->slot;
+				na[n].ch = p == NULL ? a->ch : idx ? v : cfg->ch[rows[k]];
+				na[n].name = NULL;
+				n++;
+			}
+			p = (p && p[len] == ',') ? p + len + 1 : NULL;
+		} while(p != NULL);
+	}
+	free(rows);
+	free(req->addrs);
+	req->addrs = na;
+	req->addrCount = n;
+	return 0;
+}
+
+static int is_flag(const char *s) {
+	return (s && s[0] == '-' && s[1] == '-');
+}
+
+static void print_cli_usage(FILE *err, const char *prog) {
+	fprintf(err,
+		"Usage (CLI mode): %s --ch 0 1 2 3 \\\n"
+		"                  --V0Set 650 --Pw On\n"
+		"       (read)     %s --ch 0 1 --IMon\n"
+		"       (read)     %s --ch 0 1 --VMon\n"
+		"       (read)     %s --ch 0 1 --ChStatus\n"
+		"       (read all) %s --ch all --IMon\n"
+		"       (read all) %s --ch all --VMon\n"
+		"       (read all) %s --ch all --ChStatus\n"
+		"       (slots)    %s --ch 1:0 1:1 3:all --VMon\n"
+		"       (crate)    %s --slot all --ch all --get VMon,IMon\n"
+		"       (multi)    %s --ch all --get VMon,IMon,ChStatus,Pw | --snapshot\n"
+		"       (formats)  %s --slot all --ch all --get VMon,IMon --format json|csv|bin [--cycles N] [--period MS]\n"
+		"       (Pw all)   %s --ch all --Pw On | Off\n"
+		"       (Pw all)   %s --ch all --PwOn | --PwOff\n"
+		"       (config)   %s --Pw On|Off [--config FILE] [--no-config-cache]   (per-channel parameters from config)\n"
+		"       (diff)     %s --diff --Pw On   (writes only the values that differ)\n"
+		"       (names)    %s --ch 'T*C' Trig1,Trig2 --VMon | --sync-names   (config names and globs)\n"
+		"       (watch)    %s --ch all --watch [--get VMon,IMon] [--port N] [--watch-poll MS]\n"
+		"       (crates)   %s --host 10.0.0.1,10.0.0.2 --ch all --snapshot\n"
+		"       (record)   %s --ch all --record FILE [--get VMon,IMon] [--period MS] [--ring N] [--cycles N]\n"
+		"       (dump)     %s --rec-dump FILE [--follow]\n"
+		"       (history)  %s --ch all --history FILE [--get VMon,IMon] [--period MS] [--record FILE]\n"
+		"       (export)   %s --hist-export FILE | --hist-index FILE [--ch ...] [--get P,..] [--from S] [--to S]\n"
+		"       (bench)    %s --hist-bench [--cycles POINTS]\n"
+		"       (ramp)     %s --ch all --ramp-to 1500 [--tol 1] [--timeout 600]\n"
+		"       (exporter) %s --slot all --ch all --exporter [--listen [ADDR:]PORT] [--period MS]\n"
+		"                  [--poll IMon=200,VMon@3=5000,..] [--link-budget PCT]   (record/history/exporter)\n"
+		"                  [--deadband VMon=0.5,IMon=2%%,Pw | --changes] [--heartbeat S]   (watch/record/history/cycles)\n"
+		"       (trips)    %s --slot all --ch all --trips [--trip-bits Trip,ExtTrip] [--trip-off ch|slot|all]\n"
+		"                  [--trip-exec CMD] [--period MS] [--record FILE]\n"
+		"       (hvbench)  %s --bench [--ch ...] [--get VMon,IMon] [--batch 1,8,all] [--scenario get,typed,set,..]\n"
+		"                  [--cycles N] [--format csv|json]   (same as running 'hvbench')\n"
+		"       (daemon)   %s --daemon [--socket PATH]   (same as running 'hvwrappd')\n"
+		"\n"
+		"Notes:\n"
+		"- Connection defaults to TCP/IP host 192.168.1.2 (--host, --link to change).\n"
+		"- System defaults to SY2527, login to admin/admin, slot to 1 (--system, --user/--pass, --slot).\n"
+		"- --ch items are N (on --slot), SLOT:N, SLOT:all or all; '--slot all' applies plain\n"
+		"  items to every populated slot. Each slot costs one multi-channel call per parameter.\n"
+		"- You can provide multiple parameter assignments: any --<ParamName> <value> is applied to all channels.\n"
+		"- --get accepts a comma separated list; all parameters are read in one session and\n"
+		"  printed one row per channel, followed by the first-to-last read skew.\n"
+		"- --format json|csv|bin prints --get reads for programs: a JSON line per slot read,\n"
+		"  CSV rows with a header, or 24-byte records after a --record header (--rec-dump reads\n"
+		"  them). Each cycle is written at once; --cycles N repeats it every --period ms, on\n"
+		"  one --host and without hvwrappd, so every cycle is printed when it is read.\n"
+		"- --watch prints VMon/IMon/ChStatus/Pw only when the crate reports a change; items the\n"
+		"  crate cannot push are polled every --watch-poll ms (default 1000). Not run by hvwrappd.\n"
+		"- --diff reads the current values first (one multi-channel GetChParam per parameter)\n"
+		"  and writes only the channels that differ.\n"
+		"- --host accepts a comma separated list: the crates are logged in and served in\n"
+		"  parallel, one thread each; output lines are prefixed with their host.\n"
+		"- --record appends binary samples (time, slot, ch, parameter, value) to a preallocated\n"
+		"  memory-mapped ring of --ring samples (default 1M, 24 bytes each) every --period ms\n"
+		"  (default 1000) until SIGINT/SIGTERM. With several hosts, %%h in FILE is replaced by\n"
+		"  the host (else '.host' is appended). --rec-dump prints a ring, also while recording.\n"
+		"- --history keeps the same samples compressed (delta-of-delta times, XOR values) in\n"
+		"  chunks of up to 720 points per series, for months of data; it can run alone or\n"
+		"  next to --record. --hist-export prints CSV, --from/--to in epoch seconds.\n"
+		"- --exporter serves Prometheus/OpenMetrics gauges (VMon, IMon, Pw, ChStatus or --get)\n"
+		"  on http://127.0.0.1:9780/metrics from a mirror refreshed every --period ms; scrapes\n"
+		"  never reach the crate.\n"
+		"- --poll gives parameters (PARAM=MS) or parameters of one slot (PARAM@SLOT=MS) their\n"
+		"  own period; the rest use --period. The slower reads wait for a later tick when the\n"
+		"  link has been busy for --link-budget %% (default 80) of the fastest period.\n"
+		"- --deadband keeps a sample only when it moved more than ABS (or PCT%% of the last\n"
+		"  value kept) away from the last one kept; a bare name, or --changes for every\n"
+		"  parameter, keeps changes only. A sample is kept anyway every --heartbeat s\n"
+		"  (default 60, 0 = never). Applies to --watch output, --record/--history samples and\n"
+		"  --get --cycles rows (a row is printed when one of its filtered parameters is kept).\n"
+		"  The interactive loop mode redraws in place and is not filtered.\n"
+		"- --trips reads ChStatus every --period ms (default 100) and reports each status\n"
+		"  change; a --trip-bits bit (default Trip,ExtTrip) going on is a trip. --trip-off\n"
+		"  then sets Pw Off on the channel, its slot or all channels read (one call per slot),\n"
+		"  --trip-exec runs CMD with HV_SLOT, HV_CH, HV_STATUS, HV_BITS, HV_HOST set.\n"
+		"  ChStatus values read with --get or --watch are printed with their bit names.\n"
+		"- --ramp-to sets V0Set, switches the channels on and reads VMon until all are within\n"
+		"  --tol V (default 1); reads are spaced by the time RUp/RDWn predict, 0.1 to 5 s.\n"
+		"- --bench times get/typed/mix/name/prop/info/map (and set, which restores RUp) over\n"
+		"  batch sizes 1..N and prints p50/p99/max latency and rates as CSV or JSON.\n"
+		"- --ch also takes config names and globs (T*C, SLOT:Trig1,Trig2), resolved through an index\n"
+		"  of the config's chName column (None rows left out); --sync-names writes those names to\n"
+		"  the crate where CAENHV_GetChName differs, one SetChName per distinct name.\n"
+		"- If hvwrappd is running, requests are served over its socket without a new login\n"
+		"  (--socket PATH or $HVWRAPPD_SOCKET to choose it, --no-daemon to bypass it).\n"
+		"- If no arguments are provided, the interactive ncurses demo UI is started.\n",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo",
+		prog ? prog : "HVWrappdemo");
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  CLI_PARSE                                                                */
+/*  Returns 0 when the request is runnable, otherwise the process exit code. */
+/*                                                                           */
+/*****************************************************************************/
+int cli_parse(int argc, char **argv, cli_req_t *req, FILE *err)
+{
+	int i;
+
+	memset(req, 0, sizeof(*req));
+	req->heartbeatS = -1;
+	req->sysType = DEFAULT_SYSTEM;
+	req->linkType = DEFAULT_LINK;
+	req->slot = -1;
+	req->daemon = hvwrappd_invoked(argv[0]);
+	req->bench = hvbench_invoked(argv[0]);
+
+	for(i = 1; i < argc; i++) {
+		if(str_ieq(argv[i], "--help")) {
+			print_cli_usage(err, argv[0]);
+			return 1;
+		} else if(str_ieq(argv[i], "--daemon")) {
+			req->daemon = 1;
+		} else if(str_ieq(argv[i], "--diff")) {
+			req->diff = 1;
+		} else if(str_ieq(argv[i], "--no-daemon")) {
+			req->noDaemon = 1;
+		} else if(str_ieq(argv[i], "--watch")) {
+			req->watch = 1;
+		} else if(str_ieq(argv[i], "--port") && i+1 < argc) {
+			req->watchPort = atoi(argv[++i]);
+		} else if(str_ieq(argv[i], "--watch-poll") && i+1 < argc) {
+			req->watchPollMs = atoi(argv[++i]);
+		} else if(str_ieq(argv[i], "--record") && i+1 < argc) {
+			req->recordPath = argv[++i];
+		} else if(str_ieq(argv[i], "--ring") && i+1 < argc) {
+			req->ringSize = atol(argv[++i]);
+		} else if(str_ieq(argv[i], "--rec-dump") && i+1 < argc) {
+			req->recDump = argv[++i];
+		} else if(str_ieq(argv[i], "--history") && i+1 < argc) {
+			req->histPath = argv[++i];
+		} else if(str_ieq(argv[i], "--hist-export") && i+1 < argc) {
+			req->histExport = argv[++i];
+		} else if(str_ieq(argv[i], "--hist-index") && i+1 < argc) {
+			req->histExport = argv[++i];
+			req->histIndex = 1;
+		} else if(str_ieq(argv[i], "--hist-bench")) {
+			req->histBench = 1;
+		} else if(str_ieq(argv[i], "--from") && i+1 < argc) {
+			req->fromSec = atof(argv[++i]);
+		} else if(str_ieq(argv[i], "--to") && i+1 < argc) {
+			req->toSec = atof(argv[++i]);
+		} else if(str_ieq(argv[i], "--exporter")) {
+			req->exporter = 1;
+		} else if(str_ieq(argv[i], "--listen") && i+1 < argc) {
+			req->listen = argv[++i];
+		} else if(str_ieq(argv[i], "--ramp-to") && i+1 < argc) {
+			if(!parse_float_token(argv[++i], &req->rampTo)) {
+				fprintf(err, "Invalid --ramp-to '%s'\n", argv[i]);
+				return 2;
+			}
+			req->ramp = 1;
+		} else if(str_ieq(argv[i], "--tol") && i+1 < argc) {
+			if(!parse_float_token(argv[++i], &req->rampTol) || req->rampTol <= 0.0f) {
+				fprintf(err, "Invalid --tol '%s'\n", argv[i]);
+				return 2;
+			}
+		} else if(str_ieq(argv[i], "--timeout") && i+1 < argc) {
+			req->rampTimeout = atoi(argv[++i]);
+		} else if(str_ieq(argv[i], "--follow")) {
+			req->follow = 1;
+		} else if(str_ieq(argv[i], "--period") && i+1 < argc) {
+			req->periodMs = atoi(argv[++i]);
+		} else if(str_ieq(argv[i], "--cycles") && i+1 < argc) {
+			req->cycles = atol(argv[++i]);
+		} else if(str_ieq(argv[i], "--poll") && i+1 < argc) {
+			req->poll = argv[++i];
+		} else if(str_ieq(argv[i], "--deadband") && i+1 < argc) {
+			req->deadband = argv[++i];
+		} else if(str_ieq(argv[i], "--changes")) {
+			req->changes = 1;
+		} else if(str_ieq(argv[i], "--heartbeat") && i+1 < argc) {
+			req->heartbeatS = atoi(argv[++i]);
+			if(req->heartbeatS < 0) {
+				fprintf(err, "Invalid --heartbeat '%s' (seconds, 0 = none)\n", argv[i]);
+				return 2;
+			}
+		} else if(str_ieq(argv[i], "--trips")) {
+			req->trips = 1;
+		} else if(str_ieq(argv[i], "--trip-bits") && i+1 < argc) {
+			uint32_t mask;
+
+			req->tripBits = argv[++i];
+			if(trip_parse_bits(req->tripBits, &mask) != 0) {
+				fprintf(err, "Invalid --trip-bits '%s' (ChStatus bit names like Trip,ExtTrip,OverCurrent, or a mask)\n",
+				        argv[i]);
+				return 2;
+			}
+		} else if(str_ieq(argv[i], "--trip-off") && i+1 < argc) {
+			req->tripOff = trip_parse_off(argv[++i]);
+			if(req->tripOff < 0) {
+				fprintf(err, "Invalid --trip-off '%s' (ch, slot or all)\n", argv[i]);
+				return 2;
+			}
+		} else if(str_ieq(argv[i], "--trip-exec") && i+1 < argc) {
+			req->tripExec = argv[++i];
+		} else if(str_ieq(argv[i], "--link-budget") && i+1 < argc) {
+			req->linkBudget = atoi(argv[++i]);
+			if(req->linkBudget <= 0 || req->linkBudget > 100) {
+				fprintf(err, "Invalid --link-budget '%s' (1..100 %%)\n", argv[i]);
+				return 2;
+			}
+		} else if(str_ieq(argv[i], "--bench")) {
+			req->bench = 1;
+		} else if(str_ieq(argv[i], "--batch") && i+1 < argc) {
+			req->benchBatch = argv[++i];
+		} else if(str_ieq(argv[i], "--scenario") && i+1 < argc) {
+			req->benchScenario = argv[++i];
+		} else if(str_ieq(argv[i], "--format") && i+1 < argc) {
+			req->format = argv[++i];
+		} else if(str_ieq(argv[i], "--socket") && i+1 < argc) {
+			req->sockPath = argv[++i];
+		} else if(str_ieq(argv[i], "--system") && i+1 < argc) {
+			if(parse_system_type(argv[i+1], &req->sysType) != 0) {
+				fprintf(err, "Unknown --system '%s'\n", argv[i+1]);
+				return 2;
+			}
+			i++;
+		} else if(str_ieq(argv[i], "--link") && i+1 < argc) {
+			if(parse_link_type(argv[i+1], &req->linkType) != 0) {
+				fprintf(err, "Unknown --link '%s'\n", argv[i+1]);
+				return 2;
+			}
+			i++;
+		} else if(str_ieq(argv[i], "--host") && i+1 < argc) {
+			req->host = argv[++i];
+		} else if(str_ieq(argv[i], "--user") && i+1 < argc) {
+			req->user = argv[++i];
+		} else if(str_ieq(argv[i], "--pass") && i+1 < argc) {
+			req->pass = argv[++i];
+		} else if(str_ieq(argv[i], "--slot") && i+1 < argc) {
+			if(str_ieq(argv[++i], "all"))
+				req->slotAll = 1;
+			else
+				req->slot = atoi(argv[i]);
+		} else if(str_ieq(argv[i], "--config") && i+1 < argc) {
+			req->configPath = argv[++i];
+		} else if(str_ieq(argv[i], "--no-config-cache")) {
+			req->noCfgCache = 1;
+		} else if(str_ieq(argv[i], "--sync-names")) {
+			req->syncNames = 1;
+		} else if(str_ieq(argv[i], "--get") && i+1 < argc) {
+			req->getParam = argv[++i];
+		} else if(str_ieq(argv[i], "--snapshot")) {
+			req->getParam = CLI_SNAPSHOT_PARAMS;
+		} else if(str_ieq(argv[i], "--IMon")) {
+			req->getParam = "IMon";
+		} else if(str_ieq(argv[i], "--VMon")) {
+			req->getParam = "VMon";
+		} else if(str_ieq(argv[i], "--ChStatus")) {
+			req->getParam = "ChStatus";
+		} else if(str_ieq(argv[i], "--PwOn")) {
+			if(req->paramCount >= CLI_MAX_PARAMS) {
+				fprintf(err, "Too many parameters specified\n");
+				return 2;
+			}
+			snprintf(req->params[req->paramCount].name, sizeof(req->params[req->paramCount].name), "%s", "Pw");
+			snprintf(req->params[req->paramCount].value, sizeof(req->params[req->paramCount].value), "%s", "On");
+			req->paramCount++;
+		} else if(str_ieq(argv[i], "--PwOff")) {
+			if(req->paramCount >= CLI_MAX_PARAMS) {
+				fprintf(err, "Too many parameters specified\n");
+				return 2;
+			}
+			snprintf(req->params[req->paramCount].name, sizeof(req->params[req->paramCount].name), "%s", "Pw");
+			snprintf(req->params[req->paramCount].value, sizeof(req->params[req->paramCount].value), "%s", "Off");
+			req->paramCount++;
+		} else if(str_ieq(argv[i], "--ch")) {
+			int j = i + 1;
+			int count = 0;
+			while(j + count < argc && !is_flag(argv[j + count])) count++;
+			if(count <= 0) {
+				fprintf(err, "Expected one or more channel indices after --ch\n");
+				return 2;
+			}
+			cli_addr_t *na = (cli_addr_t*)realloc(req->addrs, sizeof(cli_addr_t) * (size_t)(req->addrCount + count));
+			if(!na) {
+				fprintf(err, "Out of memory\n");
+				return 3;
+			}
+			req->addrs = na;
+			for(int k = 0; k < count; k++) {
+				if(parse_addr_token(argv[j + k], &req->addrs[req->addrCount]) != 0) {
+					fprintf(err, "Invalid channel '%s' (use N, SLOT:N, SLOT:all, all or config names)\n", argv[j + k]);
+					return 2;
+				}
+				req->addrCount++;
+			}
+			i = j + count - 1;
+		} else if(is_flag(argv[i])) {
+			/* Treat as a parameter assignment: --ParamName VALUE */
+			const char *flag = argv[i];
+			const char *name = flag + 2;
+			if(name[0] == '\0') {
+				fprintf(err, "Invalid flag '%s'\n", flag);
+				return 2;
+			}
+			if(i + 1 >= argc || is_flag(argv[i+1])) {
+				fprintf(err, "Missing value for parameter '%s'\n", name);
+				return 2;
+			}
+			if(req->paramCount >= CLI_MAX_PARAMS) {
+				fprintf(err, "Too many parameters specified\n");
+				return 2;
+			}
+			snprintf(req->params[req->paramCount].name, sizeof(req->params[req->paramCount].name), "%s", name);
+			snprintf(req->params[req->paramCount].value, sizeof(req->params[req->paramCount].value), "%s", argv[i+1]);
+			req->paramCount++;
+			i++;
+		} else {
+			fprintf(err, "Unrecognized argument '%s'\n", argv[i]);
+			return 2;
+		}
+	}
+
+	if(req->daemon || req->recDump || req->histBench)
+		return 0;
+	if(req->histExport)				/* no crate, but --ch names still come from the config */
+		return cli_resolve_names(req, err);
+
+	if((i = cli_resolve_names(req, err)) != 0)
+		return i;
+
+	if(req->bench) {
+		if(req->paramCount > 0 || req->watch || req->recordPath || req->histPath || req->exporter
+		|| req->ramp || (req->host != NULL && strchr(req->host, ',') != NULL)) {
+			fprintf(err, "--bench times one crate on its own: give a single --host, no setters or other modes.\n");
+			return 2;
+		}
+		if(req->addrCount == 0) {				/* every channel of --slot */
+			req->addrs = (cli_addr_t*)malloc(sizeof(cli_addr_t));
+			if(!req->addrs) {
+				fprintf(err, "Out of memory\n");
+				return 3;
+			}
+			req->addrs[0].slot = -1;
+			req->addrs[0].ch = -1;
+			req->addrs[0].name = NULL;
+			req->addrCount = 1;
+		}
+	}
+
+	/* Minimal validation */
+	if(req->addrCount <= 0) {
+		/* If a Pw setter is present, fallback to config file to build channel list */
+		int hasPwSetter = 0;
+		for(i = 0; i < req->paramCount; i++) {
+			if(str_ieq(req->params[i].name, "Pw")) { hasPwSetter = 1; break; }
+		}
+		if(hasPwSetter || req->syncNames) {
+			const cfg_plan_t *cfg = cli_config(req, err);
+
+			if(cfg == NULL) {
+				fprintf(err, "No channels provided and config not found or empty. Provide --ch or a valid config.\n");
+				return 2;
+			}
+			/* adopt channels from config (on --slot); values are applied from the same plan */
+			req->addrs = (cli_addr_t*)malloc(sizeof(cli_addr_t) * (size_t)cfg->n);
+			if(!req->addrs) {
+				fprintf(err, "Out of memory\n");
+				return 3;
+			}
+			for(i = 0; i < cfg->n; i++) {
+				req->addrs[i].slot = -1;
+				req->addrs[i].ch = cfg->ch[i];
+				req->addrs[i].name = NULL;
+			}
+			req->addrCount = cfg->n;
+		} else {
+			fprintf(err, "Missing channels: use --ch <list>\n");
+			print_cli_usage(err, argv[0]);
+			return 2;
+		}
+	}
+	for(i = 0; i < req->addrCount; i++)
+		if(req->addrs[i].ch < 0)
+			req->chAll = 1;
+	if(req->slot < 0) {
+		req->slot = DEFAULT_SLOT; /* default slot in code */
+	}
+	req->cfgSlot = req->slotAll ? -1 : req->slot;
+	if(req->watch && req->host != NULL && strchr(req->host, ',') != NULL) {
+		fprintf(err, "--watch follows one crate: give a single --host.\n");
+		return 2;
+	}
+	if(req->watch && req->paramCount > 0) {
+		fprintf(err, "--watch only reads: remove the setters.\n");
+		return 2;
+	}
+	if((req->recordPath || req->histPath) && (req->paramCount > 0 || req->watch)) {
+		fprintf(err, "--record and --history only read: remove the setters and --watch.\n");
+		return 2;
+	}
+	if(req->exporter && (req->paramCount > 0 || req->watch || req->recordPath || req->histPath
+	                  || (req->host != NULL && strchr(req->host, ',') != NULL))) {
+		fprintf(err, "--exporter serves one crate on its own: give a single --host, no setters,\n"
+		             "--watch, --record or --history.\n");
+		return 2;
+	}
+	if(req->ramp && (req->paramCount > 0 || req->getParam || req->watch || req->recordPath
+	              || req->histPath || req->exporter)) {
+		fprintf(err, "--ramp-to sets V0Set and Pw itself: use it without other setters or modes.\n");
+		return 2;
+	}
+	if((req->poll || req->linkBudget) && !req->recordPath && !req->histPath && !req->exporter && !req->trips) {
+		fprintf(err, "--poll and --link-budget schedule --record, --history, --trips and --exporter.\n");
+		return 2;
+	}
+	if((req->deadband || req->changes || req->heartbeatS >= 0) && !req->watch && !req->recordPath
+	&& !req->histPath && !req->trips && !(req->getParam && req->cycles > 1)) {
+		fprintf(err, "--deadband, --changes and --heartbeat filter --watch, --record, --history\n"
+		             "and --get with --cycles.\n");
+		return 2;
+	}
+	if(req->trips && (req->paramCount > 0 || req->watch || req->exporter || req->ramp || req->bench)) {
+		fprintf(err, "--trips only reads: remove the setters, --watch, --exporter, --ramp-to and --bench.\n");
+		return 2;
+	}
+	if(req->format != NULL && !req->bench) {
+		int kind = fmt_parse(req->format);
+
+		if(kind < 0) {
+			fprintf(err, "Invalid --format '%s' (text, json, csv or bin)\n", req->format);
+			return 2;
+		}
+		if(req->getParam == NULL || req->watch || req->recordPath || req->histPath || req->exporter || req->trips) {
+			fprintf(err, "--format applies to --get reads and --bench.\n");
+			return 2;
+		}
+		if(kind == FMT_BIN && req->host != NULL && strchr(req->host, ',') != NULL) {
+			fprintf(err, "--format bin writes one crate: give a single --host.\n");
+			return 2;
+		}
+	}
+	if((req->tripBits || req->tripOff || req->tripExec) && !req->trips) {
+		fprintf(err, "--trip-bits, --trip-off and --trip-exec need --trips.\n");
+		return 2;
+	}
+	if(req->trips) {
+		/* alone, --trips reads ChStatus only, at 10 Hz */
+		if(req->getParam == NULL && !req->recordPath && !req->histPath)
+			req->getParam = "ChStatus";
+		if(req->periodMs == 0)
+			req->periodMs = TRIP_DEFAULT_PERIOD;
+	}
+	if(req->ringSize < 0 || req->periodMs < 0 || req->cycles < 0) {
+		fprintf(err, "--ring, --period and --cycles take positive values.\n");
+		return 2;
+	}
+	/* a --get loop writes once per cycle: the buffered multi-crate output would hold it back */
+	if(req->cycles > 1 && req->getParam && !req->recordPath && !req->histPath && !req->trips && !req->bench
+	&& req->host != NULL && strchr(req->host, ',') != NULL) {
+		fprintf(err, "--get with --cycles reads one crate: give a single --host (or use --record).\n");
+		return 2;
+	}
+	if(req->syncNames && (req->getParam || req->watch || req->recordPath || req->histPath || req->exporter
+	                   || req->ramp || req->bench || req->trips)) {
+		fprintf(err, "--sync-names writes channel names: use it alone or with setters.\n");
+		return 2;
+	}
+	if(req->getParam == NULL && req->paramCount <= 0 && !req->watch && !req->recordPath && !req->histPath
+	&& !req->exporter && !req->ramp && !req->bench && !req->trips && !req->syncNames) {
+		fprintf(err, "Nothing to do. Provide setters like --V0Set 650 or a getter like --get IMon\n");
+		print_cli_usage(err, argv[0]);
+		return 2;
+	}
+	if(req->getParam != NULL && req->paramCount > 0) {
+		fprintf(err, "Cannot mix setters and getters in the same call. Use either --get <Param> or set flags.\n");
+		return 2;
+	}
+	return 0;
+}
+
+void cli_req_free(cli_req_t *req)
+{
+	int i;
+
+	for(i = 0; i < req->nTargets; i++)
+		free(req->targets[i].ch);
+	free(req->targets);
+	free(req->addrs);
+	req->targets = NULL;
+	req->nTargets = 0;
+	req->addrs = NULL;
+	req->addrCount = 0;
+	req->chList = NULL;
+	req->chCount = 0;
+	if(req->cfgLoaded > 0)
+		cfg_free(req->cfg);
+	req->cfg = NULL;
+	req->cfgLoaded = 0;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  SESSION                                                                  */
+/*                                                                           */
+/*****************************************************************************/
+void cli_sess_init(cli_sess_t *s, const cli_req_t *req)
+{
+	memset(s, 0, sizeof(*s));
+	s->handle = -1;
+	s->sysType = req->sysType;
+	s->linkType = req->linkType;
+	snprintf(s->host, sizeof(s->host), "%s", req->host ? req->host : DEFAULT_HOST);
+	/* Username/password defaults: match interactive logic */
+	if(req->user && req->pass) {
+		snprintf(s->user, sizeof(s->user), "%s", req->user);
+		snprintf(s->pass, sizeof(s->pass), "%s", req->pass);
+	} else {
+		/* For SY4527 / SY5527 / R6060 explicit auth is generally needed; fall back to admin/admin */
+		snprintf(s->user, sizeof(s->user), "%s", DEFAULT_USER);
+		snprintf(s->pass, sizeof(s->pass), "%s", DEFAULT_PASS);
+	}
+}
+
+/* true when 'req' addresses the crate held by session 's' */
+int cli_sess_match(const cli_sess_t *s, const cli_req_t *req)
+{
+	cli_sess_t want;
+
+	cli_sess_init(&want, req);
+	return s->sysType == want.sysType && s->linkType == want.linkType &&
+	       !strcmp(s->host, want.host) && !strcmp(s->user, want.user) &&
+	       !strcmp(s->pass, want.pass);
+}
+
+int cli_login(cli_sess_t *s, FILE *err)
+{
+	char connArg[256];
+	int handle = -1;
+
+	if(s->handle >= 0)
+		return 0;
+
+	snprintf(connArg, sizeof(connArg), "%s", s->host);
+	CAENHVRESULT ret = CAENHV_InitSystem(s->sysType, s->linkType, (void*)connArg, s->user, s->pass, &handle);
+	if(ret != CAENHV_OK) {
+		fprintf(err, "CAENHV_InitSystem failed: %s (code %d)\n", CAENHV_GetError(handle), ret);
+		return (int)ret;
+	}
+	s->handle = handle;
+	return 0;
+}
+
+int cli_logout(cli_sess_t *s, FILE *err)
+{
+	if(s->handle < 0)
+		return 0;
+
+	CAENHVRESULT dr = CAENHV_DeinitSystem(s->handle);
+	if(dr != CAENHV_OK && err != NULL)
+		fprintf(err, "CAENHV_DeinitSystem: %s (code %d)\n", CAENHV_GetError(s->handle), dr);
+	pcache_detach(s->handle);
+	s->handle = -1;
+	return (int)dr;
+}
+
+/* errors after which the handle cannot be trusted any more */
+int cli_link_lost(int ret)
+{
+	switch(ret) {
+	case CAENHV_WRITEERR:
+	case CAENHV_READERR:
+	case CAENHV_TIMEERR:
+	case CAENHV_DOWN:
+	case CAENHV_NOTPRES:
+	case CAENHV_SOCKETERROR:
+	case CAENHV_COMMUNICATIONERROR:
+	case CAENHV_NOTCONNECTED:
+		return 1;
+	}
+	return 0;
+}
+
+/* splits a "VMon,IMon" (or ':' separated) list; -1 on a bad or long list */
+int cli_split_params(const char *list, char (*names)[MAX_PARAM_NAME + 2], int max)
+{
+	int n = 0;
+
+	if(list == NULL)
+		return -1;
+	while(*list) {
+		size_t len = strcspn(list, ",:");
+
+		if(len > 0) {
+			if(n >= max || len >= MAX_PARAM_NAME + 2)
+				return -1;
+			memcpy(names[n], list, len);
+			names[n][len] = '\0';
+			n++;
+		}
+		list += len;
+		if(*list)
+			list++;
+	}
+	return n;
+}
+
+/* "Type" property of a channel parameter, from the schema cache */
+CAENHVRESULT cli_param_type(cli_sess_t *s, unsigned short slot, unsigned short ch,
+                            const char *name, unsigned long *type)
+{
+	return pcache_ch_type(s->handle, slot, ch, name, type);
+}
+
+/* one channel of a grouped write; sorted by value, then by channel */
+typedef struct {
+	float			val;
+	unsigned short	ch;
+} grp_item_t;
+
+static int grp_cmp(const void *a, const void *b)
+{
+	const grp_item_t *x = (const grp_item_t *)a, *y = (const grp_item_t *)b;
+
+	if(x->val != y->val)
+		return x->val < y->val ? -1 : 1;
+	return (int)x->ch - (int)y->ch;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  CLI_SET_GROUPED                                                          */
+/*  Writes a numeric parameter with a per-channel value. Channels sharing    */
+/*  the same value go out in one multi-channel CAENHV_SetChParam, so a       */
+/*  config costs one call per distinct value instead of one per channel.     */
+/*  '*calls' is incremented for every SetChParam issued.                     */
+/*                                                                           */
+/*****************************************************************************/
+CAENHVRESULT cli_set_grouped(cli_sess_t *s, unsigned short slot, const char *name,
+                             const unsigned short *chList, const float *vals, int n,
+                             int *calls, FILE *err)
+{
+	CAENHVRESULT	ret = CAENHV_OK;
+	grp_item_t		*it;
+	unsigned short	*grp;
+	int				i, j, k;
+
+	if(n <= 0)
+		return CAENHV_OK;
+	it = (grp_item_t *)malloc(sizeof(grp_item_t) * (size_t)n);
+	grp = (unsigned short *)malloc(sizeof(unsigned short) * (size_t)n);
+	if(it == NULL || grp == NULL) {
+		free(it);
+		free(grp);
+		fprintf(err, "Out of memory\n");
+		return CAENHV_MEMORYFAULT;
+	}
+	for(i = 0; i < n; i++) {
+		it[i].val = vals[i];
+		it[i].ch = chList[i];
+	}
+	qsort(it, (size_t)n, sizeof(grp_item_t), grp_cmp);
+
+	for(i = 0; i < n; i = j) {
+		float v = it[i].val;
+
+		for(j = i, k = 0; j < n && it[j].val == v; j++)
+			grp[k++] = it[j].ch;
+		(*calls)++;
+		CAENHVRESULT sr = CAENHV_SetChParam(s->handle, slot, name, (unsigned short)k, grp, &v);
+		if(sr != CAENHV_OK) {
+			fprintf(err, "SetChParam('%s', %.3f) on %d channel(s) failed: %s (code %d)\n",
+			        name, (double)v, k, CAENHV_GetError(s->handle), sr);
+			ret = sr;
+		}
+	}
+
+	free(it);
+	free(grp);
+	return ret;
+}
+
+/* setpoints read back from the crate may carry float rounding */
+static int same_value(int numeric, unsigned int cur, unsigned int want)
+{
+	float fc, fw;
+
+	if(!numeric)
+		return cur == want;
+	memcpy(&fc, &cur, sizeof(float));
+	memcpy(&fw, &want, sizeof(float));
+	return fabsf(fc - fw) <= 1.0e-5f * fmaxf(1.0f, fabsf(fw));
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  CLI_DIFF_KEEP                                                            */
+/*  Reads the current value of 'name' on the n channels with one             */
+/*  multi-channel GetChParam and compacts ch[]/want[] to the channels whose  */
+/*  value differs. 'want' holds 4-byte words: floats for numeric parameters, */
+/*  unsigned ints otherwise. Returns the number of channels kept, or -1      */
+/*  with the error in '*ret'.                                                */
+/*                                                                           */
+/*****************************************************************************/
+int cli_diff_keep(cli_sess_t *s, unsigned short slot, const char *name, int numeric,
+                  unsigned short *ch, void *want, int n, int *reads, FILE *err, CAENHVRESULT *ret)
+{
+	unsigned int	*cur, *w = (unsigned int *)want;
+	int				i, kept = 0;
+
+	*ret = CAENHV_OK;
+	if(n <= 0)
+		return 0;
+	if((cur = (unsigned int *)malloc(sizeof(unsigned int) * (size_t)n)) == NULL) {
+		fprintf(err, "Out of memory\n");
+		*ret = CAENHV_MEMORYFAULT;
+		return -1;
+	}
+	(*reads)++;
+	*ret = CAENHV_GetChParam(s->handle, slot, name, (unsigned short)n, ch, cur);
+	if(*ret != CAENHV_OK) {
+		fprintf(err, "GetChParam('%s') failed: %s (code %d)\n", name, CAENHV_GetError(s->handle), *ret);
+		free(cur);
+		return -1;
+	}
+	for(i = 0; i < n; i++)
+		if(!same_value(numeric, cur[i], w[i])) {
+			ch[kept] = ch[i];
+			w[kept] = w[i];
+			kept++;
+		}
+	free(cur);
+	return kept;
+}
+
+/* elapsed milliseconds between two monotonic stamps */
+static double ms_between(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1000.0 + (b->tv_nsec - a->tv_nsec) / 1.0e6;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  CLI_READ                                                                 */
+/*  Reads every parameter of the --get list for the channel list. Types and  */
+/*  buffers are prepared first, so the GetChParam calls go out back-to-back  */
+/*  and the first-to-last spread (the snapshot skew) is as small as the link */
+/*  allows. With --format the rows are queued in 'fo' instead of printed.    */
+/*  With a 'filt' on, a channel row goes on only when one of its filtered    */
+/*  parameters passes; its series are numbered from 'base'.                  */
+/*                                                                           */
+/*****************************************************************************/
+static int cli_read(cli_sess_t *s, cli_req_t *req, fmt_out_t *fo, filt_t *filt, int base,
+                    FILE *out, FILE *err)
+{
+	char			names[CLI_MAX_GET][MAX_PARAM_NAME + 2];
+	unsigned long	types[CLI_MAX_GET];
+	void			*vals[CLI_MAX_GET];
+	unsigned short	*rowCh = req->chList;
+	struct timespec	t0, t1;
+	int				nPar, p, k, exitCode = 0;
+	int				slot = req->slot, chCount = req->chCount, nRows = chCount;
+
+	nPar = cli_split_params(req->getParam, names, CLI_MAX_GET);
+	if(nPar <= 0) {
+		fprintf(err, "Invalid parameter list '%s' (at most %d names)\n", req->getParam, CLI_MAX_GET);
+		return 2;
+	}
+
+	for(p = 0; p < nPar; p++) {
+		CAENHVRESULT pr = cli_param_type(s, (unsigned short)slot, req->chList[0], names[p], &types[p]);
+		if(pr != CAENHV_OK) {
+			fprintf(err, "GetChParamProp('%s','Type') failed: %s (code %d)\n", names[p], CAENHV_GetError(s->handle), pr);
+			return (int)pr;
+		}
+	}
+
+	/* float and unsigned int (the library's 'ulong') are both 4 bytes; the
+	   channels kept by the filter follow the values */
+	vals[0] = malloc(sizeof(unsigned int) * (size_t)chCount * (size_t)nPar + sizeof(unsigned short) * (size_t)chCount);
+	if(vals[0] == NULL) {
+		fprintf(err, "Out of memory\n");
+		return 3;
+	}
+	for(p = 1; p < nPar; p++)
+		vals[p] = (unsigned int *)vals[0] + (size_t)chCount * (size_t)p;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for(p = 0; p < nPar; p++) {
+		CAENHVRESULT gr = CAENHV_GetChParam(s->handle, (unsigned short)slot, names[p], (unsigned short)chCount, req->chList, vals[p]);
+		if(gr != CAENHV_OK) {
+			fprintf(err, "GetChParam('%s') failed: %s (code %d)\n", names[p], CAENHV_GetError(s->handle), gr);
+			exitCode = (int)gr;
+			break;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	/* the rows kept are moved down in place, values and channels */
+	if(exitCode == 0 && filt != NULL && filt->on) {
+		uint64_t nowNs = acq_now_ns();
+
+		rowCh = (unsigned short *)((unsigned int *)vals[0] + (size_t)chCount * (size_t)nPar);
+		for(k = 0, nRows = 0; k < chCount; k++) {
+			int keep = 0;
+
+			for(p = 0; p < nPar; p++)
+				if(filt->band[p].on && filt_pass(filt, (base + k) * nPar + p, p, ((uint32_t *)vals[p])[k], nowNs))
+					keep = 1;
+			if(!keep)
+				continue;
+			for(p = 0; p < nPar; p++)
+				((uint32_t *)vals[p])[nRows] = ((uint32_t *)vals[p])[k];
+			rowCh[nRows++] = req->chList[k];
+		}
+	}
+
+	if(exitCode == 0 && fo->kind != FMT_TEXT) {
+		if(!fo->open)
+			exitCode = fmt_open(fo, req, (const char (*)[MAX_PARAM_NAME + 2])names, types, nPar, err);
+		if(exitCode == 0 && nRows > 0
+		&& fmt_rows(fo, acq_now_ns(), slot, rowCh, nRows, vals, ms_between(&t0, &t1)) != 0) {
+			fprintf(err, "Out of memory\n");
+			exitCode = 3;
+		}
+	} else if(exitCode == 0 && nRows > 0) {
+		for(k = 0; k < nRows; k++) {
+			fprintf(out, "Slot %d  Ch %d", slot, rowCh[k]);
+			for(p = 0; p < nPar; p++) {
+				if(types[p] == PARAM_TYPE_NUMERIC)
+					fprintf(out, "  %s = %.6f", names[p], (double)((float *)vals[p])[k]);
+				else if(types[p] == PARAM_TYPE_CHSTATUS) {
+					char bits[TRIP_STATUS_LEN];
+
+					fprintf(out, "  %s = %u (%s)", names[p], ((unsigned int *)vals[p])[k],
+					        trip_status_str(((unsigned int *)vals[p])[k], bits, sizeof(bits)));
+				} else
+					fprintf(out, "  %s = %u", names[p], ((unsigned int *)vals[p])[k]);
+			}
+			fputc('\n', out);
+		}
+		if(nPar > 1)
+			fprintf(out, "Snapshot skew: %.3f ms over %d parameter read(s)\n", ms_between(&t0, &t1), nPar);
+	}
+
+	free(vals[0]);
+	return exitCode;
+}
+
+/* appends 'ch' to the target of 'slot' (created on first use), once */
+static int target_add(cli_req_t *req, unsigned short slot, unsigned short ch)
+{
+	cli_target_t *t = NULL;
+	int i;
+
+	for(i = 0; i < req->nTargets; i++)
+		if(req->targets[i].slot == slot) {
+			t = &req->targets[i];
+			break;
+		}
+	if(t == NULL) {
+		cli_target_t *nt = (cli_target_t*)realloc(req->targets, sizeof(cli_target_t) * (size_t)(req->nTargets + 1));
+		if(!nt) return -1;
+		req->targets = nt;
+		t = &req->targets[req->nTargets++];
+		memset(t, 0, sizeof(*t));
+		t->slot = slot;
+	}
+	for(i = 0; i < t->count; i++)
+		if(t->ch[i] == ch)
+			return 0;
+	if(t->count >= t->cap) {
+		int ncap = (t->cap == 0 ? 32 : t->cap * 2);
+		unsigned short *nc = (unsigned short*)realloc(t->ch, sizeof(unsigned short) * (size_t)ncap);
+		if(!nc) return -1;
+		t->ch = nc;
+		t->cap = ncap;
+	}
+	t->ch[t->count++] = ch;
+	return 0;
+}
+
+/* channel count of the board in 'slot': crate map first, then
+   TestBdPresence; 0 when the crate cannot tell */
+static int board_channels(cli_sess_t *s, unsigned short slot, unsigned short *nrOfCh, FILE *err)
+{
+	*nrOfCh = 0;
+	/* the crate map is read once per handle and shared with the schema cache */
+	if(pcache_nr_of_ch(s->handle, slot, nrOfCh) == CAENHV_OK && *nrOfCh > 0)
+		return 0;
+
+	unsigned short serNumb = 0;
+	unsigned char fmwMin = 0, fmwMax = 0;
+	char Model[32] = {0}, Descr[64] = {0};
+	char *mdl = (char*)Model;
+	char *des = (char*)Descr;
+	CAENHVRESULT tr = CAENHV_TestBdPresence(s->handle, slot, nrOfCh, &mdl, &des,
+	                                        &serNumb, &fmwMin, &fmwMax);
+	if(tr != CAENHV_OK) {
+		*nrOfCh = 0;
+		if(tr != CAENHV_INVALIDPARAMETER && tr != CAENHV_FUNCTIONNOTAVAILABLE) {
+			fprintf(err, "CAENHV_TestBdPresence failed: %s (code %d)\n",
+			        CAENHV_GetError(s->handle), tr);
+			return (int)tr;
+		}
+	}
+	return 0;
+}
+
+/* every channel of a board, minus EXCLUDED_CH */
+static int target_add_board(cli_req_t *req, unsigned short slot, unsigned short nrOfCh)
+{
+	for(unsigned short c = 0; c < nrOfCh; c++)
+		if(!is_channel_excluded(c) && target_add(req, slot, c) != 0)
+			return -1;
+	return 0;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  CLI_RESOLVE                                                              */
+/*  Turns the --ch items into one target per slot. Plain items apply to      */
+/*  --slot, or to every populated slot with '--slot all'; SLOT:N items name  */
+/*  their slot. Board sizes come from the crate map, read once per handle.   */
+/*                                                                           */
+/*****************************************************************************/
+static int cli_resolve(cli_sess_t *s, cli_req_t *req, FILE *err)
+{
+	unsigned short *slots = NULL, *sizes = NULL;	/* slots plain items apply to */
+	unsigned short nrSlots = 0, NrOfCh;
+	int nSlots = 0, i, j, rc = 0;
+
+	if(req->nTargets > 0)
+		return 0;
+
+	if(req->slotAll) {
+		CAENHVRESULT mr = pcache_nr_of_slots(s->handle, &nrSlots);
+		if(mr != CAENHV_OK) {
+			fprintf(err, "'--slot all' needs the crate map: CAENHV_GetCrateMap failed: %s (code %d)\n",
+			        CAENHV_GetError(s->handle), mr);
+			return (int)mr;
+		}
+	}
+	slots = (unsigned short*)malloc(sizeof(unsigned short) * (size_t)(nrSlots + 1));
+	sizes = (unsigned short*)malloc(sizeof(unsigned short) * (size_t)(nrSlots + 1));
+	if(!slots || !sizes) {
+		free(slots);
+		free(sizes);
+		fprintf(err, "Out of memory\n");
+		return 3;
+	}
+	if(req->slotAll) {
+		for(i = 0; i < nrSlots; i++)
+			if(pcache_nr_of_ch(s->handle, (unsigned short)i, &NrOfCh) == CAENHV_OK && NrOfCh > 0) {
+				slots[nSlots] = (unsigned short)i;
+				sizes[nSlots++] = NrOfCh;
+			}
+		if(nSlots == 0)
+			fprintf(err, "'--slot all': no board found in the crate map\n");
+	} else {
+		slots[0] = (unsigned short)req->slot;
+		sizes[0] = 0;							/* read when an item needs it */
+		nSlots = 1;
+	}
+
+	for(i = 0; i < req->addrCount && rc == 0; i++) {
+		const cli_addr_t *a = &req->addrs[i];
+
+		if(a->slot >= 0) {
+			if(a->ch >= 0) {
+				rc = target_add(req, (unsigned short)a->slot, (unsigned short)a->ch) ? 3 : 0;
+			} else if((rc = board_channels(s, (unsigned short)a->slot, &NrOfCh, err)) == 0) {
+				if(NrOfCh == 0) {
+					fprintf(err, "Slot %d: number of channels unknown; list them as %d:N\n", a->slot, a->slot);
+					rc = 2;
+				} else {
+					rc = target_add_board(req, (unsigned short)a->slot, NrOfCh) ? 3 : 0;
+				}
+			}
+			continue;
+		}
+
+		for(j = 0; j < nSlots && rc == 0; j++) {
+			if(a->ch >= 0) {
+				/* with '--slot all' a plain channel applies where the board has it */
+				if(!req->slotAll || a->ch < sizes[j])
+					rc = target_add(req, slots[j], (unsigned short)a->ch) ? 3 : 0;
+				continue;
+			}
+			if(sizes[j] == 0 && (rc = board_channels(s, slots[j], &sizes[j], err)) != 0)
+				break;
+			if(sizes[j] > 0) {
+				rc = target_add_board(req, slots[j], sizes[j]) ? 3 : 0;
+				continue;
+			}
+
+			/* the crate cannot tell: take the channels of the config */
+			const cfg_plan_t *cfg = cli_config(req, err);
+
+			if(cfg == NULL) {
+				fprintf(err, "Unable to determine channel list for '--ch all'. "
+				             "Provide explicit --ch list or a valid config file.\n");
+				rc = 2;
+			}
+			for(int k = 0; rc == 0 && k < cfg->n; k++)
+				rc = target_add(req, slots[j], cfg->ch[k]) ? 3 : 0;
+		}
+	}
+	free(slots);
+	free(sizes);
+
+	if(rc == 3)
+		fprintf(err, "Out of memory\n");
+	if(rc == 0 && req->nTargets == 0) {
+		fprintf(err, "No channels to operate on: all channels are excluded by configuration.\n");
+		rc = 2;
+	}
+	return rc;
+}
+
+/* makes target 't' the one the read/set/watch code operates on */
+static void target_use(cli_req_t *req, int t)
+{
+	req->slot = req->targets[t].slot;
+	req->chList = req->targets[t].ch;
+	req->chCount = req->targets[t].count;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  CLI_APPLY_CONFIG                                                         */
+/*  With a Pw setter and channels not given as 'all', the parameter columns  */
+/*  of the config are written first, in header order: one SetChParam per     */
+/*  (parameter, value) group of the plan, cut down to the channels of the    */
+/*  current target. Rows belong to the --slot slot (any slot with --slot     */
+/*  all) and are never written elsewhere. The type of each parameter is      */
+/*  looked up once; with --diff one GetChParam per parameter drops the       */
+/*  channels already at their value.                                         */
+/*                                                                           */
+/*****************************************************************************/
+static int cli_apply_config(cli_sess_t *s, cli_req_t *req, FILE *out, FILE *err)
+{
+	const cfg_plan_t	*cfg = cli_config(req, err);
+	unsigned short		slot = (unsigned short)req->slot;
+	unsigned short		*grp, *set;
+	unsigned int		*cur;
+	unsigned char		*sel;
+	int					*cnt;
+	int					exitCode = 0, calls = 0, reads = 0, skipped = 0, cells = 0, rows = 0;
+	int					maxSel = 0, at, c, g, k;
+
+	if(cfg == NULL || (req->cfgSlot >= 0 && req->slot != req->cfgSlot))
+		return 0;
+	for(k = 0; k < req->chCount; k++)
+		if(req->chList[k] > maxSel)
+			maxSel = req->chList[k];
+	grp = (unsigned short *)malloc(sizeof(unsigned short) * (size_t)cfg->n);
+	set = (unsigned short *)malloc(sizeof(unsigned short) * (size_t)cfg->n);
+	cur = (unsigned int *)malloc(sizeof(unsigned int) * (size_t)cfg->n);
+	cnt = (int *)malloc(sizeof(int) * (size_t)cfg->n);
+	sel = (unsigned char *)calloc((size_t)maxSel + 1, 1);
+	if(grp == NULL || set == NULL || cur == NULL || cnt == NULL || sel == NULL) {
+		free(grp);
+		free(set);
+		free(cur);
+		free(cnt);
+		free(sel);
+		fprintf(err, "Out of memory\n");
+		return 3;
+	}
+	for(k = 0; k < req->chCount; k++)
+		sel[req->chList[k]] = 1;
+	for(k = 0; k < cfg->n; k++)
+		if(cfg->ch[k] <= maxSel && sel[cfg->ch[k]])
+			rows++;
+
+	for(c = 0; c < cfg->nPar && rows > 0; c++) {
+		const cfg_group_t	*g0 = &cfg->grp[cfg->parGrp[c]];
+		int					nGrp = cfg->parGrp[c + 1] - cfg->parGrp[c], nSet = 0;
+		unsigned long		type;
+		CAENHVRESULT		sr;
+
+		/* the target's channels in grpCh order, cnt[g] of them in group g */
+		for(g = 0; g < nGrp; g++) {
+			cnt[g] = 0;
+			for(k = 0; k < g0[g].count; k++) {
+				unsigned short ch = cfg->grpCh[g0[g].first + k];
+
+				if(ch <= maxSel && sel[ch]) {
+					set[nSet++] = ch;
+					cnt[g]++;
+				}
+			}
+		}
+		if(nSet == 0)
+			continue;
+		cells += nSet;
+
+		sr = cli_param_type(s, slot, set[0], cfg->par[c], &type);
+		if(sr != CAENHV_OK) {
+			fprintf(err, "Config column '%s': no such parameter on slot %u: %s (code %d)\n",
+			        cfg->par[c], slot, CAENHV_GetError(s->handle), sr);
+			exitCode = (int)sr;
+			continue;
+		}
+		if(req->diff) {
+			reads++;
+			sr = CAENHV_GetChParam(s->handle, slot, cfg->par[c], (unsigned short)nSet, set, cur);
+			if(sr != CAENHV_OK) {
+				fprintf(err, "GetChParam('%s') failed: %s (code %d)\n", cfg->par[c], CAENHV_GetError(s->handle), sr);
+				exitCode = (int)sr;
+				continue;
+			}
+		}
+
+		for(g = 0, at = 0; g < nGrp; at += cnt[g], g++) {
+			const cfg_group_t	*gr = &g0[g];
+			float				fv = gr->val;
+			unsigned int		uv = (unsigned int)lrintf(gr->val), want;
+			int					n = 0;
+
+			memcpy(&want, type == PARAM_TYPE_NUMERIC ? (void *)&fv : (void *)&uv, sizeof(want));
+			for(k = 0; k < cnt[g]; k++)
+				if(!req->diff || !same_value(type == PARAM_TYPE_NUMERIC, cur[at + k], want))
+					grp[n++] = set[at + k];
+			skipped += cnt[g] - n;
+			if(n == 0)
+				continue;
+			calls++;
+			sr = CAENHV_SetChParam(s->handle, slot, cfg->par[c], (unsigned short)n, grp, &want);
+			if(sr != CAENHV_OK) {
+				fprintf(err, "SetChParam('%s', %g) on %d channel(s) failed: %s (code %d)\n",
+				        cfg->par[c], (double)gr->val, n, CAENHV_GetError(s->handle), sr);
+				exitCode = (int)sr;
+			}
+		}
+	}
+
+	if(rows > 0) {
+		if(req->nTargets > 1)
+			fprintf(out, "Slot %u ", slot);
+		if(req->diff)
+			fprintf(out, "Config: %d of %d write(s) skipped as unchanged; %d GetChParam read(s), "
+			             "%d SetChParam call(s) (%d one per channel)\n",
+			        skipped, cells, reads, calls, cells);
+		else
+			fprintf(out, "Config: %d parameter(s) for %d channel(s) in %d SetChParam call(s) (%d one per channel)\n",
+			        cfg->nPar, rows, calls, cells);
+	}
+	free(grp);
+	free(set);
+	free(cur);
+	free(cnt);
+	free(sel);
+	return exitCode;
+}
+
+/* one channel whose crate name differs; sorted by name, then by channel */
+typedef struct {
+	const char		*name;
+	unsigned short	ch;
+} name_item_t;
+
+static int name_item_cmp(const void *a, const void *b)
+{
+	const name_item_t *x = (const name_item_t *)a, *y = (const name_item_t *)b;
+	int c = strcmp(x->name, y->name);
+
+	return c != 0 ? c : (int)x->ch - (int)y->ch;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  CLI_SYNC_NAMES                                                           */
+/*  --sync-names: the config names of the current target go to the crate.   */
+/*  One GetChName reads the names there; the channels that differ are        */
+/*  written with one SetChName per distinct name (the call sets one name on  */
+/*  a list of channels). None rows and channels not in the config are left  */
+/*  alone.                                                                   */
+/*                                                                           */
+/*****************************************************************************/
+static int cli_sync_names(cli_sess_t *s, cli_req_t *req, FILE *out, FILE *err)
+{
+	const cfg_plan_t	*cfg = cli_config(req, err);
+	unsigned short		slot = (unsigned short)req->slot;
+	char				(*cur)[MAX_CH_NAME] = NULL;
+	name_item_t			*it = NULL;
+	unsigned short		*grp = NULL;
+	int					*rowOf = NULL;
+	int					n = req->chCount, maxCh = 0, nDiff = 0, calls = 0, exitCode = 0;
+	int					i, j, k;
+	CAENHVRESULT		ret;
+
+	if(cfg == NULL) {
+		fprintf(err, "--sync-names: config not found or empty.\n");
+		return 2;
+	}
+	for(i = 0; i < cfg->n; i++)
+		if(cfg->ch[i] > maxCh)
+			maxCh = cfg->ch[i];
+	cur = (char (*)[MAX_CH_NAME])malloc((size_t)MAX_CH_NAME * (size_t)n);
+	it = (name_item_t *)malloc(sizeof(name_item_t) * (size_t)n);
+	grp = (unsigned short *)malloc(sizeof(unsigned short) * (size_t)n);
+	rowOf = (int *)malloc(sizeof(int) * (size_t)(maxCh + 1));
+	if(cur == NULL || it == NULL || grp == NULL || rowOf == NULL) {
+		fprintf(err, "Out of memory\n");
+		exitCode = 3;
+		goto out;
+	}
+	/* channel -> config row; a channel listed twice takes its last row */
+	for(i = 0; i <= maxCh; i++)
+		rowOf[i] = -1;
+	for(i = 0; i < cfg->n; i++)
+		rowOf[cfg->ch[i]] = i;
+
+	ret = CAENHV_GetChName(s->handle, slot, (unsigned short)n, req->chList, cur);
+	if(ret != CAENHV_OK) {
+		fprintf(err, "GetChName failed: %s (code %d)\n", CAENHV_GetError(s->handle), ret);
+		exitCode = (int)ret;
+		goto out;
+	}
+	for(k = 0; k < n; k++) {
+		int row = req->chList[k] <= maxCh ? rowOf[req->chList[k]] : -1;
+
+		if(row < 0 || str_ieq(cfg->name[row], CFG_NONE_NAME)
+		|| strncmp(cur[k], cfg->name[row], MAX_CH_NAME) == 0)
+			continue;
+		it[nDiff].name = cfg->name[row];
+		it[nDiff++].ch = req->chList[k];
+	}
+	qsort(it, (size_t)nDiff, sizeof(name_item_t), name_item_cmp);
+
+	for(i = 0; i < nDiff; i = j) {
+		for(j = i, k = 0; j < nDiff && strcmp(it[j].name, it[i].name) == 0; j++)
+			grp[k++] = it[j].ch;
+		calls++;
+		ret = CAENHV_SetChName(s->handle, slot, (unsigned short)k, grp, it[i].name);
+		if(ret != CAENHV_OK) {
+			fprintf(err, "SetChName('%s') on %d channel(s) failed: %s (code %d)\n",
+			        it[i].name, k, CAENHV_GetError(s->handle), ret);
+			exitCode = (int)ret;
+		}
+	}
+
+	if(req->nTargets > 1)
+		fprintf(out, "Slot %u ", slot);
+	fprintf(out, "Names: %d of %d channel(s) differ from the config; 1 GetChName read, %d SetChName call(s)\n",
+	        nDiff, n, calls);
+out:
+	free(cur);
+	free(it);
+	free(grp);
+	free(rowOf);
+	return exitCode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  CLI_SET                                                                  */
+/*  Applies the setters to the current target: one multi-channel             */
+/*  SetChParam per parameter.                                                */
+/*                                                                           */
+/*****************************************************************************/
+static int cli_set(cli_sess_t *s, cli_req_t *req, FILE *out, FILE *err)
+{
+	int handle = s->handle;
+	int slot = req->slot;
+	cli_param_t *params = req->params;
+	int paramCount = req->paramCount;
+	unsigned short *chList = req->chList;
+	int chCount = req->chCount;
+	int exitCode = 0;
+	int i;
+
+	if(req->nTargets > 1)
+		fprintf(out, "Slot %d:\n", slot);
+	for(i = 0; i < paramCount; i++) {
+		unsigned long type = 0;
+		unsigned short *setCh = chList;
+		int setCount = chCount;
+		CAENHVRESULT pr = cli_param_type(s, (unsigned short)slot, chList[0], params[i].name, &type);
+		if(pr != CAENHV_OK) {
+			fprintf(err, "GetChParamProp('%s','Type') failed: %s (code %d)\n", params[i].name, CAENHV_GetError(handle), pr);
+			exitCode = (int)pr;
+			break;
+		}
+
+		float fVal = (float)atof(params[i].value);
+		unsigned long lVal = 0;
+		if(type != PARAM_TYPE_NUMERIC) {
+			if(type == PARAM_TYPE_ONOFF && str_ieq(params[i].value, "on")) lVal = 1;
+			else if(type == PARAM_TYPE_ONOFF && str_ieq(params[i].value, "off")) lVal = 0;
+			else lVal = (unsigned long)strtoul(params[i].value, NULL, 0);	/* integer/enum */
+		}
+
+		if(req->diff) {
+			/* keep only the channels whose current value differs */
+			unsigned int *want = (unsigned int*)malloc(sizeof(unsigned int) * (size_t)chCount);
+			setCh = (unsigned short*)malloc(sizeof(unsigned short) * (size_t)chCount);
+			if(!want || !setCh) {
+				free(want);
+				free(setCh);
+				fprintf(err, "Out of memory\n");
+				exitCode = 3;
+				break;
+			}
+			for(int k = 0; k < chCount; k++) {
+				setCh[k] = chList[k];
+				if(type == PARAM_TYPE_NUMERIC) memcpy(&want[k], &fVal, sizeof(float));
+				else want[k] = (unsigned int)lVal;
+			}
+			int reads = 0;
+			setCount = cli_diff_keep(s, (unsigned short)slot, params[i].name, type == PARAM_TYPE_NUMERIC,
+			                         setCh, want, chCount, &reads, err, &pr);
+			free(want);
+			if(setCount < 0) {
+				free(setCh);
+				exitCode = (int)pr;
+				break;
+			}
+			if(setCount == 0) {
+				fprintf(out, "OK: %s already %s on %d channel(s), nothing written\n", params[i].name, params[i].value, chCount);
+				free(setCh);
+				continue;
+			}
+		}
+
+		CAENHVRESULT sr;
+		if(type == PARAM_TYPE_NUMERIC) {
+			sr = CAENHV_SetChParam(handle, (unsigned short)slot, params[i].name, (unsigned short)setCount, setCh, &fVal);
+			if(sr != CAENHV_OK)
+				fprintf(err, "SetChParam('%s', %f) failed: %s (code %d)\n", params[i].name, fVal, CAENHV_GetError(handle), sr);
+			else
+				fprintf(out, "OK: %s = %g applied to %d channel(s)\n", params[i].name, (double)fVal, setCount);
+		} else {
+			sr = CAENHV_SetChParam(handle, (unsigned short)slot, params[i].name, (unsigned short)setCount, setCh, &lVal);
+			if(sr != CAENHV_OK)
+				fprintf(err, "SetChParam('%s', %lu) failed: %s (code %d)\n", params[i].name, lVal, CAENHV_GetError(handle), sr);
+			else
+				fprintf(out, "OK: %s = %lu applied to %d channel(s)\n", params[i].name, lVal, setCount);
+		}
+		if(req->diff) {
+			if(sr == CAENHV_OK && setCount < chCount)
+				fprintf(out, "    %d channel(s) already at %s, skipped\n", chCount - setCount, params[i].value);
+			free(setCh);
+		}
+		if(sr != CAENHV_OK) {
+			exitCode = (int)sr;
+			break;
+		}
+	}
+	return exitCode;
+}
+
+/* '%h' in 'fmt' is the crate host; with several crates and no '%h', '.host' is appended */
+static void acq_path(char *path, size_t size, const char *fmt, const cli_sess_t *s, const cli_req_t *req)
+{
+	const char *h = strstr(fmt, "%h");
+
+	if(h != NULL)
+		snprintf(path, size, "%.*s%s%s", (int)(h - fmt), fmt, s->host, h + 2);
+	else if(req->host != NULL && strchr(req->host, ',') != NULL)
+		snprintf(path, size, "%s.%s", fmt, s->host);
+	else
+		snprintf(path, size, "%s", fmt);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  CLI_ACQUIRE                                                              */
+/*  --record / --history / --trips: the acquisition loop with the ring file, */
+/*  the compressed history and/or the trip detector as sinks, one of each    */
+/*  per crate.                                                               */
+/*                                                                           */
+/*****************************************************************************/
+static int cli_acquire(cli_sess_t *s, cli_req_t *req, FILE *out, FILE *err)
+{
+	char		recPath[1024], histPath[1024];
+	acq_t		a;
+	acq_sink_t	sink;
+	int			exitCode;
+
+	exitCode = acq_init(&a, s, req, err);
+	if(exitCode == 0 && req->recordPath) {
+		acq_path(recPath, sizeof(recPath), req->recordPath, s, req);
+		exitCode = rec_open(recPath, (uint64_t)req->ringSize, &a, s->host, &sink, err);
+		if(exitCode == 0) {
+			acq_add_sink(&a, &sink);
+			fprintf(out, "Recording to ring %s\n", recPath);
+		}
+	}
+	if(exitCode == 0 && req->histPath) {
+		acq_path(histPath, sizeof(histPath), req->histPath, s, req);
+		exitCode = hist_open(histPath, &a, &sink, err);
+		if(exitCode == 0) {
+			acq_add_sink(&a, &sink);
+			fprintf(out, "Recording to history %s\n", histPath);
+		}
+	}
+	if(exitCode == 0 && req->trips) {
+		exitCode = trip_open(&a, s, out, &sink, err);
+		if(exitCode == 0)
+			acq_add_sink(&a, &sink);
+	}
+	if(exitCode == 0) {
+		if(a.sched)
+			fprintf(out, "%d parameter(s) on %d slot(s), fastest every %lld ms\n", a.nPar, req->nTargets,
+			        (long long)(a.fastNs / 1000000LL));
+		else
+			fprintf(out, "%d parameter(s) on %d slot(s) every %d ms\n", a.nPar, req->nTargets, a.periodMs);
+		fflush(out);
+		exitCode = acq_run(&a, err);
+		if(a.sched) {
+			fprintf(out, "Reads:\n");
+			acq_report(&a, out);
+		}
+		filt_report(&a.filt, out);
+	}
+	acq_free(&a);
+	return exitCode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  CLI_READ_CYCLES                                                          */
+/*  --get on every slot addressed, --cycles times (once by default) every    */
+/*  --period ms; with --format each cycle goes out in one write. --deadband  */
+/*  and --changes drop the channel rows whose filtered parameters did not    */
+/*  move, one series per (target channel, parameter).                        */
+/*                                                                           */
+/*****************************************************************************/
+static int cli_read_cycles(cli_sess_t *s, cli_req_t *req, FILE *out, FILE *err)
+{
+	fmt_out_t		fo;
+	filt_t			filt;
+	struct timespec	next;
+	long			cycles = req->cycles > 0 ? req->cycles : 1, c;
+	int				periodMs = req->periodMs > 0 ? req->periodMs : ACQ_DEFAULT_PERIOD;
+	int				exitCode = 0, rc, t, base;
+
+	memset(&filt, 0, sizeof(filt));
+	if(req->deadband != NULL || req->changes) {
+		char			names[CLI_MAX_GET][MAX_PARAM_NAME + 2];
+		const char		*nm[CLI_MAX_GET];
+		unsigned long	types[CLI_MAX_GET];
+		int				nPar = cli_split_params(req->getParam, names, CLI_MAX_GET), nCh = 0, p;
+
+		if(nPar <= 0) {
+			fprintf(err, "Invalid parameter list '%s' (at most %d names)\n", req->getParam, CLI_MAX_GET);
+			return 2;
+		}
+		for(p = 0; p < nPar; p++) {
+			CAENHVRESULT pr = cli_param_type(s, req->targets[0].slot, req->targets[0].ch[0], names[p], &types[p]);
+
+			if(pr != CAENHV_OK) {
+				fprintf(err, "GetChParamProp('%s','Type') failed: %s (code %d)\n", names[p], CAENHV_GetError(s->handle), pr);
+				return (int)pr;
+			}
+			nm[p] = names[p];
+		}
+		for(t = 0; t < req->nTargets; t++)
+			nCh += req->targets[t].count;
+		if((exitCode = filt_init(&filt, req, nm, types, nPar, nCh * nPar, err)) != 0) {
+			filt_free(&filt);
+			return exitCode;
+		}
+	}
+
+	fmt_init(&fo, fmt_parse(req->format), s->host);
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for(c = 0; c < cycles && exitCode == 0; c++) {
+		if(c > 0) {
+			next.tv_nsec += (long)(periodMs % 1000) * 1000000L;
+			next.tv_sec += periodMs / 1000 + next.tv_nsec / 1000000000L;
+			next.tv_nsec %= 1000000000L;
+			while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+				;
+		}
+		for(t = 0, base = 0; t < req->nTargets; base += req->targets[t].count, t++) {
+			target_use(req, t);
+			rc = cli_read(s, req, &fo, &filt, base, out, err);
+			if(rc != 0) {
+				exitCode = rc;
+				if(cli_link_lost(rc))
+					break;
+			}
+		}
+		if(fo.kind != FMT_TEXT && fmt_flush(&fo, out) != 0) {
+			fprintf(err, "Output write failed: %s\n", strerror(errno));
+			exitCode = 1;
+		} else if(cycles > 1)
+			fflush(out);
+	}
+	filt_report(&filt, err);
+	filt_free(&filt);
+	fmt_free(&fo);
+	return exitCode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  CLI_EXECUTE                                                              */
+/*  Runs a parsed request on a logged-in session, slot by slot.              */
+/*                                                                           */
+/*****************************************************************************/
+int cli_execute(cli_sess_t *s, cli_req_t *req, FILE *out, FILE *err)
+{
+	int exitCode, rc, t;
+
+	exitCode = cli_resolve(s, req, err);
+	if(exitCode != 0)
+		return exitCode;
+
+	if(req->watch) {
+		if(req->nTargets != 1) {
+			fprintf(err, "--watch covers the channels of one slot per run.\n");
+			return 2;
+		}
+		target_use(req, 0);
+		return watch_run(s, req, out, err);
+	}
+
+	if(req->recordPath || req->histPath || req->trips)
+		return cli_acquire(s, req, out, err);
+
+	if(req->exporter)
+		return exp_run(s, req, out, err);
+
+	if(req->ramp)
+		return ramp_run(s, req, out, err);
+
+	if(req->bench)
+		return bench_run(s, req, out, err);
+
+	if(req->getParam == NULL) {
+		int hasPwSetter = 0;
+		for(int pi = 0; pi < req->paramCount; pi++)
+			if(str_ieq(req->params[pi].name, "Pw")) { hasPwSetter = 1; break; }
+		/* config columns for the channels addressed, before the setters */
+		if(hasPwSetter && !req->chAll)
+			for(t = 0; t < req->nTargets; t++) {
+				target_use(req, t);
+				if((rc = cli_apply_config(s, req, out, err)) != 0)
+					exitCode = rc;
+			}
+		if(req->syncNames)
+			for(t = 0; t < req->nTargets; t++) {
+				target_use(req, t);
+				if((rc = cli_sync_names(s, req, out, err)) != 0)
+					exitCode = rc;
+			}
+	}
+
+	if(req->getParam != NULL)
+		exitCode = cli_read_cycles(s, req, out, err);
+	else if(req->paramCount > 0)
+		for(t = 0; t < req->nTargets; t++) {
+			target_use(req, t);
+			rc = cli_set(s, req, out, err);
+			if(rc != 0) {
+				exitCode = rc;
+				if(cli_link_lost(rc))
+					break;
+			}
+		}
+
+	/* boards were added, removed or replaced: drop their cached schemas */
+	if(exitCode == CAENHV_SYSCONFCHANGE)
+		pcache_invalidate(s->handle);
+
+	return exitCode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  RUN_CLI                                                                  */
+/*                                                                           */
+/*****************************************************************************/
+int run_cli(int argc, char **argv)
+{
+	cli_req_t req;
+	cli_sess_t sess;
+	int exitCode;
+
+	exitCode = cli_parse(argc, argv, &req, stderr);
+	if(exitCode != 0) {
+		cli_req_free(&req);
+		return exitCode;
+	}
+
+	if(req.daemon) {
+		cli_req_free(&req);
+		return hvwrappd_main(req.sockPath);
+	}
+
+	/* reading a ring or a history needs no crate */
+	if(req.recDump) {
+		exitCode = rec_dump(req.recDump, req.follow, stdout, stderr);
+		cli_req_free(&req);
+		return exitCode;
+	}
+	if(req.histBench) {
+		exitCode = hist_bench(req.cycles, stdout, stderr);
+		cli_req_free(&req);
+		return exitCode;
+	}
+	if(req.histExport) {
+		char			names[CLI_MAX_GET][MAX_PARAM_NAME + 2];
+		hist_filter_t	f;
+
+		memset(&f, 0, sizeof(f));
+		f.fromMs = (int64_t)(req.fromSec * 1000.0);
+		f.toMs = (int64_t)(req.toSec * 1000.0);
+		f.index = req.histIndex;
+		for(int k = 0; k < req.addrCount; k++)
+			if(req.addrs[k].slot < 0)
+				req.addrs[k].slot = req.slot;		/* -1 without --slot: any */
+		f.addrs = req.addrs;
+		f.addrCount = req.addrCount;
+		if(req.getParam) {
+			f.nNames = cli_split_params(req.getParam, names, CLI_MAX_GET);
+			f.names = names;
+		}
+		exitCode = f.nNames < 0 ? 2 : hist_export(req.histExport, &f, stdout, stderr);
+		cli_req_free(&req);
+		return exitCode;
+	}
+
+	/* Hand one-shot requests to a running hvwrappd, if any; a --cycles loop
+	   must print as it goes and would hold the daemon for its whole run */
+	if(!req.noDaemon && !req.watch && !req.recordPath && !req.histPath && !req.exporter
+	&& !req.ramp && !req.bench && !req.trips && req.cycles <= 1) {
+		int fwd = hvwrappd_forward(req.sockPath, argc, argv);
+		if(fwd >= 0) {
+			cli_req_free(&req);
+			return fwd;
+		}
+	}
+
+	/* --host a,b,c: one worker per crate */
+	if(req.host != NULL && strchr(req.host, ',') != NULL) {
+		exitCode = multi_run(&req);
+		cli_req_free(&req);
+		return exitCode;
+	}
+
+	cli_sess_init(&sess, &req);
+	exitCode = cli_login(&sess, stderr);
+	if(exitCode != 0) {
+		cli_req_free(&req);
+		return exitCode;
+	}
+
+	exitCode = cli_execute(&sess, &req, stdout, stderr);
+
+	int dr = cli_logout(&sess, stderr);
+	if(dr != 0 && exitCode == 0)
+		exitCode = dr;
+
+	cli_req_free(&req);
+	return exitCode;
+}
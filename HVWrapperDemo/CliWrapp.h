@@ -0,0 +1,135 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   CLIWRAPP.H                                                              */
+/*                                                                           */
+/*   Non-interactive command line front end, shared by HVWrappdemo and by    */
+/*   the hvwrappd session daemon.                                            */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef __CLIWRAPP_H
+#define __CLIWRAPP_H
+
+#include <stdio.h>
+#include "CAENHVWrapper.h"
+#include "CfgWrapp.h"
+
+#define CLI_MAX_PARAMS     (32)
+#define CLI_MAX_GET        (16)
+#define CLI_SNAPSHOT_PARAMS "VMon,IMon,ChStatus,Pw"
+
+typedef struct {
+	char	name[64];
+	char	value[128];
+} cli_param_t;
+
+/* one --ch item: slot -1 = the --slot value(s), ch -1 = every channel;
+   'name' (not owned): config names or globs, resolved to channels by cli_parse */
+typedef struct {
+	int			slot;
+	int			ch;
+	const char	*name;
+} cli_addr_t;
+
+/* the channels of one slot; each parameter costs one multi-channel call */
+typedef struct {
+	unsigned short	slot;
+	unsigned short	*ch;
+	int				count, cap;
+} cli_target_t;
+
+/* one parsed command line */
+typedef struct {
+	CAENHV_SYSTEM_TYPE_t	sysType;
+	int						linkType;
+	const char				*host;
+	const char				*user;
+	const char				*pass;
+	int						slot;
+	int						slotAll;		/* --slot all                     */
+	int						cfgSlot;		/* slot of the config rows, -1: any */
+	cli_addr_t				*addrs;			/* --ch items as given            */
+	int						addrCount;
+	int						chAll;			/* some item covers a whole board */
+	cli_target_t			*targets;		/* addrs resolved per slot        */
+	int						nTargets;
+	unsigned short			*chList;		/* target being run (not owned)   */
+	int						chCount;
+	cli_param_t				params[CLI_MAX_PARAMS];
+	int						paramCount;
+	const char				*getParam;
+	const char				*configPath;
+	int						noCfgCache;		/* --no-config-cache              */
+	int						syncNames;		/* --sync-names: config names     */
+	cfg_plan_t				*cfg;			/* config plan, see cli_config()  */
+	int						cfgLoaded;		/* 1: cfg owned, -1: borrowed     */
+	const char				*sockPath;		/* hvwrappd socket (NULL = default) */
+	int						daemon;			/* --daemon: serve requests       */
+	int						noDaemon;		/* --no-daemon: never forward     */
+	int						diff;			/* --diff: write changed only     */
+	int						watch;			/* --watch: event driven monitor  */
+	int						watchPort;		/* --port: UDP port for events    */
+	int						watchPollMs;	/* --watch-poll: fallback period  */
+	const char				*recordPath;	/* --record: ring file            */
+	long					ringSize;		/* --ring: capacity in samples    */
+	const char				*recDump;		/* --rec-dump: ring file to print */
+	int						follow;			/* --follow: keep dumping         */
+	const char				*histPath;		/* --history: compressed history  */
+	const char				*histExport;	/* --hist-export: file to print   */
+	int						histIndex;		/* --hist-index: chunks, not data */
+	int						histBench;		/* --hist-bench                   */
+	double					fromSec, toSec;	/* --from/--to: export window     */
+	int						exporter;		/* --exporter: serve /metrics     */
+	const char				*listen;		/* --listen: [ADDR:]PORT          */
+	int						ramp;			/* --ramp-to given                */
+	float					rampTo;			/* --ramp-to: target V0Set        */
+	float					rampTol;		/* --tol: done band, V            */
+	int						rampTimeout;	/* --timeout: s                   */
+	int						periodMs;		/* --period: acquisition period   */
+	long					cycles;			/* --cycles: 0 = until stopped    */
+	const char				*poll;			/* --poll: PARAM[@SLOT]=MS,...    */
+	int						linkBudget;		/* --link-budget: % of a period   */
+	const char				*deadband;		/* --deadband: PARAM=ABS|PCT%,... */
+	int						changes;		/* --changes: change-only output  */
+	int						heartbeatS;		/* --heartbeat: s, -1 = default   */
+	int						trips;			/* --trips: act on new trips      */
+	const char				*tripBits;		/* --trip-bits: ChStatus bits     */
+	int						tripOff;		/* --trip-off: TRIP_OFF_*         */
+	const char				*tripExec;		/* --trip-exec: shell command     */
+	int						bench;			/* --bench or run as hvbench      */
+	const char				*benchBatch;	/* --batch: 1,8,all               */
+	const char				*benchScenario;	/* --scenario: get,typed,...      */
+	const char				*format;		/* --format: output format        */
+} cli_req_t;
+
+/* one logged-in crate; reused across requests by hvwrappd */
+typedef struct {
+	CAENHV_SYSTEM_TYPE_t	sysType;
+	int						linkType;
+	char					host[128];
+	char					user[64];
+	char					pass[64];
+	int						handle;			/* -1 when not logged in */
+} cli_sess_t;
+
+int  cli_parse(int argc, char **argv, cli_req_t *req, FILE *err);
+void cli_req_free(cli_req_t *req);
+void cli_sess_init(cli_sess_t *s, const cli_req_t *req);
+int  cli_sess_match(const cli_sess_t *s, const cli_req_t *req);
+int  cli_login(cli_sess_t *s, FILE *err);
+int  cli_logout(cli_sess_t *s, FILE *err);
+int  cli_link_lost(int ret);
+int  cli_split_params(const char *list, char (*names)[MAX_PARAM_NAME + 2], int max);
+const cfg_plan_t *cli_config(cli_req_t *req, FILE *err);
+CAENHVRESULT cli_param_type(cli_sess_t *s, unsigned short slot, unsigned short ch,
+                            const char *name, unsigned long *type);
+CAENHVRESULT cli_set_grouped(cli_sess_t *s, unsigned short slot, const char *name,
+                             const unsigned short *chList, const float *vals, int n,
+                             int *calls, FILE *err);
+int  cli_diff_keep(cli_sess_t *s, unsigned short slot, const char *name, int numeric,
+                   unsigned short *ch, void *want, int n, int *reads, FILE *err, CAENHVRESULT *ret);
+int  cli_execute(cli_sess_t *s, cli_req_t *req, FILE *out, FILE *err);
+int  run_cli(int argc, char **argv);
+
+#endif // __CLIWRAPP_H
@@ -25,9 +25,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <time.h>
+#include <pthread.h>
 #include "MainWrapp.h"
 #include "CAENHVWrapper.h"
 #include "console.h"
+#include "CacheWrapp.h"
+#include "TripWrapp.h"
 
 #define   BS                 8
 #define   LF                 10
@@ -39,16 +43,6 @@
 // Administrator
 #undef EXPLICIT_LOGIN
 
-
-typedef struct ParPropTag
-			{
-				unsigned long	Type, Mode;
-				float			MinVal, MaxVal;
-				unsigned short	Unit;
-				short			Exp;
-				char			OnState[30], OffState[30];
-			} ParProp;
-
 static char *ParamTypeStr[] = {
 				  "Numeric " ,
 				  "Boolean " ,
@@ -96,6 +90,7 @@ static char *SysPropModeStr[] = {
 };
 
 extern int loop;
+extern int loopMs;
 
 /*****************************************************************************/
 /*                                                                           */
@@ -119,7 +114,7 @@ static int noHVPS(void)
 /*****************************************************************************/
 static int OneHVPS(void)
 {	
-	int i, j, k;
+	int i, j, k, sel;
 
 	for( i = 0, k = 0 ; i < (MAX_HVPS - 1) ; i++ )
 		if( System[i].ID != -1 )
@@ -128,7 +123,20 @@ static int OneHVPS(void)
 			k++;
 		}
 
-	return ( ( k != 1 ) ? -1 : j );
+	if( k <= 1 )
+		return ( ( k != 1 ) ? -1 : j );
+
+/* More than one system logged in: the user chooses the one to act on */
+	con_printf("Logged systems:");
+	for( i = 0 ; i < (MAX_HVPS - 1) ; i++ )
+		if( System[i].ID != -1 )
+			con_printf("\n  %d) handle %d", i, System[i].Handle);
+	con_printf("\nSystem: ");
+	con_scanf("%d", &sel);
+
+	if( sel < 0 || sel >= (MAX_HVPS - 1) || System[sel].ID == -1 )
+		return -1;
+	return sel;
 }
 
 /*****************************************************************************/
@@ -168,178 +176,18 @@ static CAENHVRESULT ReadParamProp
 {
 	CAENHVRESULT ret;
 
-	if( Ch == 0xffff )	
-	{
-	 do{
-/* First we read the "Type" and "Mode" properties, which are always present */
-		ret = CAENHV_GetBdParamProp(handle, Slot, ParName, "Type", &(pp->Type));
-		if( ret != CAENHV_OK )
-		{
-			con_printf("CAENHV_GetBdParamProp: %s (num. %d)\n\n", 
-						CAENHV_GetError(handle), ret);
-			con_getch();
-			return ret;
-		}
-
-		ret = CAENHV_GetBdParamProp(handle, Slot, ParName, "Mode", &(pp->Mode));
-		if( ret != CAENHV_OK )
-		{
-			con_printf("CAENHV_GetBdParamProp: %s (num. %d)\n\n", 
-						CAENHV_GetError(handle), ret);
-			con_getch();
-			return ret;
-		}
-
-		if( pp->Type == PARAM_TYPE_NUMERIC )
-		{
-			ret = CAENHV_GetBdParamProp(handle, Slot, ParName, "Minval", &(pp->MinVal));
-			if( ret != CAENHV_OK )
-			{
-				con_printf("CAENHV_GetBdParamProp: %s (num. %d)\n\n", 
-							CAENHV_GetError(handle), ret);
-				con_getch();
-				return ret;
-			}
-
-			ret = CAENHV_GetBdParamProp(handle, Slot, ParName, "Maxval", &(pp->MaxVal));
-			if( ret != CAENHV_OK )
-			{
-				con_printf("CAENHVGetBdParamProp: %s (num. %d)\n\n", 
-							CAENHV_GetError(handle), ret);
-				con_getch();
-				return ret;
-			}
-
-			ret = CAENHV_GetBdParamProp(handle, Slot, ParName, "Unit", &(pp->Unit));
-			if( ret != CAENHV_OK )
-			{
-				con_printf("CAENHV_GetBdParamProp: %s (num. %d)\n\n", 
-							CAENHV_GetError(handle), ret);
-				con_getch();
-				return ret;
-			}
-
-			ret = CAENHV_GetBdParamProp(handle, Slot, ParName, "Exp", &(pp->Exp));
-			if( ret != CAENHV_OK )
-			{
-				con_printf("CAENHV_GetBdParamProp: %s (num. %d)\n\n", 
-							CAENHV_GetError(handle), ret);
-				con_getch();
-				return ret;
-			}
-		}
-		else if( pp->Type == PARAM_TYPE_ONOFF )
-		{
-			ret = CAENHV_GetBdParamProp(handle, Slot, ParName, "Onstate", pp->OnState);
-			if( ret != CAENHV_OK )
-			{
-				con_printf("CAENHV_GetBdParamProp: %s (num. %d)\n\n", 
-							CAENHV_GetError(handle), ret);
-				con_getch();
-				return ret;
-			}
-
-			ret = CAENHV_GetBdParamProp(handle, Slot, ParName, "Offstate", pp->OffState);
-			if( ret != CAENHV_OK )
-			{
-				con_printf("CAENHV_GetBdParamProp: %s (num. %d)\n\n", 
-							CAENHV_GetError(handle), ret);
-				con_getch();
-				return ret;
-			}
-		}
-        
-        if( con_kbhit() ) break;   
-       }
-     while(loop);
-	}
-	else
+/* Type, Mode, limits and states come from the schema cache: the crate is
+   asked only the first time a board model/serial/firmware is seen */
+	ret = pcache_ch_prop(handle, Slot, Ch, ParName, pp);
+	if( ret != CAENHV_OK )
 	{
-	 do{
-/* First we read the "Type" and "Mode" properties, which are always present */
-		ret = CAENHV_GetChParamProp(handle, Slot, Ch, ParName, "Type", &(pp->Type));
-		if( ret != CAENHV_OK )
-		{
-			con_printf("CAENHV_GetChParamProp: %s (num. %d)\n\n", 
-						CAENHV_GetError(handle), ret);
-			con_getch();
-			return ret;
-		}
-
-		ret = CAENHV_GetChParamProp(handle, Slot, Ch, ParName, "Mode", &(pp->Mode));
-		if( ret != CAENHV_OK )
-		{
-			con_printf("CAENHV_GetChParamProp: %s (num. %d)\n\n", 
-						CAENHV_GetError(handle), ret);
-			con_getch();
-			return ret;
-		}
-
-		if( pp->Type == PARAM_TYPE_NUMERIC )
-		{
-			ret = CAENHV_GetChParamProp(handle, Slot, Ch, ParName, "Minval", &(pp->MinVal));
-			if( ret != CAENHV_OK )
-			{
-				con_printf("CAENHV_GetChParamProp: %s (num. %d)\n\n", 
-							CAENHV_GetError(handle), ret);
-				con_getch();
-				return ret;
-			}
-
-			ret = CAENHV_GetChParamProp(handle, Slot, Ch, ParName, "Maxval", &(pp->MaxVal));
-			if( ret != CAENHV_OK )
-			{
-				con_printf("CAENHV_GetChParamProp: %s (num. %d)\n\n", 
-							CAENHV_GetError(handle), ret);
-				con_getch();
-				return ret;
-			}
-
-			ret = CAENHV_GetChParamProp(handle, Slot, Ch, ParName, "Unit", &(pp->Unit));
-			if( ret != CAENHV_OK )
-			{
-				con_printf("CAENHV_GetChParamProp: %s (num. %d)\n\n", 
-							CAENHV_GetError(handle), ret);
-				con_getch();
-				return ret;
-			}
-
-			ret = CAENHV_GetChParamProp(handle, Slot, Ch, ParName, "Exp", &(pp->Exp));
-			if( ret != CAENHV_OK )
-			{
-				con_printf("CAENHV_GetChParamProp: %s (num. %d)\n\n", 
-							CAENHV_GetError(handle), ret);
-				con_getch();
-				return ret;
-			}
-		}
-		else if( pp->Type == PARAM_TYPE_ONOFF )
-		{
-			ret = CAENHV_GetChParamProp(handle, Slot, Ch, ParName, "Onstate", pp->OnState);
-			if( ret != CAENHV_OK )
-			{
-				con_printf("CAENHV_GetChParamProp: %s (num. %d)\n\n", 
-							CAENHV_GetError(handle), ret);
-				con_getch();
-				return ret;
-			}
-
-			ret = CAENHV_GetChParamProp(handle, Slot, Ch, ParName, "Offstate", pp->OffState);
-			if( ret != CAENHV_OK )
-			{
-				con_printf("CAENHV_GetChParamProp: %s (num. %d)\n\n", 
-							CAENHV_GetError(handle), ret);
-				con_getch();
-				return ret;
-			}
-		}
-        
-        if( con_kbhit() ) break;   
-       }
-     while(loop);
+		con_printf("%s: %s (num. %d)\n\n", 
+					( Ch == PCACHE_BOARD_CH ) ? "CAENHV_GetBdParamProp" : "CAENHV_GetChParamProp",
+					CAENHV_GetError(handle), ret);
+		con_getch();
 	}
 
-	return CAENHV_OK;
+	return ret;
 }
 
 /*****************************************************************************/
@@ -425,6 +273,102 @@ static void DisplayParamProp
 	}
 }
 
+/*****************************************************************************/
+/*                                                                           */
+/*  LOOP MODE                                                                */
+/*  Internal functions                                                       */
+/*  With [r] Loop = Yes the get commands look up types and allocate their    */
+/*  buffers before the first pass; each pass is then one read, paced on an   */
+/*  absolute deadline every loopMs ([t] in the menu), and the last line      */
+/*  shows the read time of the pass and the resident set size.               */
+/*                                                                           */
+/*****************************************************************************/
+typedef struct loopstat
+			{
+				double			next;			/* deadline of the next pass */
+				double			lastMs, maxMs, sumMs;
+				unsigned long	pass, late;
+			} LOOPSTAT;
+
+static double mono_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1.0e6;
+}
+
+/* resident set size in kB; no stdio, so a pass allocates nothing: the second
+   field of /proc/self/statm, in pages, is parsed by hand */
+static long rss_kb(void)
+{
+	char	buf[64], *p;
+	long	res = 0;
+	int		fd, n;
+
+	if( ( fd = open("/proc/self/statm", O_RDONLY) ) < 0 )
+		return -1;
+	n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if( n <= 0 )
+		return -1;
+	buf[n] = '\0';
+	for( p = buf; *p >= '0' && *p <= '9'; p++ )
+		;
+	if( p == buf || *p++ != ' ' || *p < '0' || *p > '9' )
+		return -1;
+	for( ; *p >= '0' && *p <= '9'; p++ )
+		res = res * 10 + ( *p - '0' );
+	return res * ( sysconf(_SC_PAGESIZE) / 1024 );
+}
+
+static void loop_start(LOOPSTAT *ls)
+{
+	memset(ls, 0, sizeof(LOOPSTAT));
+	ls->next = mono_ms();
+}
+
+/* 't0' is mono_ms() before the read of the pass */
+static void loop_read(LOOPSTAT *ls, double t0)
+{
+	ls->lastMs = mono_ms() - t0;
+	ls->sumMs += ls->lastMs;
+	if( ls->lastMs > ls->maxMs )
+		ls->maxMs = ls->lastMs;
+	ls->pass++;
+}
+
+/* shows the pass and waits for the next one; 1 when a key stops the loop */
+static int loop_wait(LOOPSTAT *ls)
+{
+	int		cols, rows;
+	double	now;
+
+	con_size(&cols, &rows);
+	gotoxy(1, rows);
+	con_printf("Pass %lu  read %.1f ms (avg %.1f, max %.1f)  every %d ms  late %lu  RSS %ld kB  [any key] stop",
+	           ls->pass, ls->lastMs, ls->sumMs / ls->pass, ls->maxMs, loopMs, ls->late, rss_kb());
+
+	/* a pass slower than the period starts the next at once, without catching up */
+	ls->next += loopMs;
+	if( ( now = mono_ms() ) > ls->next )
+	{
+		ls->late++;
+		ls->next = now;
+	}
+	for( ;; )
+	{
+		if( con_kbhit() )
+		{
+			con_getch();
+			return 1;
+		}
+		if( ( now = mono_ms() ) >= ls->next )
+			return 0;
+		delay(ls->next - now < 100 ? (int)( ls->next - now ) + 1 : 100);
+	}
+}
+
 /*****************************************************************************/
 /*                                                                           */
 /*  HVSystemLOGIN                                                            */
@@ -576,6 +520,7 @@ if( ( i = OneHVPS() ) >= 0 )
 
 
 ret = CAENHV_DeinitSystem(handle);
+pcache_detach(handle);
 if( ret == CAENHV_OK )
 	con_printf("CAENHV_DeinitSystem: Connection closed (num. %d)\n\n", ret);
 else
@@ -585,7 +530,7 @@ con_getch();
 if( ret == CAENHV_OK )
   {
    i = 0;
-   while( System[i].Handle,handle ) i++;
+   while( System[i].Handle != handle ) i++;
    for( ; System[i].ID != -1; i++ )
      {
       System[i].ID = System[i+1].ID;
@@ -623,6 +568,8 @@ int i, temp;
 CAENHVRESULT ret;
 unsigned short slot, NrOfCh, n, listaCh[2048], Ch;
 char  (*listNameCh)[MAX_CH_NAME];
+LOOPSTAT ls;
+double t0;
 
 if( noHVPS() )
    return;
@@ -656,8 +603,11 @@ for( n = 0; n < NrOfCh; n++ )
 
 listNameCh = malloc(NrOfCh*MAX_CH_NAME);
 
+loop_start(&ls);
 do{
+	t0 = mono_ms();
 	ret = CAENHV_GetChName(handle, slot, NrOfCh, listaCh, listNameCh);
+	loop_read(&ls, t0);
 	if( ret != CAENHV_OK )
 	   {
 	    free(listNameCh);
@@ -673,12 +623,10 @@ do{
 	    for( n = 0; n < NrOfCh; n++ )
 	       con_printf("Channel n. %d: %s\n", listaCh[n], listNameCh[n]);
 	   }
-   if( con_kbhit() ) break;   
   }
-while(loop);
+while( loop && !loop_wait(&ls) );
 
-fflush(stdout);
-con_getch();
+if( !loop ) con_getch();
 /* per quando era definito come un array di puntatori a char
 for( n = 0; n < NrOfCh; n++)
     free(listNameCh[n]);
@@ -820,10 +768,14 @@ void HVGetChParam()
 {
 	int				i, temp, handle = -1;
 	unsigned short	Slot, ChNum, *ChList, Ch;
-	float			*fParValList = NULL;
-	unsigned long	tipo, *lParValList = NULL;
-	char			ParName[30];
+	void			*ParValList;
+	float			*fParValList;
+	unsigned		*lParValList;
+	unsigned long	tipo;
+	char			ParName[30], Status[TRIP_STATUS_LEN];
 	CAENHVRESULT	ret;
+	LOOPSTAT		ls;
+	double			t0;
 
 	if( noHVPS() )
 		return;
@@ -858,60 +810,52 @@ void HVGetChParam()
 		ChList[i] = Ch;
 	} 
 
-do{
-	ret = CAENHV_GetChParamProp(handle, Slot, ChList[0], ParName, "Type", &tipo);
+	ret = pcache_ch_type(handle, Slot, ChList[0], ParName, &tipo);
 	if( ret != CAENHV_OK )
 	{
 		con_printf("CAENHV_GetChParamProp: %s (num. %d)\n\n", CAENHV_GetError(handle), ret);
-		goto end;
-	}
-	
-	if( tipo == PARAM_TYPE_NUMERIC )
-	{
-		fParValList = malloc(ChNum*sizeof(float));
-		ret = CAENHV_GetChParam(handle, Slot, ParName, ChNum, ChList, fParValList);
-	}
-	else
-	{
-		lParValList = malloc(ChNum*sizeof(long));
-		ret = CAENHV_GetChParam(handle, Slot, ParName, ChNum, ChList, lParValList);
+		con_getch();
+		free(ChList);
+		return;
 	}
 
+	/* numeric values are floats, all the others 32 bit words */
+	ParValList = malloc(ChNum * sizeof(float));
+	fParValList = (float *)ParValList;
+	lParValList = (unsigned *)ParValList;
+
+	loop_start(&ls);
+do{
+	t0 = mono_ms();
+	ret = CAENHV_GetChParam(handle, Slot, ParName, ChNum, ChList, ParValList);
+	loop_read(&ls, t0);
+
+	clrscr();
+	gotoxy(1,2);
 	if( ret != CAENHV_OK )
 		con_printf("CAENHV_GetChParam: %s (num. %d)\n\n", CAENHV_GetError(handle), ret);
 	else
 	{
-		clrscr();
-		gotoxy(1,2);
 		con_printf("PARAM VALUE");
 		if( tipo == PARAM_TYPE_NUMERIC )
 			for( i = 0; i < ChNum; i++ )   
 				con_printf("\nSlot: %2d  Ch: %3d  %s: %10.2f", Slot, ChList[i],
 					                                     ParName, fParValList[i]); 
+		else if( tipo == PARAM_TYPE_CHSTATUS )
+			for( i = 0; i < ChNum; i++ )   
+				con_printf("\nSlot: %2d  Ch: %3d  %s: %x (%s)", Slot, ChList[i], ParName,
+					       lParValList[i], trip_status_str(lParValList[i], Status, sizeof(Status))); 
 		else
 			for( i = 0; i < ChNum; i++ )   
 				con_printf("\nSlot: %2d  Ch: %3d  %s: %x ", Slot, ChList[i],
 					                                     ParName, lParValList[i]); 
 	}
 
-end:
 	if( !loop ) con_getch(); 
-
-	if( tipo == PARAM_TYPE_NUMERIC )
-	{
-		if( fParValList != NULL )
-			free(fParValList); 
-	}
-	else
-	{
-		if( lParValList != NULL )
-			free(lParValList);
-	}
-
-   if( con_kbhit() ) break;   
   }
-while(loop);
+while( loop && !loop_wait(&ls) );
 
+	free(ParValList);
 	free(ChList);
 }
 
@@ -961,7 +905,7 @@ void HVSetChParam()
 		ChList[i] = (unsigned short)temp;
 	}	 
 
-	ret = CAENHV_GetChParamProp(handle, Slot, ChList[0], ParName, "Type", &tipo);
+	ret = pcache_ch_type(handle, Slot, ChList[0], ParName, &tipo);
 	if( ret != CAENHV_OK )
 	{
 		con_printf("CAENHV_GetChParamProp: %s (num. %d)\n\n", CAENHV_GetError(handle), ret);
@@ -1120,10 +1064,14 @@ void HVGetBdParam()
 {
 	int				i, temp, handle = -1;
 	unsigned short	NrOfSlot, *SlotList;
-	float			*fParValList = NULL;
-	unsigned long	tipo, *lParValList = NULL;
+	void			*ParValList;
+	float			*fParValList;
+	unsigned		*lParValList;
+	unsigned long	tipo;
 	char			ParName[30];
 	CAENHVRESULT	ret;
+	LOOPSTAT		ls;
+	double			t0;
 
 	if( noHVPS() )
 		return;
@@ -1151,37 +1099,32 @@ void HVGetBdParam()
 		SlotList[i] = temp;
 	} 
 
-do{
-
-	{
-		fParValList = malloc(50);
-		ret = CAENHV_GetBdParam(handle, NrOfSlot, SlotList, ParName, &fParValList);
-	}
-
-	ret = CAENHV_GetBdParamProp(handle, SlotList[0], ParName, "Type", &tipo);
+	ret = pcache_ch_type(handle, SlotList[0], PCACHE_BOARD_CH, ParName, &tipo);
 	if( ret != CAENHV_OK )
 	{
 		con_printf("CAENHV_GetBdParamProp: %s (num. %d)\n\n", CAENHV_GetError(handle), ret);
-		goto end;
-	}
-	
-	if( tipo == PARAM_TYPE_NUMERIC )
-	{
-		fParValList = malloc(NrOfSlot*sizeof(float));
-		ret = CAENHV_GetBdParam(handle, NrOfSlot, SlotList, ParName, fParValList);
-	}
-	else
-	{
-		lParValList = malloc(NrOfSlot*sizeof(long));
-		ret = CAENHV_GetBdParam(handle, NrOfSlot, SlotList, ParName, lParValList);
+		con_getch();
+		free(SlotList);
+		return;
 	}
 
+	/* numeric values are floats, all the others 32 bit words */
+	ParValList = malloc(NrOfSlot * sizeof(float));
+	fParValList = (float *)ParValList;
+	lParValList = (unsigned *)ParValList;
+
+	loop_start(&ls);
+do{
+	t0 = mono_ms();
+	ret = CAENHV_GetBdParam(handle, NrOfSlot, SlotList, ParName, ParValList);
+	loop_read(&ls, t0);
+
+	clrscr();
+	gotoxy(1,2);
 	if( ret != CAENHV_OK )
 		con_printf("CAENHV_GetBdParam: %s (num. %d)\n\n", CAENHV_GetError(handle), ret);
 	else
 	{
-		clrscr();
-		gotoxy(1,2);
 		con_printf("PARAM VALUE");
 		if( tipo == PARAM_TYPE_NUMERIC )
 			for( i = 0 ; i < NrOfSlot ; i++ )   
@@ -1193,23 +1136,11 @@ do{
 					                               ParName, lParValList[i]); 
 	}
 
-end:
 	if( !loop ) con_getch(); 
-
-	if( tipo == PARAM_TYPE_NUMERIC )
-	{
-		if( fParValList != NULL )
-			free(fParValList); 
-	}
-	else
-	{
-		if( lParValList != NULL )
-			free(lParValList);
-	}
-
-    if( con_kbhit() ) break;   
   }
-while(loop);
+while( loop && !loop_wait(&ls) );
+
+	free(ParValList);
 	free(SlotList);
 }
 
@@ -1254,7 +1185,7 @@ void HVSetBdParam()
 		SlotList[i] = temp;
 	} 
 
-	ret = CAENHV_GetBdParamProp(handle, SlotList[0], ParName, "Type", &tipo);
+	ret = pcache_ch_type(handle, SlotList[0], PCACHE_BOARD_CH, ParName, &tipo);
 	if( ret != CAENHV_OK )
 	{
 		con_printf("CAENHV_GetBdParamProp: %s (num. %d)\n\n", CAENHV_GetError(handle), ret);
@@ -1296,6 +1227,8 @@ void HVGetCrateMap()
 	CAENHVRESULT	ret;
 	int				handle = -1;
 	int				i;
+	LOOPSTAT		ls;
+	double			t0;
 
 	if( noHVPS() )
 		return;
@@ -1303,10 +1236,12 @@ void HVGetCrateMap()
 	if( ( i = OneHVPS() ) >= 0 )
 		handle = System[i].Handle;
 	
-
+	loop_start(&ls);
 do{
+	t0 = mono_ms();
 	ret = CAENHV_GetCrateMap(handle, &NrOfSl, &NrOfCh, &ModelList, &DescriptionList, &SerNumList,
                                   &FmwRelMinList, &FmwRelMaxList );
+	loop_read(&ls, t0);
 	if( ret != CAENHV_OK )
 	{
 		con_printf("CAENHV_GetCrateMap: %s (num. %d)\n\n", CAENHV_GetError(handle), ret);
@@ -1336,9 +1271,8 @@ do{
 		CAENHV_Free(FmwRelMaxList);
 		CAENHV_Free(NrOfCh);
 	}
-    if( con_kbhit() ) break;   
   }
-while(loop);
+while( loop && !loop_wait(&ls) );
 }
 
 /*****************************************************************************/
@@ -1395,6 +1329,8 @@ void HVGetExecList()
 	char			*ExecList = (char *)NULL;
 	CAENHVRESULT	ret;
 	int handle = -1;
+	LOOPSTAT		ls;
+	double			t0;
 
 	if( noHVPS() )
 		return;
@@ -1402,15 +1338,18 @@ void HVGetExecList()
 	if( ( i = OneHVPS() ) >= 0 )
 		handle = System[i].Handle;
 
+	loop_start(&ls);
 do{
 	ExecList = (char *)NULL;
+	t0 = mono_ms();
 	ret = CAENHV_GetExecCommList(handle, &NrOfExec, &ExecList);
+	loop_read(&ls, t0);
                                                  
 	if( ret != CAENHV_OK )
 	{
 		con_printf("CAENHV_GetExecCommList: %s (num. %d)\n\n", 
 			        CAENHV_GetError(handle), ret);
-		con_getch();
+		if( !loop ) con_getch();
 	}
 	else
 	{
@@ -1428,9 +1367,8 @@ do{
 		if( ExecList != NULL )
 			CAENHV_Free(ExecList);
 	}
-    if( con_kbhit() ) break;   
   }
-while(loop);
+while( loop && !loop_wait(&ls) );
 }
 
 /*****************************************************************************/
@@ -1444,9 +1382,9 @@ void HVGetSysProp()
 		char			cBuff[4096];
 		float			fBuff;
 		unsigned short	ui2Buff;
-		unsigned long	ui4Buff;
+		unsigned		ui4Buff;
 		short			i2Buff;
-		long			i4Buff;
+		int				i4Buff;
 		unsigned		bBuff;
 	}				app;
 	CAENHVRESULT	ret;
@@ -1455,6 +1393,9 @@ void HVGetSysProp()
 	unsigned short	NrOfProp;
 	char			*p;
 	char			*PropList = (char *)NULL;
+	unsigned		*Mode, *Type;
+	LOOPSTAT		ls;
+	double			t0;
 
 	if( noHVPS() )
 		return;
@@ -1462,98 +1403,105 @@ void HVGetSysProp()
 	if( ( i = OneHVPS() ) >= 0 )
 		handle = System[i].Handle;
 
-do{
-	PropList = (char *)NULL;
+/* the names, modes and types do not change: only the values are read in the loop */
 	ret = CAENHV_GetSysPropList(handle, &NrOfProp, &PropList);
 	if( ret != CAENHV_OK )
 	{
 		con_printf("CAENHV_GetSysPropList: %s (num. %d)\n\n", 
-			        CAENHV_GetError(handle), ret);
+		            CAENHV_GetError(handle), ret);
 		con_getch();
+		return;
 	}
-	else
-	{
-		p = PropList;    
-		clrscr();
-		gotoxy(1,2);
-		con_printf("Property Name         Property Value       Property Mode  Property Type");
-		gotoxy(1,3);
-		con_printf("-------------         ------------------   -------------  -------------");
 
-		for( i = 0 ; i < NrOfProp ; i++, p += strlen(p) + 1 )   
+	Mode = malloc(NrOfProp * 2 * sizeof(unsigned));
+	Type = Mode + NrOfProp;
+	for( i = 0, p = PropList ; i < NrOfProp ; i++, p += strlen(p) + 1 )
+	{
+		ret = CAENHV_GetSysPropInfo(handle, p, &Mode[i], &Type[i]);
+		if( ret != CAENHV_OK )
 		{
-			unsigned Mode, Type;
-
-			ret = CAENHV_GetSysPropInfo(handle, p, &Mode, &Type);
-			if( ret != CAENHV_OK )
-			{
-				con_printf("CAENHV_GetSysPropInfo: %s (num. %d)\n\n", 
-				            CAENHV_GetError(handle), ret);
-				goto end;
-			}
+			con_printf("CAENHV_GetSysPropInfo: %s (num. %d)\n\n", 
+			            CAENHV_GetError(handle), ret);
+			con_getch();
+			goto end;
+		}
+	}
 
-			ret = CAENHV_GetSysProp(handle, p, &app);
-			if(   ret != CAENHV_OK && ret != CAENHV_GETPROPNOTIMPL 
-         && ret != CAENHV_NOTGETPROP )
-			{
-				con_printf("CAENHV_GetSysProp: %s (num. %d)\n\n", 
-				            CAENHV_GetError(handle), ret);
-				goto end;
-			}
+	loop_start(&ls);
+do{
+	clrscr();
+	gotoxy(1,2);
+	con_printf("Property Name         Property Value       Property Mode  Property Type");
+	gotoxy(1,3);
+	con_printf("-------------         ------------------   -------------  -------------");
 
+	t0 = mono_ms();
+	for( i = 0, p = PropList ; i < NrOfProp ; i++, p += strlen(p) + 1 )   
+	{
+		ret = CAENHV_GetSysProp(handle, p, &app);
+		if(   ret != CAENHV_OK && ret != CAENHV_GETPROPNOTIMPL 
+       && ret != CAENHV_NOTGETPROP )
+		{
 			gotoxy(1, 4+i);
-			con_printf("%-17s",p);
-			gotoxy(23, 4+i);
-			if( Mode == SYSPROP_MODE_WRONLY || ret == CAENHV_GETPROPNOTIMPL 
-        || ret == CAENHV_NOTGETPROP )
-				con_printf("------------------");
-			else
-				switch( Type )
-				{
-				case SYSPROP_TYPE_STR:
-					app.cBuff[18] = '\0';
-					con_printf("%-17s", app.cBuff);
-					break;
-
-				case SYSPROP_TYPE_REAL:
-					con_printf("%-17.2f", app.fBuff);
-					break;
-
-				case SYSPROP_TYPE_UINT2:
-					con_printf("%-x", app.ui2Buff);
-					break;
-
-				case SYSPROP_TYPE_UINT4:
-					con_printf("%-x", app.ui4Buff);
-					break;
-
-				case SYSPROP_TYPE_INT2:
-					con_printf("%-d", app.i2Buff);
-					break;
-
-				case SYSPROP_TYPE_INT4:
-					con_printf("%-d", app.i4Buff);
-					break;
-
-				case SYSPROP_TYPE_BOOLEAN:
-					con_printf("%-d", app.bBuff);
-					break;
-			}
-			
-			gotoxy(43, 4+i);
-			con_printf(" %-17s",SysPropModeStr[Mode]);
-			gotoxy(59, 4+i);
-			con_printf("%-17s",SysPropTypeStr[Type]);
+			con_printf("CAENHV_GetSysProp: %s (num. %d)\n\n", 
+			            CAENHV_GetError(handle), ret);
+			break;
 		}
 
-end:
-		if( !loop ) con_getch();
-		if( PropList != NULL )
-			CAENHV_Free(PropList);
+		gotoxy(1, 4+i);
+		con_printf("%-17s",p);
+		gotoxy(23, 4+i);
+		if( Mode[i] == SYSPROP_MODE_WRONLY || ret == CAENHV_GETPROPNOTIMPL 
+      || ret == CAENHV_NOTGETPROP )
+			con_printf("------------------");
+		else
+			switch( Type[i] )
+			{
+			case SYSPROP_TYPE_STR:
+				app.cBuff[18] = '\0';
+				con_printf("%-17s", app.cBuff);
+				break;
+
+			case SYSPROP_TYPE_REAL:
+				con_printf("%-17.2f", app.fBuff);
+				break;
+
+			case SYSPROP_TYPE_UINT2:
+				con_printf("%-x", app.ui2Buff);
+				break;
+
+			case SYSPROP_TYPE_UINT4:
+				con_printf("%-x", app.ui4Buff);
+				break;
+
+			case SYSPROP_TYPE_INT2:
+				con_printf("%-d", app.i2Buff);
+				break;
+
+			case SYSPROP_TYPE_INT4:
+				con_printf("%-d", app.i4Buff);
+				break;
+
+			case SYSPROP_TYPE_BOOLEAN:
+				con_printf("%-d", app.bBuff);
+				break;
+		}
+		
+		gotoxy(43, 4+i);
+		con_printf(" %-17s",SysPropModeStr[Mode[i]]);
+		gotoxy(59, 4+i);
+		con_printf("%-17s",SysPropTypeStr[Type[i]]);
 	}
-    if( con_kbhit() ) break;   
+	loop_read(&ls, t0);
+
+	if( !loop ) con_getch();
   }
-while(loop);
+while( loop && !loop_wait(&ls) );
+
+end:
+	free(Mode);
+	if( PropList != NULL )
+		CAENHV_Free(PropList);
 }
 
 /*****************************************************************************/
@@ -1665,6 +1613,284 @@ void HVExecComm()
 	con_getch();
 }
 
+/*****************************************************************************/
+/*                                                                           */
+/*  HVDASHBOARD                                                              */
+/*                                                                           */
+/*  VMon, IMon, Pw and ChStatus of every channel of every slot. A thread     */
+/*  reads the crate (four multi-channel calls per slot) and publishes each   */
+/*  slot under a mutex; the screen is redrawn from the last values at        */
+/*  DASH_FRAME_MS and keys are polled, so none waits on the link. Only the   */
+/*  calling thread draws: ncurses is not thread safe.                        */
+/*                                                                           */
+/*****************************************************************************/
+#define   DASH_FRAME_MS      (100)
+#define   DASH_PERIOD_MS     (1000)
+#define   DASH_CELL_W        (41)
+#define   DASH_ALARM         (~0x7u)		/* any ChStatus bit but On/RampUp/RampDown */
+
+static const char *DashPar[4] = { "VMon", "IMon", "Pw", "ChStatus" };
+
+typedef struct dashch
+			{
+				unsigned short	Slot, Ch;
+				float			VMon, IMon;
+				unsigned		Pw, Status;
+				int				Valid;
+			} DASHCH;
+
+typedef struct dash
+			{
+				int				handle;
+				pthread_mutex_t	lock;
+				volatile int	stop;
+				volatile int	periodMs;
+				DASHCH			*ch;			/* last sweep, under lock */
+				int				nCh;
+				unsigned long	gen;			/* slot reads published */
+				double			sweepMs;
+				char			msg[128];
+			} DASH;
+
+static void dash_msg(DASH *d, const char *what, int slot, CAENHVRESULT ret)
+{
+	pthread_mutex_lock(&d->lock);
+	snprintf(d->msg, sizeof(d->msg), "%s slot %d: %s (num. %d)", what, slot, CAENHV_GetError(d->handle), ret);
+	pthread_mutex_unlock(&d->lock);
+}
+
+static void *dash_thread(void *arg)
+{
+	DASH			*d = (DASH *)arg;
+	DASHCH			*work;
+	unsigned short	nSl = 0, nCh, sl, *list;
+	unsigned		*buf;
+	int				i, k, p, n = 0, maxCh = 0;
+	double			t0;
+	CAENHVRESULT	ret;
+
+	/* layout from the crate map */
+	if( ( ret = pcache_nr_of_slots(d->handle, &nSl) ) != CAENHV_OK )
+	{
+		dash_msg(d, "GetCrateMap", 0, ret);
+		return NULL;
+	}
+	for( sl = 0; sl < nSl; sl++ )
+		if( pcache_nr_of_ch(d->handle, sl, &nCh) == CAENHV_OK )
+		{
+			n += nCh;
+			if( nCh > maxCh )
+				maxCh = nCh;
+		}
+	work = (DASHCH *)calloc((size_t)(n ? n : 1), sizeof(DASHCH));
+	list = (unsigned short *)calloc((size_t)(maxCh ? maxCh : 1), sizeof(unsigned short));
+	buf = (unsigned *)calloc((size_t)(maxCh ? maxCh : 1), sizeof(unsigned));
+	pthread_mutex_lock(&d->lock);
+	d->ch = (DASHCH *)calloc((size_t)(n ? n : 1), sizeof(DASHCH));
+	if( work == NULL || list == NULL || buf == NULL || d->ch == NULL )
+		snprintf(d->msg, sizeof(d->msg), "Out of memory");
+	else
+	{
+		for( sl = 0, i = 0; sl < nSl; sl++ )
+			if( pcache_nr_of_ch(d->handle, sl, &nCh) == CAENHV_OK )
+				for( k = 0; k < nCh; k++, i++ )
+				{
+					work[i].Slot = d->ch[i].Slot = sl;
+					work[i].Ch = d->ch[i].Ch = (unsigned short)k;
+				}
+		d->nCh = n;
+	}
+	pthread_mutex_unlock(&d->lock);
+
+	while( !d->stop && d->nCh > 0 )
+	{
+		t0 = mono_ms();
+		for( i = 0; i < n && !d->stop; i += nCh )
+		{
+			sl = work[i].Slot;
+			for( nCh = 0; i + nCh < n && work[i + nCh].Slot == sl; nCh++ )
+				list[nCh] = work[i + nCh].Ch;
+
+			for( p = 0; p < 4 && !d->stop; p++ )
+			{
+				ret = CAENHV_GetChParam(d->handle, sl, DashPar[p], nCh, list, buf);
+				if( ret != CAENHV_OK )
+				{
+					dash_msg(d, DashPar[p], sl, ret);
+					break;
+				}
+				for( k = 0; k < nCh; k++ )
+					switch( p )
+					{
+					case 0: memcpy(&work[i + k].VMon, &buf[k], sizeof(float)); break;
+					case 1: memcpy(&work[i + k].IMon, &buf[k], sizeof(float)); break;
+					case 2: work[i + k].Pw = buf[k]; break;
+					case 3: work[i + k].Status = buf[k]; work[i + k].Valid = 1; break;
+					}
+			}
+
+			/* each slot is shown as soon as it is read */
+			pthread_mutex_lock(&d->lock);
+			memcpy(&d->ch[i], &work[i], sizeof(DASHCH) * (size_t)nCh);
+			d->gen++;
+			pthread_mutex_unlock(&d->lock);
+		}
+
+		pthread_mutex_lock(&d->lock);
+		d->sweepMs = mono_ms() - t0;
+		pthread_mutex_unlock(&d->lock);
+
+		/* next sweep; 'stop' is looked at every frame */
+		while( !d->stop && mono_ms() - t0 < d->periodMs )
+			usleep(DASH_FRAME_MS * 1000);
+	}
+
+	free(work);
+	free(list);
+	free(buf);
+	return NULL;
+}
+
+static void dash_draw(const DASH *d, const DASHCH *view, int nCh, unsigned long gen, double sweepMs,
+                      const char *msg, int *page)
+{
+	int		cols, rows, nCol, nRow, perPage, nPage, i, k;
+	char	st[TRIP_STATUS_LEN];
+
+	con_size(&cols, &rows);
+	nCol = cols / DASH_CELL_W > 0 ? cols / DASH_CELL_W : 1;
+	nRow = rows - 4 > 1 ? rows - 4 : 1;
+	perPage = nCol * nRow;
+	nPage = nCh > 0 ? (nCh + perPage - 1) / perPage : 1;
+	if( *page >= nPage ) *page = nPage - 1;
+	if( *page < 0 ) *page = 0;
+
+	clrscr();
+	gotoxy(1, 1);
+	con_printf("DASHBOARD  handle %d  %d channel(s)  sweep %.0f ms every %d ms  #%lu  page %d/%d",
+	           d->handle, nCh, sweepMs, d->periodMs, gen, *page + 1, nPage);
+	for( k = 0; k < nCol; k++ )
+	{
+		gotoxy(k * DASH_CELL_W + 1, 2);
+		con_printf("Sl.Ch      VMon      IMon Pw  Status");
+	}
+	for( i = *page * perPage; i < nCh && i < (*page + 1) * perPage; i++ )
+	{
+		const DASHCH *c = &view[i];
+
+		k = i - *page * perPage;
+		gotoxy((k / nRow) * DASH_CELL_W + 1, k % nRow + 3);
+		if( !c->Valid )
+		{
+			con_printf("%2d.%-3d  ---", c->Slot, c->Ch);
+			continue;
+		}
+		if( c->Status & DASH_ALARM )
+			highvideo();
+		con_printf("%2d.%-3d %9.2f %9.3f %-3s %-.10s", c->Slot, c->Ch, c->VMon, c->IMon,
+		           c->Pw ? "On" : "Off", trip_status_str(c->Status & ~1u, st, sizeof(st)));
+		if( c->Status & DASH_ALARM )
+			normvideo();
+	}
+	gotoxy(1, rows - 1);
+	con_printf("%.*s", cols - 1, msg[0] ? msg : (nCh ? "" : "Reading the crate map..."));
+	gotoxy(1, rows);
+	con_printf("[n]ext [p]rev page  [+] faster [-] slower  [q] back");
+}
+
+void HVDashboard(void)
+{
+	DASH			d;
+	DASHCH			*view = NULL;
+	pthread_t		tid;
+	unsigned long	gen = 0;
+	double			sweepMs = 0.0;
+	char			msg[128];
+	int				i, nCh = 0, page = 0, dirty = 1, quit = 0, key;
+
+	if( noHVPS() )
+		return;
+
+	memset(&d, 0, sizeof(d));
+	d.handle = -1;
+	if( ( i = OneHVPS() ) >= 0 )
+		d.handle = System[i].Handle;
+	d.periodMs = DASH_PERIOD_MS;
+	msg[0] = '\0';
+	pthread_mutex_init(&d.lock, NULL);
+	if( pthread_create(&tid, NULL, dash_thread, &d) != 0 )
+	{
+		con_printf("Cannot start the acquisition thread\n\n");
+		con_getch();
+		pthread_mutex_destroy(&d.lock);
+		return;
+	}
+
+	while( !quit )
+	{
+		while( con_kbhit() )
+		{
+			switch( key = con_getch() )
+			{
+			case 'q': case 'Q': case 'x': case 'X': case 27:
+				quit = 1;
+				break;
+			case 'n': case ' ':
+				page++;
+				break;
+			case 'p': case 'b':
+				page--;
+				break;
+			case '+':
+				if( d.periodMs > 100 ) d.periodMs /= 2;
+				break;
+			case '-':
+				if( d.periodMs < 60000 ) d.periodMs *= 2;
+				break;
+			}
+			dirty = 1;
+		}
+
+		/* take the last sweep; the thread holds the lock only to copy one */
+		pthread_mutex_lock(&d.lock);
+		if( d.nCh != nCh && d.ch != NULL )
+		{
+			DASHCH *nv = (DASHCH *)realloc(view, sizeof(DASHCH) * (size_t)d.nCh);
+
+			if( nv != NULL )
+			{
+				view = nv;
+				nCh = d.nCh;
+			}
+		}
+		if( d.gen != gen || dirty )
+		{
+			if( nCh > 0 )
+				memcpy(view, d.ch, sizeof(DASHCH) * (size_t)nCh);
+			gen = d.gen;
+			sweepMs = d.sweepMs;
+			strcpy(msg, d.msg);
+			dirty = 1;
+		}
+		pthread_mutex_unlock(&d.lock);
+
+		if( dirty && !quit )
+			dash_draw(&d, view, nCh, gen, sweepMs, msg, &page);
+		dirty = 0;
+		delay(DASH_FRAME_MS);
+	}
+
+	/* the thread ends after the call it is in */
+	gotoxy(1, 1);
+	con_printf("Stopping the acquisition...");
+	con_flush();
+	d.stop = 1;
+	pthread_join(tid, NULL);
+	pthread_mutex_destroy(&d.lock);
+	free(d.ch);
+	free(view);
+}
+
 /*****************************************************************************/
 /*                                                                           */
 /*  HVNOFUNCTION                                                         */
@@ -0,0 +1,503 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   DAEMWRAPP.C                                                             */
+/*                                                                           */
+/*   hvwrappd session daemon. CAENHV_InitSystem dominates the cost of a      */
+/*   one-shot CLI call, so the daemon logs into each crate once and runs     */
+/*   the forwarded command lines on the open handle; a request then costs    */
+/*   only the CAENHV_* calls it actually needs.                              */
+/*                                                                           */
+/*****************************************************************************/
+#ifdef LINUX
+#define _GNU_SOURCE						/* struct ucred */
+#endif
+#include <signal.h>
+#ifdef UNIX
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "CAENHVWrapper.h"
+#include "CliWrapp.h"
+#include "DaemWrapp.h"
+#include "MultiWrapp.h"
+
+#define MAX_SESSIONS       MAX_CRATES
+#define MAX_REQ_ARGS       (256)
+#define CLIENT_TIMEOUT_S   (5)
+
+static cli_sess_t				sessions[MAX_SESSIONS];
+static unsigned long			lastUse[MAX_SESSIONS];	/* request serial */
+static unsigned long			reqSerial;
+static int						nSessions;
+static volatile sig_atomic_t	stopReq;
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Internal functions                                                       */
+/*                                                                           */
+/*****************************************************************************/
+/* ours and closed to everybody else: no symlink, mode 0700 or stricter */
+static int dir_private(const char *dir)
+{
+	struct stat st;
+
+	return lstat(dir, &st) == 0 && S_ISDIR(st.st_mode) && st.st_uid == getuid()
+	    && (st.st_mode & 077) == 0;
+}
+
+/* a socket created by this user, not a symlink to one */
+static int sock_owned(const char *path)
+{
+	struct stat st;
+
+	return lstat(path, &st) == 0 && S_ISSOCK(st.st_mode) && st.st_uid == getuid();
+}
+
+/* the process on the other end runs as this user */
+static int peer_owned(int fd)
+{
+	struct ucred	cr;
+	socklen_t		len = sizeof(cr);
+
+	return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cr, &len) == 0 && cr.uid == getuid();
+}
+
+/* --socket, $HVWRAPPD_SOCKET, else hvwrappd.sock in $XDG_RUNTIME_DIR or in a
+   private /tmp/hvwrappd-<uid> ('create': made by the daemon); -1 when the
+   directory is missing or open to other users */
+static int sock_path(char *buf, size_t len, const char *sockPath, int create)
+{
+	const char	*env = getenv("HVWRAPPD_SOCKET");
+	const char	*xdg = getenv("XDG_RUNTIME_DIR");
+	char		dir[64];
+
+	if(sockPath != NULL && *sockPath)
+		return snprintf(buf, len, "%s", sockPath) < (int)len ? 0 : -1;
+	if(env != NULL && *env)
+		return snprintf(buf, len, "%s", env) < (int)len ? 0 : -1;
+	if(xdg != NULL && *xdg == '/' && dir_private(xdg))
+		return snprintf(buf, len, "%s/hvwrappd.sock", xdg) < (int)len ? 0 : -1;
+
+	snprintf(dir, sizeof(dir), "/tmp/hvwrappd-%u", (unsigned)getuid());
+	if(create && mkdir(dir, 0700) != 0 && errno != EEXIST)
+		return -1;
+	if(!dir_private(dir)) {
+		if(create || access(dir, F_OK) == 0)
+			fprintf(stderr, "hvwrappd: %s is not a private directory of this user\n", dir);
+		return -1;
+	}
+	return snprintf(buf, len, "%s/hvwrappd.sock", dir) < (int)len ? 0 : -1;
+}
+
+static int write_full(int fd, const void *buf, size_t len)
+{
+	const char *p = (const char *)buf;
+
+	while(len > 0) {
+		ssize_t n = write(fd, p, len);
+		if(n < 0) {
+			if(errno == EINTR) continue;
+			return -1;
+		}
+		p += n;
+		len -= (size_t)n;
+	}
+	return 0;
+}
+
+static int read_full(int fd, void *buf, size_t len)
+{
+	char *p = (char *)buf;
+
+	while(len > 0) {
+		ssize_t n = read(fd, p, len);
+		if(n < 0) {
+			if(errno == EINTR) continue;
+			return -1;
+		}
+		if(n == 0)
+			return -1;
+		p += n;
+		len -= (size_t)n;
+	}
+	return 0;
+}
+
+static int sock_connect(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if(strlen(path) >= sizeof(addr.sun_path))
+		return -1;
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0)
+		return -1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static void on_stop(int sig)
+{
+	(void)sig;
+	stopReq = 1;
+}
+
+/* session for the crate addressed by 'req'; the least recently used one
+   is recycled when all are taken, but never one used by this request */
+static cli_sess_t *find_session(const cli_req_t *req, FILE *err)
+{
+	int i, lru = -1;
+
+	for(i = 0; i < nSessions; i++)
+		if(cli_sess_match(&sessions[i], req))
+			break;
+
+	if(i == nSessions) {
+		if(nSessions == MAX_SESSIONS) {
+			for(i = 0; i < nSessions; i++)
+				if(lastUse[i] != reqSerial && (lru < 0 || lastUse[i] < lastUse[lru]))
+					lru = i;
+			if(lru < 0) {
+				fprintf(err, "hvwrappd: more than %d crates in one request\n", MAX_SESSIONS);
+				return NULL;
+			}
+			cli_logout(&sessions[lru], NULL);
+			i = lru;
+		} else
+			i = nSessions++;
+		cli_sess_init(&sessions[i], req);
+	}
+	lastUse[i] = reqSerial;
+	return &sessions[i];
+}
+
+static cli_sess_t *get_session(const cli_req_t *req, FILE *err)
+{
+	cli_sess_t *s = find_session(req, err);
+
+	if(s == NULL || cli_login(s, err) != 0)
+		return NULL;
+	return s;
+}
+
+/* --host a,b,c: the crates are served in parallel on their own sessions */
+static int serve_multi(cli_req_t *req, FILE *out, FILE *err)
+{
+	char		hosts[MULTI_MAX_CRATES][MULTI_HOST_LEN];
+	cli_sess_t	*ps[MULTI_MAX_CRATES];
+	cli_req_t	one;
+	int			n, i;
+
+	n = multi_split_hosts(req->host, hosts, MULTI_MAX_CRATES);
+	if(n <= 0) {
+		fprintf(err, "Invalid --host list '%s' (at most %d crates)\n", req->host, MULTI_MAX_CRATES);
+		return 2;
+	}
+	for(i = 0; i < n; i++) {
+		one = *req;
+		one.host = hosts[i];
+		if((ps[i] = find_session(&one, err)) == NULL)
+			return 2;
+	}
+	return multi_execute(ps, n, req, 1, out, err);
+}
+
+static void serve_one(int fd)
+{
+	uint32_t		hdr[2];
+	char			*payload = NULL;
+	char			*argv[MAX_REQ_ARGS];
+	int				argc = 0;
+	char			*outBuf = NULL, *errBuf = NULL;
+	size_t			outLen = 0, errLen = 0;
+	FILE			*out, *err;
+	int32_t			exitCode = 0;
+	cli_req_t		req;
+	uint32_t		len, p;
+
+	if(read_full(fd, hdr, sizeof(hdr)) != 0 || hdr[0] != HVWRAPPD_MAGIC ||
+	   hdr[1] == 0 || hdr[1] > HVWRAPPD_MAX_REQ)
+		return;
+	len = hdr[1];
+	payload = malloc(len + 1);
+	if(payload == NULL)
+		return;
+	if(read_full(fd, payload, len) != 0) {
+		free(payload);
+		return;
+	}
+	payload[len] = '\0';
+
+	out = open_memstream(&outBuf, &outLen);
+	err = open_memstream(&errBuf, &errLen);
+	if(out == NULL || err == NULL) {
+		if(out) fclose(out);
+		if(err) fclose(err);
+		free(outBuf);
+		free(errBuf);
+		free(payload);
+		return;
+	}
+
+	/* cwd first, so relative --config paths resolve as for the caller */
+	if(chdir(payload) != 0)
+		fprintf(err, "hvwrappd: cannot enter '%s': %s\n", payload, strerror(errno));
+	for(p = (uint32_t)strlen(payload) + 1; p < len && argc < MAX_REQ_ARGS; p += (uint32_t)strlen(payload + p) + 1)
+		argv[argc++] = payload + p;
+
+	reqSerial++;
+	if(argc < 1) {
+		fprintf(err, "hvwrappd: empty request\n");
+		exitCode = 2;
+	} else if((exitCode = cli_parse(argc, argv, &req, err)) == 0) {
+		if(req.daemon || req.watch || req.recordPath || req.histPath || req.exporter || req.ramp
+		|| req.bench || req.trips || req.cycles > 1) {
+			fprintf(err, "hvwrappd: %s cannot be forwarded\n", req.daemon ? "--daemon" :
+			        req.watch ? "--watch" : req.recordPath ? "--record" :
+			        req.histPath ? "--history" : req.exporter ? "--exporter" :
+			        req.ramp ? "--ramp-to" : req.bench ? "--bench" : req.trips ? "--trips" : "--cycles");
+			exitCode = 2;
+		} else if(req.recDump || req.histExport || req.histBench) {
+			fprintf(err, "hvwrappd: file tools are not run by the daemon\n");
+			exitCode = 2;
+		} else if(req.host != NULL && strchr(req.host, ',') != NULL) {
+			exitCode = serve_multi(&req, out, err);
+		} else {
+			cli_sess_t *s = get_session(&req, err);
+
+			if(s == NULL)
+				exitCode = 1;
+			else {
+				exitCode = cli_execute(s, &req, out, err);
+				if(cli_link_lost(exitCode)) {
+					/* drop the handle; the next request logs in again */
+					fprintf(err, "hvwrappd: link to %s lost, session closed\n", s->host);
+					cli_logout(s, NULL);
+				}
+			}
+		}
+		cli_req_free(&req);
+	} else
+		cli_req_free(&req);
+
+	fclose(out);
+	fclose(err);
+
+	{
+		uint32_t rsp[4];
+
+		rsp[0] = HVWRAPPD_MAGIC;
+		rsp[1] = (uint32_t)exitCode;
+		rsp[2] = (uint32_t)outLen;
+		rsp[3] = (uint32_t)errLen;
+		if(write_full(fd, rsp, sizeof(rsp)) == 0 &&
+		   write_full(fd, outBuf, outLen) == 0)
+			write_full(fd, errBuf, errLen);
+	}
+
+	free(outBuf);
+	free(errBuf);
+	free(payload);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  HVWRAPPD_INVOKED                                                         */
+/*  True when the program was started through the 'hvwrappd' name.           */
+/*                                                                           */
+/*****************************************************************************/
+int hvwrappd_invoked(const char *argv0)
+{
+	const char *base;
+
+	if(argv0 == NULL)
+		return 0;
+	base = strrchr(argv0, '/');
+	base = base ? base + 1 : argv0;
+	return strcmp(base, HVWRAPPD_NAME) == 0;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  HVWRAPPD_MAIN                                                            */
+/*                                                                           */
+/*****************************************************************************/
+int hvwrappd_main(const char *sockPath)
+{
+	struct sockaddr_un	addr;
+	struct sigaction	sa;
+	struct stat			st;
+	char				path[sizeof(addr.sun_path)];
+	mode_t				mask;
+	int					lfd, fd, i;
+
+	if(sock_path(path, sizeof(path), sockPath, 1) != 0) {
+		fprintf(stderr, "hvwrappd: no private place for the socket (use --socket PATH)\n");
+		return 1;
+	}
+
+	/* refuse to steal the socket of a live daemon, clean up a stale one */
+	if((fd = sock_connect(path)) >= 0) {
+		close(fd);
+		fprintf(stderr, "hvwrappd: already running on %s\n", path);
+		return 2;
+	}
+	if(lstat(path, &st) == 0 && !sock_owned(path)) {
+		fprintf(stderr, "hvwrappd: %s exists and is not a socket of this user\n", path);
+		return 2;
+	}
+	unlink(path);
+
+	lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(lfd < 0) {
+		perror("hvwrappd: socket");
+		return 1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+	mask = umask(077);					/* no window with a socket open to others */
+	if(bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(lfd, 16) != 0) {
+		fprintf(stderr, "hvwrappd: cannot listen on %s: %s\n", path, strerror(errno));
+		umask(mask);
+		close(lfd);
+		return 1;
+	}
+	umask(mask);
+	chmod(path, 0600);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_stop;			/* no SA_RESTART: accept() must wake up */
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	fprintf(stderr, "hvwrappd: listening on %s\n", path);
+
+	while(!stopReq) {
+		struct timeval tmo;
+
+		fd = accept(lfd, NULL, NULL);
+		if(fd < 0) {
+			if(errno == EINTR)
+				continue;
+			perror("hvwrappd: accept");
+			break;
+		}
+		if(!peer_owned(fd)) {
+			fprintf(stderr, "hvwrappd: connection from another user refused\n");
+			close(fd);
+			continue;
+		}
+		/* a stuck client must not hold the crates hostage */
+		tmo.tv_sec = CLIENT_TIMEOUT_S;
+		tmo.tv_usec = 0;
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tmo, sizeof(tmo));
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tmo, sizeof(tmo));
+		serve_one(fd);
+		close(fd);
+	}
+
+	for(i = 0; i < nSessions; i++)
+		cli_logout(&sessions[i], stderr);
+	nSessions = 0;
+	close(lfd);
+	unlink(path);
+	fprintf(stderr, "hvwrappd: stopped\n");
+	return 0;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  HVWRAPPD_FORWARD                                                         */
+/*  Runs argv on a live daemon. Returns the remote exit code, or -1 when no  */
+/*  daemon is listening and the caller should run the request itself.       */
+/*                                                                           */
+/*****************************************************************************/
+int hvwrappd_forward(const char *sockPath, int argc, char **argv)
+{
+	struct sockaddr_un	addr;
+	char				path[sizeof(addr.sun_path)];
+	char				cwd[4096];
+	char				*payload, *p;
+	size_t				len;
+	uint32_t			hdr[2], rsp[4];
+	int					fd, i;
+
+	if(sock_path(path, sizeof(path), sockPath, 0) != 0 || (fd = sock_connect(path)) < 0)
+		return -1;
+	/* argv carries --user/--pass: only to a daemon of this same user */
+	if(!sock_owned(path) || !peer_owned(fd)) {
+		fprintf(stderr, "hvwrappd: %s is not served by this user, running the request here\n", path);
+		close(fd);
+		return -1;
+	}
+
+	if(getcwd(cwd, sizeof(cwd)) == NULL)
+		strcpy(cwd, "/");
+	len = strlen(cwd) + 1;
+	for(i = 0; i < argc; i++)
+		len += strlen(argv[i]) + 1;
+	if(len > HVWRAPPD_MAX_REQ || (payload = malloc(len)) == NULL) {
+		close(fd);
+		return -1;
+	}
+	p = payload;
+	strcpy(p, cwd);
+	p += strlen(cwd) + 1;
+	for(i = 0; i < argc; i++) {
+		strcpy(p, argv[i]);
+		p += strlen(argv[i]) + 1;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	hdr[0] = HVWRAPPD_MAGIC;
+	hdr[1] = (uint32_t)len;
+	if(write_full(fd, hdr, sizeof(hdr)) != 0 || write_full(fd, payload, len) != 0 ||
+	   read_full(fd, rsp, sizeof(rsp)) != 0 || rsp[0] != HVWRAPPD_MAGIC) {
+		/* the daemon may have acted on the request: do not run it again */
+		fprintf(stderr, "hvwrappd: request on %s failed: %s\n", path, strerror(errno));
+		free(payload);
+		close(fd);
+		return 1;
+	}
+	free(payload);
+
+	for(i = 0; i < 2; i++) {
+		uint32_t	left = rsp[2 + i];
+		FILE		*dst = i == 0 ? stdout : stderr;
+		char		buf[4096];
+
+		while(left > 0) {
+			uint32_t n = left < sizeof(buf) ? left : (uint32_t)sizeof(buf);
+			if(read_full(fd, buf, n) != 0) {
+				close(fd);
+				return 1;
+			}
+			fwrite(buf, 1, n, dst);
+			left -= n;
+		}
+	}
+	fflush(stdout);
+	close(fd);
+	return (int)(int32_t)rsp[1];
+}
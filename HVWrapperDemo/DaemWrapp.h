@@ -0,0 +1,28 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   DAEMWRAPP.H                                                             */
+/*                                                                           */
+/*   hvwrappd: keeps one logged-in handle per crate and serves CLI requests  */
+/*   over a local Unix socket.                                               */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef __DAEMWRAPP_H
+#define __DAEMWRAPP_H
+
+#define HVWRAPPD_NAME      "hvwrappd"
+#define HVWRAPPD_MAGIC     (0x31575648u)		/* "HVW1" */
+#define HVWRAPPD_MAX_REQ   (64 * 1024)
+
+/*
+  Wire format (host byte order, local socket only)
+    request : magic, length, then 'length' bytes: cwd '\0' argv[0] '\0' ...
+    response: magic, exit code, stdout length, stderr length, stdout, stderr
+*/
+
+int hvwrappd_invoked(const char *argv0);
+int hvwrappd_main(const char *sockPath);
+int hvwrappd_forward(const char *sockPath, int argc, char **argv);
+
+#endif // __DAEMWRAPP_H
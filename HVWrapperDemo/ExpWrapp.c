@@ -0,0 +1,472 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   EXPWRAPP.C                                                              */
+/*                                                                           */
+/*   The acquisition loop renders every cycle once into an immutable,       */
+/*   reference counted snapshot of the exposition text and swaps it in.     */
+/*   One poll() thread serves all scrapers from the current snapshot, so a  */
+/*   scrape never touches the crate and costs the same however many         */
+/*   scrapers or channels there are.                                         */
+/*                                                                           */
+/*****************************************************************************/
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
+#include "CAENHVWrapper.h"
+#include "CliWrapp.h"
+#include "AcqWrapp.h"
+#include "ExpWrapp.h"
+
+/* one rendered cycle; 'len' bytes are the text format, 'omLen' add "# EOF" */
+typedef struct {
+	int		refs;
+	size_t	len, omLen;
+	char	data[];
+} exp_snap_t;
+
+typedef struct {
+	int			fd;				/* -1: free */
+	char		in[2048];
+	size_t		inLen;
+	char		head[256];
+	size_t		headLen;
+	exp_snap_t	*snap;			/* body, when it is the mirror */
+	const char	*body;
+	size_t		bodyLen, off;	/* off counts head + body bytes sent */
+	struct timespec	t0;
+} exp_conn_t;
+
+typedef struct {
+	pthread_mutex_t	lock;
+	exp_snap_t		*cur;
+	const acq_t		*a;
+	const char		*host;
+	char			metric[ACQ_MAX_PARAMS][64];
+	char			*buf;			/* render scratch */
+	size_t			bufLen, bufCap;
+	uint64_t		mirrorNs;		/* last cycle that read something */
+	int				lfd, wake[2];
+	exp_conn_t		conn[EXP_MAX_CONN];
+} exp_t;
+
+static void snap_release(exp_snap_t *sn)
+{
+	if(sn != NULL && __atomic_sub_fetch(&sn->refs, 1, __ATOMIC_ACQ_REL) == 0)
+		free(sn);
+}
+
+static exp_snap_t *snap_get(exp_t *e)
+{
+	exp_snap_t *sn;
+
+	pthread_mutex_lock(&e->lock);
+	sn = e->cur;
+	if(sn != NULL)
+		__atomic_add_fetch(&sn->refs, 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&e->lock);
+	return sn;
+}
+
+static void snap_publish(exp_t *e)
+{
+	static const char	eof[] = "# EOF\n";
+	exp_snap_t			*sn, *old;
+
+	sn = (exp_snap_t *)malloc(sizeof(*sn) + e->bufLen + sizeof(eof));
+	if(sn == NULL)
+		return;					/* keep serving the previous cycle */
+	sn->refs = 1;
+	sn->len = e->bufLen;
+	sn->omLen = e->bufLen + sizeof(eof) - 1;
+	memcpy(sn->data, e->buf, e->bufLen);
+	memcpy(sn->data + e->bufLen, eof, sizeof(eof));
+
+	pthread_mutex_lock(&e->lock);
+	old = e->cur;
+	e->cur = sn;
+	pthread_mutex_unlock(&e->lock);
+	snap_release(old);
+}
+
+static void emit(exp_t *e, const char *fmt, ...)
+{
+	va_list	ap;
+	int		n;
+
+	for(;;) {
+		va_start(ap, fmt);
+		n = vsnprintf(e->buf + e->bufLen, e->bufCap - e->bufLen, fmt, ap);
+		va_end(ap);
+		if(n < 0)
+			return;
+		if((size_t)n < e->bufCap - e->bufLen) {
+			e->bufLen += (size_t)n;
+			return;
+		}
+		char *nb = (char *)realloc(e->buf, e->bufCap * 2 + (size_t)n);
+		if(nb == NULL)
+			return;
+		e->buf = nb;
+		e->bufCap = e->bufCap * 2 + (size_t)n;
+	}
+}
+
+static void render_up(exp_t *e, int up)
+{
+	if(up)
+		e->mirrorNs = acq_now_ns();
+	emit(e, "# HELP caenhv_up 1 if the last acquisition cycle read the crate.\n"
+	        "# TYPE caenhv_up gauge\ncaenhv_up{host=\"%s\"} %d\n", e->host, up);
+	emit(e, "# HELP caenhv_mirror_timestamp_seconds Time of the last mirror update.\n"
+	        "# TYPE caenhv_mirror_timestamp_seconds gauge\n"
+	        "caenhv_mirror_timestamp_seconds{host=\"%s\"} %.3f\n", e->host, (double)e->mirrorNs / 1e9);
+}
+
+/* acquisition sink: renders the latest value of every series (a tick may read only some
+   of them), one pass per parameter so each metric family is contiguous; caenhv_up drops
+   to 0 on a tick where every read failed */
+static int exp_put(void *ctx, const acq_sample_t *smp, int n)
+{
+	exp_t				*e = (exp_t *)ctx;
+	const acq_sample_t	*all = e->a->smp;
+	int					p, i;
+
+	(void)smp;
+	(void)n;
+	e->bufLen = 0;
+	render_up(e, e->a->tickFailed < e->a->tickReads);
+	for(p = 0; p < e->a->nPar; p++) {
+		emit(e, "# HELP %s CAEN HV channel parameter %s.\n# TYPE %s gauge\n",
+		     e->metric[p], e->a->par[p].name, e->metric[p]);
+		for(i = 0; i < e->a->nSmp; i++) {
+			const acq_sample_t *sm = &all[i];
+
+			if(sm->par != p || sm->tsNs == 0)
+				continue;
+			emit(e, "%s{host=\"%s\",slot=\"%u\",ch=\"%u\"} ", e->metric[p], e->host, sm->slot, sm->ch);
+			if(sm->type == PARAM_TYPE_NUMERIC)
+				emit(e, "%.9g\n", (double)sm->v.f);
+			else
+				emit(e, "%u\n", sm->v.u);
+		}
+	}
+	snap_publish(e);
+	return 0;
+}
+
+/*****************************************************************************/
+/*  HTTP side                                                                */
+/*****************************************************************************/
+
+static int parse_listen(const char *spec, struct sockaddr_in *sa)
+{
+	char		host[64] = "127.0.0.1";
+	const char	*colon = strrchr(spec, ':');
+	char		*end;
+	long		port;
+
+	memset(sa, 0, sizeof(*sa));
+	sa->sin_family = AF_INET;
+	if(colon != NULL) {
+		if((size_t)(colon - spec) >= sizeof(host))
+			return -1;
+		memcpy(host, spec, (size_t)(colon - spec));
+		host[colon - spec] = '\0';
+		spec = colon + 1;
+	}
+	port = strtol(spec, &end, 10);
+	if(end == spec || *end != '\0' || port < 1 || port > 65535 || inet_pton(AF_INET, host, &sa->sin_addr) != 1)
+		return -1;
+	sa->sin_port = htons((unsigned short)port);
+	return 0;
+}
+
+static void conn_close(exp_conn_t *c)
+{
+	close(c->fd);
+	snap_release(c->snap);
+	c->snap = NULL;
+	c->fd = -1;
+}
+
+static void conn_respond(exp_t *e, exp_conn_t *c)
+{
+	const char	*status = "200 OK";
+	const char	*type = "text/plain; version=0.0.4; charset=utf-8";
+	char		*sp;
+
+	c->in[c->inLen] = '\0';
+	sp = strchr(c->in, ' ');
+	if(strncmp(c->in, "GET ", 4) != 0 || sp == NULL) {
+		status = "405 Method Not Allowed";
+		c->body = "GET only\n";
+	} else if(strncmp(sp + 1, "/metrics", 8) == 0 && (sp[9] == ' ' || sp[9] == '?')) {
+		c->snap = snap_get(e);
+		if(c->snap == NULL) {
+			status = "503 Service Unavailable";
+			c->body = "first acquisition cycle not done yet\n";
+		} else if(strstr(c->in, "application/openmetrics-text") != NULL) {
+			type = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+			c->body = c->snap->data;
+			c->bodyLen = c->snap->omLen;
+		} else {
+			c->body = c->snap->data;
+			c->bodyLen = c->snap->len;
+		}
+	} else if(strncmp(sp + 1, "/ ", 2) == 0) {
+		type = "text/html";
+		c->body = "<html><body><a href=\"/metrics\">/metrics</a></body></html>\n";
+	} else {
+		status = "404 Not Found";
+		c->body = "not found\n";
+	}
+	if(c->snap == NULL)
+		c->bodyLen = strlen(c->body);
+	c->headLen = (size_t)snprintf(c->head, sizeof(c->head),
+		"HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+		status, type, c->bodyLen);
+	c->off = 0;
+}
+
+/* 1 while the connection has more to do */
+static int conn_io(exp_t *e, exp_conn_t *c, short rev)
+{
+	ssize_t n;
+
+	if(c->headLen == 0) {
+		if(!(rev & (POLLIN | POLLHUP | POLLERR)))
+			return 1;
+		n = recv(c->fd, c->in + c->inLen, sizeof(c->in) - 1 - c->inLen, 0);
+		if(n <= 0)
+			return n < 0 && (errno == EAGAIN || errno == EINTR);
+		c->inLen += (size_t)n;
+		c->in[c->inLen] = '\0';
+		if(strstr(c->in, "\r\n\r\n") == NULL && strstr(c->in, "\n\n") == NULL) {
+			if(c->inLen < sizeof(c->in) - 1)
+				return 1;
+			c->inLen = 0;		/* oversized: answer as a bad method */
+		}
+		conn_respond(e, c);
+	}
+	while(c->off < c->headLen + c->bodyLen) {
+		const char	*p;
+		size_t		left;
+
+		if(c->off < c->headLen) {
+			p = c->head + c->off;
+			left = c->headLen - c->off;
+		} else {
+			p = c->body + (c->off - c->headLen);
+			left = c->bodyLen - (c->off - c->headLen);
+		}
+		n = send(c->fd, p, left, MSG_NOSIGNAL);
+		if(n < 0)
+			return errno == EAGAIN || errno == EINTR;
+		c->off += (size_t)n;
+	}
+	return 0;
+}
+
+static long ms_since(const struct timespec *t0)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long)(now.tv_sec - t0->tv_sec) * 1000L + (now.tv_nsec - t0->tv_nsec) / 1000000L;
+}
+
+static void *serve(void *arg)
+{
+	exp_t			*e = (exp_t *)arg;
+	struct pollfd	pfd[EXP_MAX_CONN + 2];
+	int				map[EXP_MAX_CONN + 2];
+	int				i, n, free_slot;
+
+	for(;;) {
+		n = 0;
+		pfd[n].fd = e->wake[0];
+		pfd[n++].events = POLLIN;
+		for(i = 0, free_slot = -1; i < EXP_MAX_CONN; i++) {
+			exp_conn_t *c = &e->conn[i];
+
+			if(c->fd < 0) {
+				if(free_slot < 0) free_slot = i;
+				continue;
+			}
+			if(ms_since(&c->t0) > EXP_IO_TIMEOUT_MS) {
+				conn_close(c);
+				if(free_slot < 0) free_slot = i;
+				continue;
+			}
+			map[n] = i;
+			pfd[n].fd = c->fd;
+			pfd[n++].events = c->headLen == 0 ? POLLIN : POLLOUT;
+		}
+		if(free_slot >= 0) {
+			map[n] = -1;
+			pfd[n].fd = e->lfd;
+			pfd[n++].events = POLLIN;
+		}
+
+		if(poll(pfd, (nfds_t)n, 1000) < 0 && errno != EINTR)
+			break;
+		if(pfd[0].revents)
+			break;				/* exp_run is done */
+		for(i = 1; i < n; i++) {
+			if(pfd[i].revents == 0)
+				continue;
+			if(map[i] < 0) {
+				int fd = accept(e->lfd, NULL, NULL);
+
+				if(fd >= 0) {
+					exp_conn_t *c = &e->conn[free_slot];
+
+					fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+					memset(c, 0, sizeof(*c));
+					c->fd = fd;
+					clock_gettime(CLOCK_MONOTONIC, &c->t0);
+				}
+			} else if(!conn_io(e, &e->conn[map[i]], pfd[i].revents))
+				conn_close(&e->conn[map[i]]);
+		}
+	}
+
+	for(i = 0; i < EXP_MAX_CONN; i++)
+		if(e->conn[i].fd >= 0)
+			conn_close(&e->conn[i]);
+	return NULL;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  EXP_RUN                                                                  */
+/*  Serves until SIGINT/SIGTERM. If the link drops, caenhv_up goes to 0 and  */
+/*  the crate is logged in again, first after one period, then backing off  */
+/*  up to EXP_RELOGIN_MAX_MS; a stop request still ends the run cleanly.     */
+/*                                                                           */
+/*****************************************************************************/
+int exp_run(cli_sess_t *s, cli_req_t *req, FILE *out, FILE *err)
+{
+	struct sockaddr_in	sa;
+	exp_t				e;
+	acq_t				a;
+	acq_sink_t			sink;
+	pthread_t			tid;
+	const char			*listen_spec = req->listen ? req->listen : EXP_DEFAULT_LISTEN;
+	int					exitCode, i, one = 1;
+
+	if(parse_listen(listen_spec, &sa) != 0) {
+		fprintf(err, "Invalid --listen '%s' (use [ADDR:]PORT, PORT 1..65535)\n", listen_spec);
+		return 2;
+	}
+	if(req->getParam == NULL)
+		req->getParam = EXP_DEFAULT_PARAMS;
+	exitCode = acq_init(&a, s, req, err);
+	if(exitCode != 0) {
+		acq_free(&a);
+		return exitCode;
+	}
+
+	memset(&e, 0, sizeof(e));
+	pthread_mutex_init(&e.lock, NULL);
+	e.a = &a;
+	e.host = s->host;
+	for(i = 0; i < EXP_MAX_CONN; i++)
+		e.conn[i].fd = -1;
+	for(i = 0; i < a.nPar; i++) {
+		char *m = e.metric[i];
+		int k = snprintf(m, sizeof(e.metric[i]), "caenhv_");
+
+		for(const char *c = a.par[i].name; *c && k < (int)sizeof(e.metric[i]) - 1; c++)
+			m[k++] = isalnum((unsigned char)*c) ? (char)tolower((unsigned char)*c) : '_';
+		m[k] = '\0';
+	}
+	e.bufCap = 4096;
+	e.buf = (char *)malloc(e.bufCap);
+
+	e.lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if(e.buf == NULL || e.lfd < 0 || pipe(e.wake) != 0
+	|| setsockopt(e.lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0
+	|| bind(e.lfd, (struct sockaddr *)&sa, sizeof(sa)) != 0 || listen(e.lfd, 64) != 0) {
+		fprintf(err, "Cannot listen on %s: %s\n", listen_spec, strerror(errno));
+		if(e.lfd >= 0) close(e.lfd);
+		free(e.buf);
+		acq_free(&a);
+		return 1;
+	}
+	fcntl(e.lfd, F_SETFL, fcntl(e.lfd, F_GETFL) | O_NONBLOCK);
+	if(pthread_create(&tid, NULL, serve, &e) != 0) {
+		fprintf(err, "Cannot start the HTTP thread\n");
+		close(e.lfd);
+		close(e.wake[0]);
+		close(e.wake[1]);
+		free(e.buf);
+		acq_free(&a);
+		return 1;
+	}
+
+	sink.ctx = &e;
+	sink.put = exp_put;
+	sink.close = NULL;
+	sink.unfiltered = 0;
+	acq_add_sink(&a, &sink);
+	fprintf(out, "Serving http://%s:%u/metrics: %d parameter(s) on %d slot(s), refreshed every %lld ms\n",
+	        inet_ntoa(sa.sin_addr), ntohs(sa.sin_port), a.nPar, req->nTargets, (long long)(a.fastNs / 1000000LL));
+	fflush(out);
+
+	acq_stop_handlers(1);				/* also through the relogin waits */
+	for(;;) {
+		long waitMs = a.periodMs > 0 ? a.periodMs : ACQ_DEFAULT_PERIOD;
+
+		exitCode = acq_run(&a, err);
+		if(!cli_link_lost(exitCode) || acq_stopped())
+			break;
+		/* keep answering scrapes, with the channels gone and caenhv_up 0 */
+		e.bufLen = 0;
+		render_up(&e, 0);
+		snap_publish(&e);
+		cli_logout(s, err);
+		while(!acq_stopped()) {
+			struct timespec ts = { waitMs / 1000, (waitMs % 1000) * 1000000L };
+
+			nanosleep(&ts, NULL);			/* a signal cuts it short */
+			if(acq_stopped() || cli_login(s, err) == 0)
+				break;
+			waitMs = waitMs * 2 < EXP_RELOGIN_MAX_MS ? waitMs * 2 : EXP_RELOGIN_MAX_MS;
+		}
+		if(acq_stopped())
+			break;
+		fprintf(err, "Crate %s logged in again\n", s->host);
+	}
+	acq_stop_handlers(0);
+
+	if(write(e.wake[1], "x", 1) < 0)
+		fprintf(err, "Cannot stop the HTTP thread: %s\n", strerror(errno));
+	pthread_join(tid, NULL);
+	close(e.lfd);
+	close(e.wake[0]);
+	close(e.wake[1]);
+	snap_release(e.cur);
+	free(e.buf);
+	pthread_mutex_destroy(&e.lock);
+	if(a.sched) {
+		fprintf(out, "Reads:\n");
+		acq_report(&a, out);
+	}
+	acq_free(&a);
+	return exitCode;
+}
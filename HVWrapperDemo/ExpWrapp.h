@@ -0,0 +1,25 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   EXPWRAPP.H                                                              */
+/*                                                                           */
+/*   --exporter: Prometheus/OpenMetrics endpoint served from a mirror of    */
+/*   the crate that one acquisition loop refreshes every --period ms.        */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef __EXPWRAPP_H
+#define __EXPWRAPP_H
+
+#include <stdio.h>
+#include "CliWrapp.h"
+
+#define EXP_DEFAULT_LISTEN "127.0.0.1:9780"
+#define EXP_DEFAULT_PARAMS CLI_SNAPSHOT_PARAMS
+#define EXP_MAX_CONN       (64)
+#define EXP_IO_TIMEOUT_MS  (10000)
+#define EXP_RELOGIN_MAX_MS (60000)			/* relogin backoff cap */
+
+int exp_run(cli_sess_t *s, cli_req_t *req, FILE *out, FILE *err);
+
+#endif // __EXPWRAPP_H
@@ -0,0 +1,180 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   FILTWRAPP.C                                                             */
+/*                                                                           */
+/*   The filter works on raw 32-bit values as they come out of GetChParam   */
+/*   or an event, before anything is formatted or stored: a dropped sample  */
+/*   costs one comparison. Numeric parameters pass when they differ from    */
+/*   the last value let through by more than max(abs, rel * |last|) (any    */
+/*   difference when both are 0); the others when they differ at all.      */
+/*   The first sample of a series always passes, and so does any sample     */
+/*   arriving --heartbeat seconds after the last one let through.           */
+/*                                                                           */
+/*****************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "CAENHVWrapper.h"
+#include "CliWrapp.h"
+#include "FiltWrapp.h"
+
+/* --deadband VMon=0.5,IMon=2%,Pw: 'Pw' alone is change-only */
+static int band_parse(const char *spec, const char *name, filt_band_t *b, FILE *err)
+{
+	const char	*p = spec;
+	size_t		nameLen = strlen(name);
+
+	while(*p != '\0') {
+		const char	*end = strchr(p, ','), *eq;
+		size_t		len = end ? (size_t)(end - p) : strlen(p);
+
+		eq = memchr(p, '=', len);
+		if((eq ? (size_t)(eq - p) : len) == nameLen && strncmp(p, name, nameLen) == 0) {
+			char	val[32], *stop;
+			size_t	vLen = eq ? len - (size_t)(eq + 1 - p) : 0;
+			double	v;
+
+			b->on = 1;
+			b->abs = b->rel = 0.0f;
+			if(eq == NULL)
+				return 1;
+			if(vLen == 0 || vLen >= sizeof(val))
+				goto bad;
+			memcpy(val, eq + 1, vLen);
+			val[vLen] = '\0';
+			v = strtod(val, &stop);
+			if(stop == val || v < 0.0 || (*stop != '\0' && strcmp(stop, "%") != 0))
+				goto bad;
+			if(*stop == '%')
+				b->rel = (float)(v / 100.0);
+			else
+				b->abs = (float)v;
+			return 1;
+		}
+		p += len + (end ? 1 : 0);
+	}
+	return 0;
+
+bad:
+	fprintf(err, "Invalid --deadband entry for %s in '%s' (use PARAM=ABS, PARAM=PCT%% or PARAM)\n", name, spec);
+	return -1;
+}
+
+/* every name of the spec must be one of the parameters read */
+static int spec_check(const char *spec, const char **names, int nPar, FILE *err)
+{
+	const char *p = spec;
+
+	while(*p != '\0') {
+		const char	*end = strchr(p, ','), *eq;
+		size_t		len = end ? (size_t)(end - p) : strlen(p);
+		int			i;
+
+		eq = memchr(p, '=', len);
+		if(eq != NULL)
+			len = (size_t)(eq - p);
+		for(i = 0; i < nPar; i++)
+			if(strlen(names[i]) == len && strncmp(p, names[i], len) == 0)
+				break;
+		if(len == 0 || i == nPar) {
+			fprintf(err, "--deadband '%.*s' is not among the parameters read\n", (int)len, p);
+			return -1;
+		}
+		p = end ? end + 1 : p + strlen(p);
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  FILT_INIT                                                                */
+/*  Bands of the nPar parameters from --deadband/--changes; one slot of     */
+/*  state per series, numbered by the caller. Returns 0 or an exit code.    */
+/*                                                                           */
+/*****************************************************************************/
+int filt_init(filt_t *f, const cli_req_t *req, const char **names, const unsigned long *types,
+              int nPar, int nSeries, FILE *err)
+{
+	int p;
+
+	memset(f, 0, sizeof(*f));
+	if(req->deadband == NULL && !req->changes)
+		return 0;
+	if(nPar > FILT_MAX_PARAMS) {
+		fprintf(err, "--deadband/--changes filter at most %d parameters, %d are read\n", FILT_MAX_PARAMS, nPar);
+		return 2;
+	}
+	if(req->deadband != NULL && spec_check(req->deadband, names, nPar, err) != 0)
+		return 2;
+	for(p = 0; p < nPar; p++) {
+		f->numeric[p] = types[p] == PARAM_TYPE_NUMERIC;
+		f->band[p].on = req->changes;
+		if(req->deadband != NULL && band_parse(req->deadband, names[p], &f->band[p], err) < 0)
+			return 2;
+		f->on |= f->band[p].on;
+	}
+	f->heartbeatNs = (uint64_t)(req->heartbeatS >= 0 ? req->heartbeatS : FILT_DEFAULT_HEARTBEAT) * 1000000000ull;
+	f->nSeries = nSeries;
+	f->last = (uint32_t *)calloc((size_t)nSeries, sizeof(uint32_t));
+	f->lastNs = (uint64_t *)calloc((size_t)nSeries, sizeof(uint64_t));
+	if(f->last == NULL || f->lastNs == NULL) {
+		fprintf(err, "Out of memory\n");
+		return 3;
+	}
+	return 0;
+}
+
+/* 1 when the sample goes on; the caller formats or stores nothing otherwise */
+int filt_pass(filt_t *f, int series, int par, uint32_t raw, uint64_t nowNs)
+{
+	const filt_band_t	*b = &f->band[par];
+	uint32_t			last;
+
+	if(!f->on || !b->on)
+		return 1;
+	last = f->last[series];
+	if(f->lastNs[series] != 0 && (f->heartbeatNs == 0 || nowNs - f->lastNs[series] < f->heartbeatNs)) {
+		if(raw == last) {
+			f->dropped++;
+			return 0;
+		}
+		if(f->numeric[par] && (b->abs > 0.0f || b->rel > 0.0f)) {
+			float v, lv, band;
+
+			memcpy(&v, &raw, sizeof(v));
+			memcpy(&lv, &last, sizeof(lv));
+			band = b->rel * fabsf(lv);
+			if(band < b->abs)
+				band = b->abs;
+			if(fabsf(v - lv) <= band) {
+				f->dropped++;
+				return 0;
+			}
+		}
+	}
+	f->last[series] = raw;
+	f->lastNs[series] = nowNs;
+	f->passed++;
+	return 1;
+}
+
+void filt_report(const filt_t *f, FILE *out)
+{
+	uint64_t total = f->passed + f->dropped;
+
+	if(!f->on)
+		return;
+	fprintf(out, "Filter: %llu of %llu sample(s) kept (%.1f%%)\n", (unsigned long long)f->passed,
+	        (unsigned long long)total, total ? 100.0 * (double)f->passed / (double)total : 0.0);
+}
+
+void filt_free(filt_t *f)
+{
+	free(f->last);
+	free(f->lastNs);
+	f->last = NULL;
+	f->lastNs = NULL;
+}
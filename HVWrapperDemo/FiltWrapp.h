@@ -0,0 +1,45 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   FILTWRAPP.H                                                             */
+/*                                                                           */
+/*   Deadband / change-only filter for the monitoring paths (--deadband,     */
+/*   --changes, --heartbeat): a sample goes on only when it left the band    */
+/*   around the last value that went on, or when the heartbeat expired.      */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef __FILTWRAPP_H
+#define __FILTWRAPP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "CliWrapp.h"
+
+#define FILT_MAX_PARAMS        (16)
+#define FILT_DEFAULT_HEARTBEAT (60)			/* s, when a filter is on */
+
+typedef struct {
+	int		on;
+	float	abs;				/* band in the parameter unit */
+	float	rel;				/* band as a fraction of the last value */
+} filt_band_t;
+
+typedef struct {
+	int				on;				/* any parameter filtered */
+	filt_band_t		band[FILT_MAX_PARAMS];
+	int				numeric[FILT_MAX_PARAMS];
+	uint64_t		heartbeatNs;	/* 0: none */
+	uint32_t		*last;			/* last value let through, per series */
+	uint64_t		*lastNs;		/* and when; 0 = never */
+	int				nSeries;
+	uint64_t		passed, dropped;
+} filt_t;
+
+int  filt_init(filt_t *f, const cli_req_t *req, const char **names, const unsigned long *types,
+               int nPar, int nSeries, FILE *err);
+int  filt_pass(filt_t *f, int series, int par, uint32_t raw, uint64_t nowNs);
+void filt_report(const filt_t *f, FILE *out);
+void filt_free(filt_t *f);
+
+#endif // __FILTWRAPP_H
@@ -0,0 +1,262 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   FMTWRAPP.C                                                              */
+/*                                                                           */
+/*   json: one line per slot read, the channels and each parameter as       */
+/*         arrays: {"ts":..,"host":..,"slot":1,"skew_ms":..,"ch":[..],       */
+/*         "VMon":[..],..}; non-finite numbers are null.                     */
+/*   csv:  a header line, then ts,host,slot,ch,PARAM,.. one row a channel.  */
+/*   bin:  a --record header page with capacity 0, then 24-byte             */
+/*         acq_sample_t records, slot by slot, channel by channel, in       */
+/*         --get order; --rec-dump reads it, and so can anything that maps  */
+/*         the file.                                                         */
+/*   'ts' is the wall clock after the last read of the slot, in seconds.    */
+/*                                                                           */
+/*****************************************************************************/
+#include <sys/types.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "CAENHVWrapper.h"
+#include "CliWrapp.h"
+#include "AcqWrapp.h"
+#include "RecWrapp.h"
+#include "FmtWrapp.h"
+
+int fmt_parse(const char *name)
+{
+	if(name == NULL || strcmp(name, "text") == 0)
+		return FMT_TEXT;
+	if(strcmp(name, "json") == 0)
+		return FMT_JSON;
+	if(strcmp(name, "csv") == 0)
+		return FMT_CSV;
+	if(strcmp(name, "bin") == 0)
+		return FMT_BIN;
+	return -1;
+}
+
+void fmt_init(fmt_out_t *o, int kind, const char *host)
+{
+	memset(o, 0, sizeof(*o));
+	o->kind = kind;
+	o->host = host ? host : "";
+}
+
+/* the buffer is sized in fmt_open; growing here only covers a bad estimate */
+static int reserve(fmt_out_t *o, size_t n)
+{
+	if(o->len + n <= o->cap)
+		return 0;
+	size_t	cap = (o->len + n) * 2;
+	char	*nb = (char *)realloc(o->buf, cap);
+
+	if(nb == NULL)
+		return -1;
+	o->buf = nb;
+	o->cap = cap;
+	return 0;
+}
+
+static int put(fmt_out_t *o, const char *fmt, ...)
+{
+	va_list	ap;
+	int		n;
+
+	for(;;) {
+		va_start(ap, fmt);
+		n = vsnprintf(o->buf + o->len, o->cap - o->len, fmt, ap);
+		va_end(ap);
+		if(n < 0)
+			return -1;
+		if((size_t)n < o->cap - o->len) {
+			o->len += (size_t)n;
+			return 0;
+		}
+		if(reserve(o, (size_t)n + 1) != 0)
+			return -1;
+	}
+}
+
+/* hosts come from the command line: only '"' and '\' need escaping */
+static int put_json_str(fmt_out_t *o, const char *s)
+{
+	if(put(o, "\"") != 0)
+		return -1;
+	for(; *s != '\0'; s++)
+		if(put(o, (*s == '"' || *s == '\\') ? "\\%c" : "%c", *s) != 0)
+			return -1;
+	return put(o, "\"");
+}
+
+static int put_value(fmt_out_t *o, int p, const void *vals, int k)
+{
+	if(o->types[p] == PARAM_TYPE_NUMERIC) {
+		float f = ((const float *)vals)[k];
+
+		if(o->kind == FMT_JSON && !isfinite(f))
+			return put(o, "null");
+		return put(o, "%.7g", (double)f);
+	}
+	return put(o, "%u", ((const unsigned int *)vals)[k]);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  FMT_OPEN                                                                 */
+/*  Once per run, at the first read: sizes the buffer for a cycle over all   */
+/*  the slots of 'req' and queues the csv header or the bin header page.     */
+/*                                                                           */
+/*****************************************************************************/
+int fmt_open(fmt_out_t *o, const cli_req_t *req, const char (*names)[MAX_PARAM_NAME + 2],
+             const unsigned long *types, int nPar, FILE *err)
+{
+	size_t	hostLen = strlen(o->host), total = 0;
+	int		p, t;
+
+	o->nPar = nPar;
+	for(p = 0; p < nPar; p++) {
+		strcpy(o->names[p], names[p]);
+		o->types[p] = types[p];
+	}
+	for(t = 0; t < req->nTargets; t++)
+		total += (size_t)req->targets[t].count;
+	o->cap = REC_HEADER_SIZE + (size_t)req->nTargets * (256 + hostLen + (size_t)nPar * 24)
+	       + total * (64 + hostLen + (size_t)nPar * 24);
+	o->buf = (char *)malloc(o->cap);
+	if(o->buf == NULL) {
+		fprintf(err, "Out of memory\n");
+		return 3;
+	}
+	o->len = 0;
+	o->open = 1;
+
+	if(o->kind == FMT_CSV) {
+		put(o, "ts,host,slot,ch");
+		for(p = 0; p < nPar; p++)
+			put(o, ",%s", names[p]);
+		put(o, "\n");
+	} else if(o->kind == FMT_BIN) {
+		rec_header_t *h;
+
+		if(nPar > ACQ_MAX_PARAMS) {
+			fprintf(err, "--format bin holds at most %d parameters\n", ACQ_MAX_PARAMS);
+			return 2;
+		}
+		memset(o->buf, 0, REC_HEADER_SIZE);
+		h = (rec_header_t *)o->buf;
+		h->magic = REC_MAGIC;
+		h->version = REC_VERSION;
+		h->headerSize = REC_HEADER_SIZE;
+		h->sampleSize = sizeof(acq_sample_t);
+		h->capacity = 0;
+		h->createdNs = acq_now_ns();
+		h->periodMs = (uint32_t)(req->cycles > 1 ? (req->periodMs > 0 ? req->periodMs : ACQ_DEFAULT_PERIOD) : 0);
+		h->nPar = (uint32_t)nPar;
+		snprintf(h->host, sizeof(h->host), "%s", o->host);
+		for(p = 0; p < nPar; p++)
+			strcpy(h->parName[p], names[p]);
+		o->len = REC_HEADER_SIZE;
+	}
+	return 0;
+}
+
+/* the rows of one slot read; vals[p] holds parameter p for the n channels */
+int fmt_rows(fmt_out_t *o, uint64_t tsNs, int slot, const unsigned short *ch, int n,
+             void *const *vals, double skewMs)
+{
+	unsigned long long	sec = (unsigned long long)(tsNs / 1000000000ull);
+	unsigned			usec = (unsigned)(tsNs % 1000000000ull / 1000ull);
+	int					k, p, rc = 0;
+
+	if(o->kind == FMT_BIN) {
+		acq_sample_t *sm;
+
+		if(reserve(o, (size_t)n * (size_t)o->nPar * sizeof(acq_sample_t)) != 0)
+			return -1;
+		sm = (acq_sample_t *)(o->buf + o->len);
+		memset(sm, 0, (size_t)n * (size_t)o->nPar * sizeof(acq_sample_t));
+		for(k = 0; k < n; k++)
+			for(p = 0; p < o->nPar; p++, sm++) {
+				sm->tsNs = tsNs;
+				sm->slot = (uint16_t)slot;
+				sm->ch = ch[k];
+				sm->par = (uint16_t)p;
+				sm->type = (uint16_t)o->types[p];
+				sm->v.u = ((const uint32_t *)vals[p])[k];
+				sm->series = o->series++;
+			}
+		o->len += (size_t)n * (size_t)o->nPar * sizeof(acq_sample_t);
+		return 0;
+	}
+
+	if(o->kind == FMT_CSV) {
+		for(k = 0; k < n && rc == 0; k++) {
+			rc |= put(o, "%llu.%06u,%s,%d,%u", sec, usec, o->host, slot, ch[k]);
+			for(p = 0; p < o->nPar; p++) {
+				rc |= put(o, ",");
+				rc |= put_value(o, p, vals[p], k);
+			}
+			rc |= put(o, "\n");
+		}
+		return rc;
+	}
+
+	rc |= put(o, "{\"ts\":%llu.%06u,\"host\":", sec, usec);
+	rc |= put_json_str(o, o->host);
+	rc |= put(o, ",\"slot\":%d,\"skew_ms\":%.3f,\"ch\":[", slot, skewMs);
+	for(k = 0; k < n; k++)
+		rc |= put(o, k ? ",%u" : "%u", ch[k]);
+	for(p = 0; p < o->nPar; p++) {
+		rc |= put(o, "],\"%s\":[", o->names[p]);
+		for(k = 0; k < n; k++) {
+			if(k)
+				rc |= put(o, ",");
+			rc |= put_value(o, p, vals[p], k);
+		}
+	}
+	rc |= put(o, "]}\n");
+	return rc;
+}
+
+/* the cycle in one write(2), or one fwrite when 'out' is not a file (hvwrappd, --host a,b) */
+int fmt_flush(fmt_out_t *o, FILE *out)
+{
+	const char	*p = o->buf;
+	size_t		left = o->len;
+	int			fd = fileno(out);
+
+	o->len = 0;
+	o->series = 0;
+	if(left == 0)
+		return 0;
+	if(fd < 0)
+		return fwrite(p, 1, left, out) == left ? 0 : -1;
+	fflush(out);
+	while(left > 0) {
+		ssize_t n = write(fd, p, left);
+
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += n;
+		left -= (size_t)n;
+	}
+	return 0;
+}
+
+void fmt_free(fmt_out_t *o)
+{
+	free(o->buf);
+	o->buf = NULL;
+	o->cap = o->len = 0;
+	o->open = 0;
+}
@@ -0,0 +1,41 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   FMTWRAPP.H                                                              */
+/*                                                                           */
+/*   --format json|csv|bin for --get reads: the rows of a read cycle are     */
+/*   formatted into one buffer, sized once, and go out in a single write.    */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef __FMTWRAPP_H
+#define __FMTWRAPP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "CliWrapp.h"
+
+enum { FMT_TEXT, FMT_JSON, FMT_CSV, FMT_BIN };
+
+typedef struct {
+	int				kind;			/* FMT_* */
+	int				open;			/* header written, buffer sized */
+	const char		*host;
+	int				nPar;
+	char			names[CLI_MAX_GET][MAX_PARAM_NAME + 2];
+	unsigned long	types[CLI_MAX_GET];
+	uint32_t		series;			/* next bin series in this cycle */
+	char			*buf;
+	size_t			len, cap;
+} fmt_out_t;
+
+int  fmt_parse(const char *name);
+void fmt_init(fmt_out_t *o, int kind, const char *host);
+int  fmt_open(fmt_out_t *o, const cli_req_t *req, const char (*names)[MAX_PARAM_NAME + 2],
+              const unsigned long *types, int nPar, FILE *err);
+int  fmt_rows(fmt_out_t *o, uint64_t tsNs, int slot, const unsigned short *ch, int n,
+              void *const *vals, double skewMs);
+int  fmt_flush(fmt_out_t *o, FILE *out);
+void fmt_free(fmt_out_t *o);
+
+#endif // __FMTWRAPP_H
@@ -0,0 +1,703 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   HISTWRAPP.C                                                             */
+/*                                                                           */
+/*   History writer (an acquisition sink), reader/exporter and benchmark.   */
+/*   Each series keeps an open chunk in memory and encodes a point in a few */
+/*   shifts; the file only sees one fwrite per closed chunk.                 */
+/*                                                                           */
+/*****************************************************************************/
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <math.h>
+#include "CAENHVWrapper.h"
+#include "AcqWrapp.h"
+#include "HistWrapp.h"
+
+#define MAX_POINT_BITS     (4 + 32 + 2 + 5 + 5 + 32)
+#define CHUNK_BYTES_MAX    ((HIST_CHUNK_POINTS * MAX_POINT_BITS + 7) / 8 + 8)
+
+typedef struct {
+	hist_chunk_t	hdr;			/* count == 0: no open chunk */
+	uint8_t			*buf;
+	size_t			len;
+	uint64_t		acc;			/* bits not yet in buf */
+	int				nAcc;
+	int64_t			tPrev, dPrev;
+	uint32_t		vPrev;
+	int				lead, trail;	/* XOR window; lead -1: none yet */
+} series_t;
+
+typedef struct {
+	FILE		*f;
+	series_t	*ser;
+	int			nSer;
+	char		names[ACQ_MAX_PARAMS][MAX_PARAM_NAME + 2];
+	int			nPar;
+	uint64_t	bytes;			/* written, headers included */
+	int			failed;
+} hist_t;
+
+typedef struct {
+	const uint8_t	*p;
+	size_t			nBits, bit;
+	int				bad;
+} bitr_t;
+
+/*****************************************************************************/
+/*  Encoder                                                                  */
+/*****************************************************************************/
+
+static void put_bits(series_t *s, uint32_t v, int n)
+{
+	s->acc = (s->acc << n) | (v & (n == 32 ? 0xffffffffu : ((1u << n) - 1)));
+	s->nAcc += n;
+	while(s->nAcc >= 8) {
+		s->nAcc -= 8;
+		s->buf[s->len++] = (uint8_t)(s->acc >> s->nAcc);
+	}
+}
+
+static int clz32(uint32_t x)	{ return __builtin_clz(x); }
+static int ctz32(uint32_t x)	{ return __builtin_ctz(x); }
+
+static int value_less(int type, uint32_t a, uint32_t b)
+{
+	if(type == PARAM_TYPE_NUMERIC) {
+		float fa, fb;
+
+		memcpy(&fa, &a, sizeof(fa));
+		memcpy(&fb, &b, sizeof(fb));
+		return fa < fb;
+	}
+	return a < b;
+}
+
+static int series_flush(hist_t *h, series_t *s)
+{
+	if(s->hdr.count == 0)
+		return 0;
+	if(s->nAcc > 0)
+		s->buf[s->len++] = (uint8_t)(s->acc << (8 - s->nAcc));
+	s->hdr.nBytes = (uint32_t)s->len;
+	if(fwrite(&s->hdr, sizeof(s->hdr), 1, h->f) != 1
+	|| (s->len > 0 && fwrite(s->buf, s->len, 1, h->f) != 1))
+		h->failed = 1;
+	h->bytes += sizeof(s->hdr) + s->len;
+	s->hdr.count = 0;
+	s->len = 0;
+	s->acc = 0;
+	s->nAcc = 0;
+	return h->failed ? -1 : 1;
+}
+
+/* returns 1 when a chunk was closed to make room */
+static int series_add(hist_t *h, series_t *s, const acq_sample_t *sm)
+{
+	int64_t		t = (int64_t)(sm->tsNs / 1000000ull);
+	int64_t		d, dod;
+	uint32_t	v = sm->v.u, x;
+	int			closed = 0;
+
+	if(s->hdr.count > 0) {
+		dod = (t - s->tPrev) - s->dPrev;
+		if(s->hdr.count >= HIST_CHUNK_POINTS || t - s->hdr.tFirst >= HIST_CHUNK_SPAN_MS
+		|| dod < INT32_MIN || dod > INT32_MAX
+		|| s->hdr.slot != sm->slot || s->hdr.ch != sm->ch || s->hdr.type != sm->type
+		|| strcmp(s->hdr.par, h->names[sm->par]) != 0)
+			closed = series_flush(h, s);
+	}
+
+	if(s->hdr.count == 0) {
+		memset(&s->hdr, 0, sizeof(s->hdr));
+		s->hdr.magic = HIST_CHUNK_MAGIC;
+		s->hdr.slot = sm->slot;
+		s->hdr.ch = sm->ch;
+		strcpy(s->hdr.par, h->names[sm->par]);
+		s->hdr.type = sm->type;
+		s->hdr.count = 1;
+		s->hdr.tFirst = s->hdr.tLast = t;
+		s->hdr.vFirst = s->hdr.vMin = s->hdr.vMax = v;
+		s->tPrev = t;
+		s->dPrev = 0;
+		s->vPrev = v;
+		s->lead = -1;
+		return closed;
+	}
+
+	d = t - s->tPrev;
+	dod = d - s->dPrev;
+	if(dod == 0)
+		put_bits(s, 0, 1);
+	else if(dod >= -63 && dod <= 64)
+		put_bits(s, 2, 2), put_bits(s, (uint32_t)(dod + 63), 7);
+	else if(dod >= -255 && dod <= 256)
+		put_bits(s, 6, 3), put_bits(s, (uint32_t)(dod + 255), 9);
+	else if(dod >= -2047 && dod <= 2048)
+		put_bits(s, 14, 4), put_bits(s, (uint32_t)(dod + 2047), 12);
+	else
+		put_bits(s, 15, 4), put_bits(s, (uint32_t)(int32_t)dod, 32);
+
+	x = v ^ s->vPrev;
+	if(x == 0)
+		put_bits(s, 0, 1);
+	else {
+		int lead = clz32(x), trail = ctz32(x);
+
+		if(s->lead >= 0 && lead >= s->lead && trail >= s->trail) {
+			put_bits(s, 2, 2);
+			put_bits(s, x >> s->trail, 32 - s->lead - s->trail);
+		} else {
+			int len = 32 - lead - trail;
+
+			put_bits(s, 3, 2);
+			put_bits(s, (uint32_t)lead, 5);
+			put_bits(s, (uint32_t)(len - 1), 5);
+			put_bits(s, x >> trail, len);
+			s->lead = lead;
+			s->trail = trail;
+		}
+	}
+
+	if(value_less(s->hdr.type, v, s->hdr.vMin)) s->hdr.vMin = v;
+	if(value_less(s->hdr.type, s->hdr.vMax, v)) s->hdr.vMax = v;
+	s->hdr.tLast = t;
+	s->hdr.count++;
+	s->tPrev = t;
+	s->dPrev = d;
+	s->vPrev = v;
+	return closed;
+}
+
+/*****************************************************************************/
+/*  Decoder                                                                  */
+/*****************************************************************************/
+
+static uint32_t get_bits(bitr_t *r, int n)
+{
+	uint32_t v = 0;
+
+	while(n > 0) {
+		int off, take;
+
+		if(r->bit >= r->nBits) {
+			r->bad = 1;
+			return 0;
+		}
+		off = (int)(r->bit & 7);
+		take = 8 - off;
+		if(take > n) take = n;
+		v = (v << take) | ((r->p[r->bit >> 3] >> (8 - off - take)) & ((1u << take) - 1));
+		r->bit += (size_t)take;
+		n -= take;
+	}
+	return v;
+}
+
+/* t[] and v[] receive hdr->count points; returns 0, or -1 on a bad stream */
+static int chunk_decode(const hist_chunk_t *hdr, const uint8_t *p, int64_t *t, uint32_t *v)
+{
+	bitr_t		r = { p, (size_t)hdr->nBytes * 8, 0, 0 };
+	int64_t		d = 0;
+	int			lead = -1, trail = 0;
+	uint32_t	i;
+
+	t[0] = hdr->tFirst;
+	v[0] = hdr->vFirst;
+	for(i = 1; i < hdr->count && !r.bad; i++) {
+		int64_t dod;
+
+		if(get_bits(&r, 1) == 0)
+			dod = 0;
+		else if(get_bits(&r, 1) == 0)
+			dod = (int64_t)get_bits(&r, 7) - 63;
+		else if(get_bits(&r, 1) == 0)
+			dod = (int64_t)get_bits(&r, 9) - 255;
+		else if(get_bits(&r, 1) == 0)
+			dod = (int64_t)get_bits(&r, 12) - 2047;
+		else
+			dod = (int32_t)get_bits(&r, 32);
+		d += dod;
+		t[i] = t[i - 1] + d;
+
+		if(get_bits(&r, 1) == 0)
+			v[i] = v[i - 1];
+		else if(get_bits(&r, 1) == 0) {
+			if(lead < 0) {
+				r.bad = 1;
+				break;
+			}
+			v[i] = v[i - 1] ^ (get_bits(&r, 32 - lead - trail) << trail);
+		} else {
+			int len;
+
+			lead = (int)get_bits(&r, 5);
+			len = (int)get_bits(&r, 5) + 1;
+			trail = 32 - lead - len;
+			if(trail < 0) {
+				r.bad = 1;
+				break;
+			}
+			v[i] = v[i - 1] ^ (get_bits(&r, len) << trail);
+		}
+	}
+	return r.bad ? -1 : 0;
+}
+
+/* next chunk header at the file position: 1, 0 at a clean end, -1 if torn */
+static int chunk_next(FILE *f, off_t size, hist_chunk_t *hdr)
+{
+	off_t at = ftello(f);
+	size_t n = fread(hdr, 1, sizeof(*hdr), f);
+
+	if(n == 0 && at == size)
+		return 0;
+	if(n != sizeof(*hdr) || hdr->magic != HIST_CHUNK_MAGIC || hdr->count == 0
+	|| hdr->nBytes > (uint64_t)hdr->count * 10 + 8
+	|| at + (off_t)sizeof(*hdr) + (off_t)hdr->nBytes > size)
+		return -1;
+	hdr->par[MAX_PARAM_NAME + 1] = '\0';
+	return 1;
+}
+
+/*****************************************************************************/
+/*  Writer                                                                   */
+/*****************************************************************************/
+
+static int hist_put(void *ctx, const acq_sample_t *smp, int n)
+{
+	hist_t	*h = (hist_t *)ctx;
+	int		i, need = 0, closed = 0;
+
+	for(i = 0; i < n; i++)
+		if((int)smp[i].series >= need)
+			need = (int)smp[i].series + 1;
+	if(need > h->nSer) {
+		series_t *ns = (series_t *)realloc(h->ser, sizeof(series_t) * (size_t)need);
+
+		if(ns == NULL)
+			return -1;
+		memset(ns + h->nSer, 0, sizeof(series_t) * (size_t)(need - h->nSer));
+		h->ser = ns;
+		for(i = h->nSer; i < need; i++) {
+			h->ser[i].buf = (uint8_t *)malloc(CHUNK_BYTES_MAX);
+			if(h->ser[i].buf == NULL) {
+				h->nSer = i;
+				return -1;
+			}
+		}
+		h->nSer = need;
+	}
+	/* a tick may read only some series; each sample says which one it belongs to */
+	for(i = 0; i < n; i++)
+		closed |= series_add(h, &h->ser[smp[i].series], &smp[i]);
+	if(closed && fflush(h->f) != 0)
+		h->failed = 1;
+	return h->failed ? -1 : 0;
+}
+
+static void hist_close(void *ctx)
+{
+	hist_t	*h = (hist_t *)ctx;
+	int		i;
+
+	for(i = 0; i < h->nSer; i++) {
+		series_flush(h, &h->ser[i]);
+		free(h->ser[i].buf);
+	}
+	fclose(h->f);
+	free(h->ser);
+	free(h);
+}
+
+static hist_t *hist_new(FILE *f, char (*names)[MAX_PARAM_NAME + 2], int nPar)
+{
+	hist_t *h = (hist_t *)calloc(1, sizeof(hist_t));
+
+	if(h == NULL)
+		return NULL;
+	h->f = f;
+	h->nPar = nPar;
+	memcpy(h->names, names, sizeof(h->names[0]) * (size_t)nPar);
+	return h;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  HIST_OPEN                                                                */
+/*  Appends to 'path' (created if missing). A chunk cut short by a crash is  */
+/*  dropped first, so new chunks follow the last complete one.               */
+/*                                                                           */
+/*****************************************************************************/
+int hist_open(const char *path, const acq_t *a, acq_sink_t *sink, FILE *err)
+{
+	char			names[ACQ_MAX_PARAMS][MAX_PARAM_NAME + 2];
+	hist_file_t		fh;
+	hist_chunk_t	hdr;
+	struct stat		st;
+	hist_t			*h;
+	FILE			*f;
+	off_t			end;
+	int				p, rc;
+
+	f = fopen(path, "r+b");
+	if(f == NULL && errno == ENOENT)
+		f = fopen(path, "w+b");
+	if(f == NULL || fstat(fileno(f), &st) != 0) {
+		fprintf(err, "Cannot open history '%s': %s\n", path, strerror(errno));
+		if(f) fclose(f);
+		return 1;
+	}
+
+	if(st.st_size == 0) {
+		memset(&fh, 0, sizeof(fh));
+		fh.magic = HIST_MAGIC;
+		fh.version = HIST_VERSION;
+		fh.createdNs = acq_now_ns();
+		if(fwrite(&fh, sizeof(fh), 1, f) != 1 || fflush(f) != 0) {
+			fprintf(err, "Cannot write history '%s': %s\n", path, strerror(errno));
+			fclose(f);
+			return 1;
+		}
+	} else {
+		if(fread(&fh, sizeof(fh), 1, f) != 1 || fh.magic != HIST_MAGIC || fh.version != HIST_VERSION) {
+			fprintf(err, "'%s' exists and is not a history file: not appended to\n", path);
+			fclose(f);
+			return 1;
+		}
+		end = ftello(f);
+		while((rc = chunk_next(f, st.st_size, &hdr)) == 1) {
+			fseeko(f, (off_t)hdr.nBytes, SEEK_CUR);
+			end = ftello(f);
+		}
+		if(rc < 0) {
+			fprintf(err, "History '%s': %lld byte(s) of an incomplete chunk dropped\n",
+			        path, (long long)(st.st_size - end));
+			if(ftruncate(fileno(f), end) != 0) {
+				fprintf(err, "Cannot truncate '%s': %s\n", path, strerror(errno));
+				fclose(f);
+				return 1;
+			}
+		}
+		fseeko(f, end, SEEK_SET);
+	}
+
+	for(p = 0; p < a->nPar; p++)
+		strcpy(names[p], a->par[p].name);
+	h = hist_new(f, names, a->nPar);
+	if(h == NULL) {
+		fclose(f);
+		fprintf(err, "Out of memory\n");
+		return 3;
+	}
+	sink->ctx = h;
+	sink->put = hist_put;
+	sink->close = hist_close;
+	sink->unfiltered = 0;
+	return 0;
+}
+
+/*****************************************************************************/
+/*  Reader / exporter                                                        */
+/*****************************************************************************/
+
+static int filter_series(const hist_filter_t *f, const hist_chunk_t *c)
+{
+	int i, ok;
+
+	if(f->toMs > 0 && c->tFirst > f->toMs)
+		return 0;
+	if(f->fromMs > 0 && c->tLast < f->fromMs)
+		return 0;
+	for(i = 0, ok = f->nNames == 0; i < f->nNames && !ok; i++)
+		ok = strcmp(f->names[i], c->par) == 0;
+	if(!ok)
+		return 0;
+	for(i = 0, ok = f->addrCount == 0; i < f->addrCount && !ok; i++)
+		ok = (f->addrs[i].slot < 0 || f->addrs[i].slot == c->slot)
+		  && (f->addrs[i].ch < 0 || f->addrs[i].ch == c->ch);
+	return ok;
+}
+
+static void put_value(FILE *out, int type, uint32_t v)
+{
+	if(type == PARAM_TYPE_NUMERIC) {
+		float fv;
+
+		memcpy(&fv, &v, sizeof(fv));
+		fprintf(out, "%g", (double)fv);
+	} else
+		fprintf(out, "%u", v);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  HIST_EXPORT                                                              */
+/*  CSV of the selected points (time_ms,slot,ch,param,value), or with        */
+/*  f->index one line per chunk. Chunks outside the selection are skipped    */
+/*  on their header alone.                                                   */
+/*                                                                           */
+/*****************************************************************************/
+int hist_export(const char *path, const hist_filter_t *f, FILE *out, FILE *err)
+{
+	hist_file_t		fh;
+	hist_chunk_t	hdr;
+	struct stat		st;
+	FILE			*in;
+	uint8_t			*payload = NULL;
+	int64_t			*t = NULL;
+	uint32_t		*v = NULL, cap = 0, i;
+	uint64_t		chunks = 0, points = 0, bytes = 0;
+	int				rc, exitCode = 0;
+
+	in = fopen(path, "rb");
+	if(in == NULL || fstat(fileno(in), &st) != 0) {
+		fprintf(err, "Cannot open history '%s': %s\n", path, strerror(errno));
+		if(in) fclose(in);
+		return 1;
+	}
+	if(fread(&fh, sizeof(fh), 1, in) != 1 || fh.magic != HIST_MAGIC || fh.version != HIST_VERSION) {
+		fprintf(err, "'%s' is not a history file (or has another version)\n", path);
+		fclose(in);
+		return 1;
+	}
+
+	if(f->index)
+		fprintf(out, "slot,ch,param,points,first_ms,last_ms,min,max,bytes\n");
+	else
+		fprintf(out, "time_ms,slot,ch,param,value\n");
+
+	while((rc = chunk_next(in, st.st_size, &hdr)) == 1) {
+		if(!filter_series(f, &hdr)) {
+			fseeko(in, (off_t)hdr.nBytes, SEEK_CUR);
+			continue;
+		}
+		chunks++;
+		points += hdr.count;
+		bytes += sizeof(hdr) + hdr.nBytes;
+		if(f->index) {
+			fprintf(out, "%u,%u,%s,%u,%lld,%lld,", hdr.slot, hdr.ch, hdr.par, hdr.count,
+			        (long long)hdr.tFirst, (long long)hdr.tLast);
+			put_value(out, hdr.type, hdr.vMin);
+			fputc(',', out);
+			put_value(out, hdr.type, hdr.vMax);
+			fprintf(out, ",%u\n", (unsigned)sizeof(hdr) + hdr.nBytes);
+			fseeko(in, (off_t)hdr.nBytes, SEEK_CUR);
+			continue;
+		}
+
+		if(hdr.count > cap) {
+			int64_t		*nt = (int64_t *)realloc(t, sizeof(*t) * hdr.count);
+			uint32_t	*nv = (uint32_t *)realloc(v, sizeof(*v) * hdr.count);
+			uint8_t		*np = (uint8_t *)realloc(payload, (size_t)hdr.count * 10 + 8);
+
+			if(nt) t = nt;
+			if(nv) v = nv;
+			if(np) payload = np;
+			if(nt == NULL || nv == NULL || np == NULL) {
+				fprintf(err, "Out of memory\n");
+				exitCode = 3;
+				break;
+			}
+			cap = hdr.count;
+		}
+		if(hdr.nBytes > 0 && fread(payload, hdr.nBytes, 1, in) != 1) {
+			rc = -1;
+			break;
+		}
+		if(chunk_decode(&hdr, payload, t, v) != 0) {
+			fprintf(err, "Corrupt chunk (slot %u ch %u %s at %lld) skipped\n",
+			        hdr.slot, hdr.ch, hdr.par, (long long)hdr.tFirst);
+			exitCode = 1;
+			continue;
+		}
+		for(i = 0; i < hdr.count; i++) {
+			if((f->fromMs > 0 && t[i] < f->fromMs) || (f->toMs > 0 && t[i] > f->toMs))
+				continue;
+			fprintf(out, "%lld,%u,%u,%s,", (long long)t[i], hdr.slot, hdr.ch, hdr.par);
+			put_value(out, hdr.type, v[i]);
+			fputc('\n', out);
+		}
+	}
+	if(rc < 0)
+		fprintf(err, "History '%s' ends with an incomplete chunk (still being written?)\n", path);
+	fprintf(err, "%llu chunk(s), %llu point(s), %.2f bytes/point\n", (unsigned long long)chunks,
+	        (unsigned long long)points, points ? (double)bytes / (double)points : 0.0);
+
+	free(payload);
+	free(t);
+	free(v);
+	fclose(in);
+	return exitCode;
+}
+
+/*****************************************************************************/
+/*  Benchmark                                                                */
+/*****************************************************************************/
+
+static uint32_t bench_rand(uint32_t *seed)
+{
+	*seed = *seed * 1664525u + 1013904223u;
+	return *seed >> 8;
+}
+
+/* roughly normal, unit variance */
+static double bench_noise(uint32_t *seed)
+{
+	double s = 0.0;
+	int i;
+
+	for(i = 0; i < 12; i++)
+		s += (double)bench_rand(seed) / 16777216.0;
+	return s - 6.0;
+}
+
+static double bench_secs(const struct timespec *a, const struct timespec *b)
+{
+	return (double)(b->tv_sec - a->tv_sec) + (double)(b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  HIST_BENCH                                                               */
+/*  Synthetic crate: 4 boards x 24 channels polled every second with a few   */
+/*  ms of jitter. VMon sits at its setpoint (0.1 V steps, small noise), IMon */
+/*  drifts slowly (1 nA steps), ChStatus is On with rare ramps. Runs the     */
+/*  real writer path, then decodes the file back and counts the points.    */
+/*                                                                           */
+/*****************************************************************************/
+int hist_bench(long points, FILE *out, FILE *err)
+{
+	enum { BOARDS = 4, CHANNELS = 24, NPAR = 3 };
+	char			names[ACQ_MAX_PARAMS][MAX_PARAM_NAME + 2] = { "VMon", "IMon", "ChStatus" };
+	const int		nSer = BOARDS * CHANNELS * NPAR;
+	acq_sample_t	*smp;
+	hist_t			*h;
+	hist_chunk_t	hdr;
+	struct timespec	t0, t1;
+	struct stat		st;
+	double			encS, decS, vSet[BOARDS * CHANNELS], iBase[BOARDS * CHANNELS];
+	uint64_t		parBytes[NPAR] = { 0 }, total, decoded = 0, mismatch = 0, tsNs;
+	uint32_t		seed = 12345, ramp[BOARDS * CHANNELS] = { 0 };
+	int64_t			*tt;
+	uint32_t		*vv;
+	uint8_t			*payload;
+	FILE			*f;
+	long			k;
+	int				i, j, rc;
+
+	if(points <= 0)
+		points = 3600;
+	total = (uint64_t)points * (uint64_t)nSer;
+	f = tmpfile();
+	smp = (acq_sample_t *)calloc((size_t)nSer, sizeof(acq_sample_t));
+	tt = (int64_t *)malloc(sizeof(*tt) * HIST_CHUNK_POINTS);
+	vv = (uint32_t *)malloc(sizeof(*vv) * HIST_CHUNK_POINTS);
+	payload = (uint8_t *)malloc(CHUNK_BYTES_MAX);
+	h = f ? hist_new(f, names, NPAR) : NULL;
+	if(f == NULL || smp == NULL || tt == NULL || vv == NULL || payload == NULL || h == NULL) {
+		fprintf(err, "hist-bench: cannot set up (%s)\n", strerror(errno));
+		if(h) hist_close(h); else if(f) fclose(f);
+		free(smp); free(tt); free(vv); free(payload);
+		return 3;
+	}
+	fwrite(&(hist_file_t){ HIST_MAGIC, HIST_VERSION, 0 }, sizeof(hist_file_t), 1, f);
+	for(i = 0; i < BOARDS * CHANNELS; i++) {
+		vSet[i] = 500.0 + 50.0 * (i % 20);
+		iBase[i] = 0.5 + 0.01 * i;
+	}
+
+	/* the samples are generated outside the timed part */
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	encS = 0.0;
+	tsNs = 1700000000000000000ull;
+	for(k = 0; k < points; k++) {
+		struct timespec a, b;
+
+		tsNs += 1000000000ull + (uint64_t)(bench_rand(&seed) % 7000000u);
+		for(i = 0; i < BOARDS * CHANNELS; i++) {
+			float vmon, imon;
+
+			if(ramp[i] == 0 && bench_rand(&seed) % 20000u == 0)
+				ramp[i] = 30;
+			vmon = ramp[i] ? (float)(vSet[i] * (30 - ramp[i]) / 30.0) :
+			       (float)(floor((vSet[i] + 0.04 * bench_noise(&seed)) * 10.0 + 0.5) / 10.0);
+			imon = (float)(floor((iBase[i] + 0.05 * sin((double)k / 600.0 + i)
+			                      + 0.002 * bench_noise(&seed)) * 1000.0 + 0.5) / 1000.0);
+			for(j = 0; j < NPAR; j++) {
+				acq_sample_t *sm = &smp[i * NPAR + j];
+
+				sm->tsNs = tsNs;
+				sm->slot = (uint16_t)(i / CHANNELS);
+				sm->ch = (uint16_t)(i % CHANNELS);
+				sm->par = (uint16_t)j;
+				sm->series = (uint32_t)(i * NPAR + j);
+				sm->type = j == 2 ? PARAM_TYPE_CHSTATUS : PARAM_TYPE_NUMERIC;
+				if(j == 0) sm->v.f = vmon;
+				else if(j == 1) sm->v.f = imon;
+				else sm->v.u = ramp[i] ? 3u : 1u;
+			}
+			if(ramp[i]) ramp[i]--;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &a);
+		hist_put(h, smp, nSer);
+		clock_gettime(CLOCK_MONOTONIC, &b);
+		encS += bench_secs(&a, &b);
+	}
+	for(i = 0; i < h->nSer; i++)
+		series_flush(h, &h->ser[i]);
+	fflush(f);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	/* decode everything back */
+	fstat(fileno(f), &st);
+	rewind(f);
+	if(fread(payload, sizeof(hist_file_t), 1, f) != 1)
+		mismatch++;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	while((rc = chunk_next(f, st.st_size, &hdr)) == 1) {
+		if(fread(payload, 1, hdr.nBytes, f) != hdr.nBytes || chunk_decode(&hdr, payload, tt, vv) != 0) {
+			mismatch++;
+			break;
+		}
+		decoded += hdr.count;
+		for(j = 0; j < NPAR; j++)
+			if(strcmp(hdr.par, names[j]) == 0)
+				parBytes[j] += sizeof(hdr) + hdr.nBytes;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	decS = bench_secs(&t0, &t1);
+	if(rc < 0 || decoded != total)
+		mismatch++;
+
+	fprintf(out, "hist-bench: %d series x %ld points = %llu samples (1 s period, 0-7 ms jitter)\n",
+	        nSer, points, (unsigned long long)total);
+	fprintf(out, "  raw ring records (24 B)  %12.1f KiB\n", (double)total * 24.0 / 1024.0);
+	fprintf(out, "  plain (8 B ms + 4 B val) %12.1f KiB\n", (double)total * 12.0 / 1024.0);
+	fprintf(out, "  compressed               %12.1f KiB  %.2f B/sample  x%.1f vs plain\n",
+	        (double)h->bytes / 1024.0, (double)h->bytes / (double)total,
+	        (double)total * 12.0 / (double)h->bytes);
+	for(j = 0; j < NPAR; j++)
+		fprintf(out, "    %-10s %.2f B/sample\n", names[j],
+		        (double)parBytes[j] / ((double)total / NPAR));
+	fprintf(out, "  encode %.1f Msamples/s, decode %.1f Msamples/s\n",
+	        (double)total / encS / 1e6, (double)decoded / decS / 1e6);
+	if(mismatch)
+		fprintf(err, "hist-bench: decoded %llu of %llu samples\n",
+		        (unsigned long long)decoded, (unsigned long long)total);
+
+	hist_close(h);
+	free(smp);
+	free(tt);
+	free(vv);
+	free(payload);
+	return mismatch ? 1 : 0;
+}
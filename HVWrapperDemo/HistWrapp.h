@@ -0,0 +1,81 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   HISTWRAPP.H                                                             */
+/*                                                                           */
+/*   --history: compressed long-term channel history. One file per crate,   */
+/*   a sequence of chunks, each holding up to HIST_CHUNK_POINTS points of    */
+/*   one (slot, channel, parameter) series.                                  */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef __HISTWRAPP_H
+#define __HISTWRAPP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "AcqWrapp.h"
+
+#define HIST_MAGIC         (0x31485648u)		/* "HVH1" file header     */
+#define HIST_CHUNK_MAGIC   (0x4b4e4843u)		/* "CHNK" chunk header    */
+#define HIST_VERSION       (1)
+#define HIST_CHUNK_POINTS  (720)
+#define HIST_CHUNK_SPAN_MS (15 * 60 * 1000)	/* a chunk is closed after this */
+
+/*
+  File: hist_file_t, then chunks back to back. A chunk is a hist_chunk_t
+  followed by nBytes of bit stream (MSB first), encoding points 2..count
+  Gorilla-style:
+
+    time (ms), delta of delta D:   0                 D == 0
+                                   10   + 7 bits     -63 <= D <= 64
+                                   110  + 9 bits     -255 <= D <= 256
+                                   1110 + 12 bits    -2047 <= D <= 2048
+                                   1111 + 32 bits    otherwise
+    value, X = bits XOR previous:  0                 X == 0
+                                   10 + meaningful bits, previous window
+                                   11 + 5 bits leading zeros + 5 bits
+                                        (length - 1) + meaningful bits
+
+  Point 1 is tFirst / vFirst in the header, which also carries the chunk
+  time range and min/max, so readers can skip payloads they do not need.
+  Integers are stored in host byte order.
+*/
+typedef struct {
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	createdNs;
+} hist_file_t;
+
+typedef struct {
+	uint32_t	magic;
+	uint16_t	slot;
+	uint16_t	ch;
+	char		par[MAX_PARAM_NAME + 2];
+	uint16_t	type;			/* PARAM_TYPE_* */
+	uint16_t	reserved;
+	uint32_t	count;
+	uint32_t	nBytes;
+	int64_t		tFirst;			/* ms since the epoch */
+	int64_t		tLast;
+	uint32_t	vMin;			/* float bits for PARAM_TYPE_NUMERIC */
+	uint32_t	vMax;
+	uint32_t	vFirst;
+	uint32_t	reserved2;
+} hist_chunk_t;
+
+/* selection for hist_export(); zero/NULL fields select everything */
+typedef struct {
+	int64_t				fromMs, toMs;
+	const cli_addr_t	*addrs;			/* slot -1: any slot */
+	int					addrCount;
+	char				(*names)[MAX_PARAM_NAME + 2];
+	int					nNames;
+	int					index;			/* print the chunk index, not the points */
+} hist_filter_t;
+
+int hist_open(const char *path, const acq_t *a, acq_sink_t *sink, FILE *err);
+int hist_export(const char *path, const hist_filter_t *f, FILE *out, FILE *err);
+int hist_bench(long points, FILE *out, FILE *err);
+
+#endif // __HISTWRAPP_H
@@ -40,6 +40,7 @@ void HVGetExecList(void);
 void HVGetSysProp(void);
 void HVSetSysProp(void);
 void HVExecComm(void);
+void HVDashboard(void);
 //void HVCaenetComm(void);     // Rel. 1.1
 void quitProgram(void);
 
@@ -0,0 +1,309 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   MULTIWRAPP.C                                                            */
+/*                                                                           */
+/*   Multi-crate engine. Each crate named by --host gets its own session     */
+/*   and its own worker thread, which logs in (if needed), runs the request  */
+/*   and captures the output. The outputs are then printed in --host order,  */
+/*   every line prefixed with its host, so the wall time of a call is the    */
+/*   one of the slowest crate instead of the sum over all crates. Modes that */
+/*   run until stopped (--record, --history, --trips) write through instead, */
+/*   a whole line at a time, as each line is produced.                       */
+/*                                                                           */
+/*****************************************************************************/
+#ifdef LINUX
+#define _GNU_SOURCE						/* fopencookie */
+#endif
+#include <sys/types.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include "CAENHVWrapper.h"
+#include "CliWrapp.h"
+#include "MultiWrapp.h"
+#include "FmtWrapp.h"
+
+typedef struct {
+	cli_sess_t		*sess;
+	cli_req_t		req;			/* private copy: targets are per crate */
+	int				keep;			/* leave the session logged in        */
+	int				started;		/* runs on its own thread             */
+	int				live;			/* writes through, see live_open()    */
+	FILE			*dstOut, *dstErr;
+	int				exitCode;
+	double			ms;
+	char			*outBuf, *errBuf;
+	size_t			outLen, errLen;
+} multi_job_t;
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1.0e6;
+}
+
+/* 'buf' line by line, each line prefixed with the crate host */
+static void put_prefixed(FILE *f, const char *host, const char *buf, size_t len)
+{
+	size_t i = 0;
+
+	while(i < len) {
+		const char *nl = memchr(buf + i, '\n', len - i);
+		size_t n = nl ? (size_t)(nl - (buf + i)) + 1 : len - i;
+
+		fprintf(f, "%s  ", host);
+		fwrite(buf + i, 1, n, f);
+		if(nl == NULL)
+			fputc('\n', f);
+		i += n;
+	}
+}
+
+/* a live stream: each line goes to 'dst' as soon as it ends, prefixed with
+   the host, under one lock so the lines of the workers do not mix */
+typedef struct {
+	FILE			*dst;
+	const char		*host;
+	int				bol;			/* at the beginning of a line */
+} live_t;
+
+static pthread_mutex_t	liveLock = PTHREAD_MUTEX_INITIALIZER;
+
+static ssize_t live_write(void *cookie, const char *buf, size_t len)
+{
+	live_t	*l = (live_t *)cookie;
+	size_t	i = 0;
+
+	pthread_mutex_lock(&liveLock);
+	while(i < len) {
+		const char *nl = memchr(buf + i, '\n', len - i);
+		size_t n = nl ? (size_t)(nl - (buf + i)) + 1 : len - i;
+
+		if(l->bol)
+			fprintf(l->dst, "%s  ", l->host);
+		fwrite(buf + i, 1, n, l->dst);
+		l->bol = nl != NULL;
+		i += n;
+	}
+	fflush(l->dst);
+	pthread_mutex_unlock(&liveLock);
+	return (ssize_t)len;
+}
+
+static int live_close(void *cookie)
+{
+	live_t *l = (live_t *)cookie;
+
+	if(!l->bol)
+		live_write(l, "\n", 1);
+	free(l);
+	return 0;
+}
+
+static FILE *live_open(FILE *dst, const char *host)
+{
+	cookie_io_functions_t	io = { NULL, live_write, NULL, live_close };
+	live_t					*l = (live_t *)calloc(1, sizeof(live_t));
+	FILE					*f;
+
+	if(l == NULL)
+		return NULL;
+	l->dst = dst;
+	l->host = host;
+	l->bol = 1;
+	if((f = fopencookie(l, "w", io)) == NULL) {
+		free(l);
+		return NULL;
+	}
+	setvbuf(f, NULL, _IOLBF, 0);
+	return f;
+}
+
+static void *worker(void *arg)
+{
+	multi_job_t	*j = (multi_job_t *)arg;
+	FILE		*out, *err;
+	double		t0 = now_ms();
+
+	if(j->live) {
+		out = live_open(j->dstOut, j->sess->host);
+		err = live_open(j->dstErr, j->sess->host);
+	} else {
+		out = open_memstream(&j->outBuf, &j->outLen);
+		err = open_memstream(&j->errBuf, &j->errLen);
+	}
+	if(out == NULL || err == NULL) {
+		if(out) fclose(out);
+		if(err) fclose(err);
+		j->exitCode = 3;
+		return NULL;
+	}
+
+	j->exitCode = cli_login(j->sess, err);
+	if(j->exitCode == 0) {
+		j->exitCode = cli_execute(j->sess, &j->req, out, err);
+		if(cli_link_lost(j->exitCode))
+			fprintf(err, "link lost, session closed\n");
+		if(!j->keep || cli_link_lost(j->exitCode))
+			cli_logout(j->sess, err);
+	}
+	j->ms = now_ms() - t0;
+
+	fclose(out);
+	fclose(err);
+	return NULL;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  MULTI_SPLIT_HOSTS                                                        */
+/*  "a,b,c" -> hosts[]; returns the count, -1 for an empty item or too many  */
+/*                                                                           */
+/*****************************************************************************/
+int multi_split_hosts(const char *list, char (*hosts)[MULTI_HOST_LEN], int max)
+{
+	int n = 0;
+
+	if(list == NULL)
+		return 0;
+	for(;;) {
+		size_t len = strcspn(list, ",");
+
+		if(len == 0 || len >= MULTI_HOST_LEN || n >= max)
+			return -1;
+		memcpy(hosts[n], list, len);
+		hosts[n++][len] = '\0';
+		if(list[len] == '\0')
+			break;
+		list += len + 1;
+	}
+	return n;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  MULTI_EXECUTE                                                            */
+/*  Runs 'req' on the n sessions at once. Sessions not logged in are logged  */
+/*  in by their worker; with 'keep' they stay open (hvwrappd). The config   */
+/*  plan is compiled before the workers start and shared by all. --record,   */
+/*  --history and --trips print as they go rather than at the end.           */
+/*  Returns the first non-zero exit code in session order.                   */
+/*                                                                           */
+/*****************************************************************************/
+int multi_execute(cli_sess_t **sess, int n, cli_req_t *req, int keep, FILE *out, FILE *err)
+{
+	multi_job_t	*jobs;
+	pthread_t	*tid;
+	double		t0 = now_ms(), sum = 0.0, slowest = 0.0;
+	int			i, exitCode = 0;
+	int			fmt = req->getParam && !req->bench ? fmt_parse(req->format) : FMT_TEXT;
+	int			raw = fmt > FMT_TEXT, csvHead = 0;
+
+	jobs = (multi_job_t *)calloc((size_t)n, sizeof(multi_job_t));
+	tid = (pthread_t *)calloc((size_t)n, sizeof(pthread_t));
+	if(jobs == NULL || tid == NULL) {
+		free(jobs);
+		free(tid);
+		fprintf(err, "Out of memory\n");
+		return 3;
+	}
+
+	/* the config plan is compiled here, once: the workers only borrow it */
+	if(req->paramCount > 0 || req->syncNames || req->chAll)
+		cli_config(req, err);
+
+	for(i = 0; i < n; i++) {
+		multi_job_t *j = &jobs[i];
+
+		j->sess = sess[i];
+		j->keep = keep;
+		j->live = req->recordPath || req->histPath || req->trips;
+		j->dstOut = out;
+		j->dstErr = err;
+		j->req = *req;
+		j->req.targets = NULL;
+		j->req.nTargets = 0;
+		j->req.chList = NULL;
+		j->req.chCount = 0;
+		j->req.addrs = NULL;
+		j->req.cfgLoaded = -1;			/* the plan stays the caller's */
+		if(req->addrCount > 0) {
+			j->req.addrs = (cli_addr_t *)malloc(sizeof(cli_addr_t) * (size_t)req->addrCount);
+			if(j->req.addrs == NULL) {
+				j->exitCode = 3;
+				continue;
+			}
+			memcpy(j->req.addrs, req->addrs, sizeof(cli_addr_t) * (size_t)req->addrCount);
+		}
+		if(pthread_create(&tid[i], NULL, worker, j) == 0)
+			j->started = 1;
+		else
+			worker(j);				/* no thread: run it here */
+	}
+
+	for(i = 0; i < n; i++) {
+		multi_job_t *j = &jobs[i];
+
+		if(j->started)
+			pthread_join(tid[i], NULL);
+		if(j->outBuf && raw) {
+			/* --format rows carry their host; one csv header for all */
+			const char *body = j->outBuf;
+
+			if(fmt == FMT_CSV && csvHead && (body = memchr(j->outBuf, '\n', j->outLen)) != NULL)
+				body++;
+			if(body != NULL)
+				fwrite(body, 1, j->outLen - (size_t)(body - j->outBuf), out);
+			csvHead |= j->outLen > 0;
+		} else if(j->outBuf)
+			put_prefixed(out, sess[i]->host, j->outBuf, j->outLen);
+		if(j->errBuf) put_prefixed(err, sess[i]->host, j->errBuf, j->errLen);
+		if(j->exitCode != 0 && exitCode == 0)
+			exitCode = j->exitCode;
+		sum += j->ms;
+		if(j->ms > slowest)
+			slowest = j->ms;
+		free(j->outBuf);
+		free(j->errBuf);
+		cli_req_free(&j->req);
+	}
+	fprintf(err, "%d crate(s) in %.1f ms (slowest %.1f ms, sum %.1f ms)\n",
+	        n, now_ms() - t0, slowest, sum);
+
+	free(jobs);
+	free(tid);
+	return exitCode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  MULTI_RUN                                                                */
+/*  One-shot multi-crate call: private sessions, closed at the end.          */
+/*                                                                           */
+/*****************************************************************************/
+int multi_run(cli_req_t *req)
+{
+	char		hosts[MULTI_MAX_CRATES][MULTI_HOST_LEN];
+	cli_sess_t	sess[MULTI_MAX_CRATES], *ps[MULTI_MAX_CRATES];
+	cli_req_t	one;
+	int			n, i;
+
+	n = multi_split_hosts(req->host, hosts, MULTI_MAX_CRATES);
+	if(n <= 0) {
+		fprintf(stderr, "Invalid --host list '%s' (at most %d crates)\n", req->host, MULTI_MAX_CRATES);
+		return 2;
+	}
+	for(i = 0; i < n; i++) {
+		one = *req;
+		one.host = hosts[i];
+		cli_sess_init(&sess[i], &one);
+		ps[i] = &sess[i];
+	}
+	return multi_execute(ps, n, req, 0, stdout, stderr);
+}
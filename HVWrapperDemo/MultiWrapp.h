@@ -0,0 +1,24 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   MULTIWRAPP.H                                                            */
+/*                                                                           */
+/*   Several crates in one CLI call (--host a,b,c): one worker thread per    */
+/*   system handle, outputs merged in --host order.                          */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef __MULTIWRAPP_H
+#define __MULTIWRAPP_H
+
+#include <stdio.h>
+#include "CliWrapp.h"
+
+#define MULTI_MAX_CRATES   MAX_CRATES
+#define MULTI_HOST_LEN     (128)
+
+int multi_split_hosts(const char *list, char (*hosts)[MULTI_HOST_LEN], int max);
+int multi_execute(cli_sess_t **sess, int n, cli_req_t *req, int keep, FILE *out, FILE *err);
+int multi_run(cli_req_t *req);
+
+#endif // __MULTIWRAPP_H
@@ -0,0 +1,240 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   RAMPWRAPP.C                                                             */
+/*                                                                           */
+/*   Closed-loop ramp. After every VMon read of a slot, the time each of    */
+/*   its channels needs to reach the middle of the --tol band is predicted  */
+/*   from the distance and its RUp/RDWn rate, and the slot is read again    */
+/*   when the first of them (and those due within RAMP_BATCH_MS after it)   */
+/*   should be there: rarely while the channels are far away, densely when  */
+/*   a prediction fell short. Channels in the band leave the read list.     */
+/*                                                                           */
+/*****************************************************************************/
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <math.h>
+#include "CAENHVWrapper.h"
+#include "CliWrapp.h"
+#include "RampWrapp.h"
+
+#define RAMP_BLIND_POLL_MS (1000)		/* when RUp/RDWn cannot be read */
+
+typedef struct {
+	unsigned short	slot;
+	unsigned short	*ch;				/* active channels first, n of them */
+	float			*rUp, *rDn;			/* V/s, 0 = unknown */
+	float			*vmon;
+	int				n, total;
+	double			nextAt;				/* s since start of the next read */
+} ramp_slot_t;
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void ramp_free(ramp_slot_t *rs, int n)
+{
+	int i;
+
+	for(i = 0; i < n; i++) {
+		free(rs[i].ch);
+		free(rs[i].rUp);
+		free(rs[i].rDn);
+		free(rs[i].vmon);
+	}
+	free(rs);
+}
+
+/* V0Set and Pw On with one call each, then the ramp rates (one call each) */
+static int ramp_start(cli_sess_t *s, ramp_slot_t *r, float target, FILE *out, FILE *err)
+{
+	unsigned int	on = 1;
+	CAENHVRESULT	ret;
+	int				k;
+
+	ret = CAENHV_SetChParam(s->handle, r->slot, "V0Set", (unsigned short)r->n, r->ch, &target);
+	if(ret == CAENHV_OK)
+		ret = CAENHV_SetChParam(s->handle, r->slot, "Pw", (unsigned short)r->n, r->ch, &on);
+	if(ret != CAENHV_OK) {
+		fprintf(err, "Slot %d: starting the ramp failed: %s (code %d)\n", r->slot, CAENHV_GetError(s->handle), ret);
+		return (int)ret;
+	}
+	if(CAENHV_GetChParam(s->handle, r->slot, "RUp", (unsigned short)r->n, r->ch, r->rUp) != CAENHV_OK
+	|| CAENHV_GetChParam(s->handle, r->slot, "RDWn", (unsigned short)r->n, r->ch, r->rDn) != CAENHV_OK) {
+		fprintf(out, "Slot %d: RUp/RDWn not readable, polling every %d ms\n", r->slot, RAMP_BLIND_POLL_MS);
+		for(k = 0; k < r->n; k++)
+			r->rUp[k] = r->rDn[k] = 0.0f;
+	}
+	return 0;
+}
+
+/* s until channel k is predicted in the middle of the band */
+static double ramp_eta(const ramp_slot_t *r, int k, float target, float tol)
+{
+	float dist = fabsf(r->vmon[k] - target);
+	float rate = r->vmon[k] < target ? r->rUp[k] : r->rDn[k];
+	double eta = rate > 0.0f ? (double)(dist - tol / 2) / (double)rate : RAMP_BLIND_POLL_MS / 1000.0;
+
+	if(eta < RAMP_MIN_POLL_MS / 1000.0) eta = RAMP_MIN_POLL_MS / 1000.0;
+	if(eta > RAMP_MAX_POLL_MS / 1000.0) eta = RAMP_MAX_POLL_MS / 1000.0;
+	return eta;
+}
+
+/* drops channel k from the active list, keeping the per-channel arrays aligned */
+static void ramp_drop(ramp_slot_t *r, int k)
+{
+	int last = --r->n;
+	unsigned short c = r->ch[k];
+	float u = r->rUp[k], d = r->rDn[k];
+
+	r->ch[k] = r->ch[last];		r->ch[last] = c;
+	r->rUp[k] = r->rUp[last];	r->rUp[last] = u;
+	r->rDn[k] = r->rDn[last];	r->rDn[last] = d;
+	r->vmon[k] = r->vmon[last];
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  RAMP_RUN                                                                 */
+/*  All the resolved targets ramp together; one VMon read per slot that     */
+/*  still has channels outside the band.                                     */
+/*                                                                           */
+/*****************************************************************************/
+int ramp_run(cli_sess_t *s, cli_req_t *req, FILE *out, FILE *err)
+{
+	ramp_slot_t		*rs;
+	const float		target = req->rampTo;
+	const float		tol = req->rampTol > 0.0f ? req->rampTol : RAMP_DEFAULT_TOL;
+	const double	timeout = req->rampTimeout > 0 ? req->rampTimeout : RAMP_DEFAULT_TIMEOUT;
+	double			t0, t, longest = -1.0;
+	long			reads = 0;
+	int				exitCode = 0, active = 0, total = 0, pass, i, k;
+
+	rs = (ramp_slot_t *)calloc((size_t)req->nTargets, sizeof(ramp_slot_t));
+	if(rs == NULL) {
+		fprintf(err, "Out of memory\n");
+		return 3;
+	}
+	for(i = 0; i < req->nTargets; i++) {
+		ramp_slot_t *r = &rs[i];
+		size_t n = (size_t)req->targets[i].count;
+
+		r->slot = req->targets[i].slot;
+		r->n = r->total = (int)n;
+		r->ch = (unsigned short *)malloc(sizeof(unsigned short) * n);
+		r->rUp = (float *)malloc(sizeof(float) * n);
+		r->rDn = (float *)malloc(sizeof(float) * n);
+		r->vmon = (float *)malloc(sizeof(float) * n);
+		if(r->ch == NULL || r->rUp == NULL || r->rDn == NULL || r->vmon == NULL) {
+			ramp_free(rs, i + 1);
+			fprintf(err, "Out of memory\n");
+			return 3;
+		}
+		memcpy(r->ch, req->targets[i].ch, sizeof(unsigned short) * n);
+		active += r->n;
+	}
+	total = active;
+
+	t0 = now_s();
+	for(i = 0; i < req->nTargets && exitCode == 0; i++)
+		exitCode = ramp_start(s, &rs[i], target, out, err);
+
+	for(pass = 0; exitCode == 0 && active > 0; pass++) {
+		double next = -1.0;		/* earliest nextAt over the slots */
+		double first;
+
+		t = now_s() - t0;
+		for(i = 0; i < req->nTargets; i++) {
+			ramp_slot_t *r = &rs[i];
+			CAENHVRESULT ret;
+
+			if(r->n == 0 || r->nextAt > t + 0.001)
+				goto schedule;
+			ret = CAENHV_GetChParam(s->handle, r->slot, "VMon", (unsigned short)r->n, r->ch, r->vmon);
+			reads++;
+			t = now_s() - t0;
+			if(ret != CAENHV_OK) {
+				fprintf(err, "Slot %d: GetChParam('VMon') failed: %s (code %d)\n", r->slot, CAENHV_GetError(s->handle), ret);
+				if(cli_link_lost(ret) || ret == CAENHV_SYSCONFCHANGE) {
+					exitCode = (int)ret;
+					break;
+				}
+				r->nextAt = t + RAMP_BLIND_POLL_MS / 1000.0;
+				goto schedule;
+			}
+			first = -1.0;
+			for(k = 0; k < r->n; ) {
+				double eta;
+
+				if(fabsf(r->vmon[k] - target) <= tol) {
+					fprintf(out, "Slot %d  Ch %d  VMon %.2f V after %.1f s\n", r->slot, r->ch[k], (double)r->vmon[k], t);
+					ramp_drop(r, k);
+					active--;
+					continue;
+				}
+				if(pass == 0) {
+					float rate = r->vmon[k] < target ? r->rUp[k] : r->rDn[k];
+
+					if(rate > 0.0f && fabsf(r->vmon[k] - target) / rate > longest)
+						longest = fabsf(r->vmon[k] - target) / rate;
+				}
+				eta = ramp_eta(r, k, target, tol);
+				if(first < 0.0 || eta < first)
+					first = eta;
+				k++;
+			}
+			/* wait for the channels arriving shortly after the first one too */
+			r->nextAt = first;
+			for(k = 0; k < r->n; k++) {
+				double eta = ramp_eta(r, k, target, tol);
+
+				if(eta > r->nextAt && eta <= first + RAMP_BATCH_MS / 1000.0)
+					r->nextAt = eta;
+			}
+			r->nextAt += t;
+			if(r->nextAt > timeout)
+				r->nextAt = timeout;			/* a last read for the report */
+		schedule:
+			if(r->n > 0 && (next < 0.0 || r->nextAt < next))
+				next = r->nextAt;
+		}
+		if(pass == 0 && active > 0)
+			fprintf(out, "Ramping %d channel(s) to %g V (+/- %g V), about %.1f s to go\n",
+			        active, (double)target, (double)tol, longest);
+		if(exitCode != 0 || active == 0)
+			break;
+
+		t = now_s() - t0;
+		if(t >= timeout) {
+			fprintf(err, "Timeout after %.0f s: %d channel(s) still outside %g +/- %g V:\n",
+			        t, active, (double)target, (double)tol);
+			for(i = 0; i < req->nTargets; i++)
+				for(k = 0; k < rs[i].n; k++)
+					fprintf(err, "  Slot %d  Ch %d  VMon %.2f V\n", rs[i].slot, rs[i].ch[k], (double)rs[i].vmon[k]);
+			exitCode = 1;
+			break;
+		}
+		if(next > timeout) next = timeout;
+		if(next > t) {
+			struct timespec ts = { (time_t)(next - t), (long)(((next - t) - floor(next - t)) * 1e9) };
+
+			while(nanosleep(&ts, &ts) != 0 && errno == EINTR)
+				;
+		}
+	}
+
+	if(exitCode == 0)
+		fprintf(out, "OK: %d channel(s) at %g +/- %g V after %.1f s, %ld VMon read(s)\n",
+		        total, (double)target, (double)tol, now_s() - t0, reads);
+	ramp_free(rs, req->nTargets);
+	return exitCode;
+}
@@ -0,0 +1,25 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   RAMPWRAPP.H                                                             */
+/*                                                                           */
+/*   --ramp-to: set V0Set, switch on and follow VMon until every channel is */
+/*   within --tol, polling as the RUp/RDWn ramp rates say it is needed.      */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef __RAMPWRAPP_H
+#define __RAMPWRAPP_H
+
+#include <stdio.h>
+#include "CliWrapp.h"
+
+#define RAMP_DEFAULT_TOL      (1.0f)		/* V */
+#define RAMP_DEFAULT_TIMEOUT  (600)			/* s */
+#define RAMP_MIN_POLL_MS      (100)
+#define RAMP_MAX_POLL_MS      (5000)
+#define RAMP_BATCH_MS         (250)		/* arrivals this close share one read */
+
+int ramp_run(cli_sess_t *s, cli_req_t *req, FILE *out, FILE *err);
+
+#endif // __RAMPWRAPP_H
@@ -0,0 +1,321 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   RECWRAPP.C                                                              */
+/*                                                                           */
+/*   Ring file recorder (--record) and reader (--rec-dump). The file is      */
+/*   sized once and mapped shared, so a cycle costs a few memcpy and one     */
+/*   store to 'head': no formatting and no write(2) in the acquisition loop, */
+/*   and the disk usage is fixed whatever the run length.                    */
+/*                                                                           */
+/*****************************************************************************/
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "CAENHVWrapper.h"
+#include "AcqWrapp.h"
+#include "RecWrapp.h"
+
+#define DUMP_CHUNK         (4096)		/* records copied per head check */
+
+typedef struct {
+	int				fd;
+	size_t			mapLen;
+	rec_header_t	*hdr;
+	acq_sample_t	*rec;
+} rec_t;
+
+static size_t rec_file_size(uint64_t capacity)
+{
+	return REC_HEADER_SIZE + (size_t)capacity * sizeof(acq_sample_t);
+}
+
+/* same parameters, sizes and record layout: the file can be appended to */
+static int rec_layout_ok(const rec_header_t *h, const rec_header_t *want, off_t size)
+{
+	uint32_t p;
+
+	if(h->magic != REC_MAGIC || h->version != REC_VERSION || h->headerSize != REC_HEADER_SIZE
+	|| h->sampleSize != sizeof(acq_sample_t) || h->capacity != want->capacity
+	|| h->nPar != want->nPar || h->batch < want->batch || (size_t)size != rec_file_size(h->capacity))
+		return 0;
+	for(p = 0; p < h->nPar; p++)
+		if(strcmp(h->parName[p], want->parName[p]) != 0)
+			return 0;
+	return 1;
+}
+
+static int rec_put(void *ctx, const acq_sample_t *smp, int n)
+{
+	rec_t		*r = (rec_t *)ctx;
+	uint64_t	cap = r->hdr->capacity;
+	uint64_t	head = r->hdr->head;		/* only this process writes it */
+	uint64_t	at = head % cap;
+	size_t		first = (size_t)n;
+
+	if(n <= 0)
+		return 0;
+	if(at + (uint64_t)n > cap)
+		first = (size_t)(cap - at);
+	memcpy(&r->rec[at], smp, first * sizeof(*smp));
+	if(first < (size_t)n)
+		memcpy(&r->rec[0], smp + first, ((size_t)n - first) * sizeof(*smp));
+	__atomic_store_n(&r->hdr->head, head + (uint64_t)n, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static void rec_close(void *ctx)
+{
+	rec_t *r = (rec_t *)ctx;
+
+	msync(r->hdr, r->mapLen, MS_ASYNC);
+	munmap(r->hdr, r->mapLen);
+	close(r->fd);				/* drops the writer lock */
+	free(r);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  REC_OPEN                                                                 */
+/*  Maps 'path' for the parameters and targets of 'a'. A ring with the same  */
+/*  layout is appended to; a ring with another layout is replaced (readers   */
+/*  still attached keep the old inode). Anything else is left alone.         */
+/*                                                                           */
+/*****************************************************************************/
+int rec_open(const char *path, uint64_t capacity, const acq_t *a, const char *host,
+             acq_sink_t *sink, FILE *err)
+{
+	rec_header_t	want;
+	rec_t			*r;
+	struct stat		st;
+	size_t			len;
+	int				fd, p, t, batch = 0, fresh = 0, rc;
+
+	for(t = 0; t < a->req->nTargets; t++)
+		batch += a->req->targets[t].count * a->nPar;
+	if(capacity == 0)
+		capacity = REC_DEFAULT_CAP;
+	if((uint64_t)batch * 2 > capacity) {
+		fprintf(err, "--ring %llu is too small for %d samples per cycle\n",
+		        (unsigned long long)capacity, batch);
+		return 2;
+	}
+
+	memset(&want, 0, sizeof(want));
+	want.magic = REC_MAGIC;
+	want.version = REC_VERSION;
+	want.headerSize = REC_HEADER_SIZE;
+	want.sampleSize = sizeof(acq_sample_t);
+	want.capacity = capacity;
+	want.createdNs = acq_now_ns();
+	want.periodMs = (uint32_t)a->periodMs;
+	want.nPar = (uint32_t)a->nPar;
+	want.batch = (uint32_t)batch;
+	snprintf(want.host, sizeof(want.host), "%s", host ? host : "");
+	for(p = 0; p < a->nPar; p++)
+		strcpy(want.parName[p], a->par[p].name);
+	len = rec_file_size(capacity);
+
+	fd = open(path, O_RDWR | O_CREAT, 0644);
+	if(fd < 0 || fstat(fd, &st) != 0) {
+		fprintf(err, "Cannot open ring '%s': %s\n", path, strerror(errno));
+		if(fd >= 0) close(fd);
+		return 1;
+	}
+	if(flock(fd, LOCK_EX | LOCK_NB) != 0) {
+		fprintf(err, "Ring '%s' is already being recorded\n", path);
+		close(fd);
+		return 1;
+	}
+
+	if(st.st_size == 0)
+		fresh = 1;
+	else {
+		rec_header_t old;
+
+		if(pread(fd, &old, sizeof(old), 0) != (ssize_t)sizeof(old) || old.magic != REC_MAGIC) {
+			fprintf(err, "'%s' exists and is not a ring file: not overwritten\n", path);
+			close(fd);
+			return 1;
+		}
+		if(!rec_layout_ok(&old, &want, st.st_size)) {
+			fprintf(err, "Ring '%s' has another layout: recreated\n", path);
+			unlink(path);
+			close(fd);
+			fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+			if(fd < 0 || flock(fd, LOCK_EX | LOCK_NB) != 0) {
+				fprintf(err, "Cannot create ring '%s': %s\n", path, strerror(errno));
+				if(fd >= 0) close(fd);
+				return 1;
+			}
+			fresh = 1;
+		}
+	}
+
+	/* reserve the blocks now: a full disk fails here, not as SIGBUS later */
+	if(fresh && ((rc = posix_fallocate(fd, 0, (off_t)len)) != 0)) {
+		fprintf(err, "Cannot allocate %zu bytes for ring '%s': %s\n", len, path, strerror(rc));
+		close(fd);
+		return 1;
+	}
+
+	r = (rec_t *)calloc(1, sizeof(rec_t));
+	if(r == NULL) {
+		close(fd);
+		fprintf(err, "Out of memory\n");
+		return 3;
+	}
+	r->fd = fd;
+	r->mapLen = len;
+	r->hdr = (rec_header_t *)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(r->hdr == MAP_FAILED) {
+		fprintf(err, "Cannot map ring '%s': %s\n", path, strerror(errno));
+		close(fd);
+		free(r);
+		return 1;
+	}
+	r->rec = (acq_sample_t *)((char *)r->hdr + REC_HEADER_SIZE);
+
+	if(fresh) {
+		uint32_t magic = want.magic;
+
+		want.magic = 0;
+		memcpy(r->hdr, &want, sizeof(want));
+		__atomic_store_n(&r->hdr->magic, magic, __ATOMIC_RELEASE);
+	} else {
+		/* appending: refresh what may legitimately differ */
+		r->hdr->periodMs = want.periodMs;
+		memcpy(r->hdr->host, want.host, sizeof(want.host));
+	}
+
+	sink->ctx = r;
+	sink->put = rec_put;
+	sink->close = rec_close;
+	sink->unfiltered = 0;
+	return 0;
+}
+
+static void dump_one(FILE *out, const rec_header_t *h, const acq_sample_t *sm)
+{
+	const char *name = sm->par < h->nPar ? h->parName[sm->par] : "?";
+
+	fprintf(out, "%llu.%06llu  Slot %u  Ch %u  %s = ",
+	        (unsigned long long)(sm->tsNs / 1000000000ull),
+	        (unsigned long long)(sm->tsNs % 1000000000ull / 1000ull),
+	        sm->slot, sm->ch, name);
+	if(sm->type == PARAM_TYPE_NUMERIC)
+		fprintf(out, "%.6f\n", (double)sm->v.f);
+	else
+		fprintf(out, "%u\n", sm->v.u);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  REC_DUMP                                                                 */
+/*  Prints the records of a ring, oldest first; with 'follow' it then keeps  */
+/*  printing new records. Safe against a running writer: records that were  */
+/*  overwritten while being copied are counted as lost, not printed.         */
+/*                                                                           */
+/*****************************************************************************/
+int rec_dump(const char *path, int follow, FILE *out, FILE *err)
+{
+	const rec_header_t	*h;
+	acq_sample_t		*chunk;
+	struct stat			st;
+	uint64_t			pos, head, cap, lost = 0;
+	size_t				len;
+	uint32_t			p;
+	int					fd, stream;
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0 || fstat(fd, &st) != 0) {
+		fprintf(err, "Cannot open ring '%s': %s\n", path, strerror(errno));
+		if(fd >= 0) close(fd);
+		return 1;
+	}
+	if((size_t)st.st_size < REC_HEADER_SIZE) {
+		fprintf(err, "'%s' is not a ring file\n", path);
+		close(fd);
+		return 1;
+	}
+	len = (size_t)st.st_size;
+	h = (const rec_header_t *)mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(h == MAP_FAILED) {
+		fprintf(err, "Cannot map ring '%s': %s\n", path, strerror(errno));
+		return 1;
+	}
+	if(__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != REC_MAGIC || h->version != REC_VERSION
+	|| h->headerSize != REC_HEADER_SIZE || h->sampleSize != sizeof(acq_sample_t)
+	|| h->nPar > ACQ_MAX_PARAMS
+	|| (h->capacity != 0 ? len != rec_file_size(h->capacity) : (len - REC_HEADER_SIZE) % sizeof(acq_sample_t) != 0)) {
+		fprintf(err, "'%s' is not a ring file (or has another version)\n", path);
+		munmap((void *)h, len);
+		return 1;
+	}
+	chunk = (acq_sample_t *)malloc(sizeof(acq_sample_t) * DUMP_CHUNK);
+	if(chunk == NULL) {
+		munmap((void *)h, len);
+		fprintf(err, "Out of memory\n");
+		return 3;
+	}
+
+	/* capacity 0: a --format bin stream, written once front to back */
+	stream = h->capacity == 0;
+	cap = stream ? (len - REC_HEADER_SIZE) / sizeof(acq_sample_t) : h->capacity;
+	fprintf(out, "# %s %s  host %s  period %u ms  %s %llu  params", stream ? "stream" : "ring",
+	        path, h->host, h->periodMs, stream ? "samples" : "capacity", (unsigned long long)cap);
+	for(p = 0; p < h->nPar; p++)
+		fprintf(out, "%c%s", p ? ',' : ' ', h->parName[p]);
+	fputc('\n', out);
+
+	head = stream ? cap : __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+	pos = head + h->batch > cap ? head + h->batch - cap : 0;
+	for(;;) {
+		while(pos < head) {
+			const acq_sample_t *rec = (const acq_sample_t *)((const char *)h + REC_HEADER_SIZE);
+			uint64_t n = head - pos, at = pos % cap, valid, i;
+
+			if(n > DUMP_CHUNK) n = DUMP_CHUNK;
+			if(at + n > cap) n = cap - at;
+			memcpy(chunk, &rec[at], (size_t)n * sizeof(*chunk));
+
+			/* anything under the new bound may have changed during the copy */
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if(!stream)
+				head = __atomic_load_n(&h->head, __ATOMIC_RELAXED);
+			valid = head + h->batch > cap ? head + h->batch - cap : 0;
+			for(i = 0; i < n; i++)
+				if(pos + i >= valid)
+					dump_one(out, h, &chunk[i]);
+				else
+					lost++;
+			pos += n;
+			if(pos < valid) {
+				lost += valid - pos;
+				pos = valid;
+			}
+		}
+		if(!follow || stream)
+			break;
+		fflush(out);
+		struct timespec ts = { 0, (long)(h->periodMs > 0 && h->periodMs < 200 ? h->periodMs : 200) * 1000000L };
+		nanosleep(&ts, NULL);
+		head = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+	}
+
+	if(lost > 0)
+		fprintf(err, "%llu sample(s) overwritten before they could be read\n", (unsigned long long)lost);
+	free(chunk);
+	munmap((void *)h, len);
+	return 0;
+}
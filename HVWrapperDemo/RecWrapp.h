@@ -0,0 +1,58 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   RECWRAPP.H                                                              */
+/*                                                                           */
+/*   --record: preallocated, memory-mapped ring of acq_sample_t records.     */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef __RECWRAPP_H
+#define __RECWRAPP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "AcqWrapp.h"
+
+#define REC_MAGIC          (0x31434552u)		/* "REC1" */
+#define REC_VERSION        (1)
+#define REC_HEADER_SIZE    (4096)
+#define REC_DEFAULT_CAP    (1u << 20)			/* samples: 24 MiB */
+
+/*
+  File layout: one REC_HEADER_SIZE header page, then 'capacity' records.
+  Record i lives at REC_HEADER_SIZE + (i % capacity) * sampleSize.
+
+  'head' counts the records written since the file was created and is the
+  only field that changes while recording. The writer fills a cycle of at
+  most 'batch' records, then publishes 'head' with a release store; so
+  while 'head' reads H, records below H + batch - capacity may be being
+  overwritten. A reader loads 'head' with acquire semantics, copies, then
+  loads it again and drops every copied record under that bound.
+  'magic' is stored last when a file is created, so a reader never sees
+  a half initialised header.
+
+  --format bin writes the same header with capacity 0 and head 0, then
+  the records of each read in order until the end of the file.
+*/
+typedef struct {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	headerSize;
+	uint32_t	sampleSize;
+	uint64_t	capacity;
+	uint64_t	head;
+	uint64_t	createdNs;
+	uint32_t	periodMs;
+	uint32_t	nPar;
+	uint32_t	batch;			/* records per cycle, at most */
+	uint32_t	reserved;
+	char		host[128];
+	char		parName[ACQ_MAX_PARAMS][MAX_PARAM_NAME + 2];
+} rec_header_t;
+
+int rec_open(const char *path, uint64_t capacity, const acq_t *a, const char *host,
+             acq_sink_t *sink, FILE *err);
+int rec_dump(const char *path, int follow, FILE *out, FILE *err);
+
+#endif // __RECWRAPP_H
@@ -0,0 +1,500 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   TRIPWRAPP.C                                                             */
+/*                                                                           */
+/*   The trip sink sees the ChStatus words of every tick as the raw 32-bit  */
+/*   values of the acquisition loop: one pass compares each word with the   */
+/*   previous one of its channel and does nothing else for the (usual)      */
+/*   unchanged ones. A channel where a --trip-bits bit goes from 0 to 1 is  */
+/*   a new trip; the actions of all trips of a tick run after the pass,     */
+/*   Pw Off as one multi-channel SetChParam per slot. Latency is counted    */
+/*   from the return of the GetChParam that carried the new status to the  */
+/*   end of the actions.                                                     */
+/*                                                                           */
+/*****************************************************************************/
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "CAENHVWrapper.h"
+#include "CliWrapp.h"
+#include "AcqWrapp.h"
+#include "TripWrapp.h"
+
+#define TRIP_EXEC_VARS       (5)			/* HV_SLOT .. HV_HOST */
+
+extern char **environ;
+
+/* ChStatus bits, as in the CAEN HV Wrapper manual; bit 12 is unused */
+static const char *bitName[16] = {
+	"On", "RampUp", "RampDown", "OverCurrent", "OverVoltage", "UnderVoltage", "ExtTrip", "MaxV",
+	"ExtDisable", "Trip", "CalibError", "Unplugged", NULL, "OverVoltProt", "PowerFail", "TempError"
+};
+
+/* other spellings accepted by --trip-bits */
+static const struct { const char *name; int bit; } bitAlias[] = {
+	{ "Up", 1 }, { "Down", 2 }, { "OvC", 3 }, { "OvV", 4 }, { "UnV", 5 }, { "IntTrip", 9 },
+	{ "CalErr", 10 }, { "OvVProt", 13 }, { "TempErr", 15 }
+};
+
+/* "On,RampUp" for 3; bits without a name as "bitN"; "-" when none is set */
+const char *trip_status_str(uint32_t st, char *buf, size_t len)
+{
+	size_t	pos = 0;
+	int		b;
+
+	buf[0] = '\0';
+	for(b = 0; b < 32 && pos < len; b++) {
+		if(!(st & (1u << b)))
+			continue;
+		if(b < 16 && bitName[b] != NULL)
+			pos += (size_t)snprintf(buf + pos, len - pos, "%s%s", pos ? "," : "", bitName[b]);
+		else
+			pos += (size_t)snprintf(buf + pos, len - pos, "%sbit%d", pos ? "," : "", b);
+	}
+	if(pos == 0)
+		snprintf(buf, len, "-");
+	return buf;
+}
+
+static int bit_of(const char *name, size_t len)
+{
+	size_t i;
+
+	for(i = 0; i < 16; i++)
+		if(bitName[i] != NULL && strlen(bitName[i]) == len && strncasecmp(name, bitName[i], len) == 0)
+			return (int)i;
+	for(i = 0; i < sizeof(bitAlias) / sizeof(bitAlias[0]); i++)
+		if(strlen(bitAlias[i].name) == len && strncasecmp(name, bitAlias[i].name, len) == 0)
+			return bitAlias[i].bit;
+	if(len > 3 && strncasecmp(name, "bit", 3) == 0) {
+		char	num[8], *stop;
+		long	v;
+
+		if(len - 3 >= sizeof(num))
+			return -1;
+		memcpy(num, name + 3, len - 3);
+		num[len - 3] = '\0';
+		v = strtol(num, &stop, 10);
+		if(*stop == '\0' && v >= 0 && v < 32)
+			return (int)v;
+	}
+	return -1;
+}
+
+/* --trip-bits: names (case-insensitive), "bitN", or a number as the mask itself */
+int trip_parse_bits(const char *list, uint32_t *mask)
+{
+	const char		*p = list;
+	char			*stop;
+	unsigned long	v;
+
+	v = strtoul(list, &stop, 0);
+	if(stop != list && *stop == '\0') {
+		*mask = (uint32_t)v;
+		return v != 0 && v <= 0xffffffffUL ? 0 : -1;
+	}
+	*mask = 0;
+	while(*p != '\0') {
+		const char	*end = strchr(p, ',');
+		size_t		len = end ? (size_t)(end - p) : strlen(p);
+		int			b = bit_of(p, len);
+
+		if(b < 0)
+			return -1;
+		*mask |= 1u << b;
+		p += len + (end ? 1 : 0);
+	}
+	return *mask != 0 ? 0 : -1;
+}
+
+int trip_parse_off(const char *scope)
+{
+	if(strcmp(scope, "ch") == 0)
+		return TRIP_OFF_CH;
+	if(strcmp(scope, "slot") == 0)
+		return TRIP_OFF_SLOT;
+	if(strcmp(scope, "all") == 0)
+		return TRIP_OFF_ALL;
+	return -1;
+}
+
+/* a new trip found in the pass, acted on after it */
+typedef struct {
+	int			k;				/* channel of the trip in off[] */
+	uint16_t	slot, ch;
+	uint32_t	status, bits;
+	uint64_t	tsNs;			/* read that carried it */
+} trip_ev_t;
+
+typedef struct {
+	const acq_t		*a;
+	cli_sess_t		*s;
+	FILE			*out, *err;
+	int				par;			/* ChStatus in the parameter table */
+	uint32_t		mask;
+	int				offScope;
+	const char		*exec;
+	uint32_t		*prev;			/* last status, per series */
+	char			*seen;
+	trip_ev_t		*ev;			/* one tick worth */
+	int				nEv;
+	char			*off;			/* per target and channel: Pw Off this tick */
+	int				*offBase;		/* first of each target in off[] */
+	int				*offOf;			/* per series: place of its channel in off[] */
+	unsigned short	*chBuf;
+	pid_t			pid[TRIP_MAX_EXEC];
+	int64_t			periodNs;
+	uint64_t		lastTsNs;
+	long			ticks, late, changes, trips, offCalls, offFail, execs, execSkip;
+	double			passNs, passMaxNs;
+	double			*lat;			/* detection to end of actions, ms */
+	long			nLat, capLat;
+} trip_t;
+
+static uint64_t mono_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void stamp(FILE *out, uint64_t tsNs)
+{
+	time_t		sec = (time_t)(tsNs / 1000000000ull);
+	struct tm	tm;
+
+	localtime_r(&sec, &tm);
+	fprintf(out, "[%02d:%02d:%02d.%03d] ", tm.tm_hour, tm.tm_min, tm.tm_sec,
+	        (int)(tsNs % 1000000000ull / 1000000ull));
+}
+
+static void reap(trip_t *tr)
+{
+	int i, st;
+
+	for(i = 0; i < TRIP_MAX_EXEC; i++)
+		if(tr->pid[i] > 0 && waitpid(tr->pid[i], &st, WNOHANG) != 0)
+			tr->pid[i] = 0;
+}
+
+/* --trip-exec: /bin/sh -c CMD with the trip in the environment; not waited for.
+   The environment is built before fork(): the child of a threaded process may
+   only call async-signal-safe functions, setenv() is not one */
+static void run_exec(trip_t *tr, const trip_ev_t *e)
+{
+	static const char	*hv[TRIP_EXEC_VARS] = { "HV_SLOT=", "HV_CH=", "HV_STATUS=", "HV_BITS=", "HV_HOST=" };
+	char				var[TRIP_EXEC_VARS][TRIP_STATUS_LEN + 16], bits[TRIP_STATUS_LEN];
+	char				*argv[] = { "sh", "-c", (char *)tr->exec, NULL };
+	char				**envp;
+	int					i, j, k, n;
+	pid_t				pid;
+
+	for(i = 0; i < TRIP_MAX_EXEC && tr->pid[i] > 0; i++)
+		;
+	if(i == TRIP_MAX_EXEC) {
+		tr->execSkip++;
+		return;
+	}
+	for(n = 0; environ[n] != NULL; n++)
+		;
+	if((envp = (char **)malloc(sizeof(char *) * (size_t)(n + TRIP_EXEC_VARS + 1))) == NULL) {
+		fprintf(tr->err, "--trip-exec: out of memory\n");
+		tr->execSkip++;
+		return;
+	}
+	snprintf(var[0], sizeof(var[0]), "%s%u", hv[0], e->slot);
+	snprintf(var[1], sizeof(var[1]), "%s%u", hv[1], e->ch);
+	snprintf(var[2], sizeof(var[2]), "%s%u", hv[2], e->status);
+	snprintf(var[3], sizeof(var[3]), "%s%s", hv[3], trip_status_str(e->bits, bits, sizeof(bits)));
+	snprintf(var[4], sizeof(var[4]), "%s%s", hv[4], tr->s->host);
+	for(k = 0, n = 0; environ[k] != NULL; k++) {
+		for(j = 0; j < TRIP_EXEC_VARS && strncmp(environ[k], hv[j], strlen(hv[j])) != 0; j++)
+			;
+		if(j == TRIP_EXEC_VARS)			/* ours replace any inherited */
+			envp[n++] = environ[k];
+	}
+	for(j = 0; j < TRIP_EXEC_VARS; j++)
+		envp[n++] = var[j];
+	envp[n] = NULL;
+
+	fflush(tr->out);
+	fflush(tr->err);
+	pid = fork();
+	if(pid == 0) {
+		execve("/bin/sh", argv, envp);
+		_exit(127);
+	}
+	free(envp);
+	if(pid < 0) {
+		fprintf(tr->err, "--trip-exec: fork failed\n");
+		tr->execSkip++;
+		return;
+	}
+	tr->pid[i] = pid;
+	tr->execs++;
+}
+
+/* Pw Off on the channels marked in off[]: one call per slot */
+static void power_off(trip_t *tr)
+{
+	const cli_req_t	*req = tr->a->req;
+	unsigned		zero = 0;
+	int				t, k, n;
+
+	for(t = 0; t < req->nTargets; t++) {
+		const cli_target_t *tg = &req->targets[t];
+
+		for(k = 0, n = 0; k < tg->count; k++)
+			if(tr->off[tr->offBase[t] + k]) {
+				tr->off[tr->offBase[t] + k] = 0;
+				tr->chBuf[n++] = tg->ch[k];
+			}
+		if(n == 0)
+			continue;
+		CAENHVRESULT sr = CAENHV_SetChParam(tr->s->handle, tg->slot, "Pw", (unsigned short)n, tr->chBuf, &zero);
+		tr->offCalls++;
+		if(sr != CAENHV_OK) {
+			tr->offFail++;
+			fprintf(tr->err, "SetChParam('Pw') slot %d failed: %s (code %d)\n",
+			        tg->slot, CAENHV_GetError(tr->s->handle), sr);
+		}
+	}
+}
+
+static void mark_off(trip_t *tr, const trip_ev_t *e)
+{
+	const cli_req_t	*req = tr->a->req;
+	int				t, k;
+
+	if(tr->offScope == TRIP_OFF_CH) {
+		tr->off[e->k] = 1;
+		return;
+	}
+	for(t = 0; t < req->nTargets; t++)
+		if(tr->offScope == TRIP_OFF_ALL || req->targets[t].slot == e->slot)
+			for(k = 0; k < req->targets[t].count; k++)
+				tr->off[tr->offBase[t] + k] = 1;
+}
+
+static int trip_put(void *ctx, const acq_sample_t *smp, int n)
+{
+	trip_t			*tr = (trip_t *)ctx;
+	char			was[TRIP_STATUS_LEN], now[TRIP_STATUS_LEN];
+	uint64_t		t0, t1, ts = 0;
+	int				i;
+
+	t0 = mono_ns();
+	tr->nEv = 0;
+	for(i = 0; i < n; i++) {
+		const acq_sample_t	*sm = &smp[i];
+		uint32_t			cur = sm->v.u, old;
+
+		if(sm->par != tr->par)
+			continue;
+		ts = sm->tsNs;
+		old = tr->prev[sm->series];
+		tr->prev[sm->series] = cur;
+		if(!tr->seen[sm->series]) {
+			tr->seen[sm->series] = 1;
+			if(cur & tr->mask) {
+				stamp(tr->out, sm->tsNs);
+				fprintf(tr->out, "Slot %d  Ch %d  already tripped: %s\n", sm->slot, sm->ch,
+				        trip_status_str(cur, now, sizeof(now)));
+			}
+			continue;
+		}
+		if(cur == old)
+			continue;
+		tr->changes++;
+		if(cur & ~old & tr->mask) {
+			trip_ev_t *e = &tr->ev[tr->nEv++];
+
+			e->k = tr->offOf[sm->series];
+			e->slot = sm->slot;
+			e->ch = sm->ch;
+			e->status = cur;
+			e->bits = cur & ~old & tr->mask;
+			e->tsNs = sm->tsNs;
+		} else {
+			stamp(tr->out, sm->tsNs);
+			fprintf(tr->out, "Slot %d  Ch %d  %s -> %s\n", sm->slot, sm->ch,
+			        trip_status_str(old, was, sizeof(was)), trip_status_str(cur, now, sizeof(now)));
+		}
+	}
+	t1 = mono_ns();
+	tr->ticks++;
+	tr->passNs += (double)(t1 - t0);
+	if((double)(t1 - t0) > tr->passMaxNs)
+		tr->passMaxNs = (double)(t1 - t0);
+	/* a tick without ChStatus (not due, or its read failed) shows up late on the next one */
+	if(ts != 0) {
+		if(tr->lastTsNs != 0 && (double)(ts - tr->lastTsNs) > 1.5 * (double)tr->periodNs)
+			tr->late++;
+		tr->lastTsNs = ts;
+	}
+
+	reap(tr);
+	if(tr->nEv == 0)
+		return 0;
+
+	/* actions: Pw Off first, it is the one that protects the detector */
+	for(i = 0; i < tr->nEv && tr->offScope != TRIP_OFF_NONE; i++)
+		mark_off(tr, &tr->ev[i]);
+	if(tr->offScope != TRIP_OFF_NONE)
+		power_off(tr);
+	for(i = 0; i < tr->nEv && tr->exec != NULL; i++)
+		run_exec(tr, &tr->ev[i]);
+	t1 = acq_now_ns();
+
+	for(i = 0; i < tr->nEv; i++) {
+		const trip_ev_t	*e = &tr->ev[i];
+		double			ms = (double)(t1 - e->tsNs) / 1e6;
+
+		tr->trips++;
+		if(tr->nLat == tr->capLat) {
+			long	cap = tr->capLat ? tr->capLat * 2 : 256;
+			double	*nl = (double *)realloc(tr->lat, (size_t)cap * sizeof(double));
+
+			if(nl != NULL) {
+				tr->lat = nl;
+				tr->capLat = cap;
+			}
+		}
+		if(tr->nLat < tr->capLat)
+			tr->lat[tr->nLat++] = ms;
+		stamp(tr->out, e->tsNs);
+		fprintf(tr->out, "Slot %d  Ch %d  TRIP %s (%s), acted in %.3f ms\n", e->slot, e->ch,
+		        trip_status_str(e->bits, was, sizeof(was)), trip_status_str(e->status, now, sizeof(now)), ms);
+	}
+	fflush(tr->out);
+	return 0;
+}
+
+static void trip_free(trip_t *tr);
+
+static int cmp_double(const void *x, const void *y)
+{
+	double a = *(const double *)x, b = *(const double *)y;
+
+	return a < b ? -1 : a > b;
+}
+
+static void trip_close(void *ctx)
+{
+	trip_t	*tr = (trip_t *)ctx;
+	int		i;
+
+	fprintf(tr->out, "Trips: %ld on %ld status change(s) over %ld tick(s), %ld late (> 1.5 period)\n",
+	        tr->trips, tr->changes, tr->ticks, tr->late);
+	if(tr->ticks > 0)
+		fprintf(tr->out, "Decode: %.1f us per tick mean, %.1f us max, %d channel(s)\n",
+		        tr->passNs / (double)tr->ticks / 1e3, tr->passMaxNs / 1e3, tr->a->nSmp / tr->a->nPar);
+	if(tr->nLat > 0) {
+		qsort(tr->lat, (size_t)tr->nLat, sizeof(double), cmp_double);
+		fprintf(tr->out, "Detection to action: p50 %.3f ms, max %.3f ms\n",
+		        tr->lat[tr->nLat / 2], tr->lat[tr->nLat - 1]);
+	}
+	if(tr->offScope != TRIP_OFF_NONE)
+		fprintf(tr->out, "Pw Off: %ld call(s), %ld failed\n", tr->offCalls, tr->offFail);
+	if(tr->exec != NULL)
+		fprintf(tr->out, "--trip-exec: %ld started, %ld skipped\n", tr->execs, tr->execSkip);
+	fflush(tr->out);
+
+	for(i = 0; i < TRIP_MAX_EXEC; i++)
+		if(tr->pid[i] > 0)
+			waitpid(tr->pid[i], NULL, 0);
+	trip_free(tr);
+}
+
+static void trip_free(trip_t *tr)
+{
+	free(tr->prev);
+	free(tr->seen);
+	free(tr->ev);
+	free(tr->off);
+	free(tr->offBase);
+	free(tr->offOf);
+	free(tr->chBuf);
+	free(tr->lat);
+	free(tr);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  TRIP_OPEN                                                                */
+/*  The --trips sink of an acquisition: ChStatus must be among the          */
+/*  parameters read. Returns 0 or an exit code.                              */
+/*                                                                           */
+/*****************************************************************************/
+int trip_open(const acq_t *a, cli_sess_t *s, FILE *out, acq_sink_t *sink, FILE *err)
+{
+	const cli_req_t	*req = a->req;
+	trip_t			*tr;
+	int				p, t, i, k, nCh = 0, maxCh = 0;
+
+	for(p = 0; p < a->nPar && strcmp(a->par[p].name, "ChStatus") != 0; p++)
+		;
+	if(p == a->nPar) {
+		fprintf(err, "--trips needs ChStatus among the parameters read\n");
+		return 2;
+	}
+	tr = (trip_t *)calloc(1, sizeof(*tr));
+	if(tr == NULL) {
+		fprintf(err, "Out of memory\n");
+		return 3;
+	}
+	tr->a = a;
+	tr->s = s;
+	tr->out = out;
+	tr->err = err;
+	tr->par = p;
+	tr->offScope = req->tripOff;
+	tr->exec = req->tripExec;
+	if(trip_parse_bits(req->tripBits ? req->tripBits : TRIP_DEFAULT_BITS, &tr->mask) != 0) {
+		fprintf(err, "Invalid --trip-bits '%s'\n", req->tripBits);
+		free(tr);
+		return 2;
+	}
+	for(i = 0; i < a->nItems; i++)
+		if(a->item[i].p == p && (tr->periodNs == 0 || a->item[i].periodNs < tr->periodNs))
+			tr->periodNs = a->item[i].periodNs;
+	for(t = 0; t < req->nTargets; t++) {
+		nCh += req->targets[t].count;
+		if(req->targets[t].count > maxCh)
+			maxCh = req->targets[t].count;
+	}
+	tr->prev = (uint32_t *)calloc((size_t)a->nSmp, sizeof(uint32_t));
+	tr->seen = (char *)calloc((size_t)a->nSmp, 1);
+	tr->ev = (trip_ev_t *)calloc((size_t)nCh, sizeof(trip_ev_t));
+	tr->off = (char *)calloc((size_t)nCh, 1);
+	tr->offBase = (int *)calloc((size_t)req->nTargets, sizeof(int));
+	tr->offOf = (int *)calloc((size_t)a->nSmp, sizeof(int));
+	tr->chBuf = (unsigned short *)calloc((size_t)maxCh, sizeof(unsigned short));
+	if(tr->prev == NULL || tr->seen == NULL || tr->ev == NULL || tr->off == NULL || tr->offBase == NULL ||
+	   tr->offOf == NULL || tr->chBuf == NULL) {
+		fprintf(err, "Out of memory\n");
+		trip_free(tr);
+		return 3;
+	}
+	for(t = 0, nCh = 0; t < req->nTargets; t++) {
+		tr->offBase[t] = nCh;
+		nCh += req->targets[t].count;
+	}
+	for(i = 0; i < a->nItems; i++)
+		for(k = 0; k < req->targets[a->item[i].t].count; k++) {
+			tr->offOf[a->item[i].base + k] = tr->offBase[a->item[i].t] + k;
+		}
+	sink->ctx = tr;
+	sink->put = trip_put;
+	sink->close = trip_close;
+	sink->unfiltered = 1;			/* a trip must not wait for the deadband */
+	return 0;
+}
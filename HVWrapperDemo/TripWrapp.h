@@ -0,0 +1,32 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   TRIPWRAPP.H                                                             */
+/*                                                                           */
+/*   ChStatus decoding, and --trips: an acquisition sink that follows the   */
+/*   status of every channel read and acts on new trips (log, Pw Off on a   */
+/*   group, an external command).                                            */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef __TRIPWRAPP_H
+#define __TRIPWRAPP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "CliWrapp.h"
+#include "AcqWrapp.h"
+
+#define TRIP_DEFAULT_BITS    "Trip,ExtTrip"
+#define TRIP_DEFAULT_PERIOD  (100)			/* ms: 10 Hz */
+#define TRIP_MAX_EXEC        (8)			/* --trip-exec commands running at once */
+#define TRIP_STATUS_LEN      (160)			/* longest trip_status_str() */
+
+enum { TRIP_OFF_NONE, TRIP_OFF_CH, TRIP_OFF_SLOT, TRIP_OFF_ALL };
+
+const char *trip_status_str(uint32_t st, char *buf, size_t len);
+int  trip_parse_bits(const char *list, uint32_t *mask);
+int  trip_parse_off(const char *scope);
+int  trip_open(const acq_t *a, cli_sess_t *s, FILE *out, acq_sink_t *sink, FILE *err);
+
+#endif // __TRIPWRAPP_H
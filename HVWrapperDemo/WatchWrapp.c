@@ -0,0 +1,393 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   WATCHWRAPP.C                                                            */
+/*                                                                           */
+/*   --watch subscribes the selected channels and prints a line only when    */
+/*   the crate pushes an event, instead of re-reading every channel each     */
+/*   cycle. Items the crate refuses (per-channel listOfResultCodes, or no    */
+/*   event support at all, e.g. SY1527/SY2527) are polled at a slow rate     */
+/*   with multi-channel reads, and still printed only when they change.      */
+/*   --deadband/--changes widen "change" to "moved out of the band", for    */
+/*   events and polls alike, before anything is formatted.                   */
+/*                                                                           */
+/*****************************************************************************/
+#include <signal.h>
+#ifdef UNIX
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "CAENHVWrapper.h"
+#include "CliWrapp.h"
+#include "WatchWrapp.h"
+#include "FiltWrapp.h"
+#include "TripWrapp.h"
+
+typedef struct {
+	char			name[MAX_PARAM_NAME + 2];
+	unsigned long	type;
+	unsigned short	*pollCh;		/* channels this parameter is polled on */
+	int				pollCount;
+	float			*lastF;			/* last printed value, per polled channel */
+	unsigned int	*lastL;
+	char			*seen;
+} watch_par_t;
+
+static volatile sig_atomic_t	stopReq;
+static int						seriesPerPar;	/* highest channel + 1 */
+
+static uint64_t wall_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void on_stop(int sig)
+{
+	(void)sig;
+	stopReq = 1;
+}
+
+static double now_ms(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void stamp(FILE *out)
+{
+	struct timeval	tv;
+	struct tm		tm;
+
+	gettimeofday(&tv, NULL);
+	localtime_r(&tv.tv_sec, &tm);
+	fprintf(out, "[%02d:%02d:%02d.%03d] ", tm.tm_hour, tm.tm_min, tm.tm_sec, (int)(tv.tv_usec / 1000));
+}
+
+static void print_value(FILE *out, int slot, int ch, const watch_par_t *p, float f, unsigned int l)
+{
+	stamp(out);
+	if(p->type == PARAM_TYPE_NUMERIC)
+		fprintf(out, "Slot %d  Ch %d  %s = %.6f\n", slot, ch, p->name, (double)f);
+	else if(p->type == PARAM_TYPE_CHSTATUS) {
+		char bits[TRIP_STATUS_LEN];
+
+		fprintf(out, "Slot %d  Ch %d  %s = %u (%s)\n", slot, ch, p->name, l, trip_status_str(l, bits, sizeof(bits)));
+	} else
+		fprintf(out, "Slot %d  Ch %d  %s = %u\n", slot, ch, p->name, l);
+}
+
+static uint32_t float_bits(float f)
+{
+	uint32_t u;
+
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+/* UDP socket the crate pushes events to; port 0 picks a free one */
+static int open_event_socket(int port, int *boundPort)
+{
+	struct sockaddr_in	addr;
+	socklen_t			alen = sizeof(addr);
+	int					sck;
+
+	sck = socket(AF_INET, SOCK_DGRAM, 0);
+	if(sck < 0)
+		return -1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons((unsigned short)port);
+	if(bind(sck, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	   getsockname(sck, (struct sockaddr *)&addr, &alen) != 0) {
+		close(sck);
+		return -1;
+	}
+	*boundPort = ntohs(addr.sin_port);
+	return sck;
+}
+
+static int poll_params(cli_sess_t *s, int slot, watch_par_t *par, int nPar, void *buf, filt_t *filt,
+                       FILE *out, FILE *err)
+{
+	uint64_t	now = wall_ns();
+	int			p, k;
+
+	for(p = 0; p < nPar; p++) {
+		watch_par_t *wp = &par[p];
+
+		if(wp->pollCount == 0)
+			continue;
+		CAENHVRESULT gr = CAENHV_GetChParam(s->handle, (unsigned short)slot, wp->name,
+		                                    (unsigned short)wp->pollCount, wp->pollCh, buf);
+		if(gr != CAENHV_OK) {
+			fprintf(err, "GetChParam('%s') failed: %s (code %d)\n", wp->name, CAENHV_GetError(s->handle), gr);
+			if(cli_link_lost(gr))
+				return gr;
+			continue;
+		}
+		for(k = 0; k < wp->pollCount; k++) {
+			float			f = ((float *)buf)[k];
+			unsigned int	l = ((unsigned int *)buf)[k];
+			int				changed;
+
+			if(filt->band[p].on)
+				changed = filt_pass(filt, p * seriesPerPar + wp->pollCh[k], p, l, now);
+			else if(wp->type == PARAM_TYPE_NUMERIC)
+				changed = !wp->seen[k] || f != wp->lastF[k];
+			else
+				changed = !wp->seen[k] || l != wp->lastL[k];
+			if(!changed)
+				continue;
+			wp->seen[k] = 1;
+			wp->lastF[k] = f;
+			wp->lastL[k] = l;
+			print_value(out, slot, wp->pollCh[k], wp, f, l);
+		}
+	}
+	return CAENHV_OK;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  WATCH_RUN                                                                */
+/*                                                                           */
+/*****************************************************************************/
+int watch_run(cli_sess_t *s, cli_req_t *req, FILE *out, FILE *err)
+{
+	watch_par_t			par[WATCH_MAX_PARAMS];
+	char				nameList[128];
+	char				codes[WATCH_MAX_PARAMS];
+	char				*subscribed = NULL;
+	void				*buf = NULL;
+	struct sigaction	sa, oldInt, oldTerm;
+	filt_t				filt;
+	int					nPar = 0, slot = req->slot, chCount = req->chCount;
+	int					sck = -1, port = 0, nSub = 0, nPoll = 0;
+	int					exitCode = 0, i, p;
+	int					pollMs = req->watchPollMs > 0 ? req->watchPollMs : WATCH_DEFAULT_POLL_MS;
+	double				nextPoll;
+
+	memset(par, 0, sizeof(par));
+	memset(&filt, 0, sizeof(filt));
+
+	/* parameter set: --get list if given, VMon/IMon/ChStatus/Pw otherwise */
+	{
+		char names[WATCH_MAX_PARAMS][MAX_PARAM_NAME + 2];
+
+		nPar = cli_split_params(req->getParam ? req->getParam : WATCH_DEFAULT_PARAMS, names, WATCH_MAX_PARAMS);
+		if(nPar <= 0) {
+			fprintf(err, "Invalid parameter list '%s' (at most %d names)\n", req->getParam, WATCH_MAX_PARAMS);
+			return 2;
+		}
+		for(p = 0; p < nPar; p++) {
+			strcpy(par[p].name, names[p]);
+			CAENHVRESULT pr = cli_param_type(s, (unsigned short)slot, req->chList[0], par[p].name, &par[p].type);
+			if(pr != CAENHV_OK) {
+				fprintf(err, "GetChParamProp('%s','Type') failed: %s (code %d)\n", par[p].name, CAENHV_GetError(s->handle), pr);
+				return (int)pr;
+			}
+		}
+	}
+	{
+		const char		*nm[WATCH_MAX_PARAMS];
+		unsigned long	ty[WATCH_MAX_PARAMS];
+
+		for(p = 0, seriesPerPar = 1; p < nPar; p++) {
+			nm[p] = par[p].name;
+			ty[p] = par[p].type;
+		}
+		for(i = 0; i < chCount; i++)
+			if(req->chList[i] + 1 > seriesPerPar)
+				seriesPerPar = req->chList[i] + 1;
+		if((exitCode = filt_init(&filt, req, nm, ty, nPar, nPar * seriesPerPar, err)) != 0)
+			goto done;
+	}
+	/* the crate wants the list ':' separated */
+	nameList[0] = '\0';
+	for(p = 0; p < nPar; p++) {
+		if(p) strcat(nameList, ":");
+		strcat(nameList, par[p].name);
+	}
+
+	subscribed = calloc((size_t)chCount * (size_t)nPar, 1);
+	buf = malloc(sizeof(float) * (size_t)chCount + sizeof(unsigned int) * (size_t)chCount);
+	if(subscribed == NULL || buf == NULL) {
+		fprintf(err, "Out of memory\n");
+		exitCode = 3;
+		goto done;
+	}
+
+	sck = open_event_socket(req->watchPort, &port);
+	if(sck < 0)
+		fprintf(err, "Cannot open event socket on port %d: %s; polling every %d ms\n",
+		        req->watchPort, strerror(errno), pollMs);
+
+	for(i = 0; sck >= 0 && i < chCount; i++) {
+		memset(codes, 0, sizeof(codes));
+		CAENHVRESULT sr = CAENHV_SubscribeChannelParams(s->handle, (short)port, (unsigned short)slot,
+		                                                req->chList[i], nameList, (unsigned int)nPar, codes);
+		if(sr != CAENHV_OK) {
+			if(cli_link_lost(sr)) {
+				fprintf(err, "SubscribeChannelParams failed: %s (code %d)\n", CAENHV_GetError(s->handle), sr);
+				exitCode = (int)sr;
+				goto done;
+			}
+			if(i == 0)
+				fprintf(err, "Events not available (code %d): polling every %d ms\n", sr, pollMs);
+			break;			/* same answer for every channel: poll them all */
+		}
+		for(p = 0; p < nPar; p++) {
+			if(codes[p] == CAENHV_OK) {
+				subscribed[i * nPar + p] = 1;
+				nSub++;
+			} else
+				fprintf(err, "Slot %d  Ch %d  %s: subscribe refused (code %d), polling\n",
+				        slot, req->chList[i], par[p].name, codes[p]);
+		}
+	}
+
+	/* everything not subscribed is polled, one multi-channel read per parameter */
+	for(p = 0; p < nPar; p++) {
+		par[p].pollCh = malloc(sizeof(unsigned short) * (size_t)chCount);
+		par[p].lastF = calloc((size_t)chCount, sizeof(float));
+		par[p].lastL = calloc((size_t)chCount, sizeof(unsigned int));
+		par[p].seen = calloc((size_t)chCount, 1);
+		if(!par[p].pollCh || !par[p].lastF || !par[p].lastL || !par[p].seen) {
+			fprintf(err, "Out of memory\n");
+			exitCode = 3;
+			goto done;
+		}
+		for(i = 0; i < chCount; i++)
+			if(!subscribed[i * nPar + p])
+				par[p].pollCh[par[p].pollCount++] = req->chList[i];
+		nPoll += par[p].pollCount;
+	}
+
+	if(nSub > 0)
+		fprintf(err, "Watching %d channel(s): %d item(s) by event on UDP port %d, %d polled; Ctrl-C to stop\n",
+		        chCount, nSub, port, nPoll);
+	else
+		fprintf(err, "Watching %d channel(s): %d item(s) polled; Ctrl-C to stop\n", chCount, nPoll);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_stop;			/* no SA_RESTART: select() must wake up */
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, &oldInt);
+	sigaction(SIGTERM, &sa, &oldTerm);
+	stopReq = 0;
+
+	/* initial values, so every item is printed once */
+	if(nPoll > 0 && (exitCode = poll_params(s, slot, par, nPar, buf, &filt, out, err)) != 0)
+		goto restore;
+	fflush(out);
+	nextPoll = now_ms() + pollMs;
+
+	while(!stopReq) {
+		struct timeval	tmo;
+		fd_set			rd;
+		double			wait = nPoll > 0 ? nextPoll - now_ms() : 1000.0;
+		int				nfd = 0;
+
+		if(wait < 0) wait = 0;
+		tmo.tv_sec = (long)(wait / 1000.0);
+		tmo.tv_usec = (long)((wait - tmo.tv_sec * 1000.0) * 1000.0);
+		FD_ZERO(&rd);
+		if(nSub > 0) {
+			FD_SET(sck, &rd);
+			nfd = sck + 1;
+		}
+		int sel = select(nfd, &rd, NULL, NULL, &tmo);
+		if(sel < 0 && errno != EINTR) {
+			perror("select");
+			exitCode = 1;
+			break;
+		}
+
+		if(sel > 0 && FD_ISSET(sck, &rd)) {
+			CAENHV_SYSTEMSTATUS_t	sysStatus;
+			CAENHVEVENT_TYPE_t		*ev = NULL;
+			unsigned int			nEv = 0, e;
+
+			CAENHVRESULT er = CAENHV_GetEventData(sck, &sysStatus, &ev, &nEv);
+			if(er != CAENHV_OK) {
+				fprintf(err, "GetEventData failed: %s (code %d)\n", CAENHV_GetError(s->handle), er);
+				if(cli_link_lost(er)) {
+					exitCode = (int)er;
+					break;
+				}
+			}
+			for(e = 0; e < nEv; e++) {
+				if(ev[e].Type != PARAMETER || ev[e].BoardIndex != slot)
+					continue;
+				for(p = 0; p < nPar; p++)
+					if(!strcmp(ev[e].ItemID, par[p].name))
+						break;
+				if(p == nPar || ev[e].ChannelIndex >= seriesPerPar)
+					continue;
+				if(!filt_pass(&filt, p * seriesPerPar + ev[e].ChannelIndex, p,
+				              par[p].type == PARAM_TYPE_NUMERIC ? float_bits(ev[e].Value.FloatValue) :
+				              (uint32_t)ev[e].Value.IntValue, wall_ns()))
+					continue;
+				print_value(out, slot, ev[e].ChannelIndex, &par[p],
+				            ev[e].Value.FloatValue, (unsigned int)ev[e].Value.IntValue);
+			}
+			if(ev != NULL)
+				CAENHV_FreeEventData(&ev);
+		}
+
+		if(nPoll > 0 && now_ms() >= nextPoll) {
+			if((exitCode = poll_params(s, slot, par, nPar, buf, &filt, out, err)) != 0)
+				break;
+			nextPoll += pollMs;
+			if(nextPoll < now_ms())
+				nextPoll = now_ms() + pollMs;	/* link slower than the poll rate */
+		}
+		fflush(out);
+	}
+
+restore:
+	sigaction(SIGINT, &oldInt, NULL);
+	sigaction(SIGTERM, &oldTerm, NULL);
+	filt_report(&filt, err);
+
+done:
+	if(nSub > 0) {
+		for(i = 0; i < chCount; i++) {
+			int any = 0;
+
+			for(p = 0; p < nPar; p++)
+				any |= subscribed[i * nPar + p];
+			if(any)
+				CAENHV_UnSubscribeChannelParams(s->handle, (short)port, (unsigned short)slot,
+				                                req->chList[i], nameList, (unsigned int)nPar, codes);
+		}
+	}
+	if(sck >= 0)
+		close(sck);
+	for(p = 0; p < nPar; p++) {
+		free(par[p].pollCh);
+		free(par[p].lastF);
+		free(par[p].lastL);
+		free(par[p].seen);
+	}
+	free(subscribed);
+	free(buf);
+	filt_free(&filt);
+	return exitCode;
+}
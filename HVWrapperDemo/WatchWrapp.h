@@ -0,0 +1,22 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   WATCHWRAPP.H                                                            */
+/*                                                                           */
+/*   --watch: event driven channel monitoring (CAENHV_Subscribe* family)     */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef __WATCHWRAPP_H
+#define __WATCHWRAPP_H
+
+#include <stdio.h>
+#include "CliWrapp.h"
+
+#define WATCH_DEFAULT_PARAMS   CLI_SNAPSHOT_PARAMS
+#define WATCH_DEFAULT_POLL_MS  (1000)
+#define WATCH_MAX_PARAMS       (8)
+
+int watch_run(cli_sess_t *s, cli_req_t *req, FILE *out, FILE *err);
+
+#endif // __WATCHWRAPP_H
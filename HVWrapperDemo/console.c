@@ -18,6 +18,15 @@
 #include <stdlib.h>
 #include "console.h"
 
+/*
+  Drawing only touches stdscr, which ncurses keeps as the next frame;
+  the terminal sees it at con_flush(), i.e. once per frame: when the
+  program waits for a key (getch refreshes stdscr itself), sleeps in
+  delay() or flushes explicitly. ncurses then sends the cells that differ
+  from the frame on screen (curscr), so a redrawn table costs what
+  changed in it, not a full repaint.
+*/
+
 void  con_init(void)
 {
 initscr();
@@ -25,28 +34,41 @@ cbreak();
 noecho();
 nodelay(stdscr, FALSE);
 curs_set(FALSE);
+leaveok(stdscr, TRUE);     /* the cursor is hidden: no moves to park it */
+idlok(stdscr, TRUE);       /* scrolled text may use insert/delete line  */
 }
 
 void  con_end(void)
 {
+con_flush();
 endwin();
 }
 
+void  con_flush(void)
+{
+wnoutrefresh(stdscr);
+doupdate();
+}
+
 void  clrscr(void)
 {
- clear();  
+ erase();                  /* not clear(): that would repaint every cell */
  move(0,0); 
- refresh();
 }
 
 void  highvideo(void)
 {
-    
+attron(A_BOLD);
 }
     
 void  normvideo(void)
 {
-    
+attroff(A_BOLD);
+}
+
+void  con_size(int *cols, int *rows)
+{
+getmaxyx(stdscr, *rows, *cols);
 }
 
 int   con_getch(void)
@@ -59,9 +81,7 @@ return i;
 
 int   con_putch(int ch)
 {
- int c = addch(ch);
- refresh();
- return c;    
+ return addch(ch);
 }
 
 int   con_kbhit(void)
@@ -105,7 +125,6 @@ i = vwprintw(stdscr,fmt,marker);
 va_end(marker);
 }
 #endif
-refresh();
 return i;
 }
 
@@ -120,7 +139,6 @@ int i;
 
 echo();
 i = scanw(fmt,app);    
-refresh();
 noecho();
 return i;
 }
@@ -128,11 +146,11 @@ return i;
 void  gotoxy(int x, int y)
 {
 move(y-1, x-1);     
-refresh();
 }
 
 void  delay(int msec)
 {
+ con_flush();
  usleep(msec*1000);   
 }
 
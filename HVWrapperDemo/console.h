@@ -39,6 +39,20 @@ void  con_init(void);
     --------------------------------------------------------------------***/
 void  con_end(void);
 
+/***------------------------------------------------------------------------
+
+  con_flush
+  Sends the screen drawn since the last flush to the terminal, only the
+  cells that changed. Drawing calls do not flush by themselves: reading a
+  key (con_getch, con_kbhit, con_scanf) and delay flush first.
+  Arguments:
+    none
+  Return value:
+    none
+
+    --------------------------------------------------------------------***/
+void  con_flush(void);
+
 /***------------------------------------------------------------------------
 
   clrscr
@@ -75,6 +89,18 @@ void  highvideo(void);
     --------------------------------------------------------------------***/
 void  normvideo(void);
 
+/***------------------------------------------------------------------------
+
+  con_size
+  Size of the screen, which may change while the program runs.
+  Arguments:
+    where to store the number of columns and of rows
+  Return value:
+    none
+
+    --------------------------------------------------------------------***/
+void  con_size(int *cols, int *rows);
+
 /***------------------------------------------------------------------------
 
   con_getch
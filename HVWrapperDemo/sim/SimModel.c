@@ -0,0 +1,573 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   SIMMODEL.C                                                              */
+/*                                                                           */
+/*   Channels are not simulated on a clock: each one is stepped to 'now'    */
+/*   when it is read or set. A step moves the output towards V0Set (or 0)    */
+/*   at RUp/RDWn, derives the current from a resistive and capacitive load, */
+/*   current-limits at I0Set and trips after Trip s over it. Discharges     */
+/*   (SIMHV_TRIP_RATE) are drawn as a Poisson process over the step.         */
+/*                                                                           */
+/*****************************************************************************/
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include "SimModel.h"
+
+#define SIM_STATE_MAGIC  "HVSIMST1"
+
+sim_cfg_t sim_cfg;
+
+const sim_bdtype_t sim_bdtypes[] = {
+	{ "A1535",  "24 Ch Neg. 3.5KV 3mA", 24,  3500.0f, 3000.0f, 500.0f },
+	{ "A1833B", "12 Ch Pos. 4KV 2mA",   12,  4000.0f, 2000.0f, 500.0f },
+	{ "A1526",  "6 Ch Neg. 15KV 1mA",    6, 15000.0f, 1000.0f, 500.0f },
+	{ "A1520P", "12 Ch Pos. 500V 15mA", 12,   500.0f, 15000.0f, 100.0f },
+	{ NULL }
+};
+
+#define CH_FIELD(m) ((int)offsetof(sim_ch_t, m))
+
+const sim_par_t sim_chpars[] = {
+	{ "V0Set",    PARAM_TYPE_NUMERIC,  PARAM_MODE_RDWR,   0.0f, SIM_LIM_VMAX,   PARAM_UN_VOLT,    0, NULL, NULL, CH_FIELD(v0Set) },
+	{ "I0Set",    PARAM_TYPE_NUMERIC,  PARAM_MODE_RDWR,   0.0f, SIM_LIM_IMAX,   PARAM_UN_AMPERE, -6, NULL, NULL, CH_FIELD(i0Set) },
+	{ "V1Set",    PARAM_TYPE_NUMERIC,  PARAM_MODE_RDWR,   0.0f, SIM_LIM_VMAX,   PARAM_UN_VOLT,    0, NULL, NULL, CH_FIELD(v1Set) },
+	{ "I1Set",    PARAM_TYPE_NUMERIC,  PARAM_MODE_RDWR,   0.0f, SIM_LIM_IMAX,   PARAM_UN_AMPERE, -6, NULL, NULL, CH_FIELD(i1Set) },
+	{ "RUp",      PARAM_TYPE_NUMERIC,  PARAM_MODE_RDWR,   1.0f, SIM_LIM_RAMP,   PARAM_UN_VPS,     0, NULL, NULL, CH_FIELD(rUp) },
+	{ "RDWn",     PARAM_TYPE_NUMERIC,  PARAM_MODE_RDWR,   1.0f, SIM_LIM_RAMP,   PARAM_UN_VPS,     0, NULL, NULL, CH_FIELD(rDwn) },
+	{ "Trip",     PARAM_TYPE_NUMERIC,  PARAM_MODE_RDWR,   0.0f, SIM_TRIP_NEVER, PARAM_UN_SECOND,  0, NULL, NULL, CH_FIELD(trip) },
+	{ "SVMax",    PARAM_TYPE_NUMERIC,  PARAM_MODE_RDWR,   0.0f, SIM_LIM_VMAX,   PARAM_UN_VOLT,    0, NULL, NULL, CH_FIELD(svMax) },
+	{ "VMon",     PARAM_TYPE_NUMERIC,  PARAM_MODE_RDONLY, 0.0f, SIM_LIM_VMAX,   PARAM_UN_VOLT,    0, NULL, NULL, -1 },
+	{ "IMon",     PARAM_TYPE_NUMERIC,  PARAM_MODE_RDONLY, 0.0f, SIM_LIM_IMAX,   PARAM_UN_AMPERE, -6, NULL, NULL, -1 },
+	{ "Pw",       PARAM_TYPE_ONOFF,    PARAM_MODE_RDWR,   0.0f, 1.0f, PARAM_UN_NONE, 0, "On",     "Off",     CH_FIELD(pw) },
+	{ "POn",      PARAM_TYPE_ONOFF,    PARAM_MODE_RDWR,   0.0f, 1.0f, PARAM_UN_NONE, 0, "Enable", "Disable", CH_FIELD(pOn) },
+	{ "PDwn",     PARAM_TYPE_ONOFF,    PARAM_MODE_RDWR,   0.0f, 1.0f, PARAM_UN_NONE, 0, "Ramp",   "Kill",    CH_FIELD(pDwn) },
+	{ "ChStatus", PARAM_TYPE_CHSTATUS, PARAM_MODE_RDONLY, 0.0f, 0.0f, PARAM_UN_NONE, 0, NULL, NULL, -1 }
+};
+const int sim_nChPars = sizeof(sim_chpars) / sizeof(sim_chpars[0]);
+
+const sim_par_t sim_bdpars[] = {
+	{ "BdStatus", PARAM_TYPE_BDSTATUS, PARAM_MODE_RDONLY, 0.0f, 0.0f,         PARAM_UN_NONE,    0, NULL, NULL, -1 },
+	{ "HVMax",    PARAM_TYPE_NUMERIC,  PARAM_MODE_RDONLY, 0.0f, SIM_LIM_VMAX, PARAM_UN_VOLT,    0, NULL, NULL, -1 },
+	{ "Temp",     PARAM_TYPE_NUMERIC,  PARAM_MODE_RDONLY, 0.0f, 100.0f,       PARAM_UN_CELSIUS, 0, NULL, NULL, -1 }
+};
+const int sim_nBdPars = sizeof(sim_bdpars) / sizeof(sim_bdpars[0]);
+
+static pthread_mutex_t	cratesLock = PTHREAD_MUTEX_INITIALIZER;
+static sim_crate_t		*crates;
+
+typedef struct {
+	char			magic[8];
+	char			crate[256];
+	int				nSlots;
+	int				size;				/* sizeof(sim_board_t), catches a rebuilt library */
+} sim_state_t;
+
+static unsigned env_u(const char *name, unsigned def)
+{
+	const char *v = getenv(name);
+
+	return (v != NULL && *v != '\0') ? (unsigned)strtoul(v, NULL, 0) : def;
+}
+
+static double env_d(const char *name, double def)
+{
+	const char *v = getenv(name);
+
+	return (v != NULL && *v != '\0') ? strtod(v, NULL) : def;
+}
+
+static const char *env_s(const char *name, const char *def)
+{
+	const char *v = getenv(name);
+
+	return (v != NULL && *v != '\0') ? v : def;
+}
+
+void sim_cfg_load(void)
+{
+	sim_cfg.crate       = env_s("SIMHV_CRATE", SIM_DEFAULT_CRATE);
+	sim_cfg.stateDir    = env_s("SIMHV_STATE", NULL);
+	sim_cfg.user        = env_s("SIMHV_USER", NULL);
+	sim_cfg.passwd      = env_s("SIMHV_PASSWD", NULL);
+	sim_cfg.latencyUs   = env_u("SIMHV_LATENCY_US", 0);
+	sim_cfg.jitterUs    = env_u("SIMHV_JITTER_US", 0);
+	sim_cfg.chUs        = env_u("SIMHV_CH_US", 0);
+	sim_cfg.loginUs     = env_u("SIMHV_LOGIN_US", 0);
+	sim_cfg.eventMs     = env_u("SIMHV_EVENT_MS", 100);
+	sim_cfg.failRate    = env_d("SIMHV_FAIL_RATE", 0.0);
+	sim_cfg.tripPerHour = env_d("SIMHV_TRIP_RATE", 0.0);
+	sim_cfg.vNoise      = env_d("SIMHV_VNOISE", 0.05);
+	sim_cfg.iNoise      = env_d("SIMHV_INOISE", 0.02);
+	sim_cfg.loadMOhm    = env_d("SIMHV_LOAD_MOHM", 1000.0);
+	sim_cfg.seed        = env_u("SIMHV_SEED", 1);
+	sim_cfg.nSlots      = (int)env_u("SIMHV_SLOTS", SIM_MAX_SLOTS);
+	sim_cfg.events      = (int)env_u("SIMHV_EVENTS", 1);
+	if(sim_cfg.nSlots < 1 || sim_cfg.nSlots > SIM_MAX_SLOTS)
+		sim_cfg.nSlots = SIM_MAX_SLOTS;
+	if(sim_cfg.eventMs == 0)
+		sim_cfg.eventMs = 100;
+}
+
+/* wall clock, so that a crate restored from SIMHV_STATE kept ramping */
+double sim_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* xorshift64* */
+static uint64_t sim_rand(uint64_t *rng)
+{
+	uint64_t x = *rng;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*rng = x;
+	return x * 2685821657736338717ULL;
+}
+
+double sim_uniform(uint64_t *rng)
+{
+	return (double)(sim_rand(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double sim_gauss(uint64_t *rng)
+{
+	double u1 = 1.0 - sim_uniform(rng), u2 = sim_uniform(rng);
+
+	return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static uint64_t hash_host(const char *s)
+{
+	uint64_t h = 1469598103934665603ULL;		/* FNV-1a */
+
+	for(; *s; s++)
+		h = (h ^ (unsigned char)*s) * 1099511628211ULL;
+	return h;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Crate construction and state file                                        */
+/*                                                                           */
+/*****************************************************************************/
+static void ch_defaults(sim_crate_t *c, const sim_bdtype_t *t, sim_ch_t *ch, int k, double now)
+{
+	memset(ch, 0, sizeof(*ch));
+	ch->v0Set = t->vMax < 1000.0f ? t->vMax : 1000.0f;
+	ch->i0Set = t->iMax < 100.0f ? t->iMax : 100.0f;
+	ch->i1Set = ch->i0Set;
+	ch->rUp   = 50.0f;
+	ch->rDwn  = 50.0f;
+	ch->trip  = 10.0f;
+	ch->svMax = t->vMax;
+	ch->pDwn  = 1;
+	snprintf(ch->name, sizeof(ch->name), "CHANNEL%02d", k);
+	ch->rLoad = sim_cfg.loadMOhm * (0.8 + 0.4 * sim_uniform(&c->rng));
+	ch->cLoad = 5.0 + 20.0 * sim_uniform(&c->rng);
+	ch->last  = now;
+}
+
+static int type_find(const char *model, size_t len)
+{
+	int i;
+
+	for(i = 0; sim_bdtypes[i].model != NULL; i++)
+		if(strlen(sim_bdtypes[i].model) == len && strncmp(sim_bdtypes[i].model, model, len) == 0)
+			return i;
+	return -1;
+}
+
+/* SIMHV_CRATE: "slot:model,slot:model,..." */
+static void crate_build(sim_crate_t *c, double now)
+{
+	const char	*p = sim_cfg.crate;
+	int			s, k;
+
+	c->nSlots = sim_cfg.nSlots;
+	for(s = 0; s < SIM_MAX_SLOTS; s++)
+		c->bd[s].type = -1;
+	while(*p != '\0') {
+		char		*end;
+		const char	*model;
+		size_t		len;
+		int			t;
+
+		s = (int)strtol(p, &end, 10);
+		if(end == p || *end != ':') {
+			fprintf(stderr, "hvsim: SIMHV_CRATE: expected slot:model at '%s'\n", p);
+			return;
+		}
+		model = end + 1;
+		len = strcspn(model, ",");
+		t = type_find(model, len);
+		if(t < 0 || s < 0 || s >= c->nSlots)
+			fprintf(stderr, "hvsim: SIMHV_CRATE: no %.*s board in slot %d\n", (int)len, model, s);
+		else {
+			sim_board_t *b = &c->bd[s];
+
+			b->type   = t;
+			b->serial = (unsigned short)(100 + (sim_rand(&c->rng) % 9000));
+			b->fwMax  = 2;
+			b->fwMin  = (unsigned char)(sim_rand(&c->rng) % 20);
+			b->hvMax  = sim_bdtypes[t].vMax;
+			for(k = 0; k < sim_bdtypes[t].nCh; k++)
+				ch_defaults(c, &sim_bdtypes[t], &b->ch[k], k, now);
+		}
+		p = model + len;
+		if(*p == ',')
+			p++;
+	}
+}
+
+static void state_path(const sim_crate_t *c, char *path, size_t len)
+{
+	char	host[SIM_HOST_LEN];
+	size_t	i;
+
+	for(i = 0; c->host[i] != '\0' && i < sizeof(host) - 1; i++)
+		host[i] = (c->host[i] == '/') ? '_' : c->host[i];
+	host[i] = '\0';
+	snprintf(path, len, "%s/%s.state", sim_cfg.stateDir, host);
+}
+
+static int state_load(sim_crate_t *c)
+{
+	char		path[1024];
+	sim_state_t	h;
+	FILE		*f;
+	int			ok;
+
+	state_path(c, path, sizeof(path));
+	if((f = fopen(path, "rb")) == NULL)
+		return 0;
+	ok = fread(&h, sizeof(h), 1, f) == 1
+	  && memcmp(h.magic, SIM_STATE_MAGIC, sizeof(h.magic)) == 0
+	  && strncmp(h.crate, sim_cfg.crate, sizeof(h.crate)) == 0
+	  && h.nSlots == sim_cfg.nSlots && h.size == (int)sizeof(sim_board_t)
+	  && fread(c->symName, sizeof(c->symName), 1, f) == 1
+	  && fread(c->bd, sizeof(c->bd), 1, f) == 1;
+	fclose(f);
+	if(ok)
+		c->nSlots = h.nSlots;
+	return ok;
+}
+
+void sim_crate_save(sim_crate_t *c)
+{
+	char		path[1024], tmp[1100];
+	sim_state_t	h;
+	FILE		*f;
+	int			ok;
+
+	if(sim_cfg.stateDir == NULL)
+		return;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, SIM_STATE_MAGIC, sizeof(h.magic));
+	strncpy(h.crate, sim_cfg.crate, sizeof(h.crate) - 1);
+	h.nSlots = c->nSlots;
+	h.size = (int)sizeof(sim_board_t);
+
+	state_path(c, path, sizeof(path));
+	snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+	if((f = fopen(tmp, "wb")) == NULL) {
+		fprintf(stderr, "hvsim: cannot write %s\n", tmp);
+		return;
+	}
+	pthread_mutex_lock(&c->lock);
+	ok = fwrite(&h, sizeof(h), 1, f) == 1
+	  && fwrite(c->symName, sizeof(c->symName), 1, f) == 1
+	  && fwrite(c->bd, sizeof(c->bd), 1, f) == 1;
+	pthread_mutex_unlock(&c->lock);
+	if(fclose(f) != 0 || !ok || rename(tmp, path) != 0) {
+		fprintf(stderr, "hvsim: cannot write %s\n", path);
+		unlink(tmp);
+	}
+}
+
+sim_crate_t *sim_crate_get(const char *host)
+{
+	sim_crate_t *c;
+
+	pthread_mutex_lock(&cratesLock);
+	for(c = crates; c != NULL; c = c->next)
+		if(strcmp(c->host, host) == 0)
+			break;
+	if(c == NULL && (c = (sim_crate_t *)calloc(1, sizeof(sim_crate_t))) != NULL) {
+		strncpy(c->host, host, sizeof(c->host) - 1);
+		pthread_mutex_init(&c->lock, NULL);
+		c->rng = (sim_cfg.seed ^ hash_host(c->host)) | 1;
+		c->latencyUs = sim_cfg.latencyUs;
+		snprintf(c->symName, sizeof(c->symName), "%.*s", (int)sizeof(c->symName) - 1, c->host);
+		if(sim_cfg.stateDir == NULL || !state_load(c))
+			crate_build(c, sim_now());
+		c->next = crates;
+		crates = c;
+	}
+	pthread_mutex_unlock(&cratesLock);
+	return c;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Channel physics                                                          */
+/*                                                                           */
+/*****************************************************************************/
+static float par_max(const sim_par_t *p, const sim_board_t *b)
+{
+	const sim_bdtype_t *t = &sim_bdtypes[b->type];
+
+	if(p->max == SIM_LIM_VMAX) return t->vMax;
+	if(p->max == SIM_LIM_IMAX) return t->iMax;
+	if(p->max == SIM_LIM_RAMP) return t->rampMax;
+	return p->max;
+}
+
+static void ch_step(sim_crate_t *c, sim_board_t *b, sim_ch_t *ch, double now)
+{
+	double	prev = ch->last, dt = now - prev, limit, target, v, iLoad;
+	int		overI, spark;
+
+	if(dt <= 0.0)
+		return;
+	ch->last = now;
+
+	/* a discharge starting somewhere in the step */
+	if(ch->pw && sim_cfg.tripPerHour > 0.0 && now >= ch->sparkUntil
+	&& sim_uniform(&c->rng) < 1.0 - exp(-sim_cfg.tripPerHour * dt / 3600.0)) {
+		double start = prev + sim_uniform(&c->rng) * dt;
+
+		ch->sparkUntil = start + (ch->trip < SIM_TRIP_NEVER ? ch->trip : 1.0) + 0.5;
+		if(ch->overSince == 0.0)
+			ch->overSince = start;
+	}
+
+	limit = ch->svMax < b->hvMax ? ch->svMax : b->hvMax;
+	target = ch->pw ? (ch->v0Set < limit ? ch->v0Set : limit) : 0.0;
+	v = ch->vOut;
+	if(v < target)
+		v = (v + ch->rUp * dt < target) ? v + ch->rUp * dt : target;
+	else if(v > target)
+		v = (v - ch->rDwn * dt > target) ? v - ch->rDwn * dt : target;
+	ch->dvdt = (v - ch->vOut) / dt;
+	ch->vOut = v;
+
+	/* uA: V / MOhm, plus nF * V/s = nA */
+	iLoad = ch->vOut / ch->rLoad + ch->cLoad * ch->dvdt * 1e-3;
+	if(iLoad < 0.0) iLoad = 0.0;
+	overI = ch->pw && iLoad > ch->i0Set;
+	spark = ch->pw && now < ch->sparkUntil;
+	ch->iOut = iLoad;
+	if(overI) {							/* current limit: the output sags */
+		ch->vOut = ch->i0Set * ch->rLoad;
+		ch->iOut = ch->i0Set;
+		if(ch->overSince == 0.0)
+			ch->overSince = now;
+	}
+	if(spark)
+		ch->iOut = ch->i0Set;
+
+	if(ch->pw && ch->overSince != 0.0 && ch->trip < SIM_TRIP_NEVER) {
+		double end = (overI || spark) ? now : ch->sparkUntil;
+
+		if(end - ch->overSince >= ch->trip) {
+			ch->pw = 0;
+			ch->vOut = ch->iOut = ch->dvdt = 0.0;
+			ch->status |= SIM_CHS_INTTRIP;
+			overI = spark = 0;
+			target = 0.0;
+		}
+	}
+	if(!overI && !spark)
+		ch->overSince = 0.0;
+
+	ch->status &= SIM_CHS_INTTRIP;			/* latched until Pw On or ClearAlarm */
+	if(ch->pw)
+		ch->status |= SIM_CHS_ON;
+	if(ch->vOut < target - 0.01 && !overI)
+		ch->status |= SIM_CHS_RUP;
+	if(ch->vOut > target + 0.01)
+		ch->status |= SIM_CHS_RDW;
+	if(overI || spark)
+		ch->status |= SIM_CHS_OVC;
+	if(overI && !(ch->status & SIM_CHS_RUP))
+		ch->status |= SIM_CHS_UNV;
+	if(ch->pw && ch->v0Set > limit)
+		ch->status |= SIM_CHS_MAXV;
+}
+
+CAENHVRESULT sim_locate(sim_crate_t *c, unsigned short slot, int nCh, const unsigned short *chList)
+{
+	int i;
+
+	if(slot >= c->nSlots || c->bd[slot].type < 0)
+		return CAENHV_SLOTNOTPRES;
+	for(i = 0; i < nCh; i++)
+		if(chList[i] >= sim_bdtypes[c->bd[slot].type].nCh)
+			return CAENHV_OUTOFRANGE;
+	return CAENHV_OK;
+}
+
+const sim_par_t *sim_par_find(const sim_par_t *list, int n, const char *name)
+{
+	int i;
+
+	for(i = 0; i < n; i++)
+		if(strcmp(list[i].name, name) == 0)
+			return &list[i];
+	return NULL;
+}
+
+CAENHVRESULT sim_ch_read(sim_crate_t *c, unsigned short slot, unsigned short ch,
+                         const sim_par_t *p, void *val, int noisy, double now)
+{
+	sim_board_t	*b = &c->bd[slot];
+	sim_ch_t	*cp = &b->ch[ch];
+	double		x;
+
+	ch_step(c, b, cp, now);
+	if(p->field >= 0) {
+		memcpy(val, (const char *)cp + p->field, sizeof(float));	/* float or unsigned */
+		return CAENHV_OK;
+	}
+	if(p->type == PARAM_TYPE_CHSTATUS) {
+		*(unsigned *)val = cp->status;
+		return CAENHV_OK;
+	}
+	if(p->unit == PARAM_UN_VOLT) {
+		x = cp->vOut;
+		if(noisy)
+			x = fabs(x + sim_cfg.vNoise * sim_gauss(&c->rng));
+	} else {
+		x = cp->iOut;
+		if(noisy)
+			x += sim_cfg.iNoise * sim_gauss(&c->rng);
+	}
+	*(float *)val = (float)x;
+	return CAENHV_OK;
+}
+
+CAENHVRESULT sim_ch_write(sim_crate_t *c, unsigned short slot, unsigned short ch,
+                          const sim_par_t *p, const void *val, double now)
+{
+	sim_board_t	*b = &c->bd[slot];
+	sim_ch_t	*cp = &b->ch[ch];
+
+	if(p->mode == PARAM_MODE_RDONLY || p->field < 0)
+		return CAENHV_NOTSETPROP;
+	if(p->type == PARAM_TYPE_NUMERIC) {
+		float v = *(const float *)val;
+
+		if(!(v >= p->min && v <= par_max(p, b)))
+			return CAENHV_OUTOFRANGE;
+	} else if(*(const unsigned *)val > 1)
+		return CAENHV_OUTOFRANGE;
+
+	ch_step(c, b, cp, now);
+	if(p->field == CH_FIELD(pw)) {
+		unsigned on = *(const unsigned *)val;
+
+		if(on && !cp->pw)
+			cp->status &= ~SIM_CHS_INTTRIP;
+		if(!on && cp->pw && cp->pDwn == 0) {	/* PDwn Kill */
+			cp->vOut = cp->iOut = 0.0;
+			cp->overSince = cp->sparkUntil = 0.0;
+		}
+	}
+	memcpy((char *)cp + p->field, val, sizeof(float));
+	ch_step(c, b, cp, now + 1e-6);			/* status reflects the new setting */
+	return CAENHV_OK;
+}
+
+CAENHVRESULT sim_bd_read(sim_crate_t *c, unsigned short slot, const sim_par_t *p,
+                         void *val, int noisy, double now)
+{
+	sim_board_t	*b = &c->bd[slot];
+	int			k, on = 0;
+	double		temp;
+
+	if(p->type == PARAM_TYPE_BDSTATUS) {
+		*(unsigned *)val = 0;
+		return CAENHV_OK;
+	}
+	if(strcmp(p->name, "HVMax") == 0) {
+		*(float *)val = b->hvMax;
+		return CAENHV_OK;
+	}
+	for(k = 0; k < sim_bdtypes[b->type].nCh; k++) {
+		ch_step(c, b, &b->ch[k], now);
+		on += b->ch[k].pw != 0;
+	}
+	temp = 28.0 + 0.2 * on;
+	if(noisy)
+		temp += 0.1 * sim_gauss(&c->rng);
+	*(float *)val = (float)temp;
+	return CAENHV_OK;
+}
+
+CAENHVRESULT sim_prop(const sim_crate_t *c, unsigned short slot, const sim_par_t *p,
+                      const char *prop, void *ret)
+{
+	if(strcmp(prop, "Type") == 0)
+		*(unsigned *)ret = p->type;
+	else if(strcmp(prop, "Mode") == 0)
+		*(unsigned *)ret = p->mode;
+	else if(p->type == PARAM_TYPE_NUMERIC && strcmp(prop, "Minval") == 0)
+		*(float *)ret = p->min;
+	else if(p->type == PARAM_TYPE_NUMERIC && strcmp(prop, "Maxval") == 0)
+		*(float *)ret = par_max(p, &c->bd[slot]);
+	else if(p->type == PARAM_TYPE_NUMERIC && strcmp(prop, "Unit") == 0)
+		*(unsigned short *)ret = p->unit;
+	else if(p->type == PARAM_TYPE_NUMERIC && strcmp(prop, "Exp") == 0)
+		*(short *)ret = p->exp;
+	else if(p->type == PARAM_TYPE_ONOFF && strcmp(prop, "Onstate") == 0)
+		strcpy((char *)ret, p->on);
+	else if(p->type == PARAM_TYPE_ONOFF && strcmp(prop, "Offstate") == 0)
+		strcpy((char *)ret, p->off);
+	else
+		return CAENHV_PARAMPROPNOTFOUND;
+	return CAENHV_OK;
+}
+
+/* Kill, ClearAlarm and the simulator's own SimReset */
+CAENHVRESULT sim_exec(sim_crate_t *c, const char *comm, double now)
+{
+	int s, k;
+
+	if(strcmp(comm, "Kill") != 0 && strcmp(comm, "ClearAlarm") != 0 && strcmp(comm, "SimReset") != 0)
+		return CAENHV_EXECNOTFOUND;
+	if(strcmp(comm, "SimReset") == 0) {
+		crate_build(c, now);
+		return CAENHV_OK;
+	}
+	for(s = 0; s < c->nSlots; s++) {
+		sim_board_t *b = &c->bd[s];
+
+		if(b->type < 0)
+			continue;
+		for(k = 0; k < sim_bdtypes[b->type].nCh; k++) {
+			sim_ch_t *cp = &b->ch[k];
+
+			ch_step(c, b, cp, now);
+			if(comm[0] == 'K') {
+				cp->pw = 0;
+				cp->vOut = cp->iOut = cp->dvdt = 0.0;
+				cp->overSince = cp->sparkUntil = 0.0;
+				cp->status &= SIM_CHS_INTTRIP;
+			} else
+				cp->status &= ~SIM_CHS_INTTRIP;
+		}
+	}
+	return CAENHV_OK;
+}
@@ -0,0 +1,152 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   SIMMODEL.H                                                              */
+/*                                                                           */
+/*   Model of the simulated HV mainframe: the boards of a crate, the         */
+/*   settings of their channels and the physics that moves VMon, IMon and    */
+/*   ChStatus between two calls. Everything here runs under crate->lock.     */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef __SIMMODEL_H
+#define __SIMMODEL_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "CAENHVWrapper.h"
+
+#define SIM_MAX_SLOTS      16
+#define SIM_MAX_CH         48
+#define SIM_HOST_LEN       64
+#define SIM_NAME_LEN       32
+#define SIM_DEFAULT_CRATE  "1:A1535,3:A1833B"
+#define SIM_TRIP_NEVER     (1000.0f)		/* Trip at full scale: no trip */
+
+/* ChStatus bits, as the SY2527 reports them */
+#define SIM_CHS_ON         (1u << 0)
+#define SIM_CHS_RUP        (1u << 1)
+#define SIM_CHS_RDW        (1u << 2)
+#define SIM_CHS_OVC        (1u << 3)
+#define SIM_CHS_OVV        (1u << 4)
+#define SIM_CHS_UNV        (1u << 5)
+#define SIM_CHS_EXTTRIP    (1u << 6)
+#define SIM_CHS_MAXV       (1u << 7)
+#define SIM_CHS_EXTDIS     (1u << 8)
+#define SIM_CHS_INTTRIP    (1u << 9)
+
+/* BdStatus bits */
+#define SIM_BDS_PWFAIL     (1u << 0)
+#define SIM_BDS_OVERTEMP   (1u << 5)
+
+/* a 'max' below zero in a sim_par_t is taken from the board */
+#define SIM_LIM_VMAX       (-1.0f)
+#define SIM_LIM_IMAX       (-2.0f)
+#define SIM_LIM_RAMP       (-3.0f)
+
+typedef struct {
+	const char		*model, *desc;
+	int				nCh;
+	float			vMax;				/* V */
+	float			iMax;				/* uA */
+	float			rampMax;			/* V/s */
+} sim_bdtype_t;
+
+typedef struct {
+	const char		*name;
+	unsigned		type, mode;
+	float			min, max;
+	unsigned short	unit;
+	short			exp;
+	const char		*on, *off;			/* PARAM_TYPE_ONOFF only */
+	int				field;				/* offset of the setting in sim_ch_t, -1 = computed */
+} sim_par_t;
+
+typedef struct {
+	/* settings */
+	float			v0Set, i0Set, v1Set, i1Set, rUp, rDwn, trip, svMax;
+	unsigned		pw, pOn, pDwn;		/* pDwn: 0 = Kill, 1 = Ramp */
+	char			name[MAX_CH_NAME];
+	/* physics */
+	double			vOut;				/* V, without the noise of VMon */
+	double			iOut;				/* uA, without the noise of IMon */
+	double			dvdt;				/* V/s during the last step */
+	double			overSince;			/* model time IMon went above I0Set, 0 = below */
+	double			sparkUntil;			/* a discharge holds IMon at I0Set until then */
+	double			rLoad;				/* MOhm */
+	double			cLoad;				/* nF */
+	double			last;				/* model time of the last step */
+	unsigned		status;
+} sim_ch_t;
+
+typedef struct {
+	int				type;				/* index in sim_bdtypes, -1 = empty slot */
+	unsigned short	serial;
+	unsigned char	fwMin, fwMax;
+	float			hvMax;				/* front panel trimmer */
+	sim_ch_t		ch[SIM_MAX_CH];
+} sim_board_t;
+
+typedef struct sim_crate {
+	char			host[SIM_HOST_LEN];
+	pthread_mutex_t	lock;
+	int				nSlots;
+	sim_board_t		bd[SIM_MAX_SLOTS];
+	char			symName[SIM_NAME_LEN];
+	unsigned		latencyUs;			/* SimLatency system property */
+	int				sessions;
+	uint64_t		rng;				/* noise and discharges */
+	struct sim_crate *next;
+} sim_crate_t;
+
+/* read once from the SIMHV_* environment variables */
+typedef struct {
+	const char		*crate, *stateDir, *user, *passwd;
+	unsigned		latencyUs, jitterUs, chUs, loginUs, eventMs;
+	double			failRate, tripPerHour, vNoise, iNoise, loadMOhm;
+	uint64_t		seed;
+	int				nSlots, events;
+} sim_cfg_t;
+
+extern sim_cfg_t			sim_cfg;
+extern const sim_bdtype_t	sim_bdtypes[];
+extern const sim_par_t		sim_chpars[];
+extern const sim_par_t		sim_bdpars[];
+extern const int			sim_nChPars, sim_nBdPars;
+
+void sim_cfg_load(void);
+double sim_now(void);
+double sim_uniform(uint64_t *rng);
+double sim_gauss(uint64_t *rng);
+
+/***------------------------------------------------------------------------
+
+  sim_crate_get
+  The crate behind 'host', built from SIMHV_CRATE the first time it is
+  asked for (or restored from SIMHV_STATE). Crates live as long as the
+  process: a new login finds the channels where the last one left them.
+  Return value:
+    the crate, NULL when out of memory
+
+    --------------------------------------------------------------------***/
+sim_crate_t *sim_crate_get(const char *host);
+
+/* writes the crate to SIMHV_STATE, if set; takes crate->lock */
+void sim_crate_save(sim_crate_t *c);
+
+const sim_par_t *sim_par_find(const sim_par_t *list, int n, const char *name);
+
+/* CAENHV_OK, CAENHV_SLOTNOTPRES or CAENHV_OUTOFRANGE */
+CAENHVRESULT sim_locate(sim_crate_t *c, unsigned short slot, int nCh, const unsigned short *chList);
+
+CAENHVRESULT sim_ch_read(sim_crate_t *c, unsigned short slot, unsigned short ch,
+                         const sim_par_t *p, void *val, int noisy, double now);
+CAENHVRESULT sim_ch_write(sim_crate_t *c, unsigned short slot, unsigned short ch,
+                          const sim_par_t *p, const void *val, double now);
+CAENHVRESULT sim_bd_read(sim_crate_t *c, unsigned short slot, const sim_par_t *p,
+                         void *val, int noisy, double now);
+CAENHVRESULT sim_prop(const sim_crate_t *c, unsigned short slot, const sim_par_t *p,
+                      const char *prop, void *ret);
+CAENHVRESULT sim_exec(sim_crate_t *c, const char *comm, double now);
+
+#endif // __SIMMODEL_H
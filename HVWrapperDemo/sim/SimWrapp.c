@@ -0,0 +1,986 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   SIMWRAPP.C                                                              */
+/*                                                                           */
+/*   CAENHVWrapper API over the crate model of SimModel.c, built as a        */
+/*   libcaenhvwrapper.so stand-in by 'make sim'. Every call that would go   */
+/*   to the crate waits SIMHV_LATENCY_US, plus an exponential tail of mean  */
+/*   SIMHV_JITTER_US and SIMHV_CH_US per listed channel, holding its handle */
+/*   the way one TCP connection serialises the requests of a session.       */
+/*   Subscribed parameters are sent as UDP datagrams to 127.0.0.1:Port by  */
+/*   one thread every SIMHV_EVENT_MS, when they changed, with a keepalive   */
+/*   per port every second; CAENHV_GetEventData decodes them.               */
+/*                                                                           */
+/*****************************************************************************/
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "CAENHVWrapper.h"
+#include "SimModel.h"
+
+#define SIM_REL              "6.6-sim"
+#define SIM_MAX_HANDLES      64
+#define SIM_EV_MAGIC         "HVSIMEV1"
+#define SIM_EV_PER_DGRAM     120
+#define SIM_KEEPALIVE_MS     1000
+#define SIM_EV_DB_VOLT       (0.1f)			/* VMon events below this are not sent */
+#define SIM_EV_DB_AMPERE     (0.01f)
+
+typedef struct {
+	int				used;
+	sim_crate_t		*crate;
+	pthread_mutex_t	io;					/* one request at a time, as on the link */
+	uint64_t		rng;				/* latency and injected failures */
+	char			err[128];
+} sim_handle_t;
+
+/* a subscribed item: slot and ch are -1 for system and board parameters */
+typedef struct sim_sub {
+	int				handle;
+	unsigned short	port;
+	sim_crate_t		*crate;
+	int				slot, ch;
+	char			par[MAX_PARAM_NAME];
+	int				primed;
+	union { float f; unsigned u; char s[32]; } last;
+	struct sim_sub	*next;
+} sim_sub_t;
+
+/* what travels in a datagram; 'v' lands in IDValue_t as it is */
+typedef struct {
+	int32_t			type, handle, board, channel;
+	char			item[20];
+	union { float f; int32_t i; char s[32]; } v;
+} sim_ev_rec_t;
+
+typedef struct {
+	char			magic[8];
+	uint32_t		count;
+	sim_ev_rec_t	rec[SIM_EV_PER_DGRAM];
+} sim_ev_dgram_t;
+
+static pthread_once_t	cfgOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t	handlesLock = PTHREAD_MUTEX_INITIALIZER;
+static sim_handle_t		handles[SIM_MAX_HANDLES];
+static char				initErr[128] = "No error";
+
+static pthread_mutex_t	subsLock = PTHREAD_MUTEX_INITIALIZER;
+static sim_sub_t		*subs;
+static int				evThreadUp;
+
+static const char *sysProps[] = { "ModelName", "SwRelease", "IPAddr", "SymbolicName", "Sessions", "SimLatency" };
+static const unsigned sysPropType[] = { SYSPROP_TYPE_STR, SYSPROP_TYPE_STR, SYSPROP_TYPE_STR,
+                                        SYSPROP_TYPE_STR, SYSPROP_TYPE_UINT2, SYSPROP_TYPE_UINT4 };
+static const unsigned sysPropMode[] = { SYSPROP_MODE_RDONLY, SYSPROP_MODE_RDONLY, SYSPROP_MODE_RDONLY,
+                                        SYSPROP_MODE_RDWR, SYSPROP_MODE_RDONLY, SYSPROP_MODE_RDWR };
+#define SIM_NSYSPROPS ((int)(sizeof(sysProps) / sizeof(sysProps[0])))
+
+static const char *execComms[] = { "Kill", "ClearAlarm", "SimReset" };
+#define SIM_NCOMMS ((int)(sizeof(execComms) / sizeof(execComms[0])))
+
+static const char *err_text(CAENHVRESULT ret)
+{
+	switch(ret) {
+	case CAENHV_OK:					return "Command wrapper correctly executed";
+	case CAENHV_TIMEERR:			return "Time out in server communication";
+	case CAENHV_SLOTNOTPRES:		return "Communication with a not present board/slot";
+	case CAENHV_MEMORYFAULT:		return "User memory not sufficient";
+	case CAENHV_OUTOFRANGE:			return "Value out of range";
+	case CAENHV_PROPNOTFOUND:		return "Property not found";
+	case CAENHV_EXECNOTFOUND:		return "Execute command not found";
+	case CAENHV_NOTSETPROP:			return "No set property";
+	case CAENHV_PARAMPROPNOTFOUND:	return "Property of param not found";
+	case CAENHV_PARAMNOTFOUND:		return "Param not found";
+	case CAENHV_INVALIDPARAMETER:	return "Function Parameter not valid";
+	case CAENHV_FUNCTIONNOTAVAILABLE: return "Function not available for the connected device";
+	case CAENHV_SOCKETERROR:		return "Socket error";
+	case CAENHV_NOTCONNECTED:		return "Device not connected";
+	case CAENHV_LOGINFAILED:		return "Login failed";
+	case CAENHV_USERPASSFAILED:		return "Login failed for username/password";
+	case CAENHV_TOOMANYDEVICEOPEN:	return "Too many devices opened";
+	default:						return "Simulator error";
+	}
+}
+
+static void cfg_once(void)
+{
+	sim_cfg_load();
+}
+
+static void sleep_us(double us)
+{
+	struct timespec ts;
+
+	if(us <= 0.0)
+		return;
+	ts.tv_sec = (time_t)(us / 1e6);
+	ts.tv_nsec = (long)((us - (double)ts.tv_sec * 1e6) * 1e3);
+	while(nanosleep(&ts, &ts) != 0 && errno == EINTR)
+		;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  SIM_ENTER / SIM_LEAVE                                                    */
+/*  Bracket every call that goes to the crate: the handle is held for the   */
+/*  simulated round trip, which may end in an injected CAENHV_TIMEERR.       */
+/*                                                                           */
+/*****************************************************************************/
+static sim_handle_t *sim_enter(int handle, unsigned nItems, CAENHVRESULT *ret)
+{
+	sim_handle_t	*h;
+	double			us;
+
+	if(handle < 0 || handle >= SIM_MAX_HANDLES || !handles[handle].used) {
+		*ret = CAENHV_NOTCONNECTED;
+		return NULL;
+	}
+	h = &handles[handle];
+	pthread_mutex_lock(&h->io);
+	us = (double)h->crate->latencyUs + (double)sim_cfg.chUs * nItems;
+	if(sim_cfg.jitterUs > 0)
+		us -= (double)sim_cfg.jitterUs * log(1.0 - sim_uniform(&h->rng));
+	sleep_us(us);
+	*ret = (sim_cfg.failRate > 0.0 && sim_uniform(&h->rng) < sim_cfg.failRate) ? CAENHV_TIMEERR : CAENHV_OK;
+	return h;
+}
+
+static CAENHVRESULT sim_leave(sim_handle_t *h, CAENHVRESULT ret)
+{
+	snprintf(h->err, sizeof(h->err), "%s", err_text(ret));
+	pthread_mutex_unlock(&h->io);
+	return ret;
+}
+
+char *CAENHVLibSwRel(void)
+{
+	return SIM_REL;
+}
+
+char *CAENHV_GetError(int handle)
+{
+	if(handle < 0 || handle >= SIM_MAX_HANDLES || !handles[handle].used)
+		return initErr;
+	return handles[handle].err;
+}
+
+CAENHVRESULT CAENHV_Free(void *arg)
+{
+	free(arg);
+	return CAENHV_OK;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Sessions                                                                 */
+/*                                                                           */
+/*****************************************************************************/
+CAENHVRESULT CAENHV_InitSystem(CAENHV_SYSTEM_TYPE_t system, int LinkType, void *Arg,
+                               const char *UserName, const char *Passwd, int *handle)
+{
+	const char		*host = (LinkType == LINKTYPE_TCPIP && Arg != NULL) ? (const char *)Arg : "local";
+	sim_crate_t		*c;
+	int				i;
+
+	(void)system;						/* every system type is the same crate */
+	pthread_once(&cfgOnce, cfg_once);
+	sleep_us((double)sim_cfg.loginUs);
+	if((sim_cfg.user != NULL && (UserName == NULL || strcmp(UserName, sim_cfg.user) != 0))
+	|| (sim_cfg.passwd != NULL && (Passwd == NULL || strcmp(Passwd, sim_cfg.passwd) != 0))) {
+		snprintf(initErr, sizeof(initErr), "%s", err_text(CAENHV_USERPASSFAILED));
+		return CAENHV_USERPASSFAILED;
+	}
+	if((c = sim_crate_get(host)) == NULL) {
+		snprintf(initErr, sizeof(initErr), "%s", err_text(CAENHV_MEMORYFAULT));
+		return CAENHV_MEMORYFAULT;
+	}
+
+	pthread_mutex_lock(&handlesLock);
+	for(i = 0; i < SIM_MAX_HANDLES && handles[i].used; i++)
+		;
+	if(i == SIM_MAX_HANDLES) {
+		pthread_mutex_unlock(&handlesLock);
+		snprintf(initErr, sizeof(initErr), "%s", err_text(CAENHV_TOOMANYDEVICEOPEN));
+		return CAENHV_TOOMANYDEVICEOPEN;
+	}
+	memset(&handles[i], 0, sizeof(handles[i]));
+	pthread_mutex_init(&handles[i].io, NULL);
+	handles[i].crate = c;
+	handles[i].rng = (sim_cfg.seed * 0x9E3779B97F4A7C15ULL + (uint64_t)i) | 1;
+	snprintf(handles[i].err, sizeof(handles[i].err), "%s", err_text(CAENHV_OK));
+	handles[i].used = 1;
+	pthread_mutex_unlock(&handlesLock);
+
+	pthread_mutex_lock(&c->lock);
+	c->sessions++;
+	pthread_mutex_unlock(&c->lock);
+	*handle = i;
+	return CAENHV_OK;
+}
+
+CAENHVRESULT CAENHV_DeinitSystem(int handle)
+{
+	sim_handle_t	*h;
+	sim_sub_t		**pp;
+	CAENHVRESULT	ret;
+
+	if((h = sim_enter(handle, 0, &ret)) == NULL)
+		return ret;
+	pthread_mutex_lock(&subsLock);
+	for(pp = &subs; *pp != NULL; ) {
+		sim_sub_t *d = *pp;
+
+		if(d->handle == handle) {
+			*pp = d->next;
+			free(d);
+		} else
+			pp = &d->next;
+	}
+	pthread_mutex_unlock(&subsLock);
+
+	pthread_mutex_lock(&h->crate->lock);
+	h->crate->sessions--;
+	pthread_mutex_unlock(&h->crate->lock);
+	sim_crate_save(h->crate);
+
+	pthread_mutex_lock(&handlesLock);
+	h->used = 0;
+	pthread_mutex_unlock(&handlesLock);
+	pthread_mutex_unlock(&h->io);
+	return CAENHV_OK;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Crate map and boards                                                     */
+/*                                                                           */
+/*****************************************************************************/
+CAENHVRESULT CAENHV_GetCrateMap(int handle, ushort *NrOfSlot, ushort **NrofChList, char **ModelList,
+                                char **DescriptionList, ushort **SerNumList, uchar **FmwRelMinList,
+                                uchar **FmwRelMaxList)
+{
+	sim_handle_t	*h;
+	sim_crate_t		*c;
+	CAENHVRESULT	ret;
+	char			*m, *d;
+	int				s;
+
+	if((h = sim_enter(handle, 0, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	c = h->crate;
+	*NrofChList = (ushort *)calloc((size_t)c->nSlots, sizeof(ushort));
+	*SerNumList = (ushort *)calloc((size_t)c->nSlots, sizeof(ushort));
+	*FmwRelMinList = (uchar *)calloc((size_t)c->nSlots, 1);
+	*FmwRelMaxList = (uchar *)calloc((size_t)c->nSlots, 1);
+	*ModelList = m = (char *)calloc((size_t)c->nSlots, MAX_BOARD_NAME);
+	*DescriptionList = d = (char *)calloc((size_t)c->nSlots, MAX_BOARD_DESC);
+	if(*NrofChList == NULL || *SerNumList == NULL || *FmwRelMinList == NULL
+	|| *FmwRelMaxList == NULL || m == NULL || d == NULL) {
+		free(*NrofChList); free(*SerNumList); free(*FmwRelMinList);
+		free(*FmwRelMaxList); free(m); free(d);
+		return sim_leave(h, CAENHV_MEMORYFAULT);
+	}
+	*NrOfSlot = (ushort)c->nSlots;
+	pthread_mutex_lock(&c->lock);
+	for(s = 0; s < c->nSlots; s++) {
+		const sim_board_t *b = &c->bd[s];
+
+		if(b->type >= 0) {
+			(*NrofChList)[s] = (ushort)sim_bdtypes[b->type].nCh;
+			(*SerNumList)[s] = b->serial;
+			(*FmwRelMinList)[s] = b->fwMin;
+			(*FmwRelMaxList)[s] = b->fwMax;
+			strcpy(m, sim_bdtypes[b->type].model);
+			strcpy(d, sim_bdtypes[b->type].desc);
+		}
+		m += strlen(m) + 1;				/* NUL separated, "" for an empty slot */
+		d += strlen(d) + 1;
+	}
+	pthread_mutex_unlock(&c->lock);
+	return sim_leave(h, CAENHV_OK);
+}
+
+CAENHVRESULT CAENHV_TestBdPresence(int handle, ushort slot, ushort *NrofCh, char **Model, char **Description,
+                                   ushort *SerNum, uchar *FmwRelMin, uchar *FmwRelMax)
+{
+	sim_handle_t	*h;
+	sim_crate_t		*c;
+	CAENHVRESULT	ret;
+
+	if((h = sim_enter(handle, 0, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	c = h->crate;
+	if((ret = sim_locate(c, slot, 0, NULL)) == CAENHV_OK) {
+		const sim_board_t *b = &c->bd[slot];
+
+		*NrofCh = (ushort)sim_bdtypes[b->type].nCh;
+		*SerNum = b->serial;
+		*FmwRelMin = b->fwMin;
+		*FmwRelMax = b->fwMax;
+		if(Model != NULL && *Model != NULL)
+			strcpy(*Model, sim_bdtypes[b->type].model);
+		if(Description != NULL && *Description != NULL)
+			strcpy(*Description, sim_bdtypes[b->type].desc);
+	}
+	return sim_leave(h, ret);
+}
+
+/* ParNameList layout of the library: char[MAX_PARAM_NAME] entries ending with "" */
+static char *par_names(const sim_par_t *list, int n)
+{
+	char	*names = (char *)calloc((size_t)n + 1, MAX_PARAM_NAME);
+	int		i;
+
+	if(names != NULL)
+		for(i = 0; i < n; i++)
+			strncpy(names + i * MAX_PARAM_NAME, list[i].name, MAX_PARAM_NAME - 1);
+	return names;
+}
+
+CAENHVRESULT CAENHV_GetBdParamInfo(int handle, ushort slot, char **ParNameList)
+{
+	sim_handle_t	*h;
+	CAENHVRESULT	ret;
+
+	if((h = sim_enter(handle, 0, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	if((ret = sim_locate(h->crate, slot, 0, NULL)) == CAENHV_OK
+	&& (*ParNameList = par_names(sim_bdpars, sim_nBdPars)) == NULL)
+		ret = CAENHV_MEMORYFAULT;
+	return sim_leave(h, ret);
+}
+
+CAENHVRESULT CAENHV_GetBdParamProp(int handle, ushort slot, const char *ParName, const char *PropName, void *retval)
+{
+	sim_handle_t	*h;
+	const sim_par_t	*p;
+	CAENHVRESULT	ret;
+
+	if((h = sim_enter(handle, 0, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	if((ret = sim_locate(h->crate, slot, 0, NULL)) == CAENHV_OK) {
+		if((p = sim_par_find(sim_bdpars, sim_nBdPars, ParName)) == NULL)
+			ret = CAENHV_PARAMNOTFOUND;
+		else
+			ret = sim_prop(h->crate, slot, p, PropName, retval);
+	}
+	return sim_leave(h, ret);
+}
+
+CAENHVRESULT CAENHV_GetBdParam(int handle, ushort slotNum, const ushort *slotList, const char *ParName,
+                               void *ParValList)
+{
+	sim_handle_t	*h;
+	const sim_par_t	*p;
+	CAENHVRESULT	ret;
+	double			now = sim_now();
+	int				i;
+
+	if((h = sim_enter(handle, slotNum, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	if((p = sim_par_find(sim_bdpars, sim_nBdPars, ParName)) == NULL)
+		return sim_leave(h, CAENHV_PARAMNOTFOUND);
+	for(i = 0; i < slotNum && ret == CAENHV_OK; i++)
+		ret = sim_locate(h->crate, slotList[i], 0, NULL);
+	pthread_mutex_lock(&h->crate->lock);
+	for(i = 0; i < slotNum && ret == CAENHV_OK; i++)
+		ret = sim_bd_read(h->crate, slotList[i], p, (char *)ParValList + 4 * i, 1, now);
+	pthread_mutex_unlock(&h->crate->lock);
+	return sim_leave(h, ret);
+}
+
+CAENHVRESULT CAENHV_SetBdParam(int handle, ushort slotNum, const ushort *slotList, const char *ParName,
+                               void *ParValue)
+{
+	sim_handle_t	*h;
+	CAENHVRESULT	ret;
+	int				i;
+
+	(void)ParValue;						/* the board parameters are read-only */
+	if((h = sim_enter(handle, slotNum, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	if(sim_par_find(sim_bdpars, sim_nBdPars, ParName) == NULL)
+		return sim_leave(h, CAENHV_PARAMNOTFOUND);
+	for(i = 0; i < slotNum && ret == CAENHV_OK; i++)
+		ret = sim_locate(h->crate, slotList[i], 0, NULL);
+	return sim_leave(h, ret == CAENHV_OK ? CAENHV_NOTSETPROP : ret);	/* all read-only */
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Channels                                                                 */
+/*                                                                           */
+/*****************************************************************************/
+CAENHVRESULT CAENHV_GetChParamInfo(int handle, ushort slot, ushort Ch, char **ParNameList, int *ParNumber)
+{
+	sim_handle_t	*h;
+	CAENHVRESULT	ret;
+
+	if((h = sim_enter(handle, 0, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	if((ret = sim_locate(h->crate, slot, 1, &Ch)) == CAENHV_OK) {
+		if((*ParNameList = par_names(sim_chpars, sim_nChPars)) == NULL)
+			ret = CAENHV_MEMORYFAULT;
+		else
+			*ParNumber = sim_nChPars;
+	}
+	return sim_leave(h, ret);
+}
+
+CAENHVRESULT CAENHV_GetChParamProp(int handle, ushort slot, ushort Ch, const char *ParName,
+                                   const char *PropName, void *retval)
+{
+	sim_handle_t	*h;
+	const sim_par_t	*p;
+	CAENHVRESULT	ret;
+
+	if((h = sim_enter(handle, 0, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	if((ret = sim_locate(h->crate, slot, 1, &Ch)) == CAENHV_OK) {
+		if((p = sim_par_find(sim_chpars, sim_nChPars, ParName)) == NULL)
+			ret = CAENHV_PARAMNOTFOUND;
+		else
+			ret = sim_prop(h->crate, slot, p, PropName, retval);
+	}
+	return sim_leave(h, ret);
+}
+
+CAENHVRESULT CAENHV_GetChName(int handle, ushort slot, ushort ChNum, const ushort *ChList,
+                              char (*ChNameList)[MAX_CH_NAME])
+{
+	sim_handle_t	*h;
+	CAENHVRESULT	ret;
+	int				i;
+
+	if((h = sim_enter(handle, ChNum, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	if((ret = sim_locate(h->crate, slot, ChNum, ChList)) == CAENHV_OK) {
+		pthread_mutex_lock(&h->crate->lock);
+		for(i = 0; i < ChNum; i++)
+			memcpy(ChNameList[i], h->crate->bd[slot].ch[ChList[i]].name, MAX_CH_NAME);
+		pthread_mutex_unlock(&h->crate->lock);
+	}
+	return sim_leave(h, ret);
+}
+
+CAENHVRESULT CAENHV_SetChName(int handle, ushort slot, ushort ChNum, const ushort *ChList, const char *ChName)
+{
+	sim_handle_t	*h;
+	CAENHVRESULT	ret;
+	int				i;
+
+	if((h = sim_enter(handle, ChNum, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	if(strlen(ChName) >= MAX_CH_NAME)
+		return sim_leave(h, CAENHV_OUTOFRANGE);
+	if((ret = sim_locate(h->crate, slot, ChNum, ChList)) == CAENHV_OK) {
+		pthread_mutex_lock(&h->crate->lock);
+		for(i = 0; i < ChNum; i++) {
+			char *name = h->crate->bd[slot].ch[ChList[i]].name;
+
+			memset(name, 0, MAX_CH_NAME);
+			strcpy(name, ChName);
+		}
+		pthread_mutex_unlock(&h->crate->lock);
+	}
+	return sim_leave(h, ret);
+}
+
+CAENHVRESULT CAENHV_GetChParam(int handle, ushort slot, const char *ParName, ushort ChNum,
+                               const ushort *ChList, void *ParValList)
+{
+	sim_handle_t	*h;
+	const sim_par_t	*p;
+	CAENHVRESULT	ret;
+	double			now = sim_now();
+	int				i;
+
+	if((h = sim_enter(handle, ChNum, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	if((p = sim_par_find(sim_chpars, sim_nChPars, ParName)) == NULL)
+		return sim_leave(h, CAENHV_PARAMNOTFOUND);
+	if((ret = sim_locate(h->crate, slot, ChNum, ChList)) == CAENHV_OK) {
+		pthread_mutex_lock(&h->crate->lock);
+		for(i = 0; i < ChNum && ret == CAENHV_OK; i++)
+			ret = sim_ch_read(h->crate, slot, ChList[i], p, (char *)ParValList + 4 * i, 1, now);
+		pthread_mutex_unlock(&h->crate->lock);
+	}
+	return sim_leave(h, ret);
+}
+
+CAENHVRESULT CAENHV_SetChParam(int handle, ushort slot, const char *ParName, ushort ChNum,
+                               const ushort *ChList, void *ParValue)
+{
+	sim_handle_t	*h;
+	const sim_par_t	*p;
+	CAENHVRESULT	ret;
+	double			now = sim_now();
+	int				i;
+
+	if((h = sim_enter(handle, ChNum, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	if((p = sim_par_find(sim_chpars, sim_nChPars, ParName)) == NULL)
+		return sim_leave(h, CAENHV_PARAMNOTFOUND);
+	if((ret = sim_locate(h->crate, slot, ChNum, ChList)) == CAENHV_OK) {
+		pthread_mutex_lock(&h->crate->lock);
+		for(i = 0; i < ChNum && ret == CAENHV_OK; i++)
+			ret = sim_ch_write(h->crate, slot, ChList[i], p, ParValue, now);
+		pthread_mutex_unlock(&h->crate->lock);
+	}
+	return sim_leave(h, ret);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  System properties and commands                                           */
+/*                                                                           */
+/*****************************************************************************/
+static int sysprop_find(const char *name)
+{
+	int i;
+
+	for(i = 0; i < SIM_NSYSPROPS; i++)
+		if(strcmp(sysProps[i], name) == 0)
+			return i;
+	return -1;
+}
+
+/* the value of system property i, as GetSysProp returns it; under c->lock */
+static void sysprop_read(const sim_crate_t *c, int i, void *Result)
+{
+	switch(i) {
+	case 0: sprintf((char *)Result, "SY2527 (sim)");	break;
+	case 1: sprintf((char *)Result, "%s", SIM_REL);		break;
+	case 2: sprintf((char *)Result, "%s", c->host);		break;
+	case 3: sprintf((char *)Result, "%s", c->symName);	break;
+	case 4: *(unsigned short *)Result = (unsigned short)c->sessions;	break;
+	case 5: *(unsigned *)Result = c->latencyUs;		break;
+	}
+}
+
+/* NUL separated names, as GetSysPropList and GetExecCommList return them */
+static char *name_list(const char **names, int n)
+{
+	size_t	len = 0;
+	char	*list, *p;
+	int		i;
+
+	for(i = 0; i < n; i++)
+		len += strlen(names[i]) + 1;
+	if((list = p = (char *)malloc(len)) != NULL)
+		for(i = 0; i < n; i++) {
+			strcpy(p, names[i]);
+			p += strlen(p) + 1;
+		}
+	return list;
+}
+
+CAENHVRESULT CAENHV_GetSysPropList(int handle, ushort *NumProp, char **PropNameList)
+{
+	sim_handle_t	*h;
+	CAENHVRESULT	ret;
+
+	if((h = sim_enter(handle, 0, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	if((*PropNameList = name_list(sysProps, SIM_NSYSPROPS)) == NULL)
+		return sim_leave(h, CAENHV_MEMORYFAULT);
+	*NumProp = SIM_NSYSPROPS;
+	return sim_leave(h, CAENHV_OK);
+}
+
+CAENHVRESULT CAENHV_GetSysPropInfo(int handle, const char *PropName, unsigned *PropMode, unsigned *PropType)
+{
+	sim_handle_t	*h;
+	CAENHVRESULT	ret;
+	int				i;
+
+	if((h = sim_enter(handle, 0, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	if((i = sysprop_find(PropName)) < 0)
+		return sim_leave(h, CAENHV_PROPNOTFOUND);
+	*PropMode = sysPropMode[i];
+	*PropType = sysPropType[i];
+	return sim_leave(h, CAENHV_OK);
+}
+
+CAENHVRESULT CAENHV_GetSysProp(int handle, const char *PropName, void *Result)
+{
+	sim_handle_t	*h;
+	CAENHVRESULT	ret;
+	int				i;
+
+	if((h = sim_enter(handle, 0, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	if((i = sysprop_find(PropName)) < 0)
+		return sim_leave(h, CAENHV_PROPNOTFOUND);
+	pthread_mutex_lock(&h->crate->lock);
+	sysprop_read(h->crate, i, Result);
+	pthread_mutex_unlock(&h->crate->lock);
+	return sim_leave(h, CAENHV_OK);
+}
+
+CAENHVRESULT CAENHV_SetSysProp(int handle, const char *PropName, void *Set)
+{
+	sim_handle_t	*h;
+	CAENHVRESULT	ret;
+	int				i;
+
+	if((h = sim_enter(handle, 0, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	if((i = sysprop_find(PropName)) < 0)
+		return sim_leave(h, CAENHV_PROPNOTFOUND);
+	if(sysPropMode[i] == SYSPROP_MODE_RDONLY)
+		return sim_leave(h, CAENHV_NOTSETPROP);
+	pthread_mutex_lock(&h->crate->lock);
+	if(i == 3)
+		snprintf(h->crate->symName, sizeof(h->crate->symName), "%s", (const char *)Set);
+	else
+		h->crate->latencyUs = *(const unsigned *)Set;
+	pthread_mutex_unlock(&h->crate->lock);
+	return sim_leave(h, CAENHV_OK);
+}
+
+CAENHVRESULT CAENHV_GetExecCommList(int handle, ushort *NumComm, char **CommNameList)
+{
+	sim_handle_t	*h;
+	CAENHVRESULT	ret;
+
+	if((h = sim_enter(handle, 0, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	if((*CommNameList = name_list(execComms, SIM_NCOMMS)) == NULL)
+		return sim_leave(h, CAENHV_MEMORYFAULT);
+	*NumComm = SIM_NCOMMS;
+	return sim_leave(h, CAENHV_OK);
+}
+
+CAENHVRESULT CAENHV_ExecComm(int handle, const char *CommName)
+{
+	sim_handle_t	*h;
+	CAENHVRESULT	ret;
+
+	if((h = sim_enter(handle, 0, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	pthread_mutex_lock(&h->crate->lock);
+	ret = sim_exec(h->crate, CommName, sim_now());
+	pthread_mutex_unlock(&h->crate->lock);
+	return sim_leave(h, ret);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Events                                                                   */
+/*                                                                           */
+/*****************************************************************************/
+
+/* current value of a subscribed item into rec->v; 'noisy' 0 gives the value
+   changes are judged on. Under c->lock. Returns the deadband of the item. */
+static float sub_value(const sim_sub_t *d, sim_ev_rec_t *rec, int noisy, double now)
+{
+	const sim_par_t	*p;
+	int				i;
+
+	memset(&rec->v, 0, sizeof(rec->v));
+	if(d->slot < 0) {
+		if((i = sysprop_find(d->par)) == 4) {
+			unsigned short u;
+
+			sysprop_read(d->crate, i, &u);
+			rec->v.i = u;
+		} else if(i == 5) {
+			unsigned u;
+
+			sysprop_read(d->crate, i, &u);
+			rec->v.i = (int32_t)u;
+		} else {
+			char s[SIM_HOST_LEN + 16];
+
+			sysprop_read(d->crate, i, s);
+			snprintf(rec->v.s, sizeof(rec->v.s), "%.*s", (int)sizeof(rec->v.s) - 1, s);
+		}
+		return 0.0f;
+	}
+	if(d->ch < 0) {
+		p = sim_par_find(sim_bdpars, sim_nBdPars, d->par);
+		sim_bd_read(d->crate, (unsigned short)d->slot, p, &rec->v, noisy, now);
+	} else {
+		p = sim_par_find(sim_chpars, sim_nChPars, d->par);
+		sim_ch_read(d->crate, (unsigned short)d->slot, (unsigned short)d->ch, p, &rec->v, noisy, now);
+	}
+	if(p->type != PARAM_TYPE_NUMERIC)
+		return 0.0f;
+	return p->unit == PARAM_UN_VOLT ? SIM_EV_DB_VOLT : p->unit == PARAM_UN_AMPERE ? SIM_EV_DB_AMPERE : 0.0f;
+}
+
+static void dgram_send(int sck, unsigned short port, sim_ev_dgram_t *dg)
+{
+	struct sockaddr_in to;
+
+	if(dg->count == 0)
+		return;
+	memset(&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	to.sin_port = htons(port);
+	to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	memcpy(dg->magic, SIM_EV_MAGIC, sizeof(dg->magic));
+	sendto(sck, dg, offsetof(sim_ev_dgram_t, rec) + dg->count * sizeof(sim_ev_rec_t), 0,
+	       (struct sockaddr *)&to, sizeof(to));
+	dg->count = 0;
+}
+
+/* one pass per SIMHV_EVENT_MS: the changed items of each port, then its keepalive */
+static void *ev_thread(void *arg)
+{
+	sim_ev_dgram_t	*dg = (sim_ev_dgram_t *)calloc(1, sizeof(sim_ev_dgram_t));
+	int				sck = socket(AF_INET, SOCK_DGRAM, 0);
+	double			lastKeep = 0.0;
+
+	(void)arg;
+	if(dg == NULL || sck < 0) {
+		fprintf(stderr, "hvsim: no event thread, events are lost\n");
+		free(dg);
+		return NULL;
+	}
+	for(;;) {
+		unsigned short	port[SIM_MAX_HANDLES];
+		int				handle[SIM_MAX_HANDLES];
+		int				nPorts = 0, keep, k;
+		double			now;
+		sim_sub_t		*e;
+
+		sleep_us(sim_cfg.eventMs * 1000.0);
+		now = sim_now();
+		keep = (now - lastKeep) * 1000.0 >= SIM_KEEPALIVE_MS;
+		if(keep)
+			lastKeep = now;
+
+		pthread_mutex_lock(&subsLock);
+		for(e = subs; e != NULL; e = e->next) {
+			for(k = 0; k < nPorts && port[k] != e->port; k++)
+				;
+			if(k == nPorts && nPorts < SIM_MAX_HANDLES) {
+				port[nPorts] = e->port;
+				handle[nPorts++] = e->handle;
+			}
+		}
+		for(k = 0; k < nPorts; k++) {
+			for(e = subs; e != NULL; e = e->next) {
+				sim_ev_rec_t	*rec;
+				float			db;
+				int				changed;
+
+				if(e->port != port[k])
+					continue;
+				rec = &dg->rec[dg->count];
+				pthread_mutex_lock(&e->crate->lock);
+				db = sub_value(e, rec, 0, now);
+				changed = !e->primed
+				       || (db > 0.0f ? fabsf(rec->v.f - e->last.f) >= db
+				                     : memcmp(&rec->v, &e->last, sizeof(e->last)) != 0);
+				if(changed) {
+					memcpy(&e->last, &rec->v, sizeof(e->last));
+					e->primed = 1;
+					if(db > 0.0f)
+						sub_value(e, rec, 1, now);
+				}
+				pthread_mutex_unlock(&e->crate->lock);
+				if(!changed)
+					continue;
+				rec->type = PARAMETER;
+				rec->handle = e->handle;
+				rec->board = e->slot;
+				rec->channel = e->ch;
+				memset(rec->item, 0, sizeof(rec->item));
+				strncpy(rec->item, e->par, sizeof(rec->item) - 1);
+				if(++dg->count == SIM_EV_PER_DGRAM)
+					dgram_send(sck, port[k], dg);
+			}
+			if(keep) {
+				sim_ev_rec_t *rec = &dg->rec[dg->count];
+
+				memset(rec, 0, sizeof(*rec));
+				rec->type = KEEPALIVE;
+				rec->handle = handle[k];
+				rec->board = rec->channel = -1;
+				dg->count++;
+			}
+			dgram_send(sck, port[k], dg);
+		}
+		pthread_mutex_unlock(&subsLock);
+	}
+	return NULL;
+}
+
+/* adds (subscribe) or removes the ':' separated items of paramNameList */
+static CAENHVRESULT sub_change(int handle, short Port, int slot, int ch, const char *paramNameList,
+                               unsigned int paramNum, char *listOfResultCodes, int add)
+{
+	sim_handle_t	*h;
+	CAENHVRESULT	ret;
+	const char		*p = paramNameList;
+	unsigned int	i;
+
+	if((h = sim_enter(handle, paramNum, &ret)) == NULL || ret != CAENHV_OK)
+		return h ? sim_leave(h, ret) : ret;
+	if(!sim_cfg.events)
+		return sim_leave(h, CAENHV_FUNCTIONNOTAVAILABLE);
+	if(slot >= 0) {
+		unsigned short c = (unsigned short)ch;
+
+		if((ret = sim_locate(h->crate, (unsigned short)slot, ch >= 0, &c)) != CAENHV_OK)
+			return sim_leave(h, ret);
+	}
+
+	pthread_mutex_lock(&subsLock);
+	for(i = 0; i < paramNum; i++) {
+		char		name[MAX_PARAM_NAME];
+		size_t		len = strcspn(p, ":");
+		int			known;
+		sim_sub_t	**pp;
+
+		snprintf(name, sizeof(name), "%.*s", (int)len, p);
+		p += len + (p[len] == ':');
+		known = len < MAX_PARAM_NAME
+		     && (slot < 0 ? sysprop_find(name) >= 0
+		       : ch < 0 ? sim_par_find(sim_bdpars, sim_nBdPars, name) != NULL
+		       : sim_par_find(sim_chpars, sim_nChPars, name) != NULL);
+		listOfResultCodes[i] = known ? CAENHV_OK : CAENHV_PARAMNOTFOUND;
+		if(!known)
+			continue;
+		for(pp = &subs; *pp != NULL; pp = &(*pp)->next)
+			if((*pp)->handle == handle && (*pp)->port == (unsigned short)Port && (*pp)->slot == slot
+			&& (*pp)->ch == ch && strcmp((*pp)->par, name) == 0)
+				break;
+		if(add && *pp == NULL) {
+			sim_sub_t *d = (sim_sub_t *)calloc(1, sizeof(sim_sub_t));
+
+			if(d == NULL) {
+				listOfResultCodes[i] = CAENHV_MEMORYFAULT;
+				continue;
+			}
+			d->handle = handle;
+			d->port = (unsigned short)Port;
+			d->crate = h->crate;
+			d->slot = slot;
+			d->ch = ch;
+			strcpy(d->par, name);
+			*pp = d;					/* at the tail: datagrams keep the order */
+		} else if(!add && *pp != NULL) {
+			sim_sub_t *d = *pp;
+
+			*pp = d->next;
+			free(d);
+		}
+	}
+	if(add && !evThreadUp) {
+		pthread_t tid;
+
+		if(pthread_create(&tid, NULL, ev_thread, NULL) == 0) {
+			pthread_detach(tid);
+			evThreadUp = 1;
+		}
+	}
+	pthread_mutex_unlock(&subsLock);
+	return sim_leave(h, CAENHV_OK);
+}
+
+CAENHVRESULT CAENHV_SubscribeSystemParams(int handle, short Port, const char *paramNameList,
+                                          unsigned int paramNum, char *listOfResultCodes)
+{
+	return sub_change(handle, Port, -1, -1, paramNameList, paramNum, listOfResultCodes, 1);
+}
+
+CAENHVRESULT CAENHV_SubscribeBoardParams(int handle, short Port, const unsigned short slotIndex,
+                                         const char *paramNameList, unsigned int paramNum, char *listOfResultCodes)
+{
+	return sub_change(handle, Port, slotIndex, -1, paramNameList, paramNum, listOfResultCodes, 1);
+}
+
+CAENHVRESULT CAENHV_SubscribeChannelParams(int handle, short Port, const unsigned short slotIndex,
+                                           const unsigned short chanIndex, const char *paramNameList,
+                                           unsigned int paramNum, char *listOfResultCodes)
+{
+	return sub_change(handle, Port, slotIndex, chanIndex, paramNameList, paramNum, listOfResultCodes, 1);
+}
+
+CAENHVRESULT CAENHV_UnSubscribeSystemParams(int handle, short Port, const char *paramNameList,
+                                            unsigned int paramNum, char *listOfResultCodes)
+{
+	return sub_change(handle, Port, -1, -1, paramNameList, paramNum, listOfResultCodes, 0);
+}
+
+CAENHVRESULT CAENHV_UnSubscribeBoardParams(int handle, short Port, const unsigned short slotIndex,
+                                           const char *paramNameList, unsigned int paramNum, char *listOfResultCodes)
+{
+	return sub_change(handle, Port, slotIndex, -1, paramNameList, paramNum, listOfResultCodes, 0);
+}
+
+CAENHVRESULT CAENHV_UnSubscribeChannelParams(int handle, short Port, const unsigned short slotIndex,
+                                             const unsigned short chanIndex, const char *paramNameList,
+                                             unsigned int paramNum, char *listOfResultCodes)
+{
+	return sub_change(handle, Port, slotIndex, chanIndex, paramNameList, paramNum, listOfResultCodes, 0);
+}
+
+CAENHVRESULT CAENHV_GetEventData(int sck, CAENHV_SYSTEMSTATUS_t *SysStatus, CAENHVEVENT_TYPE_t **EventData,
+                                 unsigned int *DataNumber)
+{
+	sim_ev_dgram_t	*dg;
+	ssize_t			n;
+	unsigned int	i;
+
+	*EventData = NULL;
+	*DataNumber = 0;
+	SysStatus->System = SYNC;
+	for(i = 0; i < 16; i++)
+		SysStatus->Board[i] = SYNC;
+	if((dg = (sim_ev_dgram_t *)malloc(sizeof(sim_ev_dgram_t))) == NULL)
+		return CAENHV_MEMORYFAULT;
+	n = recv(sck, dg, sizeof(*dg), 0);
+	if(n < 0) {
+		free(dg);
+		return CAENHV_SOCKETERROR;
+	}
+	/* anything that is not ours carries no events */
+	if((size_t)n < offsetof(sim_ev_dgram_t, rec) || memcmp(dg->magic, SIM_EV_MAGIC, sizeof(dg->magic)) != 0
+	|| dg->count > SIM_EV_PER_DGRAM || (size_t)n < offsetof(sim_ev_dgram_t, rec) + dg->count * sizeof(sim_ev_rec_t)
+	|| dg->count == 0) {
+		free(dg);
+		return CAENHV_OK;
+	}
+	if((*EventData = (CAENHVEVENT_TYPE_t *)calloc(dg->count, sizeof(CAENHVEVENT_TYPE_t))) == NULL) {
+		free(dg);
+		return CAENHV_MEMORYFAULT;
+	}
+	for(i = 0; i < dg->count; i++) {
+		CAENHVEVENT_TYPE_t	*ev = &(*EventData)[i];
+		const sim_ev_rec_t	*rec = &dg->rec[i];
+
+		ev->Type = (CAENHV_ID_TYPE_t)rec->type;
+		ev->SystemHandle = rec->handle;
+		ev->BoardIndex = rec->board;
+		ev->ChannelIndex = rec->channel;
+		memcpy(ev->ItemID, rec->item, sizeof(ev->ItemID));
+		memcpy(&ev->Value, &rec->v, sizeof(rec->v));
+	}
+	*DataNumber = dg->count;
+	free(dg);
+	return CAENHV_OK;
+}
+
+CAENHVRESULT CAENHV_FreeEventData(CAENHVEVENT_TYPE_t **ListOfItemsData)
+{
+	free(*ListOfItemsData);
+	*ListOfItemsData = NULL;
+	return CAENHV_OK;
+}
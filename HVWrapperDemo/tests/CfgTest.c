@@ -0,0 +1,225 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   CFGTEST.C                                                               */
+/*                                                                           */
+/*   cfg_load on small configs: rows and values in file order, the groups   */
+/*   per (parameter, value), the skip list, '-' cells, the same plan read   */
+/*   back from the sidecar until the config changes, the header columns    */
+/*   and the lines reported as skipped; cfg_match on names and globs.        */
+/*                                                                           */
+/*****************************************************************************/
+#include <unistd.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "CAENHVWrapper.h"
+#include "CfgWrapp.h"
+#include "Check.h"
+
+static char	dir[] = "/tmp/cfgtestXXXXXX";
+static char	cfgPath[64];
+
+static void put_config(const char *text)
+{
+	FILE *fp = fopen(cfgPath, "w");
+
+	if(fp == NULL) {
+		perror(cfgPath);
+		exit(1);
+	}
+	fputs(text, fp);
+	fclose(fp);
+}
+
+/* the group of parameter 'p' holding 'val', or NULL */
+static const cfg_group_t *group_of(const cfg_plan_t *pl, int p, float val)
+{
+	int g;
+
+	for(g = pl->parGrp[p]; g < pl->parGrp[p + 1]; g++)
+		if(pl->grp[g].val == val)
+			return &pl->grp[g];
+	return NULL;
+}
+
+/* 1 if the text of 'f' (rewound) contains 'what' */
+static int said(FILE *f, const char *what)
+{
+	char line[256];
+	int found = 0;
+
+	rewind(f);
+	while(fgets(line, sizeof(line), f) != NULL)
+		found |= strstr(line, what) != NULL;
+	rewind(f);
+	return found;
+}
+
+/* the plan of the default config below, however it was loaded */
+static void check_plan(const cfg_plan_t *pl)
+{
+	const cfg_group_t *g;
+
+	CHECK(pl->n == 4 && pl->nPar == 2);
+	CHECK(strcmp(pl->par[0], "V0Set") == 0 && strcmp(pl->par[1], "I0Set") == 0);
+	CHECK(pl->ch[0] == 0 && pl->ch[1] == 1 && pl->ch[2] == 3 && pl->ch[3] == 2);
+	CHECK(strcmp(pl->name[0], "ecal_a") == 0 && strcmp(pl->name[3], "None") == 0);
+	CHECK(pl->val[0] == 100.0f && pl->val[1] == 200.0f && pl->val[2] == 100.0f);
+	CHECK(isnan(pl->val[3]));
+	CHECK(pl->val[4] == 5.0f && pl->val[5] == 5.0f && pl->val[6] == 5.0f && pl->val[7] == 0.5f);
+
+	/* V0Set: 100 on 0 and 3, 200 on 1, nothing on 2; I0Set: 0.5 on 2, 5 on 0 1 3 */
+	CHECK(pl->nGrp == 4 && pl->parGrp[1] - pl->parGrp[0] == 2);
+	g = group_of(pl, 0, 100.0f);
+	CHECK(g != NULL && g->count == 2 && pl->grpCh[g->first] == 0 && pl->grpCh[g->first + 1] == 3);
+	g = group_of(pl, 0, 200.0f);
+	CHECK(g != NULL && g->count == 1 && pl->grpCh[g->first] == 1);
+	g = group_of(pl, 1, 5.0f);
+	CHECK(g != NULL && g->count == 3 && pl->grpCh[g->first] == 0 && pl->grpCh[g->first + 2] == 3);
+	g = group_of(pl, 1, 0.5f);
+	CHECK(g != NULL && g->count == 1 && pl->grpCh[g->first] == 2);
+	CHECK(pl->nNamed == 3);
+}
+
+int main(void)
+{
+	static const char	config[] =
+		"# no header: V0Set I0Set\n"
+		"0  ecal_a  100  5\n"
+		"1, ecal_b, 200, 5\n"
+		"\n"
+		"3\tecal_c\t100\t5\n"
+		"2  None  -  0.5\n";
+	static const unsigned short	skip[] = { 1, 3 };
+	cfg_plan_t	*pl, *again;
+	FILE		*err;
+	char		cmd[160];
+
+	if(mkdtemp(dir) == NULL) {
+		perror("mkdtemp");
+		return 1;
+	}
+	snprintf(cmd, sizeof(cmd), "%s/cache", dir);
+	setenv("HVWRAPP_CACHE_DIR", cmd, 1);
+	snprintf(cfgPath, sizeof(cfgPath), "%s/config.txt", dir);
+
+	/* missing and empty configs */
+	CHECK(cfg_load(cfgPath, NULL, 0, 0, &pl, NULL) == -1 && pl == NULL);
+	put_config("# nothing\n\n");
+	CHECK(cfg_load(cfgPath, NULL, 0, 1, &pl, NULL) == 0 && pl == NULL);
+
+	/* parsed */
+	put_config(config);
+	CHECK(cfg_load(cfgPath, NULL, 0, 0, &pl, NULL) == 4);
+	if(pl != NULL) {
+		CHECK(pl->cached == 0);
+		check_plan(pl);
+	}
+	cfg_free(pl);
+
+	/* written to the sidecar, then read back from it */
+	CHECK(cfg_load(cfgPath, NULL, 0, 1, &pl, NULL) == 4);
+	CHECK(pl != NULL && pl->cached == 0);
+	CHECK(cfg_load(cfgPath, NULL, 0, 1, &again, NULL) == 4);
+	if(again != NULL) {
+		CHECK(again->cached == 1);
+		check_plan(again);
+		CHECK(pl != NULL && again->blobSize == pl->blobSize && memcmp(again->blob, pl->blob, pl->blobSize) == 0);
+	}
+	cfg_free(pl);
+	cfg_free(again);
+
+	/* another skip list is another plan */
+	CHECK(cfg_load(cfgPath, skip, 2, 1, &pl, NULL) == 2);
+	if(pl != NULL) {
+		CHECK(pl->cached == 0);
+		CHECK(pl->ch[0] == 0 && pl->ch[1] == 2);
+		CHECK(pl->nNamed == 1 && pl->nGrp == 3);
+	}
+	cfg_free(pl);
+
+	/* an edited config is parsed again */
+	put_config("0  ecal_a  100  5\n1  ecal_b  300  5\n");
+	CHECK(cfg_load(cfgPath, NULL, 0, 1, &pl, NULL) == 2);
+	CHECK(pl != NULL && pl->cached == 0 && pl->val[1] == 300.0f);
+	cfg_free(pl);
+
+	/* a header names the columns; bad rows are reported with their line */
+	if((err = tmpfile()) == NULL) {
+		perror("tmpfile");
+		return 1;
+	}
+	put_config("HV crate, run 42\n"
+	           "ch#  name  V0Set  RUp  Pw\n"
+	           "0  a  100  10  On\n"
+	           "1  b  100  x  Off\n"
+	           "2\n"
+	           "3  c  150\n"
+	           "ch  name  V0Set\n"
+	           "4  d  -  20  on\n");
+	CHECK(cfg_load(cfgPath, NULL, 0, 0, &pl, err) == 3);
+	if(pl != NULL) {
+		CHECK(pl->nPar == 3 && strcmp(pl->par[1], "RUp") == 0 && strcmp(pl->par[2], "Pw") == 0);
+		CHECK(pl->ch[0] == 0 && pl->ch[1] == 3 && pl->ch[2] == 4);
+		CHECK(pl->val[2 * 3 + 0] == 1.0f && pl->val[2 * 3 + 2] == 1.0f);
+		CHECK(isnan(pl->val[1 * 3 + 1]) && isnan(pl->val[2 * 3 + 1]));	/* short row: not set */
+		CHECK(isnan(pl->val[0 * 3 + 2]));
+	}
+	cfg_free(pl);
+	snprintf(cmd, sizeof(cmd), "%s:1: 'HV' is not a channel number", cfgPath);
+	CHECK(said(err, cmd));
+	snprintf(cmd, sizeof(cmd), "%s:4: invalid RUp 'x' for channel 1", cfgPath);
+	CHECK(said(err, cmd));
+	snprintf(cmd, sizeof(cmd), "%s:5: channel 2 has no name", cfgPath);
+	CHECK(said(err, cmd));
+	snprintf(cmd, sizeof(cmd), "%s:7: 'ch' is not a channel number", cfgPath);
+	CHECK(said(err, cmd));
+	snprintf(cmd, sizeof(cmd), "%s:2:", cfgPath);
+	CHECK(!said(err, cmd));
+	fclose(err);
+
+	/* 'channel' heads the columns too */
+	put_config("Channel,Name,I0Set\n7,x,2.5\n");
+	CHECK(cfg_load(cfgPath, NULL, 0, 0, &pl, NULL) == 1);
+	CHECK(pl != NULL && pl->nPar == 1 && strcmp(pl->par[0], "I0Set") == 0 && pl->val[0] == 2.5f);
+	cfg_free(pl);
+
+	/* names: exact, globs by their literal prefix, None left out */
+	put_config("0  ecal_a1  -  -\n"
+	           "1  ecal_b1  -  -\n"
+	           "2  ecal_a2  -  -\n"
+	           "3  None  -  -\n"
+	           "4  hcal_a1  -  -\n"
+	           "5  ecal  -  -\n"
+	           "6  ecal_a1  -  -\n");
+	CHECK(cfg_load(cfgPath, NULL, 0, 0, &pl, NULL) == 7);
+	if(pl != NULL) {
+		int rows[8];
+
+		CHECK(pl->nNamed == 6 && pl->nGrp == 0);
+		CHECK(cfg_match(pl, "ecal_a2", rows, 8) == 1 && rows[0] == 2);
+		CHECK(cfg_match(pl, "ecal_a1", rows, 8) == 2 && rows[0] == 0 && rows[1] == 6);
+		CHECK(cfg_match(pl, "ecal", rows, 8) == 1 && rows[0] == 5);		/* not a prefix match */
+		CHECK(cfg_match(pl, "ecal_a*", rows, 8) == 3 && rows[0] == 0 && rows[1] == 6 && rows[2] == 2);
+		CHECK(cfg_match(pl, "ecal*", rows, 8) == 5);
+		CHECK(cfg_match(pl, "*_a1", rows, 8) == 3);
+		CHECK(cfg_match(pl, "ecal_?1", rows, 8) == 3);
+		CHECK(cfg_match(pl, "[eh]cal_a[12]", rows, 8) == 4);
+		CHECK(cfg_match(pl, "*", rows, 2) == 6);				/* counted past 'max' */
+		CHECK(cfg_match(pl, "None", rows, 8) == 0);
+		CHECK(cfg_match(pl, "N*", rows, 8) == 0);
+		CHECK(cfg_match(pl, "zcal*", rows, 8) == 0);
+		CHECK(cfg_match(pl, "Ecal_a1", rows, 8) == 0);
+		CHECK(cfg_match(pl, "", rows, 8) == 0);
+	}
+	cfg_free(pl);
+
+	cfg_free(NULL);
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+	if(system(cmd) != 0)
+		fprintf(stderr, "cannot remove %s\n", dir);
+	return check_done("cfg");
+}
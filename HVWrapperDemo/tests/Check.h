@@ -0,0 +1,34 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   CHECK.H                                                                 */
+/*                                                                           */
+/*   The few lines shared by the unit tests (make test): CHECK() reports a  */
+/*   failed condition with its place and goes on, check_done() sums up and  */
+/*   gives the exit code of the test program.                                */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef __CHECK_H
+#define __CHECK_H
+
+#include <stdio.h>
+
+static int checkRuns, checkFails;
+
+#define CHECK(cond)																\
+	do {																		\
+		checkRuns++;															\
+		if(!(cond)) {															\
+			checkFails++;														\
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);	\
+		}																		\
+	} while(0)
+
+static int check_done(const char *name)
+{
+	printf("%-10s %d check(s), %d failed\n", name, checkRuns, checkFails);
+	return checkFails ? 1 : 0;
+}
+
+#endif // __CHECK_H
@@ -0,0 +1,179 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   FILTTEST.C                                                              */
+/*                                                                           */
+/*   --deadband / --changes / --heartbeat semantics of filt_pass: absolute  */
+/*   and relative bands around the last value kept, change-only names,     */
+/*   the heartbeat, per-series state, and the spec errors of filt_init.     */
+/*                                                                           */
+/*****************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "CAENHVWrapper.h"
+#include "CliWrapp.h"
+#include "FiltWrapp.h"
+#include "Check.h"
+
+#define S(x)       ((uint64_t)(x) * 1000000000ull)
+
+static const char			*names[] = { "VMon", "IMon", "Pw", "ChStatus" };
+static const unsigned long	types[] = { PARAM_TYPE_NUMERIC, PARAM_TYPE_NUMERIC, PARAM_TYPE_ONOFF,
+                                        PARAM_TYPE_CHSTATUS };
+
+static uint32_t fb(float f)
+{
+	uint32_t u;
+
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+static int init(filt_t *f, const char *deadband, int changes, int heartbeatS, FILE *err)
+{
+	cli_req_t req;
+
+	memset(&req, 0, sizeof(req));
+	req.deadband = deadband;
+	req.changes = changes;
+	req.heartbeatS = heartbeatS;
+	return filt_init(f, &req, names, types, 4, 8, err);
+}
+
+/* 1 if the text of 'f' (rewound) contains 'what' */
+static int said(FILE *f, const char *what)
+{
+	char line[256];
+	int found = 0;
+
+	rewind(f);
+	while(fgets(line, sizeof(line), f) != NULL)
+		found |= strstr(line, what) != NULL;
+	rewind(f);
+	return found;
+}
+
+int main(void)
+{
+	FILE	*err = tmpfile();
+	filt_t	f;
+
+	if(err == NULL) {
+		perror("tmpfile");
+		return 1;
+	}
+
+	/* no filter: everything goes on, nothing is counted */
+	CHECK(init(&f, NULL, 0, -1, err) == 0);
+	CHECK(f.on == 0);
+	CHECK(filt_pass(&f, 0, 0, fb(1.0f), S(1)) == 1);
+	CHECK(filt_pass(&f, 0, 0, fb(1.0f), S(2)) == 1);
+	CHECK(f.passed == 0 && f.dropped == 0);
+	filt_free(&f);
+
+	/* --changes: the first sample, then only changes, per series */
+	CHECK(init(&f, NULL, 1, 0, err) == 0);
+	CHECK(f.on == 1 && f.heartbeatNs == 0);
+	CHECK(filt_pass(&f, 0, 3, 1u, S(1)) == 1);
+	CHECK(filt_pass(&f, 0, 3, 1u, S(2)) == 0);
+	CHECK(filt_pass(&f, 0, 3, 3u, S(3)) == 1);
+	CHECK(filt_pass(&f, 0, 3, 1u, S(4)) == 1);		/* back is a change too */
+	CHECK(filt_pass(&f, 1, 3, 1u, S(4)) == 1);		/* another series starts fresh */
+	CHECK(filt_pass(&f, 0, 3, 1u, S(100000)) == 0);	/* heartbeat 0: never */
+	CHECK(f.passed == 4 && f.dropped == 2);
+	filt_free(&f);
+
+	/* the heartbeat lets an unchanged value through once it expired */
+	CHECK(init(&f, NULL, 1, 10, err) == 0);
+	CHECK(filt_pass(&f, 0, 2, 1u, S(0) + 1) == 1);
+	CHECK(filt_pass(&f, 0, 2, 1u, S(9)) == 0);
+	CHECK(filt_pass(&f, 0, 2, 1u, S(10) + 1) == 1);	/* 10 s after the last kept */
+	CHECK(filt_pass(&f, 0, 2, 1u, S(15)) == 0);
+	filt_free(&f);
+
+	/* default heartbeat when a filter is on */
+	CHECK(init(&f, NULL, 1, -1, err) == 0);
+	CHECK(f.heartbeatNs == S(FILT_DEFAULT_HEARTBEAT));
+	filt_free(&f);
+
+	/* absolute band: measured from the last value kept, not the last seen */
+	CHECK(init(&f, "VMon=0.5", 0, 0, err) == 0);
+	CHECK(filt_pass(&f, 0, 0, fb(100.0f), S(1)) == 1);
+	CHECK(filt_pass(&f, 0, 0, fb(100.4f), S(2)) == 0);
+	CHECK(filt_pass(&f, 0, 0, fb(99.6f), S(3)) == 0);
+	CHECK(filt_pass(&f, 0, 0, fb(100.25f), S(4)) == 0);
+	CHECK(filt_pass(&f, 0, 0, fb(100.75f), S(5)) == 1);	/* drift adds up */
+	CHECK(filt_pass(&f, 0, 0, fb(100.25f), S(6)) == 0);	/* exactly on the band edge */
+	CHECK(filt_pass(&f, 0, 0, fb(99.0f), S(7)) == 1);
+	/* the other parameters are not filtered */
+	CHECK(filt_pass(&f, 2, 1, fb(5.0f), S(1)) == 1);
+	CHECK(filt_pass(&f, 2, 1, fb(5.0f), S(2)) == 1);
+	CHECK(filt_pass(&f, 3, 3, 1u, S(1)) == 1);
+	CHECK(filt_pass(&f, 3, 3, 1u, S(2)) == 1);
+	filt_free(&f);
+
+	/* relative band and a change-only name in one spec */
+	CHECK(init(&f, "IMon=2%,ChStatus", 0, 0, err) == 0);
+	CHECK(filt_pass(&f, 0, 1, fb(100.0f), S(1)) == 1);
+	CHECK(filt_pass(&f, 0, 1, fb(101.9f), S(2)) == 0);
+	CHECK(filt_pass(&f, 0, 1, fb(102.1f), S(3)) == 1);
+	CHECK(filt_pass(&f, 0, 1, fb(100.1f), S(4)) == 0);		/* 2% of 102.1 */
+	CHECK(filt_pass(&f, 1, 3, 1u, S(1)) == 1);
+	CHECK(filt_pass(&f, 1, 3, 1u, S(2)) == 0);
+	CHECK(filt_pass(&f, 1, 3, 513u, S(3)) == 1);
+	CHECK(filt_pass(&f, 2, 0, fb(1.0f), S(1)) == 1);
+	CHECK(filt_pass(&f, 2, 0, fb(1.0f), S(2)) == 1);
+	filt_free(&f);
+
+	/* a band on a parameter that is not numeric is change-only */
+	CHECK(init(&f, "Pw=5", 0, 0, err) == 0);
+	CHECK(filt_pass(&f, 0, 2, 0u, S(1)) == 1);
+	CHECK(filt_pass(&f, 0, 2, 0u, S(2)) == 0);
+	CHECK(filt_pass(&f, 0, 2, 1u, S(3)) == 1);
+	filt_free(&f);
+
+	/* --changes and --deadband: the band wins for the names it gives */
+	CHECK(init(&f, "VMon=1", 1, 0, err) == 0);
+	CHECK(filt_pass(&f, 0, 0, fb(10.0f), S(1)) == 1);
+	CHECK(filt_pass(&f, 0, 0, fb(10.5f), S(2)) == 0);
+	CHECK(filt_pass(&f, 1, 1, fb(1.0f), S(1)) == 1);
+	CHECK(filt_pass(&f, 1, 1, fb(1.0f), S(2)) == 0);
+	CHECK(filt_pass(&f, 1, 1, fb(1.01f), S(3)) == 1);
+	filt_free(&f);
+
+	/* spec errors */
+	CHECK(init(&f, "HVMax=1", 0, 0, err) == 2);
+	CHECK(said(err, "'HVMax' is not among the parameters read"));
+	filt_free(&f);
+	CHECK(init(&f, "VMon=-1", 0, 0, err) == 2);
+	filt_free(&f);
+	CHECK(init(&f, "VMon=1x", 0, 0, err) == 2);
+	filt_free(&f);
+	CHECK(init(&f, "VMon=", 0, 0, err) == 2);
+	filt_free(&f);
+	CHECK(init(&f, "VMon,,IMon", 0, 0, err) == 2);
+	filt_free(&f);
+	{
+		const char		*many[FILT_MAX_PARAMS + 1];
+		unsigned long	ty[FILT_MAX_PARAMS + 1];
+		cli_req_t		req;
+		int				p;
+
+		for(p = 0; p <= FILT_MAX_PARAMS; p++) {
+			many[p] = "VMon";
+			ty[p] = PARAM_TYPE_NUMERIC;
+		}
+		memset(&req, 0, sizeof(req));
+		req.changes = 1;
+		fclose(err);
+		err = tmpfile();
+		CHECK(filt_init(&f, &req, many, ty, FILT_MAX_PARAMS + 1, 1, err) == 2);
+		CHECK(said(err, "at most 16 parameters"));
+		filt_free(&f);
+	}
+
+	fclose(err);
+	return check_done("filt");
+}
@@ -0,0 +1,263 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   HISTTEST.C                                                              */
+/*                                                                           */
+/*   --history round trip: series written through the acquisition sink and  */
+/*   read back by hist_export must give every point, bit for bit. The       */
+/*   series hit each delta-of-delta bucket edge, XOR windows from 1 to 32   */
+/*   bits, chunk rollover on count and span, time going backwards, single   */
+/*   point chunks; then a torn chunk is dropped on reopen.                   */
+/*                                                                           */
+/*****************************************************************************/
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "CAENHVWrapper.h"
+#include "AcqWrapp.h"
+#include "HistWrapp.h"
+#include "Check.h"
+
+#define NCH        (5)
+#define MAXPTS     (3000)
+#define T0_MS      (1700000000000ll)
+
+typedef struct {
+	int64_t		ms[MAXPTS];
+	uint32_t	v[MAXPTS];
+	int			n, got, bad;
+} expect_t;
+
+static expect_t	ex[NCH];
+static int		parOf[NCH] = { 1, 0, 1, 1, 1 };		/* 0: VMon (numeric), 1: Stat */
+
+static uint32_t rnd(uint32_t *seed)
+{
+	*seed = *seed * 1664525u + 1013904223u;
+	return *seed;
+}
+
+static void add(acq_sample_t *sm, int ch, int64_t ms, uint32_t v)
+{
+	expect_t *e = &ex[ch];
+
+	memset(sm, 0, sizeof(*sm));
+	sm->tsNs = (uint64_t)ms * 1000000ull + 123456u;		/* sub-ms part is dropped */
+	sm->slot = 1;
+	sm->ch = (uint16_t)ch;
+	sm->par = (uint16_t)parOf[ch];
+	sm->type = parOf[ch] == 0 ? PARAM_TYPE_NUMERIC : PARAM_TYPE_CHSTATUS;
+	sm->series = (uint32_t)ch;
+	sm->v.u = v;
+	e->ms[e->n] = ms;
+	e->v[e->n++] = v;
+}
+
+static uint32_t fbits(float f)
+{
+	uint32_t u;
+
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+/* the points of every channel, fed a tick (one point per channel) at a time */
+static int write_history(const char *path)
+{
+	static const int64_t	dods[] = { 0, -63, 64, -64, 65, -255, 256, -256, 257,
+	                                   -2047, 2048, -2048, 2049, 70000, -70000 };
+	static const float		fv[] = { 0.0f, -0.0f, 1e-30f, 3.4e38f, -1.5f, 1000.01f, 999.99f,
+	                                 0.001f, 12345.678f };
+	acq_t			a;
+	acq_sink_t		sink;
+	acq_sample_t	smp[NCH];
+	int64_t			t[NCH], d[NCH];
+	uint32_t		seed = 1, v3 = 0;
+	int				k, c, n;
+
+	memset(&a, 0, sizeof(a));
+	a.nPar = 2;
+	strcpy(a.par[0].name, "VMon");
+	a.par[0].type = PARAM_TYPE_NUMERIC;
+	strcpy(a.par[1].name, "Stat");
+	a.par[1].type = PARAM_TYPE_CHSTATUS;
+	if(hist_open(path, &a, &sink, stderr) != 0)
+		return -1;
+	for(c = 0; c < NCH; c++) {
+		t[c] = T0_MS;
+		d[c] = 1000;
+	}
+
+	for(k = 0; k < 2000; k++) {
+		n = 0;
+
+		/* ch 0: every dod bucket edge; values from equal to all 32 bits changing */
+		d[0] += dods[k % (int)(sizeof(dods) / sizeof(dods[0]))];
+		if(d[0] < 1) d[0] = 1000;
+		t[0] += d[0];
+		switch(k % 8) {
+		case 0:  add(&smp[n++], 0, t[0], 0u); break;
+		case 1:  add(&smp[n++], 0, t[0], 0xffffffffu); break;
+		case 2:  add(&smp[n++], 0, t[0], 0x80000000u); break;
+		case 3:  add(&smp[n++], 0, t[0], 0x00000001u); break;
+		case 4:  add(&smp[n++], 0, t[0], 0x00000001u); break;
+		case 5:  add(&smp[n++], 0, t[0], 0x00000003u); break;		/* inside the last window */
+		default: add(&smp[n++], 0, t[0], rnd(&seed)); break;
+		}
+
+		/* ch 1: numeric, jittered 1 s period */
+		t[1] += 1000 + (int64_t)(rnd(&seed) % 7u);
+		add(&smp[n++], 1, t[1], fbits(fv[k % (int)(sizeof(fv) / sizeof(fv[0]))]));
+
+		/* ch 2: a point every 10 min, so each chunk closes on its span */
+		if(k < 10) {
+			t[2] += 10 * 60 * 1000;
+			add(&smp[n++], 2, t[2], (uint32_t)k);
+		}
+
+		/* ch 3: time going backwards now and then, one bit moving over the word */
+		t[3] += k % 5 == 4 ? -3000 : 1000;
+		v3 = 1u << (k % 32);
+		add(&smp[n++], 3, t[3], v3);
+
+		/* ch 4: one point only */
+		if(k == 0)
+			add(&smp[n++], 4, T0_MS, 42u);
+
+		if(sink.put(sink.ctx, smp, n) != 0) {
+			sink.close(sink.ctx);
+			return -1;
+		}
+		CHECK(sink.put(sink.ctx, smp, 0) == 0);			/* a failed tick */
+	}
+	sink.close(sink.ctx);
+	return 0;
+}
+
+/* exports 'path' and matches each line against ex[]; returns the lines read */
+static long read_back(const char *path, const hist_filter_t *f)
+{
+	char		line[256], par[64];
+	FILE		*out = tmpfile();
+	long long	ms;
+	unsigned	slot, ch;
+	long		lines = 0;
+	int			c;
+
+	for(c = 0; c < NCH; c++)
+		ex[c].got = ex[c].bad = 0;
+	if(out == NULL || hist_export(path, f, out, stderr) != 0) {
+		if(out) fclose(out);
+		return -1;
+	}
+	rewind(out);
+	if(fgets(line, sizeof(line), out) == NULL || strcmp(line, "time_ms,slot,ch,param,value\n") != 0) {
+		fclose(out);
+		return -1;
+	}
+	while(fgets(line, sizeof(line), out) != NULL) {
+		char		val[64], want[64];
+		expect_t	*e;
+		int			pos;
+
+		lines++;
+		if(sscanf(line, "%lld,%u,%u,%63[^,],%n", &ms, &slot, &ch, par, &pos) != 4 || ch >= NCH) {
+			CHECK(!"export line parses");
+			continue;
+		}
+		snprintf(val, sizeof(val), "%s", line + pos);
+		val[strcspn(val, "\n")] = '\0';
+		e = &ex[ch];
+		if(f->fromMs > 0 || f->toMs > 0)		/* a window: counted only */
+			continue;
+		if(e->got >= e->n) {
+			e->bad++;
+			continue;
+		}
+		if(parOf[ch] == 0) {
+			float fv;
+
+			memcpy(&fv, &e->v[e->got], sizeof(fv));
+			snprintf(want, sizeof(want), "%g", (double)fv);
+		} else
+			snprintf(want, sizeof(want), "%u", e->v[e->got]);
+		if(ms != e->ms[e->got] || slot != 1 || strcmp(par, parOf[ch] ? "Stat" : "VMon") != 0
+		|| strcmp(val, want) != 0) {
+			if(e->bad++ == 0)
+				fprintf(stderr, "ch %u point %d: got %lld %s, want %lld %s\n", ch, e->got, ms, val,
+				        (long long)e->ms[e->got], want);
+		}
+		e->got++;
+	}
+	fclose(out);
+	return lines;
+}
+
+int main(void)
+{
+	char			path[] = "/tmp/histtestXXXXXX";
+	hist_filter_t	f;
+	FILE			*fp;
+	long			total = 0, lines;
+	int				fd, c;
+
+	if((fd = mkstemp(path)) < 0) {
+		perror("mkstemp");
+		return 1;
+	}
+	close(fd);
+	unlink(path);				/* hist_open creates it */
+
+	CHECK(write_history(path) == 0);
+	for(c = 0; c < NCH; c++)
+		total += ex[c].n;
+
+	/* everything back, in order, bit for bit */
+	memset(&f, 0, sizeof(f));
+	lines = read_back(path, &f);
+	CHECK(lines == total);
+	for(c = 0; c < NCH; c++) {
+		CHECK(ex[c].got == ex[c].n);
+		CHECK(ex[c].bad == 0);
+	}
+
+	/* a time window: only the points inside it */
+	f.fromMs = T0_MS + 500 * 1000;
+	f.toMs = T0_MS + 600 * 1000;
+	lines = read_back(path, &f);
+	{
+		long want = 0;
+		int k;
+
+		for(c = 0; c < NCH; c++)
+			for(k = 0; k < ex[c].n; k++)
+				if(ex[c].ms[k] >= f.fromMs && ex[c].ms[k] <= f.toMs)
+					want++;
+		CHECK(want > 0 && lines == want);
+	}
+
+	/* a torn chunk at the end is dropped when the file is opened again */
+	if((fp = fopen(path, "ab")) != NULL) {
+		static const uint32_t torn[3] = { HIST_CHUNK_MAGIC, 0x00010001u, 0u };
+
+		fwrite(torn, sizeof(torn), 1, fp);
+		fclose(fp);
+	}
+	{
+		acq_t		a;
+		acq_sink_t	sink;
+
+		memset(&a, 0, sizeof(a));
+		a.nPar = 1;
+		strcpy(a.par[0].name, "VMon");
+		CHECK(hist_open(path, &a, &sink, stderr) == 0);
+		sink.close(sink.ctx);
+	}
+	memset(&f, 0, sizeof(f));
+	CHECK(read_back(path, &f) == total);
+
+	unlink(path);
+	return check_done("hist");
+}
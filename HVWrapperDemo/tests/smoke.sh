@@ -0,0 +1,136 @@
+#!/bin/sh
+########################################################################
+#                                                                      #
+#              --- CAEN SpA - Computing Division ---                   #
+#                                                                      #
+#   CAENHVWRAPPER Software Project                                     #
+#                                                                      #
+#   smoke.sh: HVWrappdemo end to end against the simulated crate       #
+#                                                                      #
+#   Run by 'make test' as: sh tests/smoke.sh ./HVWrappdemo             #
+#   Each step runs the program in a scratch directory with its own     #
+#   crate state and pcache, and checks its exit code and output.       #
+#                                                                      #
+########################################################################
+
+PROG=${1:-./HVWrappdemo}
+PROG=$(cd "$(dirname "$PROG")" && pwd)/$(basename "$PROG")
+SIMDIR=$(dirname "$PROG")/sim
+
+if [ ! -f "$SIMDIR/libcaenhvwrapper.so" ]; then
+	echo "smoke: $SIMDIR/libcaenhvwrapper.so not built (make sim)" >&2
+	exit 1
+fi
+
+WORK=$(mktemp -d /tmp/hvsmokeXXXXXX) || exit 1
+DPID=
+EPID=
+trap 'kill $DPID $EPID 2>/dev/null; rm -rf "$WORK"' 0
+trap 'exit 1' INT TERM
+
+mkdir "$WORK/state" "$WORK/cache"
+LD_LIBRARY_PATH=$SIMDIR
+SIMHV_STATE=$WORK/state
+HVWRAPP_CACHE_DIR=$WORK/cache
+HVWRAPPD_SOCKET=$WORK/none.sock
+export LD_LIBRARY_PATH SIMHV_STATE HVWRAPP_CACHE_DIR HVWRAPPD_SOCKET
+unset SIMHV_FAIL_RATE SIMHV_TRIP_RATE SIMHV_LATENCY_US SIMHV_JITTER_US SIMHV_CRATE
+cd "$WORK" || exit 1
+
+runs=0
+fails=0
+
+# run RC PATTERN ARGS..: HVWrappdemo ARGS must exit with RC and print a line matching PATTERN
+run()
+{
+	want=$1
+	pat=$2
+	shift 2
+	runs=$((runs + 1))
+	"$PROG" "$@" > out 2>&1
+	rc=$?
+	if [ $rc -ne "$want" ] || ! grep -Eq -- "$pat" out; then
+		fails=$((fails + 1))
+		echo "smoke: HVWrappdemo $* (exit $rc, want $want; '$pat' expected):" >&2
+		sed 's/^/    /' out >&2
+	fi
+}
+
+# lines LINES ARGS..: HVWrappdemo ARGS must print LINES lines on stdout
+lines()
+{
+	want=$1
+	shift
+	runs=$((runs + 1))
+	n=$("$PROG" "$@" 2>/dev/null | wc -l)
+	if [ "$n" -ne "$want" ]; then
+		fails=$((fails + 1))
+		echo "smoke: HVWrappdemo $*: $n line(s), want $want" >&2
+	fi
+}
+
+# reads and sets, kept in the crate state between runs
+run 0 'Slot 1  Ch 1  VMon = '		--no-daemon --ch 0 1 --VMon
+run 0 'OK: Pw = 1 applied to 2 channel'	--no-daemon --ch 0 1 --V0Set 500 --RUp 500 --PwOn
+run 0 'Ch 1  V0Set = 500.0+  Pw = 1'	--no-daemon --ch 0,1 --get V0Set,Pw
+run 0 'ChStatus = [0-9]+ \(On'		--no-daemon --ch 0 1 --snapshot
+run 0 'Slot 3  Ch 0  V0Set'		--no-daemon --slot all --ch all --get V0Set
+run 0 'Slot 3  Ch 11  IMon = '		--no-daemon --ch 1:0 3:all --IMon
+lines 5					--no-daemon --ch 0 1 --get VMon,Pw --format csv --cycles 2 --period 10
+run 0 'OK: 1 channel\(s\) at 520'	--no-daemon --ch 0 --ramp-to 520 --tol 2 --timeout 20
+
+# config names and globs (named: ../config/config.txt is tried before ./config.txt)
+printf 'ch  name  V0Set\n0  ecal_a  500\n1  ecal_b  500\n2  None  -\n' > config.txt
+run 0 'Ch 1  V0Set = '			--no-daemon --config config.txt --ch 'ecal_*' --get V0Set
+run 2 "No channel named 'nosuch'"	--no-daemon --config config.txt --ch nosuch --get V0Set
+run 0 'Slot 1  Ch 1  V0Set = '		--no-daemon --config config.txt --ch 0,1 --get V0Set
+
+# recording, history and filtering
+run 0 '3 parameter\(s\) on 1 slot'	--no-daemon --ch 0 1 --record r.ring --ring 1000 --period 20 --cycles 3
+lines 19				--rec-dump r.ring
+run 0 '2 parameter\(s\) on 1 slot'	--no-daemon --ch 0 1 --history h.hist --get VMon,IMon --period 20 --cycles 5
+run 0 ' 20 point\(s\)'			--hist-export h.hist
+lines 21				--hist-export h.hist
+lines 6					--hist-export h.hist --ch 1 --get VMon
+lines 11				--hist-export h.hist --config config.txt --ch ecal_a
+run 0 'Filter: 2 of 40 sample'		--no-daemon --ch 0 1 --trips --changes --period 20 --cycles 20
+run 0 'over 20 tick\(s\)'		--no-daemon --ch 0 1 --trips --period 20 --cycles 20
+
+# hvwrappd: a request served over its socket
+"$PROG" --daemon --socket "$WORK/d.sock" > daemon.out 2>&1 &
+DPID=$!
+i=0
+while [ ! -S "$WORK/d.sock" ] && [ $i -lt 50 ]; do
+	sleep 0.1
+	i=$((i + 1))
+done
+run 0 'Ch 0  V0Set = 520'		--socket "$WORK/d.sock" --ch 0 --get V0Set
+kill $DPID 2>/dev/null
+wait $DPID 2>/dev/null
+DPID=
+
+# exporter, when curl is there to scrape it
+if command -v curl > /dev/null 2>&1; then
+	port=$((20000 + $$ % 20000))
+	"$PROG" --no-daemon --slot all --ch all --exporter --listen 127.0.0.1:$port --period 100 > exp.out 2>&1 &
+	EPID=$!
+	i=0
+	until curl -sf http://127.0.0.1:$port/metrics > metrics 2>/dev/null || [ $i -ge 50 ]; do
+		sleep 0.1
+		i=$((i + 1))
+	done
+	runs=$((runs + 1))
+	if ! grep -q '^caenhv_up{host="192.168.1.2"} 1' metrics || ! grep -q '^caenhv_vmon{' metrics; then
+		fails=$((fails + 1))
+		echo "smoke: no caenhv_up 1 / caenhv_vmon on :$port/metrics:" >&2
+		sed 's/^/    /' exp.out metrics >&2
+	fi
+	kill $EPID 2>/dev/null
+	wait $EPID 2>/dev/null
+	EPID=
+else
+	echo "smoke: curl not found, exporter not scraped" >&2
+fi
+
+printf '%-10s %d check(s), %d failed\n' smoke $runs $fails
+[ $fails -eq 0 ]
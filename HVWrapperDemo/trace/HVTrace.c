@@ -0,0 +1,1069 @@
+/*****************************************************************************/
+/*                                                                           */
+/*        --- CAEN Engineering Srl - Computing Systems Division ---          */
+/*                                                                           */
+/*   HVTRACE.C                                                               */
+/*                                                                           */
+/*   libhvtrace.so, built by 'make trace': an LD_PRELOAD shim that wraps     */
+/*   every function of CAENHVWrapper.h and forwards it to the next library  */
+/*   in the search order (dlsym RTLD_NEXT). Each thread counts into its own */
+/*   block: calls, return codes, items per call (ChNum, slotNum, ...) and a */
+/*   log-linear latency histogram of 16 sub-buckets per power of two (6%    */
+/*   resolution, 1 ns to 137 s), plus the slowest call with its arguments.  */
+/*   The blocks are summed and printed on HVTRACE_SIGNAL (SIGUSR1) and at   */
+/*   exit, by a helper thread woken through a pipe, so a dump works while   */
+/*   the program is blocked inside the library.                             */
+/*                                                                           */
+/*   HVTRACE_OUT     file the dumps are appended to (%p = pid), stderr      */
+/*   HVTRACE_SIGNAL  signal number or name, 0 = none (USR1)                  */
+/*   HVTRACE_SLOW_US print every call slower than this as it returns (0)   */
+/*   HVTRACE_ATEXIT  0 = no dump at exit (1)                                 */
+/*                                                                           */
+/*****************************************************************************/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include "CAENHVWrapper.h"
+
+#define TR_SUB_BITS          4
+#define TR_SUB               (1 << TR_SUB_BITS)
+#define TR_MAX_EXP           37					/* 2^37 ns = 137 s, the last bucket */
+#define TR_LAT_BUCKETS       ((TR_MAX_EXP - TR_SUB_BITS + 2) * TR_SUB)
+#define TR_SIZE_BUCKETS      18					/* 0, 1, 2-3, ... 65536-131071 */
+#define TR_RET_SLOTS         41					/* 0..31, 0x1000..0x1007, others */
+#define TR_WHAT_LEN          24
+
+enum {
+	TR_LIBSWREL, TR_INITSYSTEM, TR_DEINITSYSTEM, TR_GETCRATEMAP,
+	TR_GETSYSPROPLIST, TR_GETSYSPROPINFO, TR_GETSYSPROP, TR_SETSYSPROP,
+	TR_GETBDPARAM, TR_SETBDPARAM, TR_GETBDPARAMPROP, TR_GETBDPARAMINFO, TR_TESTBDPRESENCE,
+	TR_GETCHPARAMPROP, TR_GETCHPARAMINFO, TR_GETCHNAME, TR_SETCHNAME, TR_GETCHPARAM, TR_SETCHPARAM,
+	TR_GETEXECCOMMLIST, TR_EXECCOMM,
+	TR_SUBSCRIBESYSTEM, TR_SUBSCRIBEBOARD, TR_SUBSCRIBECHANNEL,
+	TR_UNSUBSCRIBESYSTEM, TR_UNSUBSCRIBEBOARD, TR_UNSUBSCRIBECHANNEL,
+	TR_GETERROR, TR_GETEVENTDATA, TR_FREEEVENTDATA, TR_FREE,
+	TR_COUNT
+};
+
+static const char *fnNames[TR_COUNT] = {
+	"CAENHVLibSwRel", "CAENHV_InitSystem", "CAENHV_DeinitSystem", "CAENHV_GetCrateMap",
+	"CAENHV_GetSysPropList", "CAENHV_GetSysPropInfo", "CAENHV_GetSysProp", "CAENHV_SetSysProp",
+	"CAENHV_GetBdParam", "CAENHV_SetBdParam", "CAENHV_GetBdParamProp", "CAENHV_GetBdParamInfo",
+	"CAENHV_TestBdPresence",
+	"CAENHV_GetChParamProp", "CAENHV_GetChParamInfo", "CAENHV_GetChName", "CAENHV_SetChName",
+	"CAENHV_GetChParam", "CAENHV_SetChParam",
+	"CAENHV_GetExecCommList", "CAENHV_ExecComm",
+	"CAENHV_SubscribeSystemParams", "CAENHV_SubscribeBoardParams", "CAENHV_SubscribeChannelParams",
+	"CAENHV_UnSubscribeSystemParams", "CAENHV_UnSubscribeBoardParams", "CAENHV_UnSubscribeChannelParams",
+	"CAENHV_GetError", "CAENHV_GetEventData", "CAENHV_FreeEventData", "CAENHV_Free"
+};
+
+/* the slowest call seen, with what it was asked for */
+typedef struct {
+	int64_t			ns;
+	struct timespec	when;
+	int				handle, slot, ret;
+	unsigned		n;
+	long			tid;
+	char			what[TR_WHAT_LEN];
+} tr_slow_t;
+
+typedef struct {
+	uint64_t		calls, errors, sumNs, sumN;
+	uint32_t		maxN;
+	uint32_t		lat[TR_LAT_BUCKETS];
+	uint32_t		size[TR_SIZE_BUCKETS];
+	uint32_t		ret[TR_RET_SLOTS];
+	tr_slow_t		slowest;
+} tr_fn_t;
+
+/* written only by its thread; blocks of finished threads are handed to new ones */
+typedef struct tr_thread {
+	tr_fn_t				fn[TR_COUNT];
+	long				tid;
+	int					retired;
+	struct tr_thread	*next;
+} tr_thread_t;
+
+static void						*fnReal[TR_COUNT];
+static __thread tr_thread_t		*self __attribute__((tls_model("initial-exec")));
+
+static pthread_mutex_t	threadsLock = PTHREAD_MUTEX_INITIALIZER;
+static tr_thread_t		*threads;
+static pthread_key_t	threadKey;
+static int				started;				/* dump thread running */
+
+static pthread_mutex_t	outLock = PTHREAD_MUTEX_INITIALIZER;
+static char				outPath[512];
+static int				trSignal = SIGUSR1;
+static int64_t			slowNs;
+static int				atExit = 1;
+static int				wakeFd[2] = { -1, -1 };
+static int64_t			t0Mono;
+
+static inline int64_t tr_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long tr_gettid(void)
+{
+	return (long)syscall(SYS_gettid);
+}
+
+/*****************************************************************************/
+/*  Histogram indices: values below 2*TR_SUB are exact, above them each     */
+/*  power of two is split in TR_SUB equal steps.                             */
+/*****************************************************************************/
+static inline int lat_bucket(uint64_t ns)
+{
+	int e, i;
+
+	if(ns < 2 * TR_SUB)
+		return (int)ns;
+	e = 63 - __builtin_clzll(ns);
+	i = (e - TR_SUB_BITS + 1) * TR_SUB + (int)((ns >> (e - TR_SUB_BITS)) & (TR_SUB - 1));
+	return i < TR_LAT_BUCKETS ? i : TR_LAT_BUCKETS - 1;
+}
+
+static double lat_bucket_mid(int i)
+{
+	int e, m;
+
+	if(i < 2 * TR_SUB)
+		return (double)i;
+	e = i / TR_SUB + TR_SUB_BITS - 1;
+	m = i % TR_SUB;
+	return (double)((uint64_t)(TR_SUB + m) << (e - TR_SUB_BITS))
+	       + (double)((uint64_t)1 << (e - TR_SUB_BITS)) / 2.0;
+}
+
+static inline int size_bucket(unsigned n)
+{
+	int b = n ? 32 - __builtin_clz(n) : 0;
+
+	return b < TR_SIZE_BUCKETS ? b : TR_SIZE_BUCKETS - 1;
+}
+
+static inline int ret_slot(CAENHVRESULT ret)
+{
+	if(ret >= 0 && ret < 32)
+		return ret;
+	if(ret >= 0x1000 && ret < 0x1008)
+		return 32 + ret - 0x1000;
+	return TR_RET_SLOTS - 1;
+}
+
+static int ret_code(int slot)
+{
+	return slot < 32 ? slot : 0x1000 + slot - 32;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  OUTPUT                                                                   */
+/*                                                                           */
+/*****************************************************************************/
+static FILE *out_open(void)
+{
+	char	path[sizeof(outPath) + 16];
+	size_t	o = 0;
+	const char *p;
+
+	if(outPath[0] == '\0')
+		return stderr;
+	for(p = outPath; *p != '\0' && o < sizeof(path) - 12; p++) {
+		if(p[0] == '%' && p[1] == 'p') {
+			o += snprintf(path + o, sizeof(path) - o, "%ld", (long)getpid());
+			p++;
+		}
+		else
+			path[o++] = *p;
+	}
+	path[o] = '\0';
+	return fopen(path, "a");
+}
+
+static void out_close(FILE *f)
+{
+	if(f == stderr)
+		fflush(f);
+	else if(f != NULL)
+		fclose(f);
+}
+
+static void fmt_wall(const struct timespec *ts, char *buf, size_t len)
+{
+	struct tm	tm;
+	size_t		n;
+
+	localtime_r(&ts->tv_sec, &tm);
+	n = strftime(buf, len, "%H:%M:%S", &tm);
+	snprintf(buf + n, len - n, ".%03d", (int)(ts->tv_nsec / 1000000L) % 1000);
+}
+
+static void slow_print(FILE *f, const tr_slow_t *s)
+{
+	char when[16];
+
+	fmt_wall(&s->when, when, sizeof(when));
+	fprintf(f, "%.3f ms at %s tid %ld h %d", (double)s->ns / 1e6, when, s->tid, s->handle);
+	if(s->slot >= 0)
+		fprintf(f, " slot %d", s->slot);
+	if(s->what[0] != '\0')
+		fprintf(f, " %s", s->what);
+	fprintf(f, " n %u ret %d", s->n, s->ret);
+}
+
+/* middle of the bucket holding the q-th call, never above the exact maximum */
+static double hist_quantile(const tr_fn_t *d, double q)
+{
+	uint64_t	want = (uint64_t)(q * (double)d->calls + 0.999999), sum = 0;
+	double		v = lat_bucket_mid(TR_LAT_BUCKETS - 1);
+	int			i;
+
+	if(want == 0)
+		want = 1;
+	for(i = 0; i < TR_LAT_BUCKETS; i++) {
+		sum += d->lat[i];
+		if(sum >= want) {
+			v = lat_bucket_mid(i);
+			break;
+		}
+	}
+	return v < (double)d->slowest.ns ? v : (double)d->slowest.ns;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  TR_DUMP                                                                  */
+/*  Sums the thread blocks and prints one row per function called. Blocks   */
+/*  of running threads are read as they are, without stopping them.          */
+/*                                                                           */
+/*****************************************************************************/
+static void tr_dump(const char *reason)
+{
+	static tr_fn_t	sum[TR_COUNT];
+	tr_thread_t		*t;
+	FILE			*f;
+	int				i, j, b, nThreads = 0;
+	double			up;
+	char			when[16];
+	struct timespec	now;
+
+	pthread_mutex_lock(&outLock);
+	memset(sum, 0, sizeof(sum));
+	pthread_mutex_lock(&threadsLock);
+	for(t = threads; t != NULL; t = t->next) {
+		nThreads++;
+		for(i = 0; i < TR_COUNT; i++) {
+			const tr_fn_t *s = &t->fn[i];
+			tr_fn_t *d = &sum[i];
+
+			if(s->calls == 0)
+				continue;
+			d->calls += s->calls;
+			d->errors += s->errors;
+			d->sumNs += s->sumNs;
+			d->sumN += s->sumN;
+			if(s->maxN > d->maxN)
+				d->maxN = s->maxN;
+			for(j = 0; j < TR_LAT_BUCKETS; j++)
+				d->lat[j] += s->lat[j];
+			for(j = 0; j < TR_SIZE_BUCKETS; j++)
+				d->size[j] += s->size[j];
+			for(j = 0; j < TR_RET_SLOTS; j++)
+				d->ret[j] += s->ret[j];
+			if(s->slowest.ns > d->slowest.ns)
+				d->slowest = s->slowest;
+		}
+	}
+	pthread_mutex_unlock(&threadsLock);
+
+	if((f = out_open()) == NULL) {
+		pthread_mutex_unlock(&outLock);
+		return;
+	}
+	clock_gettime(CLOCK_REALTIME, &now);
+	fmt_wall(&now, when, sizeof(when));
+	up = (double)(tr_now() - t0Mono) / 1e9;
+	fprintf(f, "# hvtrace pid %ld, %s, %s, %.3f s traced, %d thread blocks\n",
+	        (long)getpid(), when, reason, up, nThreads);
+	fprintf(f, "%-31s %9s %7s %10s %10s %10s %10s %10s %11s %10s\n", "function", "calls", "errors",
+	        "p50_us", "p90_us", "p99_us", "max_us", "mean_us", "total_ms", "items");
+	for(i = 0; i < TR_COUNT; i++) {
+		const tr_fn_t *d = &sum[i];
+		char items[24];
+
+		if(d->calls == 0)
+			continue;
+		snprintf(items, sizeof(items), "%.1f/%u", (double)d->sumN / (double)d->calls, d->maxN);
+		fprintf(f, "%-31s %9llu %7llu %10.1f %10.1f %10.1f %10.1f %10.1f %11.1f %10s\n", fnNames[i],
+		        (unsigned long long)d->calls, (unsigned long long)d->errors,
+		        hist_quantile(d, 0.50) / 1e3, hist_quantile(d, 0.90) / 1e3, hist_quantile(d, 0.99) / 1e3, (double)d->slowest.ns / 1e3,
+		        (double)d->sumNs / (double)d->calls / 1e3, (double)d->sumNs / 1e6, items);
+
+		fprintf(f, "    ret");
+		for(j = 0; j < TR_RET_SLOTS; j++) {
+			if(d->ret[j] == 0)
+				continue;
+			if(j == TR_RET_SLOTS - 1)
+				fprintf(f, " other:%u", d->ret[j]);
+			else if(j < 32)
+				fprintf(f, " %d:%u", j, d->ret[j]);
+			else
+				fprintf(f, " %#x:%u", ret_code(j), d->ret[j]);
+		}
+		fprintf(f, "  items");
+		for(b = 0; b < TR_SIZE_BUCKETS; b++) {
+			if(d->size[b] == 0)
+				continue;
+			if(b <= 1)
+				fprintf(f, " %d:%u", b, d->size[b]);
+			else
+				fprintf(f, " %u-%u:%u", 1u << (b - 1), (1u << b) - 1, d->size[b]);
+		}
+		fprintf(f, "\n    slowest ");
+		slow_print(f, &d->slowest);
+		fprintf(f, "\n");
+	}
+	out_close(f);
+	pthread_mutex_unlock(&outLock);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  DUMP THREAD                                                              */
+/*  The signal handler only writes one byte to a pipe; the dump itself is   */
+/*  made here, outside of signal context.                                    */
+/*                                                                           */
+/*****************************************************************************/
+static void on_signal(int sig)
+{
+	int		saved = errno;
+	char	c = 'd';
+
+	(void)sig;
+	if(write(wakeFd[1], &c, 1) < 0) {
+		/* pipe full: a dump is already pending */
+	}
+	errno = saved;
+}
+
+static void *dump_thread(void *arg)
+{
+	char c;
+
+	(void)arg;
+	for(;;) {
+		ssize_t r = read(wakeFd[0], &c, 1);
+
+		if(r == 1)
+			tr_dump("signal");
+		else if(r < 0 && errno == EINTR)
+			continue;
+		else
+			break;
+	}
+	return NULL;
+}
+
+/* called with threadsLock held, by the first call of the process (or of a forked child) */
+static void dump_start(void)
+{
+	struct sigaction	sa, old;
+	pthread_attr_t		attr;
+	pthread_t			tid;
+	sigset_t			all, prev;
+
+	started = 1;
+	if(trSignal <= 0)
+		return;
+	if(pipe(wakeFd) != 0)
+		return;
+	fcntl(wakeFd[0], F_SETFD, FD_CLOEXEC);
+	fcntl(wakeFd[1], F_SETFD, FD_CLOEXEC);
+	fcntl(wakeFd[1], F_SETFL, O_NONBLOCK);
+
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &prev);
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if(pthread_create(&tid, &attr, dump_thread, NULL) != 0) {
+		pthread_sigmask(SIG_SETMASK, &prev, NULL);
+		pthread_attr_destroy(&attr);
+		return;
+	}
+	pthread_attr_destroy(&attr);
+	pthread_sigmask(SIG_SETMASK, &prev, NULL);
+
+	/* never take the signal from a program that handles it itself */
+	if(sigaction(trSignal, NULL, &old) == 0 && old.sa_handler == SIG_DFL
+	   && !(old.sa_flags & SA_SIGINFO)) {
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = on_signal;
+		sa.sa_flags = SA_RESTART;
+		sigemptyset(&sa.sa_mask);
+		sigaction(trSignal, &sa, NULL);
+	}
+}
+
+static void thread_retire(void *p)
+{
+	pthread_mutex_lock(&threadsLock);
+	((tr_thread_t *)p)->retired = 1;
+	pthread_mutex_unlock(&threadsLock);
+}
+
+/* the first call of a thread: adopt a block a finished thread left, or add one */
+static tr_thread_t *thread_enter(void)
+{
+	tr_thread_t *t;
+
+	pthread_mutex_lock(&threadsLock);
+	if(!started)
+		dump_start();
+	for(t = threads; t != NULL && !t->retired; t = t->next)
+		;
+	if(t == NULL && (t = calloc(1, sizeof(*t))) != NULL) {
+		t->next = threads;
+		threads = t;
+	}
+	if(t != NULL) {
+		t->retired = 0;
+		t->tid = tr_gettid();
+		pthread_setspecific(threadKey, t);
+	}
+	pthread_mutex_unlock(&threadsLock);
+	self = t;
+	return t;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  TR_END                                                                   */
+/*  Accounts one call in the block of the calling thread: no lock, no       */
+/*  atomics. 'n' is the number of items the call carries (channels, slots,  */
+/*  parameters, events), 'what' the parameter or property it names.         */
+/*                                                                           */
+/*****************************************************************************/
+static void tr_end(int fn, int64_t t0, CAENHVRESULT ret, int handle, int slot, unsigned n, const char *what)
+{
+	int64_t		ns = tr_now() - t0;
+	tr_thread_t	*t = self;
+	tr_fn_t		*d;
+
+	if(ns < 0)
+		ns = 0;
+	if(t == NULL && (t = thread_enter()) == NULL)
+		return;
+	d = &t->fn[fn];
+	d->calls++;
+	d->errors += (ret != CAENHV_OK);
+	d->sumNs += (uint64_t)ns;
+	d->sumN += n;
+	if(n > d->maxN)
+		d->maxN = n;
+	d->lat[lat_bucket((uint64_t)ns)]++;
+	d->size[size_bucket(n)]++;
+	d->ret[ret_slot(ret)]++;
+	if(ns > d->slowest.ns || (slowNs > 0 && ns >= slowNs)) {
+		tr_slow_t s;
+
+		s.ns = ns;
+		clock_gettime(CLOCK_REALTIME, &s.when);
+		s.handle = handle;
+		s.slot = slot;
+		s.ret = ret;
+		s.n = n;
+		s.tid = t->tid;
+		s.what[0] = '\0';
+		if(what != NULL)
+			snprintf(s.what, sizeof(s.what), "%s", what);
+		if(ns > d->slowest.ns)
+			d->slowest = s;
+		if(slowNs > 0 && ns >= slowNs) {
+			FILE *f;
+
+			pthread_mutex_lock(&outLock);
+			if((f = out_open()) != NULL) {
+				fprintf(f, "# hvtrace slow %s ", fnNames[fn]);
+				slow_print(f, &s);
+				fprintf(f, "\n");
+				out_close(f);
+			}
+			pthread_mutex_unlock(&outLock);
+		}
+	}
+}
+
+static void *real_fn(int fn)
+{
+	void *p = __atomic_load_n(&fnReal[fn], __ATOMIC_ACQUIRE);
+
+	if(p == NULL) {
+		p = dlsym(RTLD_NEXT, fnNames[fn]);
+		__atomic_store_n(&fnReal[fn], p, __ATOMIC_RELEASE);
+	}
+	return p;
+}
+
+static CAENHVRESULT tr_missing(int fn)
+{
+	static int told;
+
+	if(!__atomic_exchange_n(&told, 1, __ATOMIC_RELAXED))
+		fprintf(stderr, "hvtrace: %s not found after libhvtrace.so (is libcaenhvwrapper loaded?)\n",
+		        fnNames[fn]);
+	return CAENHV_FUNCTIONNOTAVAILABLE;
+}
+
+/* a forked child starts from zero; its first call starts its own dump thread */
+static void at_fork_child(void)
+{
+	tr_thread_t *t;
+
+	pthread_mutex_init(&threadsLock, NULL);
+	pthread_mutex_init(&outLock, NULL);
+	for(t = threads; t != NULL; t = t->next) {
+		memset(t->fn, 0, sizeof(t->fn));
+		t->retired = 1;
+	}
+	self = NULL;
+	if(wakeFd[0] >= 0) {
+		close(wakeFd[0]);
+		close(wakeFd[1]);
+		wakeFd[0] = wakeFd[1] = -1;
+	}
+	started = 0;
+	t0Mono = tr_now();
+}
+
+static int signal_from_env(const char *v)
+{
+	static const struct { const char *name; int sig; } sigs[] = {
+		{ "USR1", SIGUSR1 }, { "USR2", SIGUSR2 }, { "HUP", SIGHUP }, { "PROF", SIGPROF }, { "URG", SIGURG }
+	};
+	size_t i;
+
+	if(strncmp(v, "SIG", 3) == 0)
+		v += 3;
+	for(i = 0; i < sizeof(sigs) / sizeof(sigs[0]); i++)
+		if(strcmp(v, sigs[i].name) == 0)
+			return sigs[i].sig;
+	return atoi(v);
+}
+
+__attribute__((constructor))
+static void tr_init(void)
+{
+	const char *v;
+
+	t0Mono = tr_now();
+	if((v = getenv("HVTRACE_OUT")) != NULL)
+		snprintf(outPath, sizeof(outPath), "%s", v);
+	if((v = getenv("HVTRACE_SIGNAL")) != NULL && *v != '\0')
+		trSignal = signal_from_env(v);
+	if((v = getenv("HVTRACE_SLOW_US")) != NULL)
+		slowNs = (int64_t)(atof(v) * 1e3);
+	if((v = getenv("HVTRACE_ATEXIT")) != NULL)
+		atExit = atoi(v) != 0;
+	pthread_key_create(&threadKey, thread_retire);
+	pthread_atfork(NULL, NULL, at_fork_child);
+}
+
+__attribute__((destructor))
+static void tr_fini(void)
+{
+	if(atExit && threads != NULL)
+		tr_dump("exit");
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  WRAPPERS                                                                 */
+/*                                                                           */
+/*****************************************************************************/
+char *CAENHVLibSwRel(void)
+{
+	char *(*fn)(void) = real_fn(TR_LIBSWREL);
+	int64_t t0;
+	char *r;
+
+	if(fn == NULL) {
+		tr_missing(TR_LIBSWREL);
+		return "hvtrace: no library";
+	}
+	t0 = tr_now();
+	r = fn();
+	tr_end(TR_LIBSWREL, t0, CAENHV_OK, -1, -1, 0, NULL);
+	return r;
+}
+
+CAENHVRESULT CAENHV_InitSystem(CAENHV_SYSTEM_TYPE_t system, int LinkType, void *Arg,
+                               const char *UserName, const char *Passwd, int *handle)
+{
+	CAENHVRESULT (*fn)(CAENHV_SYSTEM_TYPE_t, int, void *, const char *, const char *, int *) =
+		real_fn(TR_INITSYSTEM);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_INITSYSTEM);
+	t0 = tr_now();
+	ret = fn(system, LinkType, Arg, UserName, Passwd, handle);
+	tr_end(TR_INITSYSTEM, t0, ret, (ret == CAENHV_OK && handle != NULL) ? *handle : -1, -1, 1,
+	       LinkType == LINKTYPE_TCPIP ? (const char *)Arg : NULL);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_DeinitSystem(int handle)
+{
+	CAENHVRESULT (*fn)(int) = real_fn(TR_DEINITSYSTEM);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_DEINITSYSTEM);
+	t0 = tr_now();
+	ret = fn(handle);
+	tr_end(TR_DEINITSYSTEM, t0, ret, handle, -1, 1, NULL);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_GetCrateMap(int handle, ushort *NrOfSlot, ushort **NrofChList, char **ModelList,
+                                char **DescriptionList, ushort **SerNumList, uchar **FmwRelMinList,
+                                uchar **FmwRelMaxList)
+{
+	CAENHVRESULT (*fn)(int, ushort *, ushort **, char **, char **, ushort **, uchar **, uchar **) =
+		real_fn(TR_GETCRATEMAP);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_GETCRATEMAP);
+	t0 = tr_now();
+	ret = fn(handle, NrOfSlot, NrofChList, ModelList, DescriptionList, SerNumList, FmwRelMinList, FmwRelMaxList);
+	tr_end(TR_GETCRATEMAP, t0, ret, handle, -1, (ret == CAENHV_OK && NrOfSlot != NULL) ? *NrOfSlot : 0, NULL);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_GetSysPropList(int handle, ushort *NumProp, char **PropNameList)
+{
+	CAENHVRESULT (*fn)(int, ushort *, char **) = real_fn(TR_GETSYSPROPLIST);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_GETSYSPROPLIST);
+	t0 = tr_now();
+	ret = fn(handle, NumProp, PropNameList);
+	tr_end(TR_GETSYSPROPLIST, t0, ret, handle, -1, (ret == CAENHV_OK && NumProp != NULL) ? *NumProp : 0, NULL);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_GetSysPropInfo(int handle, const char *PropName, unsigned *PropMode, unsigned *PropType)
+{
+	CAENHVRESULT (*fn)(int, const char *, unsigned *, unsigned *) = real_fn(TR_GETSYSPROPINFO);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_GETSYSPROPINFO);
+	t0 = tr_now();
+	ret = fn(handle, PropName, PropMode, PropType);
+	tr_end(TR_GETSYSPROPINFO, t0, ret, handle, -1, 1, PropName);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_GetSysProp(int handle, const char *PropName, void *Result)
+{
+	CAENHVRESULT (*fn)(int, const char *, void *) = real_fn(TR_GETSYSPROP);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_GETSYSPROP);
+	t0 = tr_now();
+	ret = fn(handle, PropName, Result);
+	tr_end(TR_GETSYSPROP, t0, ret, handle, -1, 1, PropName);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_SetSysProp(int handle, const char *PropName, void *Set)
+{
+	CAENHVRESULT (*fn)(int, const char *, void *) = real_fn(TR_SETSYSPROP);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_SETSYSPROP);
+	t0 = tr_now();
+	ret = fn(handle, PropName, Set);
+	tr_end(TR_SETSYSPROP, t0, ret, handle, -1, 1, PropName);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_GetBdParam(int handle, ushort slotNum, const ushort *slotList, const char *ParName,
+                               void *ParValList)
+{
+	CAENHVRESULT (*fn)(int, ushort, const ushort *, const char *, void *) = real_fn(TR_GETBDPARAM);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_GETBDPARAM);
+	t0 = tr_now();
+	ret = fn(handle, slotNum, slotList, ParName, ParValList);
+	tr_end(TR_GETBDPARAM, t0, ret, handle, (slotNum > 0 && slotList != NULL) ? slotList[0] : -1, slotNum, ParName);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_SetBdParam(int handle, ushort slotNum, const ushort *slotList, const char *ParName,
+                               void *ParValue)
+{
+	CAENHVRESULT (*fn)(int, ushort, const ushort *, const char *, void *) = real_fn(TR_SETBDPARAM);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_SETBDPARAM);
+	t0 = tr_now();
+	ret = fn(handle, slotNum, slotList, ParName, ParValue);
+	tr_end(TR_SETBDPARAM, t0, ret, handle, (slotNum > 0 && slotList != NULL) ? slotList[0] : -1, slotNum, ParName);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_GetBdParamProp(int handle, ushort slot, const char *ParName, const char *PropName,
+                                   void *retval)
+{
+	CAENHVRESULT (*fn)(int, ushort, const char *, const char *, void *) = real_fn(TR_GETBDPARAMPROP);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_GETBDPARAMPROP);
+	t0 = tr_now();
+	ret = fn(handle, slot, ParName, PropName, retval);
+	tr_end(TR_GETBDPARAMPROP, t0, ret, handle, slot, 1, ParName);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_GetBdParamInfo(int handle, ushort slot, char **ParNameList)
+{
+	CAENHVRESULT (*fn)(int, ushort, char **) = real_fn(TR_GETBDPARAMINFO);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_GETBDPARAMINFO);
+	t0 = tr_now();
+	ret = fn(handle, slot, ParNameList);
+	tr_end(TR_GETBDPARAMINFO, t0, ret, handle, slot, 1, NULL);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_TestBdPresence(int handle, ushort slot, ushort *NrofCh, char **Model, char **Description,
+                                   ushort *SerNum, uchar *FmwRelMin, uchar *FmwRelMax)
+{
+	CAENHVRESULT (*fn)(int, ushort, ushort *, char **, char **, ushort *, uchar *, uchar *) =
+		real_fn(TR_TESTBDPRESENCE);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_TESTBDPRESENCE);
+	t0 = tr_now();
+	ret = fn(handle, slot, NrofCh, Model, Description, SerNum, FmwRelMin, FmwRelMax);
+	tr_end(TR_TESTBDPRESENCE, t0, ret, handle, slot, 1, NULL);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_GetChParamProp(int handle, ushort slot, ushort Ch, const char *ParName,
+                                   const char *PropName, void *retval)
+{
+	CAENHVRESULT (*fn)(int, ushort, ushort, const char *, const char *, void *) = real_fn(TR_GETCHPARAMPROP);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_GETCHPARAMPROP);
+	t0 = tr_now();
+	ret = fn(handle, slot, Ch, ParName, PropName, retval);
+	tr_end(TR_GETCHPARAMPROP, t0, ret, handle, slot, 1, ParName);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_GetChParamInfo(int handle, ushort slot, ushort Ch, char **ParNameList, int *ParNumber)
+{
+	CAENHVRESULT (*fn)(int, ushort, ushort, char **, int *) = real_fn(TR_GETCHPARAMINFO);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_GETCHPARAMINFO);
+	t0 = tr_now();
+	ret = fn(handle, slot, Ch, ParNameList, ParNumber);
+	tr_end(TR_GETCHPARAMINFO, t0, ret, handle, slot,
+	       (ret == CAENHV_OK && ParNumber != NULL && *ParNumber > 0) ? (unsigned)*ParNumber : 0, NULL);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_GetChName(int handle, ushort slot, ushort ChNum, const ushort *ChList,
+                              char (*ChNameList)[MAX_CH_NAME])
+{
+	CAENHVRESULT (*fn)(int, ushort, ushort, const ushort *, char (*)[MAX_CH_NAME]) = real_fn(TR_GETCHNAME);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_GETCHNAME);
+	t0 = tr_now();
+	ret = fn(handle, slot, ChNum, ChList, ChNameList);
+	tr_end(TR_GETCHNAME, t0, ret, handle, slot, ChNum, NULL);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_SetChName(int handle, ushort slot, ushort ChNum, const ushort *ChList, const char *ChName)
+{
+	CAENHVRESULT (*fn)(int, ushort, ushort, const ushort *, const char *) = real_fn(TR_SETCHNAME);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_SETCHNAME);
+	t0 = tr_now();
+	ret = fn(handle, slot, ChNum, ChList, ChName);
+	tr_end(TR_SETCHNAME, t0, ret, handle, slot, ChNum, ChName);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_GetChParam(int handle, ushort slot, const char *ParName, ushort ChNum,
+                               const ushort *ChList, void *ParValList)
+{
+	CAENHVRESULT (*fn)(int, ushort, const char *, ushort, const ushort *, void *) = real_fn(TR_GETCHPARAM);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_GETCHPARAM);
+	t0 = tr_now();
+	ret = fn(handle, slot, ParName, ChNum, ChList, ParValList);
+	tr_end(TR_GETCHPARAM, t0, ret, handle, slot, ChNum, ParName);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_SetChParam(int handle, ushort slot, const char *ParName, ushort ChNum,
+                               const ushort *ChList, void *ParValue)
+{
+	CAENHVRESULT (*fn)(int, ushort, const char *, ushort, const ushort *, void *) = real_fn(TR_SETCHPARAM);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_SETCHPARAM);
+	t0 = tr_now();
+	ret = fn(handle, slot, ParName, ChNum, ChList, ParValue);
+	tr_end(TR_SETCHPARAM, t0, ret, handle, slot, ChNum, ParName);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_GetExecCommList(int handle, ushort *NumComm, char **CommNameList)
+{
+	CAENHVRESULT (*fn)(int, ushort *, char **) = real_fn(TR_GETEXECCOMMLIST);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_GETEXECCOMMLIST);
+	t0 = tr_now();
+	ret = fn(handle, NumComm, CommNameList);
+	tr_end(TR_GETEXECCOMMLIST, t0, ret, handle, -1, (ret == CAENHV_OK && NumComm != NULL) ? *NumComm : 0, NULL);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_ExecComm(int handle, const char *CommName)
+{
+	CAENHVRESULT (*fn)(int, const char *) = real_fn(TR_EXECCOMM);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_EXECCOMM);
+	t0 = tr_now();
+	ret = fn(handle, CommName);
+	tr_end(TR_EXECCOMM, t0, ret, handle, -1, 1, CommName);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_SubscribeSystemParams(int handle, short Port, const char *paramNameList,
+                                          unsigned int paramNum, char *listOfResultCodes)
+{
+	CAENHVRESULT (*fn)(int, short, const char *, unsigned int, char *) = real_fn(TR_SUBSCRIBESYSTEM);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_SUBSCRIBESYSTEM);
+	t0 = tr_now();
+	ret = fn(handle, Port, paramNameList, paramNum, listOfResultCodes);
+	tr_end(TR_SUBSCRIBESYSTEM, t0, ret, handle, -1, paramNum, paramNameList);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_SubscribeBoardParams(int handle, short Port, const unsigned short slotIndex,
+                                         const char *paramNameList, unsigned int paramNum, char *listOfResultCodes)
+{
+	CAENHVRESULT (*fn)(int, short, const unsigned short, const char *, unsigned int, char *) =
+		real_fn(TR_SUBSCRIBEBOARD);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_SUBSCRIBEBOARD);
+	t0 = tr_now();
+	ret = fn(handle, Port, slotIndex, paramNameList, paramNum, listOfResultCodes);
+	tr_end(TR_SUBSCRIBEBOARD, t0, ret, handle, slotIndex, paramNum, paramNameList);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_SubscribeChannelParams(int handle, short Port, const unsigned short slotIndex,
+                                           const unsigned short chanIndex, const char *paramNameList,
+                                           unsigned int paramNum, char *listOfResultCodes)
+{
+	CAENHVRESULT (*fn)(int, short, const unsigned short, const unsigned short, const char *, unsigned int,
+	                   char *) = real_fn(TR_SUBSCRIBECHANNEL);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_SUBSCRIBECHANNEL);
+	t0 = tr_now();
+	ret = fn(handle, Port, slotIndex, chanIndex, paramNameList, paramNum, listOfResultCodes);
+	tr_end(TR_SUBSCRIBECHANNEL, t0, ret, handle, slotIndex, paramNum, paramNameList);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_UnSubscribeSystemParams(int handle, short Port, const char *paramNameList,
+                                            unsigned int paramNum, char *listOfResultCodes)
+{
+	CAENHVRESULT (*fn)(int, short, const char *, unsigned int, char *) = real_fn(TR_UNSUBSCRIBESYSTEM);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_UNSUBSCRIBESYSTEM);
+	t0 = tr_now();
+	ret = fn(handle, Port, paramNameList, paramNum, listOfResultCodes);
+	tr_end(TR_UNSUBSCRIBESYSTEM, t0, ret, handle, -1, paramNum, paramNameList);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_UnSubscribeBoardParams(int handle, short Port, const unsigned short slotIndex,
+                                           const char *paramNameList, unsigned int paramNum,
+                                           char *listOfResultCodes)
+{
+	CAENHVRESULT (*fn)(int, short, const unsigned short, const char *, unsigned int, char *) =
+		real_fn(TR_UNSUBSCRIBEBOARD);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_UNSUBSCRIBEBOARD);
+	t0 = tr_now();
+	ret = fn(handle, Port, slotIndex, paramNameList, paramNum, listOfResultCodes);
+	tr_end(TR_UNSUBSCRIBEBOARD, t0, ret, handle, slotIndex, paramNum, paramNameList);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_UnSubscribeChannelParams(int handle, short Port, const unsigned short slotIndex,
+                                             const unsigned short chanIndex, const char *paramNameList,
+                                             unsigned int paramNum, char *listOfResultCodes)
+{
+	CAENHVRESULT (*fn)(int, short, const unsigned short, const unsigned short, const char *, unsigned int,
+	                   char *) = real_fn(TR_UNSUBSCRIBECHANNEL);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_UNSUBSCRIBECHANNEL);
+	t0 = tr_now();
+	ret = fn(handle, Port, slotIndex, chanIndex, paramNameList, paramNum, listOfResultCodes);
+	tr_end(TR_UNSUBSCRIBECHANNEL, t0, ret, handle, slotIndex, paramNum, paramNameList);
+	return ret;
+}
+
+char *CAENHV_GetError(int handle)
+{
+	char *(*fn)(int) = real_fn(TR_GETERROR);
+	int64_t t0;
+	char *r;
+
+	if(fn == NULL) {
+		tr_missing(TR_GETERROR);
+		return "hvtrace: no library";
+	}
+	t0 = tr_now();
+	r = fn(handle);
+	tr_end(TR_GETERROR, t0, CAENHV_OK, handle, -1, 0, NULL);
+	return r;
+}
+
+CAENHVRESULT CAENHV_GetEventData(int sck, CAENHV_SYSTEMSTATUS_t *SysStatus, CAENHVEVENT_TYPE_t **EventData,
+                                 unsigned int *DataNumber)
+{
+	CAENHVRESULT (*fn)(int, CAENHV_SYSTEMSTATUS_t *, CAENHVEVENT_TYPE_t **, unsigned int *) =
+		real_fn(TR_GETEVENTDATA);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_GETEVENTDATA);
+	t0 = tr_now();
+	ret = fn(sck, SysStatus, EventData, DataNumber);
+	tr_end(TR_GETEVENTDATA, t0, ret, -1, -1, (ret == CAENHV_OK && DataNumber != NULL) ? *DataNumber : 0, NULL);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_FreeEventData(CAENHVEVENT_TYPE_t **ListOfItemsData)
+{
+	CAENHVRESULT (*fn)(CAENHVEVENT_TYPE_t **) = real_fn(TR_FREEEVENTDATA);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_FREEEVENTDATA);
+	t0 = tr_now();
+	ret = fn(ListOfItemsData);
+	tr_end(TR_FREEEVENTDATA, t0, ret, -1, -1, 0, NULL);
+	return ret;
+}
+
+CAENHVRESULT CAENHV_Free(void *arg)
+{
+	CAENHVRESULT (*fn)(void *) = real_fn(TR_FREE);
+	int64_t t0;
+	CAENHVRESULT ret;
+
+	if(fn == NULL)
+		return tr_missing(TR_FREE);
+	t0 = tr_now();
+	ret = fn(arg);
+	tr_end(TR_FREE, t0, ret, -1, -1, 0, NULL);
+	return ret;
+}